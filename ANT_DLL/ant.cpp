@@ -40,7 +40,8 @@ All rights reserved.
 #endif
 
 
-#define MAX_CHANNELS ((UCHAR) 8)
+#define MAX_CHANNELS ((UCHAR) (CHANNEL_NUMBER_MASK + 1))   // Every channel number a message can carry, whatever the device supports
+#define MESSAGE_BATCH_SIZE ((ULONG) 32)   // Messages taken from the framer each time the message thread wakes
 
 #define MESG_CHANNEL_OFFSET                  0
 #define MESG_EVENT_ID_OFFSET                 1
@@ -79,7 +80,7 @@ static DSI_THREAD_IDNUM eTheThread;
 
 // Local funcs
 static DSI_THREAD_RETURN MessageThread(void *pvParameter_);
-static void SerialHaveMessage(ANT_MESSAGE& stMessage_, USHORT usSize_);
+static void SerialHaveMessage(const ANT_MESSAGE& stMessage_, USHORT usSize_);
 static void MemoryCleanup(); //Deletes internal objects from memory
 
 extern "C" EXPORT
@@ -176,6 +177,10 @@ BOOL ANT_InitExt(UCHAR ucUSBDeviceNum, ULONG ulBaudrate, UCHAR ucPortType_, UCHA
       return(FALSE);
    }
 
+   //Responses go to the response function, not the channel event functions,
+   //so they can be read ahead of channel data without reordering a channel.
+   pclMessageObject->SetPriorityResponses(TRUE);
+
    //Let Serial know about Framer.
    //for(int i = 1; i < 100; i++) Sleep(1000);
    pclSerialObject->SetCallback(pclMessageObject);
@@ -2250,8 +2255,8 @@ void ANT_Nap(ULONG ulMilliseconds_)
 // Local functions ****************************************************//
 static DSI_THREAD_RETURN MessageThread(void *pvParameter_)
 {
-   ANT_MESSAGE stMessage;
-   USHORT usSize;
+   ANT_MESSAGE_VIEW astMessages[MESSAGE_BATCH_SIZE];
+   ULONG ulMessages;
 
    eTheThread = DSIThread_GetCurrentThreadIDNum();
 #if defined(DEBUG_FILE)
@@ -2262,21 +2267,18 @@ static DSI_THREAD_RETURN MessageThread(void *pvParameter_)
 
    while(bGoThread)
    {
-      if(pclMessageObject->WaitForMessage(1000/*DSI_THREAD_INFINITE*/))
+      if(pclMessageObject->WaitForMessages(1000/*DSI_THREAD_INFINITE*/))
       {
-         usSize = pclMessageObject->GetMessage(&stMessage);
+         ulMessages = pclMessageObject->PeekMessages(astMessages, MESSAGE_BATCH_SIZE);
 
-         if(usSize == DSI_FRAMER_ERROR)
+         for(ULONG i = 0; i < ulMessages; i++)
          {
-            // Get the message to clear the error
-            usSize = pclMessageObject->GetMessage(&stMessage, MESG_MAX_SIZE_VALUE);
-            continue;
+            // Framer errors are skipped; returning them cleared them
+            if(astMessages[i].ucSize != 0 && astMessages[i].ucSize != DSI_FRAMER_ANT_ITEM_ERROR)
+               SerialHaveMessage(*astMessages[i].pstANTMessage, astMessages[i].ucSize);
          }
 
-         if(usSize != 0 && usSize != DSI_FRAMER_ERROR && usSize != DSI_FRAMER_TIMEDOUT)
-         {
-            SerialHaveMessage(stMessage, usSize);
-         }
+         pclMessageObject->ConsumeMessage();
       }
    }
 
@@ -2395,7 +2397,7 @@ void CallResponseFunction(UCHAR ucANTChannel_, UCHAR ucResponseMsgID) {
 // called by the serial message driver code, to be defined by the user,
 // when a serial message is received from the ANT module.
 ///////////////////////////////////////////////////////////////////////
-static void SerialHaveMessage(ANT_MESSAGE& stMessage_, USHORT usSize_)
+static void SerialHaveMessage(const ANT_MESSAGE& stMessage_, USHORT usSize_)
 {
    UCHAR ucANTChannel_;
 
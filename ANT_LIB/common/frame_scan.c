@@ -0,0 +1,154 @@
+/*
+This software is subject to the license described in the License.txt file
+included with this software distribution. You may not use this file except
+in compliance with this license.
+
+Copyright (c) Dynastream Innovations Inc. 2016
+All rights reserved.
+*/
+#include "types.h"
+#include "frame_scan.h"
+
+#if defined(FRAME_SCAN_SSE2)
+   #include <emmintrin.h>
+   #if defined(_MSC_VER)
+      #include <intrin.h>
+   #endif
+#endif
+
+
+//////////////////////////////////////////////////////////////////////////////////
+// Private Function Prototypes
+//////////////////////////////////////////////////////////////////////////////////
+
+#if defined(FRAME_SCAN_SSE2)
+static ULONG LowestBit(ULONG ulMask_);
+#endif
+
+
+//////////////////////////////////////////////////////////////////////////////////
+// Public Functions
+//////////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////
+ULONG FrameScan_FindByte(const UCHAR *pucData_, ULONG ulSize_, UCHAR ucByte_)
+{
+   ULONG i = 0;
+
+#if defined(FRAME_SCAN_SSE2)
+   __m128i stPattern = _mm_set1_epi8((char)ucByte_);
+
+   for (; (i + 16) <= ulSize_; i += 16)
+   {
+      __m128i stBlock = _mm_loadu_si128((const __m128i *)&pucData_[i]);
+      ULONG ulMask = (ULONG)_mm_movemask_epi8(_mm_cmpeq_epi8(stBlock, stPattern));
+
+      if (ulMask != 0)
+         return i + LowestBit(ulMask);
+   }
+#endif
+
+   for (; i < ulSize_; i++)
+   {
+      if (pucData_[i] == ucByte_)
+         return i;
+   }
+
+   return ulSize_;
+}
+
+///////////////////////////////////////////////////////////////////////
+UCHAR FrameScan_Xor(const UCHAR *pucData_, ULONG ulSize_)
+{
+   UCHAR ucCheckSum = 0;
+   ULONG i = 0;
+
+#if defined(FRAME_SCAN_SSE2)
+   if (ulSize_ >= 16)
+   {
+      __m128i stSum = _mm_setzero_si128();
+
+      for (; (i + 16) <= ulSize_; i += 16)
+         stSum = _mm_xor_si128(stSum, _mm_loadu_si128((const __m128i *)&pucData_[i]));
+
+      // Fold the 16 lanes down to one byte.
+      stSum = _mm_xor_si128(stSum, _mm_srli_si128(stSum, 8));
+      stSum = _mm_xor_si128(stSum, _mm_srli_si128(stSum, 4));
+      stSum = _mm_xor_si128(stSum, _mm_srli_si128(stSum, 2));
+      stSum = _mm_xor_si128(stSum, _mm_srli_si128(stSum, 1));
+      ucCheckSum = (UCHAR)_mm_cvtsi128_si32(stSum);
+   }
+#endif
+
+   for (; i < ulSize_; i++)
+      ucCheckSum ^= pucData_[i];
+
+   return ucCheckSum;
+}
+
+///////////////////////////////////////////////////////////////////////
+ULONG FrameScan_Frames(const UCHAR *pucData_, ULONG ulSize_, UCHAR ucSync_, UCHAR ucOverhead_, USHORT usMaxIndex_, FRAME_SCAN_RESULT *pastFrames_, ULONG ulMaxFrames_, ULONG *pulFrames_)
+{
+   ULONG ulPos = 0;
+   ULONG ulFrames = 0;
+
+   while (ulFrames < ulMaxFrames_)
+   {
+      ULONG ulStart = ulPos + FrameScan_FindByte(&pucData_[ulPos], ulSize_ - ulPos, ucSync_);
+      UCHAR ucLastIndex;
+
+      if ((ulStart + 1) >= ulSize_)                         // No sync, or no length byte yet.
+      {
+         ulPos = ulStart;
+         break;
+      }
+
+      ucLastIndex = (UCHAR)(pucData_[ulStart + 1] + ucOverhead_);
+
+      if ((USHORT)ucLastIndex > usMaxIndex_)                // Let the caller's receiver turf it.
+      {
+         ulPos = ulStart;
+         break;
+      }
+
+      // A receiver looks at the size from the third byte on, so a
+      // length that wrapped below that still ends the frame there.
+      if (ucLastIndex < 2)
+         ucLastIndex = 2;
+
+      if ((ulStart + ucLastIndex) >= ulSize_)               // The rest of the frame is in a later buffer.
+      {
+         ulPos = ulStart;
+         break;
+      }
+
+      pastFrames_[ulFrames].ulOffset = ulStart;
+      pastFrames_[ulFrames].usSize = (USHORT)(ucLastIndex + 1);
+      pastFrames_[ulFrames].bCheckSumOk = (FrameScan_Xor(&pucData_[ulStart], (ULONG)ucLastIndex + 1) == 0);
+      ulFrames++;
+
+      ulPos = ulStart + ucLastIndex + 1;
+   }
+
+   *pulFrames_ = ulFrames;
+   return ulPos;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////
+// Private Functions
+//////////////////////////////////////////////////////////////////////////////////
+
+#if defined(FRAME_SCAN_SSE2)
+///////////////////////////////////////////////////////////////////////
+static ULONG LowestBit(ULONG ulMask_)
+{
+#if defined(_MSC_VER)
+   unsigned long ulIndex;
+   _BitScanForward(&ulIndex, ulMask_);
+   return (ULONG)ulIndex;
+#else
+   return (ULONG)__builtin_ctz(ulMask_);
+#endif
+}
+#endif
@@ -0,0 +1,75 @@
+/*
+This software is subject to the license described in the License.txt file
+included with this software distribution. You may not use this file except
+in compliance with this license.
+
+Copyright (c) Dynastream Innovations Inc. 2016
+All rights reserved.
+*/
+#if !defined(FRAME_SCAN_H)
+#define FRAME_SCAN_H
+
+#include "types.h"
+
+//////////////////////////////////////////////////////////////////////////////////
+// Public Definitions
+//////////////////////////////////////////////////////////////////////////////////
+
+#define FRAME_SCAN_VERSION   "AQB0.001"
+
+// SSE2 is always present on x64 and is the compiler default for 32 bit x86.
+#if defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2)) || defined(__SSE2__)
+   #define FRAME_SCAN_SSE2
+#endif
+
+typedef struct
+{
+   ULONG ulOffset;                                          // Offset of the sync byte in the scanned buffer.
+   USHORT usSize;                                           // Size of the whole frame, sync through checksum.
+   BOOL bCheckSumOk;
+} FRAME_SCAN_RESULT;
+
+
+//////////////////////////////////////////////////////////////////////////////////
+// Public Function Prototypes
+//////////////////////////////////////////////////////////////////////////////////
+
+#if defined(__cplusplus)
+   extern "C" {
+#endif
+
+ULONG FrameScan_FindByte(const UCHAR *pucData_, ULONG ulSize_, UCHAR ucByte_);
+/////////////////////////////////////////////////////////////////
+// Returns the offset of the first ucByte_ in the buffer, or
+// ulSize_ if there is none.
+/////////////////////////////////////////////////////////////////
+
+UCHAR FrameScan_Xor(const UCHAR *pucData_, ULONG ulSize_);
+/////////////////////////////////////////////////////////////////
+// Same result as CheckSum_Calc8(), a block at a time.
+/////////////////////////////////////////////////////////////////
+
+ULONG FrameScan_Frames(const UCHAR *pucData_, ULONG ulSize_, UCHAR ucSync_, UCHAR ucOverhead_, USHORT usMaxIndex_, FRAME_SCAN_RESULT *pastFrames_, ULONG ulMaxFrames_, ULONG *pulFrames_);
+/////////////////////////////////////////////////////////////////
+// Finds the complete frames in a buffer, starting from the state
+// where no frame is in progress.  A frame starts with ucSync_ and
+// a length byte, runs to index length + ucOverhead_ and ends with
+// an XOR checksum over the whole frame.  The index arithmetic is
+// done in a UCHAR, exactly as a byte at a time receiver would.
+//
+// Scanning stops at the first frame that is not entirely in the
+// buffer, at a frame whose last index would exceed usMaxIndex_
+// (the caller's receiver has to decide what to do with it) or
+// once ulMaxFrames_ frames have been found.
+//
+// Returns the number of bytes dealt with.  Anything before the
+// returned offset is either inside a reported frame or is noise
+// that a byte at a time receiver would have dropped; the bytes
+// from the returned offset on have not been looked at yet.
+/////////////////////////////////////////////////////////////////
+
+#if defined(__cplusplus)
+   }
+#endif
+
+#endif // !defined(FRAME_SCAN_H)
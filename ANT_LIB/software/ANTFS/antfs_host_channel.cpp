@@ -2427,6 +2427,10 @@ ANTFSHostChannel::RETURN_STATUS ANTFSHostChannel::AttemptSearch(void)
    BOOL bFoundBroadcastDevice = FALSE;
    UCHAR ucFirstMesgRetries;
    BOOL bFirstMesgResult;
+   ANT_CHANNEL_CONFIG stChannelConfig;
+   ANT_CHANNEL_CONFIG_RESULT stConfigResult;
+
+   memset(&stChannelConfig, 0, sizeof(stChannelConfig));
 
    while (eANTFSState == ANTFS_HOST_STATE_SEARCHING)
    {
@@ -2498,34 +2502,19 @@ ANTFSHostChannel::RETURN_STATUS ANTFSHostChannel::AttemptSearch(void)
             return RETURN_SERIAL_ERROR;
          }
 
-         if (pclANT->AssignChannel(ucChannelNumber, 0x00, ucNetworkNumber, MESSAGE_TIMEOUT) == FALSE)
-         {
-            #if defined(DEBUG_FILE)
-               DSIDebug::ThreadWrite("ANTFSHostChannel::AttemptSearch():  Failed ANT_AssignChannel().");
-            #endif
-            return RETURN_SERIAL_ERROR;
-         }
-
-         if (pclANT->SetChannelPeriod(ucChannelNumber, usTheMessagePeriod, MESSAGE_TIMEOUT) == FALSE)
-         {
-            #if defined(DEBUG_FILE)
-               DSIDebug::ThreadWrite("ANTFSHostChannel::AttemptSearch():  Failed ANT_SetChannelPeriod().");
-            #endif
-            return RETURN_SERIAL_ERROR;
-         }
-
-         if (pclANT->SetChannelSearchTimeout(ucChannelNumber, ANTFS_SEARCH_TIMEOUT, MESSAGE_TIMEOUT) == FALSE)
-         {
-            #if defined(DEBUG_FILE)
-               DSIDebug::ThreadWrite("ANTFSHostChannel::AttemptSearch():  Failed ANT_SetChannelSearchTimeout().");
-            #endif
-            return RETURN_SERIAL_ERROR;
-         }
+         // Assign the channel and send its settings in one pipelined sequence.
+         stChannelConfig.ulFields = ANT_CHANNEL_CONFIG_ASSIGN | ANT_CHANNEL_CONFIG_PERIOD | ANT_CHANNEL_CONFIG_SEARCH_TIMEOUT | ANT_CHANNEL_CONFIG_RF_FREQUENCY;
+         stChannelConfig.ucNetworkNumber = ucNetworkNumber;
+         stChannelConfig.ucChannelType = 0x00;
+         stChannelConfig.ucExtendedAssign = 0x00;
+         stChannelConfig.usMessagePeriod = usTheMessagePeriod;
+         stChannelConfig.ucSearchTimeout = ANTFS_SEARCH_TIMEOUT;
+         stChannelConfig.ucRFFrequency = ucSearchRadioFrequency;
 
-         if (pclANT->SetChannelRFFrequency(ucChannelNumber, ucSearchRadioFrequency, MESSAGE_TIMEOUT) == FALSE)
+         if (pclANT->ConfigureChannel(ucChannelNumber, &stChannelConfig, &stConfigResult, MESSAGE_TIMEOUT) == FALSE)
          {
             #if defined(DEBUG_FILE)
-               DSIDebug::ThreadWrite("ANTFSHostChannel::AttemptSearch():  Failed ANT_SetChannelRFFreq().");
+               DSIDebug::ThreadPrintf("ANTFSHostChannel::AttemptSearch():  Failed ConfigureChannel() (steps 0x%04lX).", stConfigResult.ulFailed);
             #endif
             return RETURN_SERIAL_ERROR;
          }
@@ -15,6 +15,7 @@ All rights reserved.
 #include "usb_device.hpp"
 #include "usb_device_list.hpp"
 
+class DSISerialCallback;
 
 struct USBError
 {
@@ -53,6 +54,17 @@ class USBDeviceHandle
 
    static BOOL Open(const USBDevice& clDevice_, USBDeviceHandle*& pclDeviceHandle_, ULONG ulBaudRate_);
    static BOOL Close(USBDeviceHandle*& pclDeviceHandle_, BOOL bReset_ = FALSE);
+   static BOOL TryOpen(const USBDevice& clDevice_);
+
+   static BOOL StartHotplugNotification(void (*pfCallback_)(void));
+   /////////////////////////////////////////////////////////////////
+   // Calls pfCallback_ (from a system thread) whenever a USB device
+   // is attached or removed, until StopHotplugNotification().
+   // The callback must not block or enumerate devices itself.
+   // Returns FALSE if the platform cannot report hotplug events.
+   /////////////////////////////////////////////////////////////////
+
+   static void StopHotplugNotification();
 
 
    virtual USBError::Enum Write(void* pvData_, ULONG ulSize_, ULONG& ulBytesWritten_) = 0;  //!!Need timeout?
@@ -69,6 +81,16 @@ class USBDeviceHandle
 
    virtual USBError::Enum Read(void* pvData_, ULONG ulSize_, ULONG& ulBytesRead_, ULONG ulWaitTime_) = 0;
 
+   virtual BOOL SetReceiveCallback(DSISerialCallback* /*pclCallback_*/) { return FALSE; }
+   /////////////////////////////////////////////////////////////////
+   // Hands received data straight to pclCallback_ from the handle's
+   // own receive thread instead of queueing it for Read().  Read()
+   // must not be used while a callback is set.  Pass NULL to go back
+   // to queueing.  If the receive thread stops on its own (device
+   // removed, too many errors), pclCallback_->Error() is called.
+   // Returns FALSE if the handle does not support this.
+   /////////////////////////////////////////////////////////////////
+
    virtual const USBDevice& GetDevice() = 0;
 
   protected:
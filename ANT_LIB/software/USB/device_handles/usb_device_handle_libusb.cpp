@@ -16,6 +16,8 @@ All rights reserved.
 #include "usb_device_list.hpp"
 #include "dsi_debug.hpp"
 #include "antmessage.h"
+#include "dsi_serial.hpp"
+#include "dsi_serial_callback.hpp"
 
 #include <memory>
 
@@ -26,6 +28,7 @@ using namespace std;
 //////////////////////////////////////////////////////////////////////////////////
 
 USBDeviceList<const USBDeviceLibusb> USBDeviceHandleLibusb::clDeviceList;
+UCHAR USBDeviceHandleLibusb::ucRxTransferCount = USB_LIBUSB_DEFAULT_RX_TRANSFERS;
 
 
 //////////////////////////////////////////////////////////////////////////////////
@@ -149,6 +152,16 @@ BOOL USBDeviceHandleLibusb::Close(USBDeviceHandleLibusb*& pclDeviceHandle_, BOOL
    return TRUE;
 }
 
+void USBDeviceHandleLibusb::SetRxTransferCount(UCHAR ucCount_)
+{
+   if(ucCount_ == 0)
+      ucCount_ = 1;
+   else if(ucCount_ > USB_LIBUSB_MAX_RX_TRANSFERS)
+      ucCount_ = USB_LIBUSB_MAX_RX_TRANSFERS;
+
+   ucRxTransferCount = ucCount_;
+}
+
 //A more efficient way to test if you can open a device.  For instance, this function won't create a receive loop, etc.)
 BOOL USBDeviceHandleLibusb::TryOpen(const USBDeviceLibusb& clDevice_)
 {
@@ -210,6 +223,14 @@ try
    hReceiveThread = NULL;
    bStopReceiveThread = TRUE;
    device_handle = NULL;
+   pclRxCallback = NULL;
+
+   ucNumRxTransfers = ucRxTransferCount;
+   for(UCHAR i = 0; i < USB_LIBUSB_MAX_RX_TRANSFERS; i++)
+   {
+      apvAsyncContext[i] = NULL;
+      abRequestSubmitted[i] = FALSE;
+   }
 
    clLibusbLibrary.Init();
    //pfSetDebug(255);
@@ -406,6 +427,15 @@ USBError::Enum USBDeviceHandleLibusb::Read(void* pvData_, ULONG ulSize_, ULONG&
    return USBError::NONE;
 }
 
+///////////////////////////////////////////////////////////////////////
+BOOL USBDeviceHandleLibusb::SetReceiveCallback(DSISerialCallback* pclCallback_)
+{
+   //The receive thread picks this up on its next reap and flushes anything
+   //still queued to the callback first, so ordering is preserved.
+   pclRxCallback = pclCallback_;
+   return TRUE;
+}
+
 
 
 void USBDeviceHandleLibusb::ReceiveThread()
@@ -416,21 +446,11 @@ void USBDeviceHandleLibusb::ReceiveThread()
    #endif
 
    UCHAR ucConsecIoErrors = 0;
-   UCHAR aucData[4096];
+   UCHAR ucReapIndex = 0;
+   INT iRet;
 
-   VOID *asyncContextObject = NULL;
-   BOOL isRequestSubmitted = FALSE;
-
-   INT iRet = clLibusbLibrary.BulkSetupAsync(device_handle, &asyncContextObject, USB_ANT_EP_IN);
-   if(iRet < 0)
-   {
-      #if defined(DEBUG_FILE)
-         char acMesg[255];
-         SNPRINTF(acMesg, 255, "ReceiveThread(): BulkSetupAsync() Error: %d", iRet);
-         DSIDebug::ThreadWrite(acMesg);
-      #endif
+   if(SetupRxTransfers() == FALSE)
       bStopReceiveThread = TRUE;
-   }
 
 
    while(!bStopReceiveThread)
@@ -438,12 +458,17 @@ void USBDeviceHandleLibusb::ReceiveThread()
       //size must be the largest usb message we will receive or else it will get dropped, or will
       //  get a -1 ("permission error") and then -104 ("connection reset by peer") errors!
 
-      if(!isRequestSubmitted)
+      //Keep every idle request posted so the endpoint always has somewhere to put data
+      for(UCHAR i = 0; i < ucNumRxTransfers; i++)
       {
-         iRet = clLibusbLibrary.SubmitAsync(asyncContextObject, (char*)aucData, sizeof(aucData));
+         UCHAR ucIndex = (UCHAR)((ucReapIndex + i) % ucNumRxTransfers);  //submit in reap order
+         if(abRequestSubmitted[ucIndex])
+            continue;
+
+         iRet = clLibusbLibrary.SubmitAsync(apvAsyncContext[ucIndex], (char*)aaucRxData[ucIndex], sizeof(aaucRxData[ucIndex]));
          if(iRet >= 0)
          {
-            isRequestSubmitted = TRUE;
+            abRequestSubmitted[ucIndex] = TRUE;
          }
          else
          {
@@ -456,13 +481,36 @@ void USBDeviceHandleLibusb::ReceiveThread()
             break;
          }
       }
+      if(bStopReceiveThread)
+         break;
 
-         iRet = clLibusbLibrary.ReapAsyncNocancel(asyncContextObject, 1000);
+      //Requests complete in the order they were submitted, so always reap the oldest one
+      iRet = clLibusbLibrary.ReapAsyncNocancel(apvAsyncContext[ucReapIndex], 1000);
 
       if(iRet > 0)
       {
-         clRxQueue.PushArray(aucData, iRet);
-         isRequestSubmitted = FALSE;   //We need to resubmit the request or we will just get the same data again
+         UCHAR* pucData = aaucRxData[ucReapIndex];
+
+         DSISerialCallback* pclCallback = pclRxCallback;
+         if(pclCallback != NULL)
+         {
+            //Direct mode, feed the framer from here
+            UCHAR aucQueued[255];
+            ULONG ulQueued;
+            while(clRxQueue.GetCount() != 0 && (ulQueued = clRxQueue.PopArray(aucQueued, sizeof(aucQueued))) != 0)
+               pclCallback->ProcessBytes(aucQueued, ulQueued);
+
+            pclCallback->ProcessBytes(pucData, (ULONG)iRet);
+         }
+         else if(clRxQueue.PushArray(pucData, iRet) != (ULONG)iRet)
+         {
+            #if defined(DEBUG_FILE)
+               DSIDebug::ThreadWrite("ReceiveThread(): Rx queue full, data dropped.");
+            #endif
+         }
+
+         abRequestSubmitted[ucReapIndex] = FALSE;   //We need to resubmit the request or we will just get the same data again
+         ucReapIndex = (UCHAR)((ucReapIndex + 1) % ucNumRxTransfers);
          ucConsecIoErrors = 0;
       }
      else if(iRet == -116)
@@ -502,20 +550,17 @@ void USBDeviceHandleLibusb::ReceiveThread()
             #endif
             bStopReceiveThread = TRUE;
          }
-         else  //We can try to cancel our request and start a new one to see if it fixes the problem
+         else  //We can try to cancel our requests and start new ones to see if it fixes the problem
             //TODO //!!up to this point in time, we don't know what errors are actually causing this, so restarting the request may be entirely useless
          {
-            if(clLibusbLibrary.CancelAsync(asyncContextObject) == 0
-               && clLibusbLibrary.FreeAsync(&asyncContextObject) == 0
-               && clLibusbLibrary.BulkSetupAsync(device_handle, &asyncContextObject, USB_ANT_EP_IN) == 0)
-            {
-               isRequestSubmitted = FALSE;
-            }
-            else
+            //All of the requests are restarted, otherwise a lone resubmitted request would complete out of order
+            FreeRxTransfers();
+            ucReapIndex = 0;
+            if(SetupRxTransfers() == FALSE)
             {
                #if defined(DEBUG_FILE)
                   if(bRxDebug)
-                     DSIDebug::ThreadWrite("ReceiveThread(): Failed to free old async request and create a new one.");
+                     DSIDebug::ThreadWrite("ReceiveThread(): Failed to free old async requests and create new ones.");
                #endif
                bStopReceiveThread = TRUE;
             }
@@ -526,9 +571,54 @@ void USBDeviceHandleLibusb::ReceiveThread()
 
    bDeviceGone = TRUE;  //The read loop is dead, since we can't get any info, the device might as well be gone
 
-   if(asyncContextObject != NULL)
+   //Nobody is calling Read() in direct mode, so report it ourselves
+   if(pclRxCallback != NULL)
+      pclRxCallback->Error(DSI_SERIAL_DEVICE_GONE);
+
+   FreeRxTransfers();
+
+   DSIThread_MutexLock(&stMutexCriticalSection);
+      bStopReceiveThread = TRUE;
+      DSIThread_CondSignal(&stEventReceiveThreadExit);                       // Set an event to alert the main process that Rx thread is finished and can be closed.
+   DSIThread_MutexUnlock(&stMutexCriticalSection);
+}
+
+///////////////////////////////////////////////////////////////////////
+// Creates the async contexts for the bulk-IN request pool.
+///////////////////////////////////////////////////////////////////////
+BOOL USBDeviceHandleLibusb::SetupRxTransfers()
+{
+   for(UCHAR i = 0; i < ucNumRxTransfers; i++)
    {
-      iRet = clLibusbLibrary.CancelAsync(asyncContextObject);
+      abRequestSubmitted[i] = FALSE;
+
+      INT iRet = clLibusbLibrary.BulkSetupAsync(device_handle, &apvAsyncContext[i], USB_ANT_EP_IN);
+      if(iRet < 0)
+      {
+         #if defined(DEBUG_FILE)
+            char acMesg[255];
+            SNPRINTF(acMesg, 255, "ReceiveThread(): BulkSetupAsync() Error: %d", iRet);
+            DSIDebug::ThreadWrite(acMesg);
+         #endif
+         apvAsyncContext[i] = NULL;
+         return FALSE;
+      }
+   }
+
+   return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////
+// Cancels any outstanding requests and frees their contexts.
+///////////////////////////////////////////////////////////////////////
+void USBDeviceHandleLibusb::FreeRxTransfers()
+{
+   for(UCHAR i = 0; i < ucNumRxTransfers; i++)
+   {
+      if(apvAsyncContext[i] == NULL)
+         continue;
+
+      INT iRet = clLibusbLibrary.CancelAsync(apvAsyncContext[i]);
       #if defined(DEBUG_FILE)
          if(iRet < 0)
          {
@@ -537,7 +627,7 @@ void USBDeviceHandleLibusb::ReceiveThread()
             DSIDebug::ThreadWrite(acMesg);
          }
       #endif
-      iRet = clLibusbLibrary.FreeAsync(&asyncContextObject);
+      iRet = clLibusbLibrary.FreeAsync(&apvAsyncContext[i]);
       #if defined(DEBUG_FILE)
          if(iRet < 0)
          {
@@ -546,13 +636,9 @@ void USBDeviceHandleLibusb::ReceiveThread()
             DSIDebug::ThreadWrite(acMesg);
          }
       #endif
-     asyncContextObject = NULL;
+      apvAsyncContext[i] = NULL;
+      abRequestSubmitted[i] = FALSE;
    }
-
-   DSIThread_MutexLock(&stMutexCriticalSection);
-      bStopReceiveThread = TRUE;
-      DSIThread_CondSignal(&stEventReceiveThreadExit);                       // Set an event to alert the main process that Rx thread is finished and can be closed.
-   DSIThread_MutexUnlock(&stMutexCriticalSection);
 }
 
 
@@ -15,7 +15,7 @@ All rights reserved.
 
 #include "usb_device_handle.hpp"
 #include "usb_device_libusb.hpp"
-#include "dsi_ts_queue.hpp"
+#include "dsi_ts_ring_buffer.hpp"
 
 #include "usb_device_list.hpp"
 
@@ -29,6 +29,10 @@ All rights reserved.
 
 typedef USBDeviceList<const USBDeviceLibusb*> USBDeviceListLibusb;
 
+#define USB_LIBUSB_DEFAULT_RX_TRANSFERS   ((UCHAR) 4)       // Bulk-IN requests kept in flight per device.
+#define USB_LIBUSB_MAX_RX_TRANSFERS       ((UCHAR) 16)
+#define USB_LIBUSB_RX_TRANSFER_SIZE       4096              // Must be at least the largest USB transfer we will receive.
+
 /*
 //for internal use only!
 struct SerialData
@@ -56,7 +60,7 @@ class USBDeviceHandleLibusb : public USBDeviceHandle
 
    LibusbLibrary clLibusbLibrary;
    //std::deque<SerialData*> clOverflowQueue;  //used if the user does not specify a big enough array
-   TSQueue<UCHAR> clRxQueue;
+   TSRingBuffer<UCHAR> clRxQueue;
 
    const USBDeviceLibusb clDevice;
    usb_dev_handle* device_handle;
@@ -70,10 +74,22 @@ class USBDeviceHandleLibusb : public USBDeviceHandle
 
    BOOL bDeviceGone;
 
+   DSISerialCallback* volatile pclRxCallback;            // If set, received data bypasses clRxQueue.
+
+   // Bulk-IN request pool, only used by the receive thread
+   UCHAR ucNumRxTransfers;
+   VOID* apvAsyncContext[USB_LIBUSB_MAX_RX_TRANSFERS];
+   BOOL abRequestSubmitted[USB_LIBUSB_MAX_RX_TRANSFERS];
+   UCHAR aaucRxData[USB_LIBUSB_MAX_RX_TRANSFERS][USB_LIBUSB_RX_TRANSFER_SIZE];
+
+   static UCHAR ucRxTransferCount;                       // Pool size used by handles opened from now on.
+
 
    BOOL POpen();
    void PClose(BOOL bReset_ = FALSE);
    void ReceiveThread();
+   BOOL SetupRxTransfers();
+   void FreeRxTransfers();
    static DSI_THREAD_RETURN ProcessThread(void* pvParameter_);
 
    static USBDeviceList<const USBDeviceLibusb> clDeviceList;  //This holds only instances of USBDeviceLibusb (unless someone manually makes their own)
@@ -88,11 +104,19 @@ class USBDeviceHandleLibusb : public USBDeviceHandle
    static BOOL Close(USBDeviceHandleLibusb*& pclDeviceHandle_, BOOL bReset_ = FALSE);
    static BOOL TryOpen(const USBDeviceLibusb& clDevice_);
 
+   static void SetRxTransferCount(UCHAR ucCount_);
+   /////////////////////////////////////////////////////////////////
+   // Sets how many bulk-IN requests are kept in flight for each
+   // device opened after this call.  Values are clamped to
+   // 1..USB_LIBUSB_MAX_RX_TRANSFERS.
+   /////////////////////////////////////////////////////////////////
+
 
    //USBDeviceHandle Base Class//
 
    USBError::Enum Write(void* pvData_, ULONG ulSize_, ULONG& ulBytesWritten_);
    USBError::Enum Read(void* pvData_, ULONG ulSize_, ULONG& ulBytesRead_, ULONG ulWaitTime_);
+   BOOL SetReceiveCallback(DSISerialCallback* pclCallback_);
 
    const USBDevice& GetDevice() { return clDevice; }
 
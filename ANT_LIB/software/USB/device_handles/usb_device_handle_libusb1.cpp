@@ -0,0 +1,591 @@
+/*
+This software is subject to the license described in the License.txt file
+included with this software distribution. You may not use this file except
+in compliance with this license.
+
+Copyright (c) Dynastream Innovations Inc. 2016
+All rights reserved.
+*/
+#include "types.h"
+#if defined(DSI_TYPES_LINUX)
+
+
+#include "usb_device_handle_libusb1.hpp"
+
+#include "macros.h"
+#include "usb_device_list.hpp"
+#include "dsi_serial.hpp"
+#include "dsi_serial_callback.hpp"
+
+#include <string.h>
+
+
+//////////////////////////////////////////////////////////////////////////////////
+// Static declarations
+//////////////////////////////////////////////////////////////////////////////////
+
+USBDeviceList<const USBDeviceLibusb1> USBDeviceHandleLibusb1::clDeviceList;
+
+libusb_context* USBDeviceHandleLibusb1::pstContext = NULL;
+DSI_MUTEX USBDeviceHandleLibusb1::stContextMutex = PTHREAD_MUTEX_INITIALIZER;   //DSI_MUTEX is a pthread mutex here, static init avoids ordering problems
+DSI_THREAD_ID USBDeviceHandleLibusb1::hEventThread;
+volatile BOOL USBDeviceHandleLibusb1::bStopEventThread = TRUE;
+ULONG USBDeviceHandleLibusb1::ulOpenHandles = 0;
+
+static DSI_CONDITION_VAR stEventThreadExit = PTHREAD_COND_INITIALIZER;
+static BOOL bEventThreadRunning = FALSE;
+
+libusb_hotplug_callback_handle USBDeviceHandleLibusb1::hHotplugCallback;
+void (*USBDeviceHandleLibusb1::pfHotplugCallback)(void) = NULL;
+
+
+//////////////////////////////////////////////////////////////////////////////////
+// Private Definitions
+//////////////////////////////////////////////////////////////////////////////////
+
+const UCHAR USB_ANT_CONFIGURATION = 1;
+const UCHAR USB_ANT_INTERFACE = 0;
+const UCHAR USB_ANT_EP_IN  = 0x81;
+const UCHAR USB_ANT_EP_OUT = 0x01;
+
+static BOOL CanOpenDevice(const USBDeviceLibusb1*const & pclDevice_)
+{
+   if(pclDevice_ == NULL)
+      return FALSE;
+
+   return USBDeviceHandleLibusb1::TryOpen(*pclDevice_);
+}
+
+const USBDeviceListLibusb1 USBDeviceHandleLibusb1::GetAllDevices()
+{
+   USBDeviceListLibusb1 clList;
+
+   clDeviceList = USBDeviceList<const USBDeviceLibusb1>();  //clear device list
+
+   libusb_context* pstCtx = GetContext();
+   if(pstCtx == NULL)
+      return clList;
+
+   libusb_device** ppstDevices;
+   ssize_t iCount = libusb_get_device_list(pstCtx, &ppstDevices);
+   if(iCount < 0)
+      return clList;
+
+   for(ssize_t i = 0; i < iCount; i++)
+   {
+      clDeviceList.Add( USBDeviceLibusb1(ppstDevices[i]) );  //save the copies to the static private list, each holds its own reference
+      clList.Add( clDeviceList.GetAddress(clDeviceList.GetSize()-1) );  //save a pointer to the just added device
+   }
+
+   libusb_free_device_list(ppstDevices, 1);
+
+   return clList;
+}
+
+
+const USBDeviceListLibusb1 USBDeviceHandleLibusb1::GetAvailableDevices()
+{
+   return USBDeviceHandleLibusb1::GetAllDevices().GetSubList(CanOpenDevice);
+}
+
+
+BOOL USBDeviceHandleLibusb1::Open(const USBDeviceLibusb1& clDevice_, USBDeviceHandleLibusb1*& pclDeviceHandle_)
+{
+   try
+   {
+      pclDeviceHandle_ = new USBDeviceHandleLibusb1(clDevice_);
+   }
+   catch(...)
+   {
+      pclDeviceHandle_ = NULL;
+      return FALSE;
+   }
+
+   return TRUE;
+}
+
+
+BOOL USBDeviceHandleLibusb1::Close(USBDeviceHandleLibusb1*& pclDeviceHandle_, BOOL bReset_)
+{
+   if(pclDeviceHandle_ == NULL)
+      return FALSE;
+
+   pclDeviceHandle_->PClose(bReset_);
+   delete pclDeviceHandle_;
+   pclDeviceHandle_ = NULL;
+
+   return TRUE;
+}
+
+//A more efficient way to test if you can open a device.  For instance, this function won't submit any transfers.
+BOOL USBDeviceHandleLibusb1::TryOpen(const USBDeviceLibusb1& clDevice_)
+{
+   libusb_device_handle* pstTempDeviceHandle;
+   if(libusb_open(clDevice_.GetRawDevice(), &pstTempDeviceHandle) != 0)
+      return FALSE;
+
+   libusb_set_auto_detach_kernel_driver(pstTempDeviceHandle, 1);
+
+   int ret = libusb_claim_interface(pstTempDeviceHandle, USB_ANT_INTERFACE);
+   if(ret == 0)
+      libusb_release_interface(pstTempDeviceHandle, USB_ANT_INTERFACE);
+
+   libusb_close(pstTempDeviceHandle);
+
+   return (ret == 0);
+}
+
+
+///////////////////////////////////////////////////////////////////////
+// Constructor
+///////////////////////////////////////////////////////////////////////
+
+USBDeviceHandleLibusb1::USBDeviceHandleLibusb1(const USBDeviceLibusb1& clDevice_)
+try
+:
+   USBDeviceHandle(),
+   clDevice(clDevice_),
+   bDeviceGone(TRUE)
+{
+   pstDeviceHandle = NULL;
+   pclRxCallback = NULL;
+   ucRxTransfersPending = 0;
+   bClosing = TRUE;
+
+   for(UCHAR i = 0; i < USB_LIBUSB1_RX_TRANSFERS; i++)
+      apstRxTransfer[i] = NULL;
+
+   if(POpen() == FALSE)
+      throw 0; //!!We need something to throw
+
+   return;
+}
+catch(...)
+{
+   throw;
+}
+
+///////////////////////////////////////////////////////////////////////
+// Destructor
+///////////////////////////////////////////////////////////////////////
+USBDeviceHandleLibusb1::~USBDeviceHandleLibusb1()
+{
+}
+
+
+///////////////////////////////////////////////////////////////////////
+// Opens the device and posts the bulk-IN transfers.
+///////////////////////////////////////////////////////////////////////
+BOOL USBDeviceHandleLibusb1::POpen()
+{
+   if(GetContext() == NULL)
+      return FALSE;
+
+   if(libusb_open(clDevice.GetRawDevice(), &pstDeviceHandle) != 0)
+   {
+      pstDeviceHandle = NULL;
+      return FALSE;
+   }
+
+   libusb_set_auto_detach_kernel_driver(pstDeviceHandle, 1);  //Serial drivers may have claimed the stick
+
+   //Setting the configuration again would do a light reset, so only set it if needed
+   int iConfig = 0;
+   if(libusb_get_configuration(pstDeviceHandle, &iConfig) != 0 || iConfig != USB_ANT_CONFIGURATION)
+   {
+      if(libusb_set_configuration(pstDeviceHandle, USB_ANT_CONFIGURATION) != 0)
+      {
+         libusb_close(pstDeviceHandle);
+         pstDeviceHandle = NULL;
+         return FALSE;
+      }
+   }
+
+   if(libusb_claim_interface(pstDeviceHandle, USB_ANT_INTERFACE) != 0)
+   {
+      libusb_close(pstDeviceHandle);
+      pstDeviceHandle = NULL;
+      return FALSE;
+   }
+
+   if(DSIThread_MutexInit(&stMutexCriticalSection) != DSI_THREAD_ENONE)
+   {
+      libusb_release_interface(pstDeviceHandle, USB_ANT_INTERFACE);
+      libusb_close(pstDeviceHandle);
+      pstDeviceHandle = NULL;
+      return FALSE;
+   }
+
+   if(DSIThread_CondInit(&stEventRxTransfersDone) != DSI_THREAD_ENONE)
+   {
+      DSIThread_MutexDestroy(&stMutexCriticalSection);
+      libusb_release_interface(pstDeviceHandle, USB_ANT_INTERFACE);
+      libusb_close(pstDeviceHandle);
+      pstDeviceHandle = NULL;
+      return FALSE;
+   }
+
+   if(StartEventThread() == FALSE)
+   {
+      DSIThread_CondDestroy(&stEventRxTransfersDone);
+      DSIThread_MutexDestroy(&stMutexCriticalSection);
+      libusb_release_interface(pstDeviceHandle, USB_ANT_INTERFACE);
+      libusb_close(pstDeviceHandle);
+      pstDeviceHandle = NULL;
+      return FALSE;
+   }
+
+   //From here on PClose() can clean up everything
+   bDeviceGone = FALSE;
+   bClosing = FALSE;
+
+   for(UCHAR i = 0; i < USB_LIBUSB1_RX_TRANSFERS; i++)
+   {
+      apstRxTransfer[i] = libusb_alloc_transfer(0);
+      if(apstRxTransfer[i] == NULL)
+      {
+         PClose();
+         return FALSE;
+      }
+
+      libusb_fill_bulk_transfer(apstRxTransfer[i], pstDeviceHandle, USB_ANT_EP_IN, aaucRxData[i], sizeof(aaucRxData[i]), &USBDeviceHandleLibusb1::RxTransferCallback, this, 0);
+
+      DSIThread_MutexLock(&stMutexCriticalSection);
+      if(libusb_submit_transfer(apstRxTransfer[i]) == 0)
+         ucRxTransfersPending++;
+      DSIThread_MutexUnlock(&stMutexCriticalSection);
+   }
+
+   if(ucRxTransfersPending == 0)
+   {
+      PClose();
+      return FALSE;
+   }
+
+   return TRUE;
+}
+
+
+///////////////////////////////////////////////////////////////////////
+// Cancels the transfers and closes the device.
+///////////////////////////////////////////////////////////////////////
+void USBDeviceHandleLibusb1::PClose(BOOL bReset_)
+{
+   if(pstDeviceHandle == NULL)
+      return;
+
+   bDeviceGone = TRUE;
+
+   DSIThread_MutexLock(&stMutexCriticalSection);
+   {
+      bClosing = TRUE;
+
+      for(UCHAR i = 0; i < USB_LIBUSB1_RX_TRANSFERS; i++)
+      {
+         if(apstRxTransfer[i] != NULL)
+            libusb_cancel_transfer(apstRxTransfer[i]);  //Fails harmlessly for transfers that already retired
+      }
+
+      //The event thread retires the cancelled transfers
+      while(ucRxTransfersPending != 0)
+      {
+         if(DSIThread_CondTimedWait(&stEventRxTransfersDone, &stMutexCriticalSection, 3000) != DSI_THREAD_ENONE)
+            break;
+      }
+   }
+   DSIThread_MutexUnlock(&stMutexCriticalSection);
+
+   for(UCHAR i = 0; i < USB_LIBUSB1_RX_TRANSFERS; i++)
+   {
+      //A transfer libusb still owns can't be freed, leak it rather than crash
+      if(apstRxTransfer[i] != NULL && ucRxTransfersPending == 0)
+         libusb_free_transfer(apstRxTransfer[i]);
+      apstRxTransfer[i] = NULL;
+   }
+
+   libusb_release_interface(pstDeviceHandle, USB_ANT_INTERFACE);
+
+   if(bReset_)
+      libusb_reset_device(pstDeviceHandle);
+
+   libusb_close(pstDeviceHandle);
+   pstDeviceHandle = NULL;
+
+   StopEventThread();
+
+   DSIThread_CondDestroy(&stEventRxTransfersDone);
+   DSIThread_MutexDestroy(&stMutexCriticalSection);
+}
+
+
+///////////////////////////////////////////////////////////////////////
+USBError::Enum USBDeviceHandleLibusb1::Write(void* pvData_, ULONG ulSize_, ULONG& ulBytesWritten_)
+{
+   ulBytesWritten_ = 0;
+
+   if(bDeviceGone)
+      return USBError::DEVICE_GONE;
+
+   if(pvData_ == NULL)
+      return USBError::INVALID_PARAM;
+
+   int iTransferred = 0;
+   int ret = libusb_bulk_transfer(pstDeviceHandle, USB_ANT_EP_OUT, (unsigned char*)pvData_, (int)ulSize_, &iTransferred, 3000);
+   if(ret == LIBUSB_ERROR_NO_DEVICE)
+      return USBError::DEVICE_GONE;
+
+   if(ret != 0)
+      return USBError::FAILED;
+
+   ulBytesWritten_ = (ULONG)iTransferred;
+   return USBError::NONE;
+}
+
+
+///////////////////////////////////////////////////////////////////////
+USBError::Enum USBDeviceHandleLibusb1::Read(void* pvData_, ULONG ulSize_, ULONG& ulBytesRead_, ULONG ulWaitTime_)
+{
+   if(bDeviceGone)
+      return USBError::DEVICE_GONE;
+
+   ulBytesRead_ = clRxQueue.PopArray(reinterpret_cast<UCHAR* const>(pvData_), ulSize_, ulWaitTime_);
+   if(ulBytesRead_ == 0)
+      return USBError::TIMED_OUT;
+
+   return USBError::NONE;
+}
+
+///////////////////////////////////////////////////////////////////////
+BOOL USBDeviceHandleLibusb1::SetReceiveCallback(DSISerialCallback* pclCallback_)
+{
+   //The next completed transfer flushes anything still queued to the
+   //callback first, so ordering is preserved.
+   pclRxCallback = pclCallback_;
+   return TRUE;
+}
+
+
+///////////////////////////////////////////////////////////////////////
+// Runs on the event thread.
+///////////////////////////////////////////////////////////////////////
+void USBDeviceHandleLibusb1::RxTransferComplete(struct libusb_transfer* pstTransfer_)
+{
+   switch(pstTransfer_->status)
+   {
+      case LIBUSB_TRANSFER_COMPLETED:
+      {
+         if(pstTransfer_->actual_length <= 0)
+            break;
+
+         DSISerialCallback* pclCallback = pclRxCallback;
+         if(pclCallback != NULL)
+         {
+            //Direct mode, feed the framer from here
+            UCHAR aucQueued[255];
+            ULONG ulQueued;
+            while(clRxQueue.GetCount() != 0 && (ulQueued = clRxQueue.PopArray(aucQueued, sizeof(aucQueued))) != 0)
+               pclCallback->ProcessBytes(aucQueued, ulQueued);
+
+            pclCallback->ProcessBytes(pstTransfer_->buffer, (ULONG)pstTransfer_->actual_length);
+         }
+         else
+         {
+            clRxQueue.PushArray(pstTransfer_->buffer, (ULONG)pstTransfer_->actual_length);
+         }
+         break;
+      }
+
+      case LIBUSB_TRANSFER_NO_DEVICE:
+         bDeviceGone = TRUE;
+         break;
+
+      default:   //Cancelled, or a transient error we retry
+         break;
+   }
+
+   if(!bClosing && !bDeviceGone && pstTransfer_->status != LIBUSB_TRANSFER_CANCELLED)
+   {
+      int ret = libusb_submit_transfer(pstTransfer_);
+      if(ret == 0)
+         return;   //still pending
+
+      if(ret == LIBUSB_ERROR_NO_DEVICE)
+         bDeviceGone = TRUE;
+   }
+
+   //This transfer has retired
+   DSISerialCallback* pclReportGone = NULL;
+   DSIThread_MutexLock(&stMutexCriticalSection);
+      ucRxTransfersPending--;
+      if(ucRxTransfersPending == 0)
+      {
+         if(!bClosing)
+            pclReportGone = pclRxCallback;
+         bDeviceGone = TRUE;   //Nothing left to read with
+         DSIThread_CondSignal(&stEventRxTransfersDone);
+      }
+   DSIThread_MutexUnlock(&stMutexCriticalSection);
+   //NOTE: PClose() may free this instance once the mutex is released, don't touch members past here
+
+   //Nobody is calling Read() in direct mode, so report it ourselves
+   if(pclReportGone != NULL)
+      pclReportGone->Error(DSI_SERIAL_DEVICE_GONE);
+}
+
+///////////////////////////////////////////////////////////////////////
+void LIBUSB_CALL USBDeviceHandleLibusb1::RxTransferCallback(struct libusb_transfer* pstTransfer_)
+{
+   USBDeviceHandleLibusb1* This = reinterpret_cast<USBDeviceHandleLibusb1*>(pstTransfer_->user_data);
+   This->RxTransferComplete(pstTransfer_);
+}
+
+
+///////////////////////////////////////////////////////////////////////
+// Registers for attach/detach events on every device.
+///////////////////////////////////////////////////////////////////////
+BOOL USBDeviceHandleLibusb1::RegisterHotplug(void (*pfCallback_)(void))
+{
+   if(pfCallback_ == NULL || pfHotplugCallback != NULL)
+      return FALSE;
+
+   if(libusb_has_capability(LIBUSB_CAP_HAS_HOTPLUG) == 0)
+      return FALSE;
+
+   libusb_context* pstCtx = GetContext();
+   if(pstCtx == NULL)
+      return FALSE;
+
+   pfHotplugCallback = pfCallback_;
+   int ret = libusb_hotplug_register_callback(pstCtx,
+      (libusb_hotplug_event)(LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED | LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT),
+      (libusb_hotplug_flag)0, LIBUSB_HOTPLUG_MATCH_ANY, LIBUSB_HOTPLUG_MATCH_ANY, LIBUSB_HOTPLUG_MATCH_ANY,
+      &USBDeviceHandleLibusb1::HotplugCallback, NULL, &hHotplugCallback);
+
+   if(ret != LIBUSB_SUCCESS)
+   {
+      pfHotplugCallback = NULL;
+      return FALSE;
+   }
+
+   if(StartEventThread() == FALSE)   //Hotplug callbacks are dispatched from libusb_handle_events()
+   {
+      libusb_hotplug_deregister_callback(pstCtx, hHotplugCallback);
+      pfHotplugCallback = NULL;
+      return FALSE;
+   }
+
+   return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////
+void USBDeviceHandleLibusb1::UnregisterHotplug()
+{
+   if(pfHotplugCallback == NULL)
+      return;
+
+   libusb_hotplug_deregister_callback(pstContext, hHotplugCallback);
+   StopEventThread();
+   pfHotplugCallback = NULL;
+}
+
+///////////////////////////////////////////////////////////////////////
+int LIBUSB_CALL USBDeviceHandleLibusb1::HotplugCallback(libusb_context* /*pstContext_*/, libusb_device* /*pstDevice_*/, libusb_hotplug_event /*eEvent_*/, void* /*pvUserData_*/)
+{
+   void (*pfCallback)(void) = pfHotplugCallback;
+   if(pfCallback != NULL)
+      pfCallback();
+
+   return 0;   //Stay registered
+}
+
+///////////////////////////////////////////////////////////////////////
+// Returns the shared context, creating it on first use.  The context
+// lives for the rest of the process since USBDeviceLibusb1 instances
+// hold devices from it.
+///////////////////////////////////////////////////////////////////////
+libusb_context* USBDeviceHandleLibusb1::GetContext()
+{
+   DSIThread_MutexLock(&stContextMutex);
+   if(pstContext == NULL)
+   {
+      if(libusb_init(&pstContext) != 0)
+         pstContext = NULL;
+   }
+   DSIThread_MutexUnlock(&stContextMutex);
+
+   return pstContext;
+}
+
+///////////////////////////////////////////////////////////////////////
+// Adds a user of the event thread, starting it for the first one.
+///////////////////////////////////////////////////////////////////////
+BOOL USBDeviceHandleLibusb1::StartEventThread()
+{
+   BOOL bSuccess = TRUE;
+
+   DSIThread_MutexLock(&stContextMutex);
+   if(ulOpenHandles == 0)
+   {
+      bStopEventThread = FALSE;
+      bEventThreadRunning = TRUE;
+      hEventThread = DSIThread_CreateThread(&USBDeviceHandleLibusb1::EventThread, NULL);
+      if(hEventThread == (DSI_THREAD_ID)NULL)
+      {
+         bEventThreadRunning = FALSE;
+         bSuccess = FALSE;
+      }
+   }
+
+   if(bSuccess)
+      ulOpenHandles++;
+   DSIThread_MutexUnlock(&stContextMutex);
+
+   return bSuccess;
+}
+
+///////////////////////////////////////////////////////////////////////
+// Removes a user of the event thread, stopping it after the last one.
+///////////////////////////////////////////////////////////////////////
+void USBDeviceHandleLibusb1::StopEventThread()
+{
+   DSIThread_MutexLock(&stContextMutex);
+   if(ulOpenHandles != 0 && --ulOpenHandles == 0)
+   {
+      bStopEventThread = TRUE;
+      libusb_interrupt_event_handler(pstContext);
+
+      while(bEventThreadRunning)
+      {
+         if(DSIThread_CondTimedWait(&stEventThreadExit, &stContextMutex, 3000) != DSI_THREAD_ENONE)
+         {
+            // We were unable to stop the thread normally.
+            DSIThread_DestroyThread(hEventThread);
+            bEventThreadRunning = FALSE;
+         }
+      }
+
+      DSIThread_ReleaseThreadID(hEventThread);
+      hEventThread = (DSI_THREAD_ID)NULL;
+   }
+   DSIThread_MutexUnlock(&stContextMutex);
+}
+
+///////////////////////////////////////////////////////////////////////
+DSI_THREAD_RETURN USBDeviceHandleLibusb1::EventThread(void* /*pvParameter_*/)
+{
+   while(!bStopEventThread)
+   {
+      //Completions for every open device are dispatched from here
+      struct timeval stTimeout = { 1, 0 };
+      libusb_handle_events_timeout_completed(pstContext, &stTimeout, NULL);
+   }
+
+   DSIThread_MutexLock(&stContextMutex);
+      bEventThreadRunning = FALSE;
+      DSIThread_CondSignal(&stEventThreadExit);                            // Set an event to alert StopEventThread() that we are finished.
+   DSIThread_MutexUnlock(&stContextMutex);
+
+   return 0;
+}
+
+#endif //defined(DSI_TYPES_LINUX)
@@ -0,0 +1,129 @@
+/*
+This software is subject to the license described in the License.txt file
+included with this software distribution. You may not use this file except
+in compliance with this license.
+
+Copyright (c) Dynastream Innovations Inc. 2016
+All rights reserved.
+*/
+#ifndef USB_DEVICE_HANDLE_LIBUSB1_HPP
+#define USB_DEVICE_HANDLE_LIBUSB1_HPP
+
+#include "types.h"
+
+#if defined(DSI_TYPES_LINUX)
+
+#include "dsi_thread.h"
+
+#include "usb_device_handle.hpp"
+#include "usb_device_libusb1.hpp"
+#include "dsi_ts_ring_buffer.hpp"
+
+#include "usb_device_list.hpp"
+
+#include <libusb-1.0/libusb.h>
+
+
+//////////////////////////////////////////////////////////////////////////////////
+// Public Definitions
+//////////////////////////////////////////////////////////////////////////////////
+
+typedef USBDeviceList<const USBDeviceLibusb1*> USBDeviceListLibusb1;
+
+#define USB_LIBUSB1_RX_TRANSFERS       4                 // Bulk-IN transfers kept in flight per device.
+#define USB_LIBUSB1_RX_TRANSFER_SIZE   4096              // Must be at least the largest USB transfer we will receive.
+
+
+//////////////////////////////////////////////////////////////////////////////////
+// Public Class Prototypes
+//////////////////////////////////////////////////////////////////////////////////
+
+//All handles share one libusb context, and one thread running libusb_handle_events() for it.
+//That thread exists while at least one handle is open.
+class USBDeviceHandleLibusb1 : public USBDeviceHandle
+{
+  private:
+
+   TSRingBuffer<UCHAR> clRxQueue;
+
+   const USBDeviceLibusb1 clDevice;
+   libusb_device_handle* pstDeviceHandle;
+
+   struct libusb_transfer* apstRxTransfer[USB_LIBUSB1_RX_TRANSFERS];
+   UCHAR aaucRxData[USB_LIBUSB1_RX_TRANSFERS][USB_LIBUSB1_RX_TRANSFER_SIZE];
+
+   DSI_MUTEX stMutexCriticalSection;                     // Protects ucRxTransfersPending.
+   DSI_CONDITION_VAR stEventRxTransfersDone;             // Signalled when the last transfer has retired.
+   UCHAR ucRxTransfersPending;                           // Transfers currently owned by libusb.
+   volatile BOOL bClosing;                               // Stops completed transfers from being resubmitted.
+
+   volatile BOOL bDeviceGone;
+   DSISerialCallback* volatile pclRxCallback;            // If set, received data bypasses clRxQueue.
+
+   BOOL POpen();
+   void PClose(BOOL bReset_ = FALSE);
+   void RxTransferComplete(struct libusb_transfer* pstTransfer_);
+   static void LIBUSB_CALL RxTransferCallback(struct libusb_transfer* pstTransfer_);
+
+   // Shared event loop
+   static libusb_context* pstContext;
+   static DSI_MUTEX stContextMutex;
+   static DSI_THREAD_ID hEventThread;
+   static volatile BOOL bStopEventThread;
+   static ULONG ulOpenHandles;
+
+   static libusb_context* GetContext();
+   static BOOL StartEventThread();
+   static void StopEventThread();
+   static DSI_THREAD_RETURN EventThread(void* pvParameter_);
+
+   static libusb_hotplug_callback_handle hHotplugCallback;
+   static void (*pfHotplugCallback)(void);
+   static int LIBUSB_CALL HotplugCallback(libusb_context* pstContext_, libusb_device* pstDevice_, libusb_hotplug_event eEvent_, void* pvUserData_);
+
+   static USBDeviceList<const USBDeviceLibusb1> clDeviceList;  //This holds only instances of USBDeviceLibusb1
+
+
+  public:
+
+   static const USBDeviceListLibusb1 GetAllDevices();
+   static const USBDeviceListLibusb1 GetAvailableDevices();
+
+   static BOOL Open(const USBDeviceLibusb1& clDevice_, USBDeviceHandleLibusb1*& pclDeviceHandle_);
+   static BOOL Close(USBDeviceHandleLibusb1*& pclDeviceHandle_, BOOL bReset_ = FALSE);
+   static BOOL TryOpen(const USBDeviceLibusb1& clDevice_);
+
+   static BOOL RegisterHotplug(void (*pfCallback_)(void));
+   static void UnregisterHotplug();
+   /////////////////////////////////////////////////////////////////
+   // Calls pfCallback_ from the event thread when any USB device is
+   // attached or removed.  Keeps the event thread running while
+   // registered.  Returns FALSE if libusb has no hotplug support.
+   /////////////////////////////////////////////////////////////////
+
+
+   //USBDeviceHandle Base Class//
+
+   USBError::Enum Write(void* pvData_, ULONG ulSize_, ULONG& ulBytesWritten_);
+   USBError::Enum Read(void* pvData_, ULONG ulSize_, ULONG& ulBytesRead_, ULONG ulWaitTime_);
+   BOOL SetReceiveCallback(DSISerialCallback* pclCallback_);
+
+   const USBDevice& GetDevice() { return clDevice; }
+
+   ////
+
+  protected:
+
+   USBDeviceHandleLibusb1(const USBDeviceLibusb1& clDevice_);
+   virtual ~USBDeviceHandleLibusb1();
+
+  private:
+
+   USBDeviceHandleLibusb1(const USBDeviceHandleLibusb1&);            // Not copyable.
+   USBDeviceHandleLibusb1& operator=(const USBDeviceHandleLibusb1&);
+
+};
+
+#endif // defined(DSI_TYPES_LINUX)
+
+#endif // !defined(USB_DEVICE_HANDLE_LIBUSB1_HPP)
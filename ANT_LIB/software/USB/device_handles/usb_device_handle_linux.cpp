@@ -0,0 +1,163 @@
+/*
+This software is subject to the license described in the License.txt file
+included with this software distribution. You may not use this file except
+in compliance with this license.
+
+Copyright (c) Dynastream Innovations Inc. 2016
+All rights reserved.
+*/
+#include "types.h"
+#if defined(DSI_TYPES_LINUX)
+
+#include "usb_device_handle.hpp"
+
+#include "usb_device_handle_libusb1.hpp"
+
+#include "usb_device_libusb1.hpp"
+
+#include "usb_device_list.hpp"
+
+
+BOOL Libusb1DeviceMatch(const USBDeviceLibusb1* const & pclDevice_)
+{
+   USHORT usVid = pclDevice_->GetVid();
+   return (usVid == USBDeviceHandle::USB_ANT_VID || usVid == USBDeviceHandle::USB_ANT_VID_TWO);
+}
+
+BOOL USBDeviceHandle::CopyANTDevice(const USBDevice*& pclUSBDeviceCopy_, const USBDevice* pclUSBDeviceOrg_)
+{
+   if (pclUSBDeviceOrg_ == NULL)
+      return FALSE;
+
+   if (pclUSBDeviceCopy_ != NULL)
+      return FALSE;
+
+
+   switch(pclUSBDeviceOrg_->GetDeviceType())
+   {
+      case DeviceType::LIBUSB1:
+      {
+         const USBDeviceLibusb1& clDeviceLibusb1 = dynamic_cast<const USBDeviceLibusb1&>(*pclUSBDeviceOrg_);
+         pclUSBDeviceCopy_ = new USBDeviceLibusb1(clDeviceLibusb1);
+         break;
+      }
+
+      default:
+      {
+         return FALSE;
+      }
+   }
+
+   return TRUE;
+}
+
+const ANTDeviceList USBDeviceHandle::GetAllDevices(ULONG ulDeviceTypeField_)
+{
+   ANTDeviceList clDeviceList;
+
+   if( (ulDeviceTypeField_ & DeviceType::LIBUSB1) != 0)
+   {
+      const USBDeviceListLibusb1 clDeviceLibusb1List = USBDeviceHandleLibusb1::GetAllDevices();  //!!There is a list copy here!
+      clDeviceList.Add(clDeviceLibusb1List.GetSubList(Libusb1DeviceMatch) );
+   }
+
+   return clDeviceList;
+}
+
+const ANTDeviceList USBDeviceHandle::GetAvailableDevices(ULONG ulDeviceTypeField_)
+{
+   ANTDeviceList clDeviceList;
+
+   if( (ulDeviceTypeField_ & DeviceType::LIBUSB1) != 0)
+   {
+      //Filter on VID before trying to open anything
+      const USBDeviceListLibusb1 clDeviceLibusb1List = USBDeviceHandleLibusb1::GetAllDevices().GetSubList(Libusb1DeviceMatch);  //!!There is a list copy here!
+      for(ULONG i = 0; i < clDeviceLibusb1List.GetSize(); i++)
+      {
+         if(USBDeviceHandleLibusb1::TryOpen(*clDeviceLibusb1List[i]))
+            clDeviceList.Add(clDeviceLibusb1List[i]);
+      }
+   }
+
+   return clDeviceList;
+}
+
+
+BOOL USBDeviceHandle::Open(const USBDevice& clDevice_, USBDeviceHandle*& pclDeviceHandle_, ULONG /*ulBaudRate_*/)
+{
+   BOOL bSuccess;
+   switch(clDevice_.GetDeviceType())
+   {
+      case DeviceType::LIBUSB1:
+      {
+         const USBDeviceLibusb1& clDeviceLibusb1 = dynamic_cast<const USBDeviceLibusb1&>(clDevice_);
+
+         USBDeviceHandleLibusb1* pclDeviceHandleLibusb1;
+         bSuccess = USBDeviceHandleLibusb1::Open(clDeviceLibusb1, pclDeviceHandleLibusb1);
+
+         pclDeviceHandle_ = pclDeviceHandleLibusb1;
+         break;
+      }
+
+      default:
+      {
+         pclDeviceHandle_ = NULL;
+         bSuccess = FALSE;
+         break;
+      }
+   }
+
+   return bSuccess;
+}
+
+BOOL USBDeviceHandle::Close(USBDeviceHandle*& pclDeviceHandle_, BOOL bReset_)
+{
+   if(pclDeviceHandle_ == NULL)
+      return FALSE;
+
+   BOOL bSuccess;
+   switch(pclDeviceHandle_->GetDevice().GetDeviceType())
+   {
+      case DeviceType::LIBUSB1:
+      {
+         USBDeviceHandleLibusb1* pclDeviceHandleLibusb1 = dynamic_cast<USBDeviceHandleLibusb1*>(pclDeviceHandle_);
+         bSuccess = USBDeviceHandleLibusb1::Close(pclDeviceHandleLibusb1, bReset_);
+
+         pclDeviceHandle_ = pclDeviceHandleLibusb1;
+         break;
+      }
+
+      default:
+      {
+         pclDeviceHandle_ = NULL;
+         bSuccess = FALSE;
+         break;
+      }
+   }
+
+   return bSuccess;
+}
+BOOL USBDeviceHandle::TryOpen(const USBDevice& clDevice_)
+{
+   switch(clDevice_.GetDeviceType())
+   {
+      case DeviceType::LIBUSB1:
+         return USBDeviceHandleLibusb1::TryOpen(dynamic_cast<const USBDeviceLibusb1&>(clDevice_));
+
+      default:
+         return FALSE;
+   }
+}
+
+BOOL USBDeviceHandle::StartHotplugNotification(void (*pfCallback_)(void))
+{
+   return USBDeviceHandleLibusb1::RegisterHotplug(pfCallback_);
+}
+
+void USBDeviceHandle::StopHotplugNotification()
+{
+   USBDeviceHandleLibusb1::UnregisterHotplug();
+}
+
+
+#endif //defined(DSI_TYPES_LINUX)
@@ -21,7 +21,7 @@ All rights reserved.
 #include "dsi_cm_library.hpp"
 
 
-#include "dsi_ts_queue.hpp"
+#include "dsi_ts_ring_buffer.hpp"
 
 #include <windows.h>
 
@@ -45,7 +45,7 @@ class USBDeviceHandleSI : public USBDeviceHandle
 
       CMLibrary clCmLibrary;
 
-      TSQueue<char> clRxQueue;
+      TSRingBuffer<char> clRxQueue;
 
       // USB Variables
       HANDLE hUSBEvent;
@@ -21,6 +21,33 @@ All rights reserved.
 
 #include "usb_device_list.hpp"
 
+#include <windows.h>
+#include <cfgmgr32.h>
+#include <string.h>
+
+
+//CM_Register_Notification() is only in cfgmgr32.dll on Windows 8 and up, so it is looked up at runtime.
+typedef CONFIGRET (WINAPI *CM_Register_Notification_t)(PCM_NOTIFY_FILTER, PVOID, PCM_NOTIFY_CALLBACK, PHCMNOTIFICATION);
+typedef CONFIGRET (WINAPI *CM_Unregister_Notification_t)(HCMNOTIFICATION);
+
+static const GUID stGuidUsbDevice = { 0xA5DCBF10, 0x6530, 0x11D2, { 0x90, 0x1F, 0x00, 0xC0, 0x4F, 0xB9, 0x51, 0xED } };  //GUID_DEVINTERFACE_USB_DEVICE
+
+static HMODULE hCfgMgrLibrary = NULL;
+static HCMNOTIFICATION hHotplugNotification = NULL;
+static void (*pfHotplugCallback)(void) = NULL;
+
+static DWORD CALLBACK HotplugNotify(HCMNOTIFICATION /*hNotify_*/, PVOID /*pvContext_*/, CM_NOTIFY_ACTION eAction_, PCM_NOTIFY_EVENT_DATA /*pstEventData_*/, DWORD /*dwEventDataSize_*/)
+{
+   if(eAction_ == CM_NOTIFY_ACTION_DEVICEINTERFACEARRIVAL || eAction_ == CM_NOTIFY_ACTION_DEVICEINTERFACEREMOVAL)
+   {
+      void (*pfCallback)(void) = pfHotplugCallback;
+      if(pfCallback != NULL)
+         pfCallback();
+   }
+
+   return ERROR_SUCCESS;
+}
+
 
 BOOL SiDeviceMatch(const USBDeviceSI* const & pclDevice_)
 {
@@ -192,6 +219,65 @@ BOOL USBDeviceHandle::Close(USBDeviceHandle*& pclDeviceHandle_, BOOL bReset_)
    return bSuccess;
 }
 
+BOOL USBDeviceHandle::TryOpen(const USBDevice& clDevice_)
+{
+   switch(clDevice_.GetDeviceType())
+   {
+      case DeviceType::SI_LABS:
+         return USBDeviceHandleSI::TryOpen(dynamic_cast<const USBDeviceSI&>(clDevice_));
+
+      case DeviceType::LIBUSB:
+         return USBDeviceHandleLibusb::TryOpen(dynamic_cast<const USBDeviceLibusb&>(clDevice_));
+
+      default:
+         return FALSE;
+   }
+}
+
+BOOL USBDeviceHandle::StartHotplugNotification(void (*pfCallback_)(void))
+{
+   if(hHotplugNotification != NULL || pfCallback_ == NULL)
+      return FALSE;
+
+   if(hCfgMgrLibrary == NULL)
+      hCfgMgrLibrary = LoadLibraryA("cfgmgr32.dll");
+
+   if(hCfgMgrLibrary == NULL)
+      return FALSE;
+
+   CM_Register_Notification_t pfRegister = (CM_Register_Notification_t)GetProcAddress(hCfgMgrLibrary, "CM_Register_Notification");
+   if(pfRegister == NULL)
+      return FALSE;
+
+   CM_NOTIFY_FILTER stFilter;
+   memset(&stFilter, 0, sizeof(stFilter));
+   stFilter.cbSize = sizeof(stFilter);
+   stFilter.FilterType = CM_NOTIFY_FILTER_TYPE_DEVICEINTERFACE;
+   stFilter.u.DeviceInterface.ClassGuid = stGuidUsbDevice;
+
+   pfHotplugCallback = pfCallback_;
+   if(pfRegister(&stFilter, NULL, HotplugNotify, &hHotplugNotification) != CR_SUCCESS)
+   {
+      hHotplugNotification = NULL;
+      pfHotplugCallback = NULL;
+      return FALSE;
+   }
+
+   return TRUE;
+}
+
+void USBDeviceHandle::StopHotplugNotification()
+{
+   if(hHotplugNotification == NULL)
+      return;
+
+   CM_Unregister_Notification_t pfUnregister = (CM_Unregister_Notification_t)GetProcAddress(hCfgMgrLibrary, "CM_Unregister_Notification");
+   if(pfUnregister != NULL)
+      pfUnregister(hHotplugNotification);    //Waits for any callback in progress
+
+   hHotplugNotification = NULL;
+   pfHotplugCallback = NULL;
+}
 
 
 #endif //defined(DSI_TYPES_WINDOWS)
\ No newline at end of file
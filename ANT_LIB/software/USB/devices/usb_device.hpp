@@ -29,7 +29,8 @@ struct DeviceType
       SI_LABS        = 1<<0,
       LIBUSB         = 1<<1,
       IO_KIT         = 1<<2,
-      SI_LABS_IOKIT  = 1<<3
+      SI_LABS_IOKIT  = 1<<3,
+      LIBUSB1        = 1<<4
    };
 };
 
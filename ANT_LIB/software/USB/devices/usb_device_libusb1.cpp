@@ -0,0 +1,144 @@
+/*
+This software is subject to the license described in the License.txt file
+included with this software distribution. You may not use this file except
+in compliance with this license.
+
+Copyright (c) Dynastream Innovations Inc. 2016
+All rights reserved.
+*/
+#include "types.h"
+#if defined(DSI_TYPES_LINUX)
+
+#include "usb_device_libusb1.hpp"
+
+#include "macros.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+
+USBDeviceLibusb1::USBDeviceLibusb1(libusb_device* pstDevice_)
+:
+   pstDevice(libusb_ref_device(pstDevice_)),
+   usVid(0),
+   usPid(0),
+   ulSerialNumber(0)
+{
+   szProductDescription[0] = '\0';
+   szSerialString[0] = '\0';
+
+   struct libusb_device_descriptor stDescriptor;
+   if(libusb_get_device_descriptor(pstDevice, &stDescriptor) != 0)
+      return;
+
+   usVid = stDescriptor.idVendor;
+   usPid = stDescriptor.idProduct;
+
+   libusb_device_handle* pstTempDeviceHandle;
+   if(libusb_open(pstDevice, &pstTempDeviceHandle) != 0)  //Fails if we don't have permission, the VID/PID are still good
+      return;
+
+   int ret = libusb_get_string_descriptor_ascii(pstTempDeviceHandle, stDescriptor.iProduct, szProductDescription, sizeof(szProductDescription));
+   if(ret < 0)
+   {
+      szProductDescription[0] = '\0';
+   }
+
+   ret = libusb_get_string_descriptor_ascii(pstTempDeviceHandle, stDescriptor.iSerialNumber, szSerialString, sizeof(szSerialString));
+   if(ret < 0)
+   {
+      szSerialString[0] = '\0';
+      ulSerialNumber = 0;
+   }
+   else
+   {
+      USBDeviceLibusb1::GetDeviceSerialNumber(ulSerialNumber);
+   }
+
+   libusb_close(pstTempDeviceHandle);
+
+   return;
+}
+
+USBDeviceLibusb1::USBDeviceLibusb1(const USBDeviceLibusb1& clDevice_)
+:
+   USBDevice(),
+   pstDevice(libusb_ref_device(clDevice_.pstDevice)),
+   usVid(clDevice_.usVid),
+   usPid(clDevice_.usPid),
+   ulSerialNumber(clDevice_.ulSerialNumber)
+{
+   STRNCPY((char*)szProductDescription, (char*)clDevice_.szProductDescription, sizeof(szProductDescription));
+   memcpy(szSerialString, clDevice_.szSerialString, sizeof(szSerialString));
+   return;
+}
+
+USBDeviceLibusb1::~USBDeviceLibusb1()
+{
+   libusb_unref_device(pstDevice);
+}
+
+
+USBDeviceLibusb1& USBDeviceLibusb1::operator=(const USBDeviceLibusb1& clDevice_)
+{
+   if(this == &clDevice_)
+      return *this;
+
+   libusb_ref_device(clDevice_.pstDevice);
+   libusb_unref_device(pstDevice);
+
+   pstDevice = clDevice_.pstDevice;
+   usVid = clDevice_.usVid;
+   usPid = clDevice_.usPid;
+   ulSerialNumber = clDevice_.ulSerialNumber;
+   STRNCPY((char*)szProductDescription, (char*)clDevice_.szProductDescription, sizeof(szProductDescription));
+   memcpy(szSerialString, clDevice_.szSerialString, sizeof(szSerialString));
+
+   return *this;
+}
+
+BOOL USBDeviceLibusb1::USBReset() const
+{
+   libusb_device_handle* pstTempDeviceHandle;
+   if(libusb_open(pstDevice, &pstTempDeviceHandle) != 0)
+      return FALSE;
+
+   int ret = libusb_reset_device(pstTempDeviceHandle);
+   libusb_close(pstTempDeviceHandle);
+
+   return (ret == 0 || ret == LIBUSB_ERROR_NOT_FOUND);   //NOT_FOUND means it re-enumerated, which is what we wanted
+}
+
+BOOL USBDeviceLibusb1::GetProductDescription(UCHAR* pucProductDescription_, USHORT usBufferSize_) const
+{
+   return(STRNCPY((char*) pucProductDescription_, (char*) szProductDescription, usBufferSize_));
+}
+
+BOOL USBDeviceLibusb1::GetSerialString(UCHAR* pucSerialString_, USHORT usBufferSize_) const
+{
+   if(sizeof(szSerialString) > usBufferSize_)
+   {
+      memcpy(pucSerialString_, szSerialString, usBufferSize_);
+      return FALSE;
+   }
+
+   memcpy(pucSerialString_, szSerialString, sizeof(szSerialString));
+   return TRUE;
+}
+
+//The serial number actually is not limited to a ULONG by USB specs,
+//so, our range here is determined by whatever we do in our products.
+//For now we have it defined as 1 to (ULONG_MAX-1)
+BOOL USBDeviceLibusb1::GetDeviceSerialNumber(ULONG& ulSerialNumber_)
+{
+   ULONG ulSerial = strtoul((char*)szSerialString, NULL, 10);
+   if(ulSerial == 0 || ulSerial == ULONG_MAX)
+      return FALSE;
+
+   ulSerialNumber_ = ulSerial;
+   return TRUE;
+}
+
+
+#endif //defined(DSI_TYPES_LINUX)
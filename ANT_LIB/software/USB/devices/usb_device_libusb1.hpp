@@ -0,0 +1,71 @@
+/*
+This software is subject to the license described in the License.txt file
+included with this software distribution. You may not use this file except
+in compliance with this license.
+
+Copyright (c) Dynastream Innovations Inc. 2016
+All rights reserved.
+*/
+#ifndef USB_DEVICE_LIBUSB1_HPP
+#define USB_DEVICE_LIBUSB1_HPP
+
+#include "types.h"
+
+#if defined(DSI_TYPES_LINUX)
+
+#include "usb_device.hpp"
+
+#include <libusb-1.0/libusb.h>
+
+
+//////////////////////////////////////////////////////////////////////////////////
+// Public Definitions
+//////////////////////////////////////////////////////////////////////////////////
+
+
+//Holds a reference on the libusb_device, so the device stays valid after the list it came from is freed.
+class USBDeviceLibusb1 : public USBDevice
+{
+  public:
+   USBDeviceLibusb1(libusb_device* pstDevice_);
+   USBDeviceLibusb1(const USBDeviceLibusb1& clDevice_);
+   ~USBDeviceLibusb1();
+
+   USBDeviceLibusb1& operator=(const USBDeviceLibusb1& clDevice_);
+
+   libusb_device* GetRawDevice() const { return pstDevice; }
+
+
+
+   //USBDevice Base//
+
+   BOOL USBReset() const;
+
+   USHORT GetVid() const { return usVid; }
+   USHORT GetPid() const { return usPid; }
+
+   ULONG GetSerialNumber() const { return ulSerialNumber; }
+   BOOL GetProductDescription(UCHAR* pucProductDescription_, USHORT usBufferSize_) const; //guaranteed to be null-terminated
+   BOOL GetSerialString(UCHAR* pucSerialString_, USHORT usBufferSize_) const;
+
+   DeviceType::Enum GetDeviceType() const { return DeviceType::LIBUSB1; }
+
+   ////
+
+
+  private:
+
+   BOOL GetDeviceSerialNumber(ULONG& ulSerialNumber_);
+
+   libusb_device* pstDevice;
+   USHORT usVid;
+   USHORT usPid;
+   ULONG ulSerialNumber;
+   UCHAR szProductDescription[USB_MAX_STRLEN];
+   UCHAR szSerialString[USB_MAX_STRLEN];
+
+};
+
+#endif // defined(DSI_TYPES_LINUX)
+
+#endif // !defined(USB_DEVICE_LIBUSB1_HPP)
@@ -0,0 +1,257 @@
+/*
+This software is subject to the license described in the License.txt file
+included with this software distribution. You may not use this file except
+in compliance with this license.
+
+Copyright (c) Dynastream Innovations Inc. 2016
+All rights reserved.
+*/
+#include "types.h"
+
+#include "usb_device_registry.hpp"
+
+#include "usb_device_handle.hpp"
+#include "usb_device_list.hpp"
+
+#if defined(DSI_TYPES_WINDOWS)
+   #include <windows.h>
+#endif
+
+
+//////////////////////////////////////////////////////////////////////////////////
+// Private Definitions
+//////////////////////////////////////////////////////////////////////////////////
+
+#if defined(DSI_TYPES_WINDOWS)
+   #define REGISTRY_ATOMIC_INC(x)      InterlockedIncrement(x)
+   #define REGISTRY_ATOMIC_DEC(x)      InterlockedDecrement(x)
+#else
+   #define REGISTRY_ATOMIC_INC(x)      __sync_add_and_fetch(x, 1)
+   #define REGISTRY_ATOMIC_DEC(x)      __sync_sub_and_fetch(x, 1)
+#endif
+
+
+//////////////////////////////////////////////////////////////////////////////////
+// USBDeviceSnapshot
+//////////////////////////////////////////////////////////////////////////////////
+
+USBDeviceSnapshot::USBDeviceSnapshot()
+:
+   pstData(NULL)
+{
+   return;
+}
+
+USBDeviceSnapshot::USBDeviceSnapshot(SnapshotData* pstData_)
+:
+   pstData(pstData_)
+{
+   return;
+}
+
+USBDeviceSnapshot::USBDeviceSnapshot(const USBDeviceSnapshot& clSnapshot_)
+:
+   pstData(clSnapshot_.pstData)
+{
+   AddRef(pstData);
+   return;
+}
+
+USBDeviceSnapshot::~USBDeviceSnapshot()
+{
+   Release(pstData);
+}
+
+USBDeviceSnapshot& USBDeviceSnapshot::operator=(const USBDeviceSnapshot& clSnapshot_)
+{
+   if(pstData == clSnapshot_.pstData)
+      return *this;
+
+   AddRef(clSnapshot_.pstData);
+   Release(pstData);
+   pstData = clSnapshot_.pstData;
+
+   return *this;
+}
+
+ULONG USBDeviceSnapshot::GetSize() const
+{
+   if(pstData == NULL)
+      return 0;
+
+   return (ULONG)pstData->clDevices.size();
+}
+
+const USBDevice* USBDeviceSnapshot::operator[](ULONG ulNum_) const
+{
+   if(ulNum_ >= GetSize())
+      return NULL;
+
+   return pstData->clDevices[ulNum_];
+}
+
+ULONG USBDeviceSnapshot::GetGeneration() const
+{
+   if(pstData == NULL)
+      return 0;
+
+   return pstData->ulGeneration;
+}
+
+USBDeviceSnapshot::SnapshotData* USBDeviceSnapshot::NewData(ULONG ulGeneration_)
+{
+   SnapshotData* pstData = new SnapshotData;
+   pstData->lRefCount = 1;
+   pstData->ulGeneration = ulGeneration_;
+
+   return pstData;
+}
+
+void USBDeviceSnapshot::AddRef(SnapshotData* pstData_)
+{
+   if(pstData_ != NULL)
+      REGISTRY_ATOMIC_INC(&pstData_->lRefCount);
+}
+
+void USBDeviceSnapshot::Release(SnapshotData* pstData_)
+{
+   if(pstData_ == NULL)
+      return;
+
+   if(REGISTRY_ATOMIC_DEC(&pstData_->lRefCount) != 0)
+      return;
+
+   for(ULONG i=0; i<pstData_->clDevices.size(); i++)
+      delete pstData_->clDevices[i];
+
+   delete pstData_;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////
+// USBDeviceRegistry
+//////////////////////////////////////////////////////////////////////////////////
+
+USBDeviceRegistry::USBDeviceRegistry()
+:
+   pstCurrent(NULL),
+   ulGeneration(0),
+   bHotplugStarted(FALSE),
+   bHotplugActive(FALSE),
+   bStale(TRUE)
+{
+   DSIThread_MutexInit(&stMutexCriticalSection);
+   return;
+}
+
+USBDeviceRegistry::~USBDeviceRegistry()
+{
+   if(bHotplugActive)
+      USBDeviceHandle::StopHotplugNotification();
+
+   USBDeviceSnapshot::Release(pstCurrent);
+   DSIThread_MutexDestroy(&stMutexCriticalSection);
+}
+
+///////////////////////////////////////////////////////////////////////
+// The registry is created on first use; function statics are
+// initialized once even when several threads get here together.
+///////////////////////////////////////////////////////////////////////
+USBDeviceRegistry& USBDeviceRegistry::Instance()
+{
+   static USBDeviceRegistry clRegistry;
+   return clRegistry;
+}
+
+///////////////////////////////////////////////////////////////////////
+const USBDeviceSnapshot USBDeviceRegistry::GetAllDevices()
+{
+   USBDeviceRegistry& clRegistry = Instance();
+
+   DSIThread_MutexLock(&clRegistry.stMutexCriticalSection);
+
+   if(clRegistry.bHotplugStarted == FALSE)
+   {
+      //Register before the first enumeration so nothing attached in between is missed
+      clRegistry.bHotplugStarted = TRUE;
+      clRegistry.bHotplugActive = USBDeviceHandle::StartHotplugNotification(&USBDeviceRegistry::HotplugCallback);
+   }
+
+   if(clRegistry.bStale || clRegistry.bHotplugActive == FALSE || clRegistry.pstCurrent == NULL)
+      clRegistry.Refresh();
+
+   USBDeviceSnapshot::AddRef(clRegistry.pstCurrent);
+   USBDeviceSnapshot clSnapshot(clRegistry.pstCurrent);
+
+   DSIThread_MutexUnlock(&clRegistry.stMutexCriticalSection);
+
+   return clSnapshot;
+}
+
+///////////////////////////////////////////////////////////////////////
+const USBDeviceSnapshot USBDeviceRegistry::GetAvailableDevices()
+{
+   const USBDeviceSnapshot clAllDevices = GetAllDevices();
+
+   USBDeviceSnapshot::SnapshotData* pstAvailable = USBDeviceSnapshot::NewData(clAllDevices.GetGeneration());
+   for(ULONG i=0; i<clAllDevices.GetSize(); i++)
+   {
+      if(USBDeviceHandle::TryOpen(*clAllDevices[i]) == FALSE)
+         continue;
+
+      const USBDevice* pclCopy = NULL;
+      if(USBDeviceHandle::CopyANTDevice(pclCopy, clAllDevices[i]))
+         pstAvailable->clDevices.push_back(pclCopy);
+   }
+
+   return USBDeviceSnapshot(pstAvailable);
+}
+
+///////////////////////////////////////////////////////////////////////
+void USBDeviceRegistry::Invalidate()
+{
+   Instance().bStale = TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////
+BOOL USBDeviceRegistry::IsHotplugActive()
+{
+   USBDeviceRegistry& clRegistry = Instance();
+
+   DSIThread_MutexLock(&clRegistry.stMutexCriticalSection);
+   BOOL bActive = clRegistry.bHotplugActive;
+   DSIThread_MutexUnlock(&clRegistry.stMutexCriticalSection);
+
+   return bActive;
+}
+
+///////////////////////////////////////////////////////////////////////
+// Runs on a system thread; must not take our mutex, since stopping the
+// notification waits for callbacks in progress.
+///////////////////////////////////////////////////////////////////////
+void USBDeviceRegistry::HotplugCallback()
+{
+   Invalidate();
+}
+
+///////////////////////////////////////////////////////////////////////
+// Enumerates the bus into a new snapshot.  stMutexCriticalSection must
+// be locked before calling this function.
+///////////////////////////////////////////////////////////////////////
+void USBDeviceRegistry::Refresh()
+{
+   bStale = FALSE;   //Cleared first, so a device attached while we enumerate marks us stale again
+
+   const ANTDeviceList clDeviceList = USBDeviceHandle::GetAllDevices();
+
+   USBDeviceSnapshot::SnapshotData* pstNew = USBDeviceSnapshot::NewData(++ulGeneration);
+   for(ULONG i=0; i<clDeviceList.GetSize(); i++)
+   {
+      const USBDevice* pclCopy = NULL;
+      if(USBDeviceHandle::CopyANTDevice(pclCopy, clDeviceList[i]))
+         pstNew->clDevices.push_back(pclCopy);
+   }
+
+   USBDeviceSnapshot::Release(pstCurrent);
+   pstCurrent = pstNew;
+}
@@ -0,0 +1,114 @@
+/*
+This software is subject to the license described in the License.txt file
+included with this software distribution. You may not use this file except
+in compliance with this license.
+
+Copyright (c) Dynastream Innovations Inc. 2016
+All rights reserved.
+*/
+#ifndef USB_DEVICE_REGISTRY_HPP
+#define USB_DEVICE_REGISTRY_HPP
+
+#include "types.h"
+#include "dsi_thread.h"
+
+#include "usb_device.hpp"
+
+#include <vector>
+
+
+//////////////////////////////////////////////////////////////////////////////////
+// Public Class Prototypes
+//////////////////////////////////////////////////////////////////////////////////
+
+//An immutable list of ANT devices.  Holds its own copies of the devices, so
+//they stay valid for as long as any copy of the snapshot exists, no matter
+//how many times the bus is enumerated in the meantime.  Copies are cheap.
+class USBDeviceSnapshot
+{
+  public:
+
+   USBDeviceSnapshot();
+   USBDeviceSnapshot(const USBDeviceSnapshot& clSnapshot_);
+   ~USBDeviceSnapshot();
+
+   USBDeviceSnapshot& operator=(const USBDeviceSnapshot& clSnapshot_);
+
+   ULONG GetSize() const;
+   const USBDevice* operator[](ULONG ulNum_) const;
+
+   ULONG GetGeneration() const;
+   /////////////////////////////////////////////////////////////////
+   // Increments each time the registry enumerates the bus, so two
+   // snapshots with the same generation hold the same devices.
+   /////////////////////////////////////////////////////////////////
+
+  private:
+
+   struct SnapshotData
+   {
+      volatile LONG lRefCount;
+      ULONG ulGeneration;
+      std::vector<const USBDevice*> clDevices;
+   };
+
+   SnapshotData* pstData;
+
+   explicit USBDeviceSnapshot(SnapshotData* pstData_);      // Takes over the caller's reference.
+   static SnapshotData* NewData(ULONG ulGeneration_);
+   static void AddRef(SnapshotData* pstData_);
+   static void Release(SnapshotData* pstData_);
+
+   friend class USBDeviceRegistry;
+};
+
+
+//Process-wide cache of the ANT devices on the bus.  The bus is enumerated
+//once and then only again after a hotplug notification says something was
+//attached or removed.  If the platform cannot deliver hotplug notifications,
+//every request enumerates, as USBDeviceHandle::GetAllDevices() does.
+class USBDeviceRegistry
+{
+  public:
+
+   static const USBDeviceSnapshot GetAllDevices();
+   /////////////////////////////////////////////////////////////////
+   // Returns the ANT devices currently attached.
+   /////////////////////////////////////////////////////////////////
+
+   static const USBDeviceSnapshot GetAvailableDevices();
+   /////////////////////////////////////////////////////////////////
+   // Returns the attached devices that can be opened right now.
+   // This trial-opens each cached device but does not enumerate
+   // the bus again.
+   /////////////////////////////////////////////////////////////////
+
+   static void Invalidate();
+   /////////////////////////////////////////////////////////////////
+   // Forces the next request to enumerate the bus.  Called from the
+   // hotplug notification; safe to call from any thread.
+   /////////////////////////////////////////////////////////////////
+
+   static BOOL IsHotplugActive();
+
+  private:
+
+   DSI_MUTEX stMutexCriticalSection;                     // Protects everything below.
+   USBDeviceSnapshot::SnapshotData* pstCurrent;          // We hold one reference on this.
+   ULONG ulGeneration;
+   BOOL bHotplugStarted;
+   BOOL bHotplugActive;
+   volatile BOOL bStale;
+
+   USBDeviceRegistry();
+   ~USBDeviceRegistry();
+
+   static USBDeviceRegistry& Instance();
+   static void HotplugCallback();
+   void Refresh();
+
+   USBDeviceRegistry(const USBDeviceRegistry&);               // Not copyable.
+   USBDeviceRegistry& operator=(const USBDeviceRegistry&);
+};
+
+#endif //USB_DEVICE_REGISTRY_HPP
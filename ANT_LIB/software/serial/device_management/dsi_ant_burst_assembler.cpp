@@ -0,0 +1,207 @@
+/*
+This software is subject to the license described in the License.txt file
+included with this software distribution. You may not use this file except
+in compliance with this license.
+
+Copyright (c) Dynastream Innovations Inc. 2016
+All rights reserved.
+*/
+#include "types.h"
+#include "antdefines.h"
+#include "antmessage.h"
+#include "dsi_framer_ant.hpp"
+
+#include "dsi_ant_burst_assembler.hpp"
+
+#include <string.h>
+
+//////////////////////////////////////////////////////////////////////////////////
+// Private Definitions
+//////////////////////////////////////////////////////////////////////////////////
+
+#define MESG_CHANNEL_OFFSET                  0
+#define MESG_EVENT_ID_OFFSET                 1
+#define MESG_EVENT_CODE_OFFSET               2
+
+#define EXT_BURST_PAYLOAD_OFFSET             5        // Legacy extended burst: channel, device number, device type and transmission type come first.
+#define BURST_PAYLOAD_SIZE                   8
+
+//////////////////////////////////////////////////////////////////////////////////
+// Public Functions
+//////////////////////////////////////////////////////////////////////////////////
+
+DSIANTBurstAssembler::DSIANTBurstAssembler()
+{
+   pucBuffer = (UCHAR*)NULL;
+   ulBufferSize = 0;
+   ulMaxSize = DSI_ANT_BURST_DEFAULT_MAX_SIZE;
+   ulSize = 0;
+   bInProgress = FALSE;
+   ucSequence = 0;
+}
+
+///////////////////////////////////////////////////////////////////////
+DSIANTBurstAssembler::~DSIANTBurstAssembler()
+{
+   delete[] pucBuffer;
+}
+
+///////////////////////////////////////////////////////////////////////
+void DSIANTBurstAssembler::SetMaxSize(ULONG ulMaxSize_)
+{
+   ulMaxSize = ulMaxSize_;
+}
+
+///////////////////////////////////////////////////////////////////////
+BOOL DSIANTBurstAssembler::ProcessMessage(DSIFramerANT *pclANT_, const ANT_MESSAGE *pstMessage_, USHORT usMesgSize_, DSIANTMessageProcessor *pclProcessor_)
+{
+   const UCHAR *pucPayload;
+   ULONG ulPayloadSize;
+   UCHAR aucSegment[MESG_MAX_SIZE_VALUE];
+   UCHAR ucPacketSequence = pstMessage_->aucData[MESG_CHANNEL_OFFSET] & SEQUENCE_NUMBER_MASK;
+
+   switch (pstMessage_->ucMessageID)
+   {
+      case MESG_BURST_DATA_ID:
+         pucPayload = &pstMessage_->aucData[1];
+         ulPayloadSize = BURST_PAYLOAD_SIZE;
+         break;
+
+      case MESG_EXT_BURST_DATA_ID:
+         pucPayload = &pstMessage_->aucData[EXT_BURST_PAYLOAD_OFFSET];
+         ulPayloadSize = BURST_PAYLOAD_SIZE;
+         break;
+
+      case MESG_ADV_BURST_DATA_ID:
+         if (usMesgSize_ < 1)
+            return TRUE;
+         pucPayload = &pstMessage_->aucData[1];
+         ulPayloadSize = usMesgSize_ - 1;
+         break;
+
+      case DSI_FRAMER_ANT_BURST_SEGMENT_ID:
+         pucPayload = aucSegment;
+         ulPayloadSize = pclANT_->GetBurstSegment(pstMessage_, aucSegment);
+
+         if (ulPayloadSize == 0)                                     // Overwritten before it was read.
+         {
+            if (bInProgress)
+               Finish(pclProcessor_, ANT_BURST_RESULT_LOST);
+            return TRUE;
+         }
+         break;
+
+      case MESG_RESPONSE_EVENT_ID:
+         if (bInProgress &&
+             (pstMessage_->aucData[MESG_EVENT_ID_OFFSET] == MESG_EVENT_ID) &&
+             (pstMessage_->aucData[MESG_EVENT_CODE_OFFSET] == EVENT_TRANSFER_RX_FAILED))
+         {
+            Finish(pclProcessor_, ANT_BURST_RESULT_RX_FAILED);
+         }
+         return FALSE;                                               // The processor still sees the event.
+
+      default:
+         return FALSE;
+   }
+
+   if ((ucPacketSequence & ~SEQUENCE_LAST_MESSAGE) == SEQUENCE_FIRST_MESSAGE)
+   {
+      if (bInProgress)
+         Finish(pclProcessor_, ANT_BURST_RESULT_INTERRUPTED);
+
+      bInProgress = TRUE;
+      ulSize = 0;
+   }
+   else
+   {
+      UCHAR ucExpected;
+
+      if (!bInProgress)                                              // The start was missed or the transfer already failed.
+         return TRUE;
+
+      if ((ucSequence & ~SEQUENCE_LAST_MESSAGE) == SEQUENCE_NUMBER_ROLLOVER)
+         ucExpected = SEQUENCE_NUMBER_INC;
+      else
+         ucExpected = (ucSequence & ~SEQUENCE_LAST_MESSAGE) + SEQUENCE_NUMBER_INC;
+
+      if ((ucPacketSequence & ~SEQUENCE_LAST_MESSAGE) != ucExpected)
+      {
+         Finish(pclProcessor_, ANT_BURST_RESULT_SEQUENCE);
+         return TRUE;
+      }
+   }
+
+   ucSequence = ucPacketSequence;
+
+   if (!Append(pucPayload, ulPayloadSize))
+   {
+      Finish(pclProcessor_, ANT_BURST_RESULT_OVERFLOW);
+      return TRUE;
+   }
+
+   if (ucPacketSequence & SEQUENCE_LAST_MESSAGE)
+      Finish(pclProcessor_, ANT_BURST_RESULT_PASS);
+
+   return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////
+void DSIANTBurstAssembler::Reset(void)
+{
+   bInProgress = FALSE;
+   ulSize = 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// Private Functions
+//////////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////
+// Adds data to the transfer, growing the buffer by doubling it.
+// Returns FALSE if the transfer would exceed ulMaxSize or the memory
+// could not be allocated.
+///////////////////////////////////////////////////////////////////////
+BOOL DSIANTBurstAssembler::Append(const UCHAR *pucData_, ULONG ulSize_)
+{
+   if ((ulSize_ > ulMaxSize) || (ulSize > (ulMaxSize - ulSize_)))
+      return FALSE;
+
+   if ((ulSize + ulSize_) > ulBufferSize)
+   {
+      ULONG ulNewSize = (ulBufferSize == 0) ? DSI_ANT_BURST_INITIAL_SIZE : ulBufferSize;
+      UCHAR *pucNewBuffer;
+
+      while (ulNewSize < (ulSize + ulSize_))
+         ulNewSize *= 2;
+
+      pucNewBuffer = new UCHAR[ulNewSize];
+      if (pucNewBuffer == NULL)
+         return FALSE;
+
+      if (ulSize != 0)
+         memcpy(pucNewBuffer, pucBuffer, ulSize);
+
+      delete[] pucBuffer;
+      pucBuffer = pucNewBuffer;
+      ulBufferSize = ulNewSize;
+   }
+
+   memcpy(&pucBuffer[ulSize], pucData_, ulSize_);
+   ulSize += ulSize_;
+
+   return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////
+// Ends the transfer in progress and hands it to the processor.  The
+// data of a failed transfer is what was received before it failed.
+///////////////////////////////////////////////////////////////////////
+void DSIANTBurstAssembler::Finish(DSIANTMessageProcessor *pclProcessor_, ANT_BURST_RESULT eResult_)
+{
+   bInProgress = FALSE;
+
+   if (pclProcessor_ != (DSIANTMessageProcessor*) NULL)
+      pclProcessor_->ProcessBurstTransfer(pucBuffer, ulSize, eResult_);
+
+   ulSize = 0;
+}
@@ -0,0 +1,80 @@
+/*
+This software is subject to the license described in the License.txt file
+included with this software distribution. You may not use this file except
+in compliance with this license.
+
+Copyright (c) Dynastream Innovations Inc. 2016
+All rights reserved.
+*/
+#if !defined(DSI_ANT_BURST_ASSEMBLER_HPP)
+#define DSI_ANT_BURST_ASSEMBLER_HPP
+
+#include "types.h"
+#include "dsi_framer_ant.hpp"
+#include "dsi_ant_message_processor.hpp"
+
+//////////////////////////////////////////////////////////////////////////////////
+// Public Definitions
+//////////////////////////////////////////////////////////////////////////////////
+
+#define DSI_ANT_BURST_INITIAL_SIZE     ((ULONG) 512)        // Buffer allocated for the first transfer on a channel.
+#define DSI_ANT_BURST_DEFAULT_MAX_SIZE ((ULONG) 0x00100000) // Largest transfer assembled unless SetMaxSize() is called.
+
+//////////////////////////////////////////////////////////////////////////////////
+// Public Class Prototypes
+//////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////
+// Collects the burst packets received on one channel into a single
+// buffer, and hands the message processor each transfer once it is
+// complete or has failed.  The buffer grows as needed and is kept
+// for the following transfers.
+/////////////////////////////////////////////////////////////////
+class DSIANTBurstAssembler
+{
+   public:
+
+      DSIANTBurstAssembler();
+      ~DSIANTBurstAssembler();
+
+      void SetMaxSize(ULONG ulMaxSize_);
+      /////////////////////////////////////////////////////////////////
+      // Sets the largest transfer that will be assembled.  Larger
+      // transfers are reported as ANT_BURST_RESULT_OVERFLOW.
+      /////////////////////////////////////////////////////////////////
+
+      BOOL ProcessMessage(DSIFramerANT *pclANT_, const ANT_MESSAGE *pstMessage_, USHORT usMesgSize_, DSIANTMessageProcessor *pclProcessor_);
+      /////////////////////////////////////////////////////////////////
+      // Adds a received message to the transfer in progress.
+      // Parameters:
+      //    *pclANT_:         The framer the message came from, used
+      //                      to read advanced burst segments.
+      //    *pstMessage_:     A message for this assembler's channel.
+      //    usMesgSize_:      Size of the message data.
+      //    *pclProcessor_:   Given the transfer when it ends.
+      // Returns TRUE if the message was a burst packet and has been
+      // used up, or FALSE if it should be passed on as usual.
+      /////////////////////////////////////////////////////////////////
+
+      void Reset(void);
+      /////////////////////////////////////////////////////////////////
+      // Drops the transfer in progress without reporting it.
+      /////////////////////////////////////////////////////////////////
+
+   private:
+
+      UCHAR *pucBuffer;
+      ULONG ulBufferSize;
+      ULONG ulMaxSize;
+      ULONG ulSize;                                         // Bytes of the transfer in progress.
+      BOOL bInProgress;
+      UCHAR ucSequence;                                     // Sequence bits of the last packet added.
+
+      BOOL Append(const UCHAR *pucData_, ULONG ulSize_);
+      void Finish(DSIANTMessageProcessor *pclProcessor_, ANT_BURST_RESULT eResult_);
+
+      DSIANTBurstAssembler(const DSIANTBurstAssembler&);     // Not copyable.
+      DSIANTBurstAssembler& operator=(const DSIANTBurstAssembler&);
+};
+
+#endif  // DSI_ANT_BURST_ASSEMBLER_HPP
@@ -0,0 +1,408 @@
+/*
+This software is subject to the license described in the License.txt file
+included with this software distribution. You may not use this file except
+in compliance with this license.
+
+Copyright (c) Dynastream Innovations Inc. 2016
+All rights reserved.
+*/
+#include "types.h"
+#include "dsi_thread.h"
+#include "dsi_framer_ant.hpp"
+
+#include "dsi_debug.hpp"
+
+#include "dsi_ant_channel_executor.hpp"
+
+#include <string.h>
+
+//////////////////////////////////////////////////////////////////////////////////
+// Public Functions
+//////////////////////////////////////////////////////////////////////////////////
+
+DSIANTChannelExecutor::DSIANTChannelExecutor()
+{
+   for (UCHAR i = 0; i < DSI_ANT_EXECUTOR_CHANNELS; i++)
+   {
+      astChannel[i].pastItems = (Item*)NULL;
+      astChannel[i].usHead = 0;
+      astChannel[i].usCount = 0;
+      astChannel[i].bScheduled = FALSE;
+      astChannel[i].bRunning = FALSE;
+      astChannel[i].ulDropped = 0;
+   }
+
+   ucReadyHead = 0;
+   ucReadyCount = 0;
+   ucThreads = 0;
+   ucThreadsRunning = 0;
+   usQueueSize = 0;
+   eOverflow = ANT_EXECUTOR_OVERFLOW_DROP_OLDEST;
+   pfExecute = (ANT_EXECUTOR_FUNC)NULL;
+   pvParameter = NULL;
+   bStop = TRUE;
+   bPostsBlock = TRUE;
+
+   DSIThread_MutexInit(&stMutexCriticalSection);
+   DSIThread_CondInit(&stCondWork);
+   DSIThread_CondInit(&stCondSpace);
+   DSIThread_CondInit(&stCondIdle);
+   DSIThread_CondInit(&stCondThreadExit);
+}
+
+///////////////////////////////////////////////////////////////////////
+DSIANTChannelExecutor::~DSIANTChannelExecutor()
+{
+   Stop();
+
+   DSIThread_CondDestroy(&stCondThreadExit);
+   DSIThread_CondDestroy(&stCondIdle);
+   DSIThread_CondDestroy(&stCondSpace);
+   DSIThread_CondDestroy(&stCondWork);
+   DSIThread_MutexDestroy(&stMutexCriticalSection);
+}
+
+///////////////////////////////////////////////////////////////////////
+BOOL DSIANTChannelExecutor::Start(UCHAR ucThreads_, USHORT usQueueSize_, ANT_EXECUTOR_OVERFLOW eOverflow_, ANT_EXECUTOR_FUNC pfExecute_, void *pvParameter_)
+{
+   if (ucThreads_ == 0 || ucThreads_ > DSI_ANT_EXECUTOR_MAX_THREADS || usQueueSize_ == 0 || pfExecute_ == NULL)
+      return FALSE;
+
+   Stop();
+
+   for (UCHAR i = 0; i < DSI_ANT_EXECUTOR_CHANNELS; i++)
+   {
+      astChannel[i].pastItems = new Item[usQueueSize_];
+      if (astChannel[i].pastItems == NULL)
+      {
+         Stop();
+         return FALSE;
+      }
+      astChannel[i].ulDropped = 0;
+   }
+
+   usQueueSize = usQueueSize_;
+   eOverflow = eOverflow_;
+   pfExecute = pfExecute_;
+   pvParameter = pvParameter_;
+   bStop = FALSE;
+
+   DSIThread_MutexLock(&stMutexCriticalSection);
+   for (UCHAR i = 0; i < ucThreads_; i++)
+   {
+      ahThread[i] = DSIThread_CreateThread(&DSIANTChannelExecutor::WorkerThreadStart, this);
+      if (ahThread[i] == (DSI_THREAD_ID)NULL)
+         break;
+
+      ucThreads++;
+      ucThreadsRunning++;
+   }
+   DSIThread_MutexUnlock(&stMutexCriticalSection);
+
+   if (ucThreads != ucThreads_)
+   {
+      Stop();
+      return FALSE;
+   }
+
+   return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////
+void DSIANTChannelExecutor::Stop(void)
+{
+   DSIThread_MutexLock(&stMutexCriticalSection);
+
+   bStop = TRUE;
+   DSIThread_CondBroadcast(&stCondWork);
+   DSIThread_CondBroadcast(&stCondSpace);
+
+   while (ucThreadsRunning != 0)
+   {
+      if (DSIThread_CondTimedWait(&stCondThreadExit, &stMutexCriticalSection, 3000) != DSI_THREAD_ENONE)
+      {
+         // We were unable to stop the threads normally.
+         for (UCHAR i = 0; i < ucThreads; i++)
+            DSIThread_DestroyThread(ahThread[i]);
+         ucThreadsRunning = 0;
+      }
+   }
+
+   DSIThread_MutexUnlock(&stMutexCriticalSection);
+
+   for (UCHAR i = 0; i < ucThreads; i++)
+      DSIThread_ReleaseThreadID(ahThread[i]);
+   ucThreads = 0;
+
+   for (UCHAR i = 0; i < DSI_ANT_EXECUTOR_CHANNELS; i++)
+   {
+      delete[] astChannel[i].pastItems;
+      astChannel[i].pastItems = (Item*)NULL;
+      astChannel[i].usHead = 0;
+      astChannel[i].usCount = 0;
+      astChannel[i].bScheduled = FALSE;
+      astChannel[i].bRunning = FALSE;
+   }
+
+   ucReadyHead = 0;
+   ucReadyCount = 0;
+}
+
+///////////////////////////////////////////////////////////////////////
+BOOL DSIANTChannelExecutor::Post(UCHAR ucChannel_, DSIANTMessageProcessor *pclProcessor_, const ANT_MESSAGE *pstMessage_, USHORT usMesgSize_)
+{
+   Channel* pstChannel;
+   Item* pstItem;
+
+   if (ucChannel_ >= DSI_ANT_EXECUTOR_CHANNELS || usMesgSize_ > MESG_MAX_SIZE_VALUE)
+      return FALSE;
+
+   pstChannel = &astChannel[ucChannel_];
+
+   DSIThread_MutexLock(&stMutexCriticalSection);
+
+   if (eOverflow == ANT_EXECUTOR_OVERFLOW_BLOCK)
+   {
+      while (!bStop && bPostsBlock && pstChannel->usCount == usQueueSize)
+         DSIThread_CondTimedWait(&stCondSpace, &stMutexCriticalSection, DSI_THREAD_INFINITE);
+   }
+
+   if (bStop)
+   {
+      DSIThread_MutexUnlock(&stMutexCriticalSection);
+      return FALSE;
+   }
+
+   if (pstChannel->usCount == usQueueSize)
+   {
+      pstChannel->ulDropped++;
+
+      if (eOverflow != ANT_EXECUTOR_OVERFLOW_DROP_OLDEST)
+      {
+         DSIThread_MutexUnlock(&stMutexCriticalSection);
+         return FALSE;
+      }
+
+      pstChannel->usHead = (USHORT)((pstChannel->usHead + 1) % usQueueSize);
+      pstChannel->usCount--;
+   }
+
+   pstItem = &pstChannel->pastItems[(pstChannel->usHead + pstChannel->usCount) % usQueueSize];
+   pstItem->pclProcessor = pclProcessor_;
+   pstItem->usMesgSize = usMesgSize_;
+   pstItem->stMessage.ucMessageID = pstMessage_->ucMessageID;
+   memcpy(pstItem->stMessage.aucData, pstMessage_->aucData, usMesgSize_);
+   pstChannel->usCount++;
+
+   if (!pstChannel->bScheduled)
+      ScheduleChannel(ucChannel_);
+
+   DSIThread_MutexUnlock(&stMutexCriticalSection);
+
+   return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////
+BOOL DSIANTChannelExecutor::Flush(UCHAR ucChannel_)
+{
+   BOOL bWaited = FALSE;
+
+   if (ucChannel_ >= DSI_ANT_EXECUTOR_CHANNELS)
+      return FALSE;
+
+   DSIThread_MutexLock(&stMutexCriticalSection);
+
+   DropQueued(ucChannel_);
+
+   if (!IsWorker())
+   {
+      WaitForRunner(ucChannel_);
+      bWaited = TRUE;
+   }
+
+   DSIThread_MutexUnlock(&stMutexCriticalSection);
+
+   return bWaited;
+}
+
+///////////////////////////////////////////////////////////////////////
+BOOL DSIANTChannelExecutor::FlushAll(void)
+{
+   BOOL bWaited = FALSE;
+
+   DSIThread_MutexLock(&stMutexCriticalSection);
+
+   for (UCHAR i = 0; i < DSI_ANT_EXECUTOR_CHANNELS; i++)
+      DropQueued(i);
+
+   if (!IsWorker())
+   {
+      for (UCHAR i = 0; i < DSI_ANT_EXECUTOR_CHANNELS; i++)
+         WaitForRunner(i);
+      bWaited = TRUE;
+   }
+
+   DSIThread_MutexUnlock(&stMutexCriticalSection);
+
+   return bWaited;
+}
+
+///////////////////////////////////////////////////////////////////////
+void DSIANTChannelExecutor::SetPostsBlock(BOOL bBlock_)
+{
+   DSIThread_MutexLock(&stMutexCriticalSection);
+
+   bPostsBlock = bBlock_;
+   if (!bBlock_)
+      DSIThread_CondBroadcast(&stCondSpace);
+
+   DSIThread_MutexUnlock(&stMutexCriticalSection);
+}
+
+///////////////////////////////////////////////////////////////////////
+ULONG DSIANTChannelExecutor::GetDropped(UCHAR ucChannel_)
+{
+   ULONG ulDropped;
+
+   if (ucChannel_ >= DSI_ANT_EXECUTOR_CHANNELS)
+      return 0;
+
+   DSIThread_MutexLock(&stMutexCriticalSection);
+      ulDropped = astChannel[ucChannel_].ulDropped;
+   DSIThread_MutexUnlock(&stMutexCriticalSection);
+
+   return ulDropped;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// Private Functions
+//////////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////
+// Returns TRUE if the caller is a worker, which is always running a
+// channel while it is outside this class.
+// stMutexCriticalSection must be locked before calling this function.
+///////////////////////////////////////////////////////////////////////
+BOOL DSIANTChannelExecutor::IsWorker(void)
+{
+   DSI_THREAD_IDNUM hCaller = DSIThread_GetCurrentThreadIDNum();
+
+   for (UCHAR i = 0; i < DSI_ANT_EXECUTOR_CHANNELS; i++)
+   {
+      if (astChannel[i].bRunning && DSIThread_CompareThreads(astChannel[i].hRunner, hCaller))
+         return TRUE;
+   }
+
+   return FALSE;
+}
+
+///////////////////////////////////////////////////////////////////////
+// Puts a channel at the back of the ready list.
+// stMutexCriticalSection must be locked before calling this function.
+///////////////////////////////////////////////////////////////////////
+void DSIANTChannelExecutor::ScheduleChannel(UCHAR ucChannel_)
+{
+   // A channel is never in the list twice, so the list can not overflow.
+   aucReady[(ucReadyHead + ucReadyCount) % DSI_ANT_EXECUTOR_CHANNELS] = ucChannel_;
+   ucReadyCount++;
+   astChannel[ucChannel_].bScheduled = TRUE;
+
+   DSIThread_CondSignal(&stCondWork);
+}
+
+///////////////////////////////////////////////////////////////////////
+// stMutexCriticalSection must be locked before calling this function.
+///////////////////////////////////////////////////////////////////////
+void DSIANTChannelExecutor::DropQueued(UCHAR ucChannel_)
+{
+   astChannel[ucChannel_].usHead = 0;
+   astChannel[ucChannel_].usCount = 0;                      // A worker that takes it from the ready list finds it empty.
+
+   DSIThread_CondBroadcast(&stCondSpace);
+}
+
+///////////////////////////////////////////////////////////////////////
+// Waits for the worker running a channel to leave it.  The caller
+// must not be a worker.
+// stMutexCriticalSection must be locked before calling this function.
+///////////////////////////////////////////////////////////////////////
+void DSIANTChannelExecutor::WaitForRunner(UCHAR ucChannel_)
+{
+   Channel* pstChannel = &astChannel[ucChannel_];
+
+   while (pstChannel->bRunning)
+      DSIThread_CondTimedWait(&stCondIdle, &stMutexCriticalSection, DSI_THREAD_INFINITE);
+}
+
+///////////////////////////////////////////////////////////////////////
+void DSIANTChannelExecutor::WorkerThread(void)
+{
+   Item stItem;
+
+   DSIThread_MutexLock(&stMutexCriticalSection);
+
+   while (!bStop)
+   {
+      UCHAR ucChannel;
+      Channel* pstChannel;
+
+      if (ucReadyCount == 0)
+      {
+         DSIThread_CondTimedWait(&stCondWork, &stMutexCriticalSection, DSI_THREAD_INFINITE);
+         continue;
+      }
+
+      ucChannel = aucReady[ucReadyHead];
+      ucReadyHead = (UCHAR)((ucReadyHead + 1) % DSI_ANT_EXECUTOR_CHANNELS);
+      ucReadyCount--;
+
+      pstChannel = &astChannel[ucChannel];
+      pstChannel->bRunning = TRUE;
+      pstChannel->hRunner = DSIThread_GetCurrentThreadIDNum();
+
+      for (UCHAR i = 0; i < DSI_ANT_EXECUTOR_BATCH_SIZE && pstChannel->usCount != 0 && !bStop; i++)
+      {
+         Item* pstItem = &pstChannel->pastItems[pstChannel->usHead];
+
+         // Copied out so the slot can be reused while the processor runs.
+         stItem.pclProcessor = pstItem->pclProcessor;
+         stItem.usMesgSize = pstItem->usMesgSize;
+         stItem.stMessage.ucMessageID = pstItem->stMessage.ucMessageID;
+         memcpy(stItem.stMessage.aucData, pstItem->stMessage.aucData, pstItem->usMesgSize);
+
+         pstChannel->usHead = (USHORT)((pstChannel->usHead + 1) % usQueueSize);
+         pstChannel->usCount--;
+         if (eOverflow == ANT_EXECUTOR_OVERFLOW_BLOCK)
+            DSIThread_CondBroadcast(&stCondSpace);
+
+         DSIThread_MutexUnlock(&stMutexCriticalSection);
+         pfExecute(pvParameter, ucChannel, stItem.pclProcessor, &stItem.stMessage, stItem.usMesgSize);
+         DSIThread_MutexLock(&stMutexCriticalSection);
+      }
+
+      pstChannel->bRunning = FALSE;
+      pstChannel->bScheduled = FALSE;
+      DSIThread_CondBroadcast(&stCondIdle);
+
+      // Anything left waits behind the channels that were already ready.
+      if (pstChannel->usCount != 0 && !bStop)
+         ScheduleChannel(ucChannel);
+   }
+
+   ucThreadsRunning--;
+   DSIThread_CondBroadcast(&stCondThreadExit);
+
+   DSIThread_MutexUnlock(&stMutexCriticalSection);
+}
+
+///////////////////////////////////////////////////////////////////////
+DSI_THREAD_RETURN DSIANTChannelExecutor::WorkerThreadStart(void *pvParameter_)
+{
+   #if defined(DEBUG_FILE)
+   DSIDebug::ThreadInit("ANTWorker");
+   #endif
+
+   ((DSIANTChannelExecutor*)pvParameter_)->WorkerThread();
+
+   return 0;
+}
@@ -0,0 +1,168 @@
+/*
+This software is subject to the license described in the License.txt file
+included with this software distribution. You may not use this file except
+in compliance with this license.
+
+Copyright (c) Dynastream Innovations Inc. 2016
+All rights reserved.
+*/
+#if !defined(DSI_ANT_CHANNEL_EXECUTOR_HPP)
+#define DSI_ANT_CHANNEL_EXECUTOR_HPP
+
+#include "types.h"
+#include "antdefines.h"
+#include "dsi_thread.h"
+#include "dsi_framer_ant.hpp"
+#include "dsi_ant_message_processor.hpp"
+
+//////////////////////////////////////////////////////////////////////////////////
+// Public Definitions
+//////////////////////////////////////////////////////////////////////////////////
+
+#define DSI_ANT_EXECUTOR_MAX_THREADS         8
+#define DSI_ANT_EXECUTOR_CHANNELS            (CHANNEL_NUMBER_MASK + 1)   // Every channel number a message can carry.
+#define DSI_ANT_EXECUTOR_DEFAULT_QUEUE_SIZE  ((USHORT) 64)              // Messages queued per channel.
+#define DSI_ANT_EXECUTOR_BATCH_SIZE          8                          // Messages run for a channel before its worker moves on to the next ready channel.
+
+typedef enum
+{
+   ANT_EXECUTOR_OVERFLOW_DROP_OLDEST = 0,                   // The oldest queued message is dropped to make room.
+   ANT_EXECUTOR_OVERFLOW_DROP_NEWEST = 1,                   // The new message is dropped.
+   ANT_EXECUTOR_OVERFLOW_BLOCK = 2                          // Post() waits for room, holding up every channel.
+} ANT_EXECUTOR_OVERFLOW;
+
+// Runs one message on a worker thread.
+typedef void (*ANT_EXECUTOR_FUNC)(void *pvParameter_, UCHAR ucChannel_, DSIANTMessageProcessor *pclProcessor_, ANT_MESSAGE *pstMessage_, USHORT usMesgSize_);
+
+//////////////////////////////////////////////////////////////////////////////////
+// Public Class Prototypes
+//////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////
+// Runs messages for message processors on a small pool of worker
+// threads.  Each channel has its own bounded queue, and is run by
+// at most one worker at a time, so a processor sees its messages in
+// the order they were posted and never from two threads at once.
+// A busy channel gives its worker up after
+// DSI_ANT_EXECUTOR_BATCH_SIZE messages, so it can not hold up the
+// other channels.
+/////////////////////////////////////////////////////////////////
+class DSIANTChannelExecutor
+{
+   public:
+
+      DSIANTChannelExecutor();
+      ~DSIANTChannelExecutor();
+
+      BOOL Start(UCHAR ucThreads_, USHORT usQueueSize_, ANT_EXECUTOR_OVERFLOW eOverflow_, ANT_EXECUTOR_FUNC pfExecute_, void *pvParameter_);
+      /////////////////////////////////////////////////////////////////
+      // Starts the worker threads.
+      // Parameters:
+      //    ucThreads_:       Number of workers, 1 to
+      //                      DSI_ANT_EXECUTOR_MAX_THREADS.
+      //    usQueueSize_:     Messages queued per channel before
+      //                      eOverflow_ applies.
+      //    eOverflow_:       What Post() does when a queue is full.
+      //    pfExecute_:       Called on a worker for each message.
+      //    *pvParameter_:    Passed to pfExecute_.
+      // Returns TRUE if successful.  Otherwise, it returns FALSE.
+      /////////////////////////////////////////////////////////////////
+
+      void Stop(void);
+      /////////////////////////////////////////////////////////////////
+      // Stops the workers and drops any queued messages.  Must not be
+      // called from a worker.
+      /////////////////////////////////////////////////////////////////
+
+      BOOL Post(UCHAR ucChannel_, DSIANTMessageProcessor *pclProcessor_, const ANT_MESSAGE *pstMessage_, USHORT usMesgSize_);
+      /////////////////////////////////////////////////////////////////
+      // Queues a message for a channel's processor.
+      // Returns FALSE if the message was dropped or the executor is
+      // stopped.  With ANT_EXECUTOR_OVERFLOW_DROP_OLDEST, a full queue
+      // loses its oldest message instead and this returns TRUE.
+      /////////////////////////////////////////////////////////////////
+
+      BOOL Flush(UCHAR ucChannel_);
+      /////////////////////////////////////////////////////////////////
+      // Drops the messages queued for a channel and waits for the
+      // message being run, if any.  Once this returns TRUE nothing
+      // posted before it will be run.
+      // Called from a worker, it only drops the queued messages and
+      // returns FALSE: the worker could be waiting on itself, or on a
+      // worker that is waiting on it.
+      /////////////////////////////////////////////////////////////////
+
+      BOOL FlushAll(void);
+      /////////////////////////////////////////////////////////////////
+      // Flush() for every channel.
+      /////////////////////////////////////////////////////////////////
+
+      void SetPostsBlock(BOOL bBlock_);
+      /////////////////////////////////////////////////////////////////
+      // With ANT_EXECUTOR_OVERFLOW_BLOCK, FALSE makes Post() drop the
+      // new message instead of waiting for room, including a Post()
+      // already waiting.  Lets a thread that waits for the posting
+      // thread do so while the workers wait for it.  TRUE (default)
+      // restores the wait.
+      /////////////////////////////////////////////////////////////////
+
+      ULONG GetDropped(UCHAR ucChannel_);
+      /////////////////////////////////////////////////////////////////
+      // Returns the number of messages dropped for a channel because
+      // its queue was full.
+      /////////////////////////////////////////////////////////////////
+
+   private:
+
+      struct Item
+      {
+         DSIANTMessageProcessor *pclProcessor;
+         USHORT usMesgSize;
+         ANT_MESSAGE stMessage;
+      };
+
+      struct Channel
+      {
+         Item *pastItems;                                   // Ring of usQueueSize items.
+         USHORT usHead;
+         USHORT usCount;
+         BOOL bScheduled;                                   // In the ready list or being run.
+         BOOL bRunning;
+         DSI_THREAD_IDNUM hRunner;                          // Worker running the channel, while bRunning.
+         ULONG ulDropped;
+      };
+
+      Channel astChannel[DSI_ANT_EXECUTOR_CHANNELS];
+      UCHAR aucReady[DSI_ANT_EXECUTOR_CHANNELS];            // Channels waiting for a worker, oldest first.
+      UCHAR ucReadyHead;
+      UCHAR ucReadyCount;
+
+      DSI_THREAD_ID ahThread[DSI_ANT_EXECUTOR_MAX_THREADS];
+      UCHAR ucThreads;
+      UCHAR ucThreadsRunning;
+
+      USHORT usQueueSize;
+      ANT_EXECUTOR_OVERFLOW eOverflow;
+      ANT_EXECUTOR_FUNC pfExecute;
+      void *pvParameter;
+
+      DSI_MUTEX stMutexCriticalSection;                     // Protects everything above.
+      DSI_CONDITION_VAR stCondWork;                         // Signalled when a channel becomes ready.
+      DSI_CONDITION_VAR stCondSpace;                        // Signalled when a queue has room.
+      DSI_CONDITION_VAR stCondIdle;                         // Signalled when a worker leaves a channel.
+      DSI_CONDITION_VAR stCondThreadExit;                   // Signalled when a worker ends.
+      volatile BOOL bStop;
+      BOOL bPostsBlock;
+
+      BOOL IsWorker(void);
+      void ScheduleChannel(UCHAR ucChannel_);
+      void DropQueued(UCHAR ucChannel_);
+      void WaitForRunner(UCHAR ucChannel_);
+      void WorkerThread(void);
+      static DSI_THREAD_RETURN WorkerThreadStart(void *pvParameter_);
+
+      DSIANTChannelExecutor(const DSIANTChannelExecutor&);  // Not copyable.
+      DSIANTChannelExecutor& operator=(const DSIANTChannelExecutor&);
+};
+
+#endif  // DSI_ANT_CHANNEL_EXECUTOR_HPP
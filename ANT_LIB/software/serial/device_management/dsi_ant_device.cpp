@@ -7,6 +7,7 @@ Copyright (c) Dynastream Innovations Inc. 2016
 All rights reserved.
 */
 #include "types.h"
+#include "defines.h"
 #include "version.h"
 #include "dsi_framer_ant.hpp"
 #include "dsi_serial_generic.hpp"
@@ -24,11 +25,41 @@ All rights reserved.
 #include <stdlib.h>
 #include <time.h>
 
+#if defined(DSI_TYPES_WINDOWS)
+   #include <windows.h>
+#endif
+
+//////////////////////////////////////////////////////////////////////////////////
+// Private Definitions
+//////////////////////////////////////////////////////////////////////////////////
+
+#if defined(DSI_TYPES_WINDOWS)
+   #define CHANNEL_TABLE_BARRIER()     MemoryBarrier()
+#else
+   #define CHANNEL_TABLE_BARRIER()     __sync_synchronize()
+#endif
+
+#define CAPABILITIES_MAX_CHANNELS_OFFSET     0
+
 //////////////////////////////////////////////////////////////////////////////////
 // Public Functions
 //////////////////////////////////////////////////////////////////////////////////
 
 DSIANTDevice::DSIANTDevice()
+{
+   Setup(new DSISerialGeneric());
+}
+
+///////////////////////////////////////////////////////////////////////
+DSIANTDevice::DSIANTDevice(DSISerial *pclSerial_)
+{
+   Setup(pclSerial_);
+}
+
+///////////////////////////////////////////////////////////////////////
+// Shared by the constructors; takes ownership of pclSerial_.
+///////////////////////////////////////////////////////////////////////
+void DSIANTDevice::Setup(DSISerial *pclSerial_)
 {
    #if defined(DEBUG_FILE)
       DSIDebug::ThreadInit("Application");
@@ -45,13 +76,20 @@ DSIANTDevice::DSIANTDevice()
 
    ulUSBSerialNumber = 0;
 
-   memset(apclChannelList, 0, sizeof(apclChannelList));
+   pstReaderTable = (ChannelTable*)NULL;
+   pstRetiredTables = (ChannelTable*)NULL;
+   pstChannelTable = NewChannelTable(DSI_ANT_DEVICE_DEFAULT_CHANNELS);
+   paclBurstAssembler = new DSIANTBurstAssembler[DSI_ANT_DEVICE_DEFAULT_CHANNELS];
+   ucBurstAssemblers = DSI_ANT_DEVICE_DEFAULT_CHANNELS;
+   pclExecutor = (DSIANTChannelExecutor*)NULL;
+   if (pstChannelTable == NULL || paclBurstAssembler == NULL)
+      bInitFailed = TRUE;
 
    #if defined(DEBUG_FILE)
       DSIDebug::Init();
    #endif
 
-   pclSerialObject = new DSISerialGeneric();
+   pclSerialObject = pclSerial_;
    pclANT = new DSIFramerANT();
    if (pclANT->Init(pclSerialObject) == FALSE)
    {
@@ -91,6 +129,10 @@ DSIANTDevice::~DSIANTDevice()
    DisconnectFromDevice();
 
    ClearManagedChannelList();
+   delete pclExecutor;
+   FreeRetiredTables();
+   DeleteChannelTable(pstChannelTable);
+   delete[] paclBurstAssembler;
 
    delete pclSerialObject;
    delete pclANT;
@@ -170,6 +212,10 @@ void DSIANTDevice::DisconnectFromDevice()
 
    DSIThread_MutexUnlock(&stMutexCriticalSection);
 
+   // Nothing received before the disconnect is run after it.
+   if (pclExecutor != NULL)
+      pclExecutor->FlushAll();
+
 
    #if defined(DEBUG_FILE)
       DSIDebug::ThreadWrite("DSIANTDevice::DisconnectFromDevice():  Closed.");
@@ -207,6 +253,15 @@ BOOL DSIANTDevice::Open(UCHAR ucUSBDeviceNum_, USHORT usBaudRate_)
       return ConnectToDevice();
 }
 
+///////////////////////////////////////////////////////////////////////
+BOOL DSIANTDevice::OpenSerial(void)
+{
+   //Always make sure we are not currently open
+   DisconnectFromDevice();
+
+   return ConnectToDevice();
+}
+
 
 ///////////////////////////////////////////////////////////////////////
 BOOL DSIANTDevice::ConnectToDevice(void)
@@ -245,9 +300,13 @@ BOOL DSIANTDevice::ConnectToDevice(void)
       pclANT->ResetSystem(200);
       //If this fails it is probably connected at the wrong baud rate
 
-      if(pclANT->GetCapabilities(NULL, 200) == FALSE)
+      //No capabilities means no working device, so the connection fails rather than
+      //guessing a channel count; the table keeps the size it had before.
+      UCHAR aucCapabilities[MESG_CAPABILITIES_SIZE];
+      if(pclANT->GetCapabilities(aucCapabilities, 200) == FALSE)
+         failedConnect = TRUE;
+      else if(SetChannelCount(aucCapabilities[CAPABILITIES_MAX_CHANNELS_OFFSET]) == FALSE)
          failedConnect = TRUE;
-      //TODO could get number of channels and use dynamic sized channel array
    }
 
    if(!failedConnect)
@@ -278,7 +337,7 @@ BOOL DSIANTDevice::AddMessageProcessor(UCHAR ucChannelNumber_, DSIANTMessageProc
 {
    DSIThread_MutexLock(&stMutexChannelListAccess);
 
-   if(ucChannelNumber_ >= MAX_ANT_CHANNELS)
+   if(ucChannelNumber_ >= pstChannelTable->ucChannels)
    {
       #if defined(DEBUG_FILE)
          DSIDebug::ThreadWrite("DSIANTDevice::AddManagedChannel():  Invalid channel number");
@@ -287,7 +346,7 @@ BOOL DSIANTDevice::AddMessageProcessor(UCHAR ucChannelNumber_, DSIANTMessageProc
       return FALSE;
    }
 
-   if(apclChannelList[ucChannelNumber_] != (DSIANTMessageProcessor*) NULL)
+   if(pstChannelTable->apclChannel[ucChannelNumber_] != (DSIANTMessageProcessor*) NULL)
    {
       #if defined(DEBUG_FILE)
          DSIDebug::ThreadWrite("DSIANTDevice::AddManagedChannel(): Managed channel already registered for this channel number. Unregister first.");
@@ -296,9 +355,20 @@ BOOL DSIANTDevice::AddMessageProcessor(UCHAR ucChannelNumber_, DSIANTMessageProc
       return FALSE;
    }
 
-   apclChannelList[ucChannelNumber_] = pclChannel_;
+   ChannelTable* pstTable = CopyChannelTable();
+   if(pstTable == (ChannelTable*) NULL)
+   {
+      DSIThread_MutexUnlock(&stMutexChannelListAccess);
+      return FALSE;
+   }
+
+   paclBurstAssembler[ucChannelNumber_].Reset();
    pclChannel_->Init(pclANT, ucChannelNumber_);
 
+   // The receive thread does not see the processor until it is initialized.
+   pstTable->apclChannel[ucChannelNumber_] = pclChannel_;
+   PublishChannelTable(pstTable, FALSE);
+
    DSIThread_MutexUnlock(&stMutexChannelListAccess);
 
    return TRUE;
@@ -320,7 +390,7 @@ BOOL DSIANTDevice::RemoveMessageProcessor(DSIANTMessageProcessor* pclChannel_)
    // Find the handle in the list
    ucChannel = pclChannel_->GetChannelNumber();
 
-   if(apclChannelList[ucChannel] == (DSIANTMessageProcessor*) NULL)
+   if(ucChannel >= pstChannelTable->ucChannels || pstChannelTable->apclChannel[ucChannel] == (DSIANTMessageProcessor*) NULL)
    {
       #if defined(DEBUG_FILE)
          DSIDebug::ThreadWrite("DSIANTDevice::RemoveMessageProcessor(): No message processor registered.");
@@ -329,7 +399,7 @@ BOOL DSIANTDevice::RemoveMessageProcessor(DSIANTMessageProcessor* pclChannel_)
       return FALSE;
    }
 
-   if(apclChannelList[ucChannel] != pclChannel_)
+   if(pstChannelTable->apclChannel[ucChannel] != pclChannel_)
    {
       #if defined(DEBUG_FILE)
          DSIDebug::ThreadWrite("DSIANTDevice::RemoveMessageProcessor(): Message processor mismatch during removal.");
@@ -338,8 +408,30 @@ BOOL DSIANTDevice::RemoveMessageProcessor(DSIANTMessageProcessor* pclChannel_)
       return FALSE;
    }
 
+   ChannelTable* pstTable = CopyChannelTable();
+   if(pstTable == (ChannelTable*) NULL)
+   {
+      DSIThread_MutexUnlock(&stMutexChannelListAccess);
+      return FALSE;
+   }
+
+   // Once the receive thread has moved on to the new table, it can not be inside the processor.
+   pstTable->apclChannel[ucChannel] = (DSIANTMessageProcessor*) NULL;
+   PublishChannelTable(pstTable, TRUE);
+
+   DSIThread_MutexUnlock(&stMutexChannelListAccess);
+
+   // Not flushed under the lock; the message being run may need it.
+   if (pclExecutor != NULL)
+      pclExecutor->Flush(ucChannel);
+
    pclChannel_->Close();
-   apclChannelList[ucChannel] = (DSIANTMessageProcessor*) NULL;
+
+   DSIThread_MutexLock(&stMutexChannelListAccess);
+
+   // Unless a new processor has taken the channel meanwhile.
+   if(ucChannel < ucBurstAssemblers && pstChannelTable->apclChannel[ucChannel] == (DSIANTMessageProcessor*) NULL)
+      paclBurstAssembler[ucChannel].Reset();
 
    DSIThread_MutexUnlock(&stMutexChannelListAccess);
 
@@ -354,8 +446,106 @@ BOOL DSIANTDevice::RemoveMessageProcessor(DSIANTMessageProcessor* pclChannel_)
 void DSIANTDevice::ClearManagedChannelList(void)
 {
    DSIThread_MutexLock(&stMutexChannelListAccess);
-      memset(apclChannelList, 0, sizeof(apclChannelList));
+
+   ChannelTable* pstTable = NewChannelTable(pstChannelTable->ucChannels);
+   if(pstTable == (ChannelTable*) NULL)
+   {
+      DSIThread_MutexUnlock(&stMutexChannelListAccess);
+      return;
+   }
+
+   PublishChannelTable(pstTable, TRUE);
+
+   DSIThread_MutexUnlock(&stMutexChannelListAccess);
+
+   if (pclExecutor != NULL)
+      pclExecutor->FlushAll();
+
+   DSIThread_MutexLock(&stMutexChannelListAccess);
+
+   for (UCHAR i = 0; i < ucBurstAssemblers; i++)
+   {
+      if(pstChannelTable->apclChannel[i] == (DSIANTMessageProcessor*) NULL)
+         paclBurstAssembler[i].Reset();
+   }
+
+   DSIThread_MutexUnlock(&stMutexChannelListAccess);
+}
+
+///////////////////////////////////////////////////////////////////////
+BOOL DSIANTDevice::SetMaxBurstSize(UCHAR ucChannelNumber_, ULONG ulMaxSize_)
+{
+   BOOL bReturn = FALSE;
+
+   DSIThread_MutexLock(&stMutexChannelListAccess);
+   if(ucChannelNumber_ < ucBurstAssemblers)
+   {
+      paclBurstAssembler[ucChannelNumber_].SetMaxSize(ulMaxSize_);
+      bReturn = TRUE;
+   }
    DSIThread_MutexUnlock(&stMutexChannelListAccess);
+
+   return bReturn;
+}
+
+///////////////////////////////////////////////////////////////////////
+BOOL DSIANTDevice::SetProcessorThreads(UCHAR ucThreads_, USHORT usQueueSize_, ANT_EXECUTOR_OVERFLOW eOverflow_)
+{
+   BOOL bReturn = TRUE;
+
+   DSIThread_MutexLock(&stMutexCriticalSection);
+
+   if (hReceiveThread != NULL)
+   {
+      #if defined(DEBUG_FILE)
+         DSIDebug::ThreadWrite("DSIANTDevice::SetProcessorThreads():  Device is open.");
+      #endif
+      DSIThread_MutexUnlock(&stMutexCriticalSection);
+      return FALSE;
+   }
+
+   delete pclExecutor;
+   pclExecutor = (DSIANTChannelExecutor*)NULL;
+
+   if (ucThreads_ != 0)
+   {
+      pclExecutor = new DSIANTChannelExecutor();
+      if (pclExecutor == NULL)
+      {
+         bReturn = FALSE;
+      }
+      else if (pclExecutor->Start(ucThreads_, usQueueSize_, eOverflow_, &DSIANTDevice::DispatchMessageStart, this) == FALSE)
+      {
+         delete pclExecutor;
+         pclExecutor = (DSIANTChannelExecutor*)NULL;
+         bReturn = FALSE;
+      }
+   }
+
+   DSIThread_MutexUnlock(&stMutexCriticalSection);
+
+   return bReturn;
+}
+
+///////////////////////////////////////////////////////////////////////
+ULONG DSIANTDevice::GetDroppedMessages(UCHAR ucChannelNumber_)
+{
+   if (pclExecutor == NULL)
+      return 0;
+
+   return pclExecutor->GetDropped(ucChannelNumber_);
+}
+
+///////////////////////////////////////////////////////////////////////
+UCHAR DSIANTDevice::GetChannelCount(void)
+{
+   UCHAR ucChannels;
+
+   DSIThread_MutexLock(&stMutexChannelListAccess);
+      ucChannels = pstChannelTable->ucChannels;
+   DSIThread_MutexUnlock(&stMutexChannelListAccess);
+
+   return ucChannels;
 }
 
 #if defined(DEBUG_FILE)
@@ -397,101 +587,105 @@ DSI_THREAD_RETURN DSIANTDevice::ReceiveThreadStart(void *pvParameter_)
 
 void DSIANTDevice::ReceiveThread(void)
 {
-   ANT_MESSAGE stMessage;
-   USHORT usMesgSize = 0;
+   ANT_MESSAGE_VIEW astMessages[DSI_ANT_DEVICE_RX_BATCH_SIZE];
 
+   hReceiveThreadIDNum = DSIThread_GetCurrentThreadIDNum();
    bReceiveThreadRunning = TRUE;
 
    while (bKillThread == FALSE)
    {
-      usMesgSize = pclANT->WaitForMessage(1000);
+      if (pclANT->WaitForMessages(1000) == 0)
+         continue;
 
       if (bKillThread)
          break;
 
-      switch(usMesgSize)
+      // Take everything queued in one go and dispatch it in place, without holding the framer.
+      ULONG ulMessages = pclANT->PeekMessages(astMessages, DSI_ANT_DEVICE_RX_BATCH_SIZE);
+      BOOL bSerialError = FALSE;
+
+      for (ULONG i = 0; i < ulMessages; i++)
       {
-         case DSI_FRAMER_TIMEDOUT:
-            break;
+         ANT_MESSAGE *pstMessage = (ANT_MESSAGE*)astMessages[i].pstANTMessage;
+         USHORT usMesgSize = astMessages[i].ucSize;
+         UCHAR ucANTChannel;
 
-         case DSI_FRAMER_ERROR:
+         if (astMessages[i].ucSize == DSI_FRAMER_ANT_ITEM_ERROR)
+         {
+            #if defined(DEBUG_FILE)
             {
-               usMesgSize = pclANT->GetMessage(&stMessage, MESG_MAX_SIZE_VALUE);  //get the message to clear the error
-               #if defined(DEBUG_FILE)
-               {
-                  UCHAR aucString[256];
+               UCHAR aucString[256];
 
-                  SNPRINTF((char *)aucString,256, "DSIANTDevice::RecvThread():  Framer Error %u .", stMessage.ucMessageID);
-                  DSIDebug::ThreadWrite((char *)aucString);
+               SNPRINTF((char *)aucString,256, "DSIANTDevice::RecvThread():  Framer Error %u .", pstMessage->ucMessageID);
+               DSIDebug::ThreadWrite((char *)aucString);
 
-                  if(stMessage.ucMessageID == DSI_FRAMER_ANT_ESERIAL)
-                  {
-                     SNPRINTF((char *)aucString,256, "DSIANTDevice::RecvThread():  Serial Error %u .", stMessage.aucData[0]);
-                     DSIDebug::ThreadWrite((char *)aucString);
-                  }
+               if(pstMessage->ucMessageID == DSI_FRAMER_ANT_ESERIAL)
+               {
+                  SNPRINTF((char *)aucString,256, "DSIANTDevice::RecvThread():  Serial Error %u .", pstMessage->aucData[0]);
+                  DSIDebug::ThreadWrite((char *)aucString);
                }
-               #endif
-
-               //bCancel = TRUE;
+            }
+            #endif
 
-               HandleSerialError();
+            //bCancel = TRUE;
 
-               continue;
-            }
+            bSerialError = TRUE;
             break;
+         }
 
-         default:
-            //if (usMesgSize < DSI_FRAMER_TIMEDOUT)  //if the return isn't DSI_FRAMER_TIMEDOUT or DSI_FRAMER_ERROR
-            {
-               UCHAR ucANTChannel;
-               usMesgSize = pclANT->GetMessage(&stMessage, MESG_MAX_SIZE_VALUE);
+         #if defined(DEBUG_FILE)
+         if (usMesgSize == 0)
+         {
+            UCHAR aucString2[256];
 
-               #if defined(DEBUG_FILE)
-               if (usMesgSize == 0)
-               {
-                  UCHAR aucString2[256];
+            SNPRINTF((char *)aucString2,256, "Rx msg reported size 0, dump:%u[0x%02X]...[0x%02X][0x%02X][0x%02X][0x%02X][0x%02X][0x%02X][0x%02X][0x%02X]", usMesgSize , pstMessage->ucMessageID, pstMessage->aucData[0], pstMessage->aucData[1], pstMessage->aucData[2], pstMessage->aucData[3], pstMessage->aucData[4], pstMessage->aucData[5], pstMessage->aucData[6], pstMessage->aucData[7]);
+            DSIDebug::ThreadWrite((char *)aucString2);
+         }
+         #endif
 
-                  SNPRINTF((char *)aucString2,256, "Rx msg reported size 0, dump:%u[0x%02X]...[0x%02X][0x%02X][0x%02X][0x%02X][0x%02X][0x%02X][0x%02X][0x%02X]", usMesgSize , stMessage.ucMessageID, stMessage.aucData[0], stMessage.aucData[1], stMessage.aucData[2], stMessage.aucData[3], stMessage.aucData[4], stMessage.aucData[5], stMessage.aucData[6], stMessage.aucData[7]);
-                  DSIDebug::ThreadWrite((char *)aucString2);
-               }
-               #endif
+         if(pstMessage->ucMessageID == MESG_SERIAL_ERROR_ID)
+         {
+            #if defined(DEBUG_FILE)
+            {
+               UCHAR aucString[256];
+               SNPRINTF((char *) aucString, 256, "DSIANTDevice::RecvThread():  Serial Error.");
+               DSIDebug::ThreadWrite((char *) aucString);
+            }
+            #endif
 
-               if(stMessage.ucMessageID == MESG_SERIAL_ERROR_ID)
-               {
-                  #if defined(DEBUG_FILE)
-                  {
-                     UCHAR aucString[256];
-                     SNPRINTF((char *) aucString, 256, "DSIANTDevice::RecvThread():  Serial Error.");
-                     DSIDebug::ThreadWrite((char *) aucString);
-                  }
-                  #endif
+            bSerialError = TRUE;
+            break;
+         }
 
-                  HandleSerialError();
+         // Figure out channel
+         //ucANTChannel = stMessage.aucData[MESG_CHANNEL_OFFSET] & CHANNEL_NUMBER_MASK;
+         ucANTChannel = pclANT->GetChannelNumber(pstMessage);
 
-                  continue;
-               }
+         // Send messages to appropriate handler
+         ChannelTable* pstTable = AcquireChannelTable();
 
-               // Figure out channel
-               //ucANTChannel = stMessage.aucData[MESG_CHANNEL_OFFSET] & CHANNEL_NUMBER_MASK;
-               ucANTChannel = pclANT->GetChannelNumber(&stMessage);
+         if(ucANTChannel < pstTable->ucChannels)
+         {
+            DSIANTMessageProcessor* pclProcessor = pstTable->apclChannel[ucANTChannel];
 
-               // Send messages to appropriate handler
-               if(ucANTChannel != 0xFF)
-               {
-                  DSIThread_MutexLock(&stMutexChannelListAccess);
+            // TODO: Add general channel and protocol event callbacks?
+            if(pclProcessor != (DSIANTMessageProcessor*) NULL)
+            {
+               if(pclExecutor != NULL)
+                  pclExecutor->Post(ucANTChannel, pclProcessor, pstMessage, usMesgSize);
+               else
+                  DispatchMessage(ucANTChannel, pclProcessor, pstMessage, usMesgSize);
+            }
+         }
 
-                  // TODO: Add general channel and protocol event callbacks?
-                  if(apclChannelList[ucANTChannel] != (DSIANTMessageProcessor*) NULL)
-                  {
-                     if(apclChannelList[ucANTChannel]->GetEnabled())
-                        apclChannelList[ucANTChannel]->ProcessMessage(&stMessage, usMesgSize);
-                  }
+         ReleaseChannelTable();
+      }
 
-                  DSIThread_MutexUnlock(&stMutexChannelListAccess);
-               }
+      pclANT->ConsumeMessage();
 
-             }
-      }
+      // The messages after a serial error are dropped with the connection.
+      if (bSerialError)
+         HandleSerialError();
 
    } // while()
 
@@ -501,19 +695,48 @@ void DSIANTDevice::ReceiveThread(void)
    DSIThread_MutexUnlock(&stMutexCriticalSection);
 }
 
+///////////////////////////////////////////////////////////////////////
+// Passes a message to its channel's processor, on the receive thread
+// or on a worker.
+///////////////////////////////////////////////////////////////////////
+void DSIANTDevice::DispatchMessage(UCHAR ucChannel_, DSIANTMessageProcessor* pclProcessor_, ANT_MESSAGE* pstMessage_, USHORT usMesgSize_)
+{
+   if(pclProcessor_->GetEnabled())
+   {
+      // Burst packets stop here for processors that take whole transfers.
+      if(!pclProcessor_->GetAssembleBursts() ||
+         !paclBurstAssembler[ucChannel_].ProcessMessage(pclANT, pstMessage_, usMesgSize_, pclProcessor_))
+      {
+         pclProcessor_->ProcessMessage(pstMessage_, usMesgSize_);
+      }
+   }
+}
+
+///////////////////////////////////////////////////////////////////////
+void DSIANTDevice::DispatchMessageStart(void *pvParameter_, UCHAR ucChannel_, DSIANTMessageProcessor* pclProcessor_, ANT_MESSAGE* pstMessage_, USHORT usMesgSize_)
+{
+   ((DSIANTDevice*)pvParameter_)->DispatchMessage(ucChannel_, pclProcessor_, pstMessage_, usMesgSize_);
+}
+
 ///////////////////////////////////////////////////////////////////////
 //TODO //TTA Should change this to be like the managed side
 void DSIANTDevice::HandleSerialError(void)
 {
    UCHAR i;
 
+   // Processors are not run while they are being notified.
+   if (pclExecutor != NULL)
+      pclExecutor->FlushAll();
+
    DSIThread_MutexLock(&stMutexChannelListAccess);
 
    // Notify callbacks
-   for(i = 0; i< MAX_ANT_CHANNELS; i++)
+   for(i = 0; i< pstChannelTable->ucChannels; i++)
    {
-      if(apclChannelList[i] != (DSIANTMessageProcessor*) NULL)
-         apclChannelList[i]->ProcessDeviceNotification(ANT_DEVICE_NOTIFICATION_SHUTDOWN, (void*) NULL);
+      paclBurstAssembler[i].Reset();
+
+      if(pstChannelTable->apclChannel[i] != (DSIANTMessageProcessor*) NULL)
+         pstChannelTable->apclChannel[i]->ProcessDeviceNotification(ANT_DEVICE_NOTIFICATION_SHUTDOWN, (void*) NULL);
    }
 
    DSIThread_MutexUnlock(&stMutexChannelListAccess);
@@ -523,3 +746,192 @@ void DSIANTDevice::HandleSerialError(void)
    #endif
    DisconnectFromDevice();
 }
+
+///////////////////////////////////////////////////////////////////////
+// Marks the published table as in use by the receive thread and
+// returns it.  Only the receive thread may call this, once per
+// message, followed by ReleaseChannelTable().
+///////////////////////////////////////////////////////////////////////
+DSIANTDevice::ChannelTable* DSIANTDevice::AcquireChannelTable(void)
+{
+   ChannelTable* pstTable;
+
+   // Check the table was not replaced before the mark could be seen.
+   do
+   {
+      pstTable = pstChannelTable;
+      pstReaderTable = pstTable;
+      CHANNEL_TABLE_BARRIER();
+   } while (pstTable != pstChannelTable);
+
+   return pstTable;
+}
+
+///////////////////////////////////////////////////////////////////////
+void DSIANTDevice::ReleaseChannelTable(void)
+{
+   CHANNEL_TABLE_BARRIER();
+   pstReaderTable = (ChannelTable*)NULL;
+}
+
+///////////////////////////////////////////////////////////////////////
+// Returns an empty table with ucChannels_ channels, or NULL if it
+// could not be allocated.
+///////////////////////////////////////////////////////////////////////
+DSIANTDevice::ChannelTable* DSIANTDevice::NewChannelTable(UCHAR ucChannels_)
+{
+   ChannelTable* pstTable = new ChannelTable;
+
+   if (pstTable == NULL)
+      return (ChannelTable*)NULL;
+
+   pstTable->ucChannels = ucChannels_;
+   pstTable->pstNextRetired = (ChannelTable*)NULL;
+   pstTable->apclChannel = new DSIANTMessageProcessor*[ucChannels_ + 1];   // Never empty, so never NULL when it succeeds.
+
+   if (pstTable->apclChannel == NULL)
+   {
+      delete pstTable;
+      return (ChannelTable*)NULL;
+   }
+
+   memset(pstTable->apclChannel, 0, (ucChannels_ + 1) * sizeof(DSIANTMessageProcessor*));
+
+   return pstTable;
+}
+
+///////////////////////////////////////////////////////////////////////
+void DSIANTDevice::DeleteChannelTable(ChannelTable* pstTable_)
+{
+   if (pstTable_ == NULL)
+      return;
+
+   delete[] pstTable_->apclChannel;
+   delete pstTable_;
+}
+
+///////////////////////////////////////////////////////////////////////
+// Returns a copy of the published table to be changed and published.
+// stMutexChannelListAccess must be locked before calling this function.
+///////////////////////////////////////////////////////////////////////
+DSIANTDevice::ChannelTable* DSIANTDevice::CopyChannelTable(void)
+{
+   ChannelTable* pstTable = NewChannelTable(pstChannelTable->ucChannels);
+
+   if (pstTable != NULL)
+      memcpy(pstTable->apclChannel, pstChannelTable->apclChannel, pstTable->ucChannels * sizeof(DSIANTMessageProcessor*));
+
+   return pstTable;
+}
+
+///////////////////////////////////////////////////////////////////////
+// Sizes the channel table and burst assemblers for a device with
+// ucChannels_ channels.  Processors already added keep their channels,
+// even past the end of the device's.  Must only be called while the
+// receive thread is stopped.
+// Returns FALSE if the memory could not be allocated.
+///////////////////////////////////////////////////////////////////////
+BOOL DSIANTDevice::SetChannelCount(UCHAR ucChannels_)
+{
+   DSIThread_MutexLock(&stMutexChannelListAccess);
+
+   for (UCHAR i = ucChannels_; i < pstChannelTable->ucChannels; i++)
+   {
+      if (pstChannelTable->apclChannel[i] != (DSIANTMessageProcessor*) NULL)
+         ucChannels_ = i + 1;
+   }
+
+   if (ucChannels_ != pstChannelTable->ucChannels)
+   {
+      ChannelTable* pstTable = NewChannelTable(ucChannels_);
+      DSIANTBurstAssembler* paclAssemblers = new DSIANTBurstAssembler[ucChannels_ + 1];
+
+      if (pstTable == NULL || paclAssemblers == NULL)
+      {
+         DeleteChannelTable(pstTable);
+         delete[] paclAssemblers;
+         DSIThread_MutexUnlock(&stMutexChannelListAccess);
+         return FALSE;
+      }
+
+      memcpy(pstTable->apclChannel, pstChannelTable->apclChannel, MIN(ucChannels_, pstChannelTable->ucChannels) * sizeof(DSIANTMessageProcessor*));
+      PublishChannelTable(pstTable, TRUE);
+
+      delete[] paclBurstAssembler;
+      paclBurstAssembler = paclAssemblers;
+      ucBurstAssemblers = ucChannels_;
+
+      #if defined(DEBUG_FILE)
+         DSIDebug::ThreadPrintf("DSIANTDevice::SetChannelCount(): %u channels.", ucChannels_);
+      #endif
+   }
+
+   DSIThread_MutexUnlock(&stMutexChannelListAccess);
+
+   return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////
+// Replaces the published table.  With bWaitForReader_, returns only
+// once the receive thread is no longer dispatching from the old
+// table, unless it is the caller.  Old tables are freed once the
+// receive thread is not using them.
+// stMutexChannelListAccess must be locked before calling this function.
+///////////////////////////////////////////////////////////////////////
+void DSIANTDevice::PublishChannelTable(ChannelTable* pstTable_, BOOL bWaitForReader_)
+{
+   ChannelTable* pstOldTable = pstChannelTable;
+
+   CHANNEL_TABLE_BARRIER();                                       // The new table is filled in before it is seen.
+   pstChannelTable = pstTable_;
+   CHANNEL_TABLE_BARRIER();
+
+   pstOldTable->pstNextRetired = pstRetiredTables;
+   pstRetiredTables = pstOldTable;
+
+   if (bWaitForReader_ &&
+       ((bReceiveThreadRunning == FALSE) || !DSIThread_CompareThreads(hReceiveThreadIDNum, DSIThread_GetCurrentThreadIDNum())))
+   {
+      // The receive thread may be waiting for room on a worker that is
+      // waiting for stMutexChannelListAccess.
+      if (pclExecutor != NULL)
+         pclExecutor->SetPostsBlock(FALSE);
+
+      while (pstReaderTable == pstOldTable)
+         DSIThread_Sleep(1);
+
+      if (pclExecutor != NULL)
+         pclExecutor->SetPostsBlock(TRUE);
+   }
+
+   FreeRetiredTables();
+}
+
+///////////////////////////////////////////////////////////////////////
+// Frees the replaced tables the receive thread is not using.
+// stMutexChannelListAccess must be locked before calling this function,
+// unless the receive thread has stopped.
+///////////////////////////////////////////////////////////////////////
+void DSIANTDevice::FreeRetiredTables(void)
+{
+   ChannelTable** ppstTable = &pstRetiredTables;
+   ChannelTable* pstInUse;
+
+   CHANNEL_TABLE_BARRIER();
+   pstInUse = pstReaderTable;
+
+   while (*ppstTable != NULL)
+   {
+      ChannelTable* pstTable = *ppstTable;
+
+      if (pstTable == pstInUse)
+      {
+         ppstTable = &pstTable->pstNextRetired;
+      }
+      else
+      {
+         *ppstTable = pstTable->pstNextRetired;
+         DeleteChannelTable(pstTable);
+      }
+   }
+}
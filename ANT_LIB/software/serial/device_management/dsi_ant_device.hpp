@@ -18,16 +18,18 @@ All rights reserved.
 #include "antmessage.h"
 
 #include "dsi_ant_message_processor.hpp"
+#include "dsi_ant_burst_assembler.hpp"
+#include "dsi_ant_channel_executor.hpp"
 #include "dsi_response_queue.hpp"
 
 
-#define MAX_ANT_CHANNELS  8
-
 //////////////////////////////////////////////////////////////////////////////////
 // Public Definitions
 //////////////////////////////////////////////////////////////////////////////////
 
-//----none----
+#define DSI_ANT_DEVICE_DEFAULT_CHANNELS ((UCHAR) 8)        // Channels available until a device reports how many it has.
+
+#define DSI_ANT_DEVICE_RX_BATCH_SIZE   ((ULONG) 32)        // Messages taken from the framer each time the receive thread wakes.
 
 //////////////////////////////////////////////////////////////////////////////////
 // Public Class Prototypes
@@ -49,7 +51,14 @@ class DSIANTDevice
       // Private Definitions
       //////////////////////////////////////////////////////////////////////////////////
 
-      //----none----
+      // The message processors, as seen by the receive thread.  A table is never
+      // changed once published; registration publishes a new one in its place.
+      struct ChannelTable
+      {
+         UCHAR ucChannels;
+         DSIANTMessageProcessor** apclChannel;              // ucChannels entries.
+         ChannelTable* pstNextRetired;
+      };
 
       //////////////////////////////////////////////////////////////////////////////////
       // Private Variables
@@ -58,7 +67,8 @@ class DSIANTDevice
       volatile BOOL bOpened;
 
       DSI_THREAD_ID hReceiveThread;                         // Handle for the receive thread.
-      DSI_MUTEX stMutexChannelListAccess;                  // Mutex used with the channel list
+      DSI_THREAD_IDNUM hReceiveThreadIDNum;
+      DSI_MUTEX stMutexChannelListAccess;                  // Serializes changes to the channel table
       DSI_CONDITION_VAR stCondReceiveThreadExit;            // Event to signal the receive thread has ended.
 
       volatile BOOL bKillThread;
@@ -67,9 +77,14 @@ class DSIANTDevice
 
       ULONG ulUSBSerialNumber;
 
-      DSIANTMessageProcessor* apclChannelList[MAX_ANT_CHANNELS];
+      ChannelTable* volatile pstChannelTable;               // The published table.
+      ChannelTable* volatile pstReaderTable;                // Table the receive thread is dispatching from, NULL when it is not.
+      ChannelTable* pstRetiredTables;                       // Replaced tables that may still be in use.
+      DSIANTBurstAssembler* paclBurstAssembler;             // One per channel of the table, for processors that assemble bursts.
+      UCHAR ucBurstAssemblers;
+      DSIANTChannelExecutor* pclExecutor;                   // Runs the processors on worker threads, or NULL to run them on the receive thread.
 
-      DSISerialGeneric *pclSerialObject;
+      DSISerial *pclSerialObject;                           // Owned; a DSISerialGeneric unless another port was given to the constructor.
       DSIFramerANT *pclANT;
 
    protected:
@@ -79,9 +94,20 @@ class DSIANTDevice
       // Private Function Prototypes
       //////////////////////////////////////////////////////////////////////////////////
 
+      void Setup(DSISerial *pclSerial_);
       void DisconnectFromDevice();
 
       void ReceiveThread(void);
+      void DispatchMessage(UCHAR ucChannel_, DSIANTMessageProcessor* pclProcessor_, ANT_MESSAGE* pstMessage_, USHORT usMesgSize_);
+      static void DispatchMessageStart(void *pvParameter_, UCHAR ucChannel_, DSIANTMessageProcessor* pclProcessor_, ANT_MESSAGE* pstMessage_, USHORT usMesgSize_);
+      ChannelTable* AcquireChannelTable(void);
+      void ReleaseChannelTable(void);
+      ChannelTable* NewChannelTable(UCHAR ucChannels_);
+      void DeleteChannelTable(ChannelTable* pstTable_);
+      ChannelTable* CopyChannelTable(void);
+      BOOL SetChannelCount(UCHAR ucChannels_);
+      void PublishChannelTable(ChannelTable* pstTable_, BOOL bWaitForReader_);
+      void FreeRetiredTables(void);
       static DSI_THREAD_RETURN ReceiveThreadStart(void *pvParameter_);
       BOOL ConnectToDevice(void);
 
@@ -92,6 +118,13 @@ class DSIANTDevice
    public:
 
       DSIANTDevice();
+      DSIANTDevice(DSISerial *pclSerial_);
+      /////////////////////////////////////////////////////////////////
+      // Uses the given port instead of a DSISerialGeneric, e.g. a
+      // DSISerialTTY served by a DSISerialReactor.  The device deletes
+      // the port when it is destroyed.
+      /////////////////////////////////////////////////////////////////
+
       virtual ~DSIANTDevice();
 
 
@@ -113,6 +146,13 @@ class DSIANTDevice
       /////////////////////////////////////////////////////////////////
       virtual BOOL Open(UCHAR ucUSBDeviceNum_, USHORT usBaudRate_);
 
+      /////////////////////////////////////////////////////////////////
+      // Opens the device on the port as it is already initialized,
+      // e.g. by DSISerialTTY::Init() with a device node.
+      // Returns TRUE if successful.  Otherwise, it returns FALSE.
+      /////////////////////////////////////////////////////////////////
+      BOOL OpenSerial(void);
+
 
       /////////////////////////////////////////////////////////////////
       // Stops any pending actions, closes device down and cleans
@@ -143,6 +183,11 @@ class DSIANTDevice
       //    Remove instances of classes derived of DSIANTMessageProcessor
       //    from the list to stop processing messages for that
       //    channel number
+      //    Waits for the receive thread or executor to finish passing
+      //    a message to the processor, so it is safe to delete once
+      //    this returns.  Does not wait when called from a message
+      //    processor, as that could deadlock; the removed processor
+      //    may then still be running on another worker.
       /////////////////////////////////////////////////////////////////
       BOOL RemoveMessageProcessor(DSIANTMessageProcessor* pclChannel_);
 
@@ -151,6 +196,48 @@ class DSIANTDevice
       /////////////////////////////////////////////////////////////////
       void ClearManagedChannelList(void);
 
+      /////////////////////////////////////////////////////////////////
+      // Sets the largest burst transfer assembled for a channel whose
+      // message processor assembles bursts.
+      // Parameters:
+      //    ucChannelNumber_: ANT channel number
+      //    ulMaxSize_:       Bytes; defaults to
+      //                      DSI_ANT_BURST_DEFAULT_MAX_SIZE.
+      // Returns FALSE if the channel number is invalid.
+      /////////////////////////////////////////////////////////////////
+      BOOL SetMaxBurstSize(UCHAR ucChannelNumber_, ULONG ulMaxSize_);
+
+      /////////////////////////////////////////////////////////////////
+      // Runs the message processors on a pool of worker threads
+      // instead of the receive thread, so that a slow processor only
+      // holds up its own channel.  Each processor still gets its
+      // messages in order, one at a time.  Must be called while the
+      // device is closed.
+      // Parameters:
+      //    ucThreads_:       Number of workers, up to
+      //                      DSI_ANT_EXECUTOR_MAX_THREADS.  0 runs the
+      //                      processors on the receive thread again.
+      //    usQueueSize_:     Messages queued per channel.
+      //    eOverflow_:       What happens to a message for a channel
+      //                      whose queue is full.
+      // Returns TRUE if successful.  Otherwise, it returns FALSE.
+      /////////////////////////////////////////////////////////////////
+      BOOL SetProcessorThreads(UCHAR ucThreads_, USHORT usQueueSize_ = DSI_ANT_EXECUTOR_DEFAULT_QUEUE_SIZE, ANT_EXECUTOR_OVERFLOW eOverflow_ = ANT_EXECUTOR_OVERFLOW_DROP_OLDEST);
+
+      /////////////////////////////////////////////////////////////////
+      // Returns the number of messages dropped for a channel because
+      // its processor's queue was full.  Always 0 unless
+      // SetProcessorThreads() is in use.
+      /////////////////////////////////////////////////////////////////
+      ULONG GetDroppedMessages(UCHAR ucChannelNumber_);
+
+      /////////////////////////////////////////////////////////////////
+      // Returns the number of channels message processors can be
+      // added on.  This is the number the device reported when it was
+      // opened, or DSI_ANT_DEVICE_DEFAULT_CHANNELS before then.
+      /////////////////////////////////////////////////////////////////
+      UCHAR GetChannelCount(void);
+
       /////////////////////////////////////////////////////////////////
       // Returns the serial number of the connected USB device
       /////////////////////////////////////////////////////////////////
@@ -0,0 +1,229 @@
+/*
+This software is subject to the license described in the License.txt file
+included with this software distribution. You may not use this file except
+in compliance with this license.
+
+Copyright (c) Dynastream Innovations Inc. 2016
+All rights reserved.
+*/
+#include "types.h"
+#include "dsi_thread.h"
+#include "dsi_serial_generic.hpp"
+#if defined(DSI_TYPES_LINUX)
+   #include "dsi_serial_tty.hpp"
+#endif
+
+#include "dsi_ant_device_manager.hpp"
+
+
+//////////////////////////////////////////////////////////////////////////////////
+// Public Functions
+//////////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////
+// Constructor
+///////////////////////////////////////////////////////////////////////
+DSIANTDeviceManager::DSIANTDeviceManager()
+{
+   pstDevices = (Device*)NULL;
+   ulDevices = 0;
+
+   DSIThread_MutexInit(&stMutexDeviceList);
+}
+
+///////////////////////////////////////////////////////////////////////
+// Destructor
+///////////////////////////////////////////////////////////////////////
+DSIANTDeviceManager::~DSIANTDeviceManager()
+{
+   Stop();
+
+   DSIThread_MutexDestroy(&stMutexDeviceList);
+}
+
+///////////////////////////////////////////////////////////////////////
+BOOL DSIANTDeviceManager::Start(UCHAR ucThreads_)
+{
+#if defined(DSI_TYPES_LINUX)
+   return clReactor.Start(ucThreads_);
+#else
+   return (ucThreads_ != 0);
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////
+void DSIANTDeviceManager::Stop(void)
+{
+   Device *pstDevice;
+
+   DSIThread_MutexLock(&stMutexDeviceList);
+   pstDevice = pstDevices;
+   pstDevices = (Device*)NULL;
+   ulDevices = 0;
+   DSIThread_MutexUnlock(&stMutexDeviceList);
+
+   // Devices close their ports as they are deleted, which takes them off the reactor.
+   while (pstDevice != NULL)
+   {
+      Device *pstNext = pstDevice->pstNext;
+
+      delete pstDevice->pclDevice;
+      delete pstDevice;
+      pstDevice = pstNext;
+   }
+
+#if defined(DSI_TYPES_LINUX)
+   clReactor.Stop();
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////
+DSIANTDevice* DSIANTDeviceManager::AddDevice(UCHAR ucUSBDeviceNum_, USHORT usBaudRate_)
+{
+   DSISerialGeneric *pclSerial = new DSISerialGeneric();
+   DSIANTDevice *pclDevice;
+
+   if (pclSerial == NULL)
+      return (DSIANTDevice*)NULL;
+
+   pclSerial->SetDirectReceive(TRUE);
+
+   pclDevice = NewDevice(pclSerial);
+   if (pclDevice == NULL)
+      return (DSIANTDevice*)NULL;
+
+   if ((pclDevice->Open(ucUSBDeviceNum_, usBaudRate_) == FALSE) || (ListDevice(pclDevice) == FALSE))
+   {
+      delete pclDevice;
+      return (DSIANTDevice*)NULL;
+   }
+
+   return pclDevice;
+}
+
+#if defined(DSI_TYPES_LINUX)
+///////////////////////////////////////////////////////////////////////
+DSIANTDevice* DSIANTDeviceManager::AddDevice(const char *pcDevicePath_, ULONG ulBaud_)
+{
+   DSISerialTTY *pclSerial;
+   DSIANTDevice *pclDevice;
+
+   if (clReactor.GetThreadCount() == 0)
+      return (DSIANTDevice*)NULL;
+
+   pclSerial = new DSISerialTTY();
+   if (pclSerial == NULL)
+      return (DSIANTDevice*)NULL;
+
+   if (pclSerial->Init(ulBaud_, pcDevicePath_) == FALSE)
+   {
+      delete pclSerial;
+      return (DSIANTDevice*)NULL;
+   }
+
+   pclSerial->SetReactor(&clReactor);
+
+   pclDevice = NewDevice(pclSerial);
+   if (pclDevice == NULL)
+      return (DSIANTDevice*)NULL;
+
+   if ((pclDevice->OpenSerial() == FALSE) || (ListDevice(pclDevice) == FALSE))
+   {
+      delete pclDevice;
+      return (DSIANTDevice*)NULL;
+   }
+
+   return pclDevice;
+}
+#endif
+
+///////////////////////////////////////////////////////////////////////
+BOOL DSIANTDeviceManager::RemoveDevice(DSIANTDevice *pclDevice_)
+{
+   Device *pstDevice = (Device*)NULL;
+   Device **ppstLink;
+
+   DSIThread_MutexLock(&stMutexDeviceList);
+
+   for (ppstLink = &pstDevices; *ppstLink != NULL; ppstLink = &(*ppstLink)->pstNext)
+   {
+      if ((*ppstLink)->pclDevice == pclDevice_)
+      {
+         pstDevice = *ppstLink;
+         *ppstLink = pstDevice->pstNext;
+         ulDevices--;
+         break;
+      }
+   }
+
+   DSIThread_MutexUnlock(&stMutexDeviceList);
+
+   if (pstDevice == NULL)
+      return FALSE;
+
+   delete pstDevice->pclDevice;
+   delete pstDevice;
+
+   return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////
+ULONG DSIANTDeviceManager::GetDeviceCount(void)
+{
+   ULONG ulCount;
+
+   DSIThread_MutexLock(&stMutexDeviceList);
+   ulCount = ulDevices;
+   DSIThread_MutexUnlock(&stMutexDeviceList);
+
+   return ulCount;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// Private Functions
+//////////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////
+// Makes a device on pclSerial_, which it then owns.  Returns NULL, and
+// deletes pclSerial_, if the device could not be made.
+///////////////////////////////////////////////////////////////////////
+DSIANTDevice* DSIANTDeviceManager::NewDevice(DSISerial *pclSerial_)
+{
+   DSIANTDevice *pclDevice;
+
+   try
+   {
+      pclDevice = new DSIANTDevice(pclSerial_);
+   }
+   catch(...)
+   {
+      pclDevice = (DSIANTDevice*)NULL;
+   }
+
+   if (pclDevice == NULL)
+      delete pclSerial_;
+
+   return pclDevice;
+}
+
+///////////////////////////////////////////////////////////////////////
+// Adds an open device to the list.  Returns FALSE if the memory could
+// not be allocated.
+///////////////////////////////////////////////////////////////////////
+BOOL DSIANTDeviceManager::ListDevice(DSIANTDevice *pclDevice_)
+{
+   Device *pstDevice = new Device;
+
+   if (pstDevice == NULL)
+      return FALSE;
+
+   pstDevice->pclDevice = pclDevice_;
+
+   DSIThread_MutexLock(&stMutexDeviceList);
+   pstDevice->pstNext = pstDevices;
+   pstDevices = pstDevice;
+   ulDevices++;
+   DSIThread_MutexUnlock(&stMutexDeviceList);
+
+   return TRUE;
+}
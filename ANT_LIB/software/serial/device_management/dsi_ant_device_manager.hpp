@@ -0,0 +1,119 @@
+/*
+This software is subject to the license described in the License.txt file
+included with this software distribution. You may not use this file except
+in compliance with this license.
+
+Copyright (c) Dynastream Innovations Inc. 2016
+All rights reserved.
+*/
+#if !defined(DSI_ANT_DEVICE_MANAGER_HPP)
+#define DSI_ANT_DEVICE_MANAGER_HPP
+
+#include "types.h"
+#include "dsi_thread.h"
+#include "dsi_ant_device.hpp"
+
+#if defined(DSI_TYPES_LINUX)
+   #include "dsi_serial_reactor.hpp"
+#endif
+
+//////////////////////////////////////////////////////////////////////////////////
+// Public Class Prototypes
+//////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////
+// Owns a set of DSIANTDevices and shares their I/O threads where
+// the backend allows it, so that a host with many sticks does not
+// need a read thread per stick.  Sticks opened as a tty are read
+// and framed on the threads of one DSISerialReactor (linux only).
+// USB sticks on the libusb-1.0 handle feed their framer from its
+// single event thread (direct receive).  The other USB backends
+// (libusb and SI on Windows) keep a read thread per stick.  Each
+// device still dispatches to its message processors from its own
+// receive thread, or from its executor if it has one.
+// Devices can be added and removed at any time.
+/////////////////////////////////////////////////////////////////
+class DSIANTDeviceManager
+{
+   public:
+
+      DSIANTDeviceManager();
+      ~DSIANTDeviceManager();
+
+      BOOL Start(UCHAR ucThreads_);
+      /////////////////////////////////////////////////////////////////
+      // Starts the I/O threads shared by tty devices.
+      // Parameters:
+      //    ucThreads_:       Number of threads, 1 to
+      //                      DSI_SERIAL_REACTOR_MAX_THREADS.  Ignored
+      //                      where tty devices are not supported.
+      // Returns TRUE if successful.  Otherwise, it returns FALSE.
+      /////////////////////////////////////////////////////////////////
+
+      void Stop(void);
+      /////////////////////////////////////////////////////////////////
+      // Closes and deletes every device, then stops the I/O threads.
+      // Must not be called while a device is being added.
+      /////////////////////////////////////////////////////////////////
+
+      DSIANTDevice* AddDevice(UCHAR ucUSBDeviceNum_, USHORT usBaudRate_);
+      /////////////////////////////////////////////////////////////////
+      // Opens a USB stick with direct receive.  Only the libusb-1.0
+      // handle shares its read thread between sticks; the other
+      // backends still read each stick on a thread of its own.
+      // Parameters:
+      //    ucUSBDeviceNum_:  USB device number
+      //    usBaudRate_:      Serial baud rate
+      // Returns the open device, or NULL if it could not be opened.
+      // The manager owns it; remove it with RemoveDevice().
+      /////////////////////////////////////////////////////////////////
+
+#if defined(DSI_TYPES_LINUX)
+      DSIANTDevice* AddDevice(const char *pcDevicePath_, ULONG ulBaud_);
+      /////////////////////////////////////////////////////////////////
+      // Opens a stick exposed as a tty and serves it from the
+      // manager's reactor.  Start() must have been called.
+      // Parameters:
+      //    *pcDevicePath_:   Device node, e.g. "/dev/ttyUSB0".
+      //    ulBaud_:          Baud rate.
+      // Returns the open device, or NULL if it could not be opened.
+      // The manager owns it; remove it with RemoveDevice().
+      /////////////////////////////////////////////////////////////////
+#endif
+
+      BOOL RemoveDevice(DSIANTDevice *pclDevice_);
+      /////////////////////////////////////////////////////////////////
+      // Closes and deletes a device added to this manager.  Must not
+      // be called from one of the device's message processors.
+      // Returns FALSE if the device was not added to this manager.
+      /////////////////////////////////////////////////////////////////
+
+      ULONG GetDeviceCount(void);
+      /////////////////////////////////////////////////////////////////
+      // Returns the number of devices added and not yet removed.
+      /////////////////////////////////////////////////////////////////
+
+   private:
+
+      struct Device
+      {
+         DSIANTDevice *pclDevice;
+         Device *pstNext;
+      };
+
+      Device *pstDevices;
+      ULONG ulDevices;
+      DSI_MUTEX stMutexDeviceList;                          // Protects the list; never held while a device opens or closes.
+
+   #if defined(DSI_TYPES_LINUX)
+      DSISerialReactor clReactor;
+   #endif
+
+      static DSIANTDevice* NewDevice(DSISerial *pclSerial_);
+      BOOL ListDevice(DSIANTDevice *pclDevice_);
+
+      DSIANTDeviceManager(const DSIANTDeviceManager&);      // Not copyable.
+      DSIANTDeviceManager& operator=(const DSIANTDeviceManager&);
+};
+
+#endif // !defined(DSI_ANT_DEVICE_MANAGER_HPP)
@@ -21,6 +21,16 @@ typedef enum
    ANT_DEVICE_NOTIFICATION_SHUTDOWN = 2
 } ANT_DEVICE_NOTIFICATION;
 
+typedef enum
+{
+   ANT_BURST_RESULT_PASS = 0,                               // Every packet arrived in order, ending with the last.
+   ANT_BURST_RESULT_RX_FAILED = 1,                          // ANT reported EVENT_TRANSFER_RX_FAILED.
+   ANT_BURST_RESULT_SEQUENCE = 2,                           // A packet was missed or repeated.
+   ANT_BURST_RESULT_INTERRUPTED = 3,                        // A new transfer started before the last packet.
+   ANT_BURST_RESULT_OVERFLOW = 4,                           // The transfer was larger than allowed.
+   ANT_BURST_RESULT_LOST = 5                                // Advanced burst data was overwritten before it was read.
+} ANT_BURST_RESULT;
+
 //////////////////////////////////////////////////////////////////////////////////
 // Public Class Prototypes
 //////////////////////////////////////////////////////////////////////////////////
@@ -94,6 +104,30 @@ class DSIANTMessageProcessor
       //    notifications, such as a reset or shutting down the device
       /////////////////////////////////////////////////////////////////
 
+      virtual BOOL GetAssembleBursts(void) { return FALSE; }
+      /////////////////////////////////////////////////////////////////
+      // Return TRUE to have burst transfers assembled before they
+      // are passed on.  Burst packets then go to
+      // ProcessBurstTransfer() once per transfer and are no longer
+      // passed to ProcessMessage().
+      // Operation:
+      //    This function is used from a class managing the connection
+      //    to ANT (e.g. DSIANTDevice), each time a message arrives.
+      /////////////////////////////////////////////////////////////////
+
+      virtual void ProcessBurstTransfer(const UCHAR * /*pucData_*/, ULONG /*ulSize_*/, ANT_BURST_RESULT /*eResult_*/) {}
+      /////////////////////////////////////////////////////////////////
+      // Processes a received burst transfer, when GetAssembleBursts()
+      // returns TRUE.
+      // Parameters:
+      //    *pucData_:        The transfer's data, without sequence
+      //                      bytes.  Only valid during the call.
+      //    ulSize_:          Bytes of data.
+      //    eResult_:         ANT_BURST_RESULT_PASS for a complete
+      //                      transfer.  Otherwise the transfer failed
+      //                      and the data is what arrived before that.
+      /////////////////////////////////////////////////////////////////
+
       virtual UCHAR GetChannelNumber(void) { return ucChannelNumber; }
       /////////////////////////////////////////////////////////////////
       // Returns the ANT channel number
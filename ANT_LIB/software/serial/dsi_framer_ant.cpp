@@ -11,6 +11,7 @@ All rights reserved.
 #include "antmessage.h"
 #include "antdefines.h"
 #include "checksum.h"
+#include "frame_scan.h"
 #include "dsi_thread.h"
 #include "dsi_framer_ant.hpp"
 
@@ -36,6 +37,19 @@ All rights reserved.
 
 #define ANT_BASIC_CAPABILITIES_SIZE           4
 
+#define RESPONSE_ANY_CHANNEL                  ((USHORT) 0x100)  // Bucket key of responses that match on the message ID alone.
+
+#define CHANNEL_CONFIG_NEVER_KNOWN            (ANT_CHANNEL_CONFIG_PROXIMITY_SEARCH | ANT_CHANNEL_CONFIG_OPEN)  // Steps ConfigureChannel() always sends.
+
+static const ANT_MESSAGE stInvalidSizeMessage = { DSI_FRAMER_ANT_EINVALID_SIZE, {0} };  // Handed out by PeekMessages() for a message that was too large.
+
+//////////////////////////////////////////////////////////////////////////////////
+// Private Function Prototypes
+//////////////////////////////////////////////////////////////////////////////////
+
+static UCHAR GetResponseBucket(UCHAR ucMessageID_, USHORT usChannel_);
+static BOOL IsPriorityMessage(UCHAR ucMessageID_, const UCHAR *pucData_);
+
 //////////////////////////////////////////////////////////////////////////////////
 // Public Class Functions
 //////////////////////////////////////////////////////////////////////////////////
@@ -47,17 +61,47 @@ DSIFramerANT::DSIFramerANT()
    bClosing = FALSE;
    pbCancel = (volatile BOOL*)NULL;
    bSplitAdvancedBursts = FALSE;
+   bAssembleAdvancedBursts = FALSE;
+   ucTxBatchSize = DSI_FRAMER_ANT_TX_BATCH_DEFAULT;
+   ulMessageHighWater = 0;
+   bPriorityResponses = FALSE;
+
+   ulMessageQueueSize = DSI_FRAMER_ANT_QUEUE_DEFAULT_SIZE;
+   pucMessageQueue = new UCHAR[ulMessageQueueSize + sizeof(ANT_MESSAGE)];  // Slack so a message viewed in place can always be read in full.
+   if (pucMessageQueue == NULL)
+      bInitOkay = FALSE;
 
    if (DSIThread_CondInit(&stCondMessageReady) != DSI_THREAD_ENONE)
       bInitOkay = FALSE;
 
+   if (DSIThread_CondInit(&stCondPriorityReady) != DSI_THREAD_ENONE)
+      bInitOkay = FALSE;
+
    if (DSIThread_MutexInit(&stMutexCriticalSection) != DSI_THREAD_ENONE)
       bInitOkay = FALSE;
 
    if (DSIThread_MutexInit(&stMutexResponseRequest) != DSI_THREAD_ENONE)
       bInitOkay = FALSE;
 
-   pclResponseListStart = (ANTMessageResponse*)NULL;
+   memset(apclResponseIndex, 0, sizeof(apclResponseIndex));
+   ulResponseCount = 0;
+   pclCompletedTokens = (ANTCommandToken*)NULL;
+   pclCompletingToken = (ANTCommandToken*)NULL;
+
+   if (DSIThread_CondInit(&stCondTokenIdle) != DSI_THREAD_ENONE)
+      bInitOkay = FALSE;
+
+   pclResponsePool = new ANTMessageResponse[DSI_FRAMER_ANT_RESPONSE_POOL_SIZE];
+   for (ucFreeResponses = 0; ucFreeResponses < DSI_FRAMER_ANT_RESPONSE_POOL_SIZE; ucFreeResponses++)
+      apclFreeResponses[ucFreeResponses] = &pclResponsePool[ucFreeResponses];
+
+   memset(astChannelConfig, 0, sizeof(astChannelConfig));
+   ucNetworkKeysKnown = 0;
+
+   memset(apucBurstBuffer, 0, sizeof(apucBurstBuffer));
+   memset(aulBurstPosition, 0, sizeof(aulBurstPosition));
+   ulBurstBufferSize = DSI_FRAMER_ANT_BURST_BUFFER_DEFAULT;
+   ucBurstGeneration = 0;
 
    Init((DSISerial*)NULL);
 }
@@ -68,24 +112,62 @@ DSIFramerANT::DSIFramerANT(DSISerial *pclSerial_) : DSIFramer(pclSerial_)
    bClosing = FALSE;
    pbCancel = (volatile BOOL*)NULL;
    bSplitAdvancedBursts = FALSE;
+   bAssembleAdvancedBursts = FALSE;
+   ucTxBatchSize = DSI_FRAMER_ANT_TX_BATCH_DEFAULT;
+   ulMessageHighWater = 0;
+   bPriorityResponses = FALSE;
+
+   ulMessageQueueSize = DSI_FRAMER_ANT_QUEUE_DEFAULT_SIZE;
+   pucMessageQueue = new UCHAR[ulMessageQueueSize + sizeof(ANT_MESSAGE)];  // Slack so a message viewed in place can always be read in full.
+   if (pucMessageQueue == NULL)
+      bInitOkay = FALSE;
 
    if (DSIThread_CondInit(&stCondMessageReady) != DSI_THREAD_ENONE)
       bInitOkay = FALSE;
 
+   if (DSIThread_CondInit(&stCondPriorityReady) != DSI_THREAD_ENONE)
+      bInitOkay = FALSE;
+
    if (DSIThread_MutexInit(&stMutexCriticalSection) != DSI_THREAD_ENONE)
       bInitOkay = FALSE;
 
    if (DSIThread_MutexInit(&stMutexResponseRequest) != DSI_THREAD_ENONE)
       bInitOkay = FALSE;
 
-   pclResponseListStart = (ANTMessageResponse*)NULL;
+   memset(apclResponseIndex, 0, sizeof(apclResponseIndex));
+   ulResponseCount = 0;
+   pclCompletedTokens = (ANTCommandToken*)NULL;
+   pclCompletingToken = (ANTCommandToken*)NULL;
+
+   if (DSIThread_CondInit(&stCondTokenIdle) != DSI_THREAD_ENONE)
+      bInitOkay = FALSE;
+
+   pclResponsePool = new ANTMessageResponse[DSI_FRAMER_ANT_RESPONSE_POOL_SIZE];
+   for (ucFreeResponses = 0; ucFreeResponses < DSI_FRAMER_ANT_RESPONSE_POOL_SIZE; ucFreeResponses++)
+      apclFreeResponses[ucFreeResponses] = &pclResponsePool[ucFreeResponses];
+
+   memset(astChannelConfig, 0, sizeof(astChannelConfig));
+   ucNetworkKeysKnown = 0;
+
+   memset(apucBurstBuffer, 0, sizeof(apucBurstBuffer));
+   memset(aulBurstPosition, 0, sizeof(aulBurstPosition));
+   ulBurstBufferSize = DSI_FRAMER_ANT_BURST_BUFFER_DEFAULT;
+   ucBurstGeneration = 0;
 
    Init(pclSerial_);
 }
 ///////////////////////////////////////////////////////////////////////
 DSIFramerANT::~DSIFramerANT()
 {
+   // Responses lock stMutexResponseRequest when they are destroyed, so they go first.
+   DetachResponses();
+   delete[] pclResponsePool;
+   FreeBurstBuffers();
+   delete[] pucMessageQueue;
+
    DSIThread_CondDestroy(&stCondMessageReady);
+   DSIThread_CondDestroy(&stCondPriorityReady);
+   DSIThread_CondDestroy(&stCondTokenIdle);
    DSIThread_MutexDestroy(&stMutexCriticalSection);
    DSIThread_MutexDestroy(&stMutexResponseRequest);
 }
@@ -96,6 +178,172 @@ void DSIFramerANT::SetSplitAdvBursts(BOOL bSplitAdvBursts_)
    bSplitAdvancedBursts = bSplitAdvBursts_;
 }
 
+///////////////////////////////////////////////////////////////////////
+void DSIFramerANT::SetAssembleAdvBursts(BOOL bAssembleAdvBursts_, ULONG ulBufferSize_)
+{
+   ULONG ulSize = 1;
+
+   ulBufferSize_ = MAX(ulBufferSize_, 2 * MESG_MAX_SIZE_VALUE);
+   while ((ulSize < ulBufferSize_) && (ulSize < 0x80000000))
+      ulSize <<= 1;
+
+   DSIThread_MutexLock(&stMutexCriticalSection);
+   FreeBurstBuffers();
+   memset(aulBurstPosition, 0, sizeof(aulBurstPosition));
+   ucBurstGeneration++;
+   ulBurstBufferSize = ulSize;
+   bAssembleAdvancedBursts = bAssembleAdvBursts_;
+   DSIThread_MutexUnlock(&stMutexCriticalSection);
+}
+
+///////////////////////////////////////////////////////////////////////
+UCHAR DSIFramerANT::GetBurstSegment(const ANT_MESSAGE *pstANTMessage_, UCHAR *pucData_)
+{
+   UCHAR ucSize = 0;
+
+   if (pstANTMessage_->ucMessageID != DSI_FRAMER_ANT_BURST_SEGMENT_ID)
+      return 0;
+
+   UCHAR ucChannel = pstANTMessage_->aucData[0] & CHANNEL_NUMBER_MASK;
+   ULONG ulPosition = (ULONG) pstANTMessage_->aucData[1] |
+                      ((ULONG) pstANTMessage_->aucData[2] << 8) |
+                      ((ULONG) pstANTMessage_->aucData[3] << 16) |
+                      ((ULONG) pstANTMessage_->aucData[4] << 24);
+
+   // The receive thread only writes to the buffer with the lock held, so the copy cannot be torn.
+   DSIThread_MutexLock(&stMutexCriticalSection);
+
+   // The data is gone once the writes since it reach the size of the buffer, or the buffer has been freed.
+   if ((apucBurstBuffer[ucChannel] != NULL) &&
+       (pstANTMessage_->aucData[6] == ucBurstGeneration) &&
+       ((aulBurstPosition[ucChannel] - ulPosition) <= ulBurstBufferSize))
+   {
+      ucSize = pstANTMessage_->aucData[5];
+      memcpy(pucData_, &apucBurstBuffer[ucChannel][ulPosition & (ulBurstBufferSize - 1)], ucSize);
+   }
+
+   DSIThread_MutexUnlock(&stMutexCriticalSection);
+
+   return ucSize;
+}
+
+///////////////////////////////////////////////////////////////////////
+void DSIFramerANT::SetTxBatchSize(UCHAR ucTxBatchSize_)
+{
+   if (ucTxBatchSize_ == 0)
+      ucTxBatchSize_ = 1;
+   else if (ucTxBatchSize_ > DSI_FRAMER_ANT_TX_BATCH_MAX)
+      ucTxBatchSize_ = DSI_FRAMER_ANT_TX_BATCH_MAX;
+
+   ucTxBatchSize = ucTxBatchSize_;
+}
+
+///////////////////////////////////////////////////////////////////////
+BOOL DSIFramerANT::SetMessageQueueSize(ULONG ulSize_)
+{
+   if (ulSize_ < DSI_FRAMER_ANT_QUEUE_MIN_SIZE)
+      ulSize_ = DSI_FRAMER_ANT_QUEUE_MIN_SIZE;
+
+   DSIThread_MutexLock(&stMutexCriticalSection);
+
+   if (ulMessageCount != 0)
+   {
+      DSIThread_MutexUnlock(&stMutexCriticalSection);
+      return FALSE;
+   }
+
+   UCHAR *pucNewQueue = new UCHAR[ulSize_ + sizeof(ANT_MESSAGE)];
+   if (pucNewQueue == NULL)
+   {
+      DSIThread_MutexUnlock(&stMutexCriticalSection);
+      return FALSE;
+   }
+
+   delete[] pucMessageQueue;
+   pucMessageQueue = pucNewQueue;
+   ulMessageQueueSize = ulSize_;
+   ResetMessageQueue();
+
+   DSIThread_MutexUnlock(&stMutexCriticalSection);
+   return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////
+ULONG DSIFramerANT::GetMessageQueueSize()
+{
+   return ulMessageQueueSize;
+}
+
+///////////////////////////////////////////////////////////////////////
+ULONG DSIFramerANT::GetMessageQueueHighWater(BOOL bReset_)
+{
+   DSIThread_MutexLock(&stMutexCriticalSection);
+
+   ULONG ulHighWater = ulMessageHighWater;
+   if (bReset_)
+      ulMessageHighWater = ulMessageBytes;
+
+   DSIThread_MutexUnlock(&stMutexCriticalSection);
+
+   return ulHighWater;
+}
+
+///////////////////////////////////////////////////////////////////////
+void DSIFramerANT::SetPriorityResponses(BOOL bPriorityResponses_)
+{
+   DSIThread_MutexLock(&stMutexCriticalSection);
+   bPriorityResponses = bPriorityResponses_;
+   DSIThread_MutexUnlock(&stMutexCriticalSection);
+}
+
+///////////////////////////////////////////////////////////////////////
+USHORT DSIFramerANT::WaitForPriorityMessage(ULONG ulMilliseconds_)
+{
+   USHORT usMessageSize;
+
+   DSIThread_MutexLock(&stMutexCriticalSection);
+
+   if ((ucError == 0) && (ulPriorityCount == 0) && (ulMilliseconds_ != 0))
+      DSIThread_CondTimedWait(&stCondPriorityReady, &stMutexCriticalSection, ulMilliseconds_);
+
+   if (ucError)
+      usMessageSize = DSI_FRAMER_ERROR;
+   else if (ulPriorityCount != 0)
+      usMessageSize = astPriorityQueue[ulPriorityTail].ucSize;
+   else
+      usMessageSize = DSI_FRAMER_TIMEDOUT;
+
+   DSIThread_MutexUnlock(&stMutexCriticalSection);
+
+   return usMessageSize;
+}
+
+///////////////////////////////////////////////////////////////////////
+USHORT DSIFramerANT::GetPriorityMessage(void *pvData_, USHORT usSize_)
+{
+   USHORT usRetVal = DSI_FRAMER_TIMEDOUT;
+
+   DSIThread_MutexLock(&stMutexCriticalSection);
+
+   if (ulPriorityCount != 0)
+   {
+      ANT_MESSAGE_ITEM *pstItem = &astPriorityQueue[ulPriorityTail];
+
+      usRetVal = pstItem->ucSize;
+      if (usSize_ != 0)
+         usRetVal = MIN(usRetVal, usSize_);
+
+      ((ANT_MESSAGE *) pvData_)->ucMessageID = pstItem->stANTMessage.ucMessageID;
+      memcpy(((ANT_MESSAGE *) pvData_)->aucData, pstItem->stANTMessage.aucData, usRetVal);
+
+      DequeuePriorityMessage();
+   }
+
+   DSIThread_MutexUnlock(&stMutexCriticalSection);
+
+   return usRetVal;
+}
+
 ///////////////////////////////////////////////////////////////////////
 void DSIFramerANT::SetCancelParameter(volatile BOOL *pbCancel_)
 {
@@ -112,8 +360,10 @@ volatile BOOL* DSIFramerANT::GetCancelParameter()
 BOOL DSIFramerANT::Init(DSISerial *pclSerial_)
 {
    ucRxIndex = 0;
-   usMessageHead = 0;
-   usMessageTail = 0;
+   ResetMessageQueue();
+   ulPriorityTail = 0;
+   ulPriorityCount = 0;
+   ulPriorityPeeked = 0;
    ucError = 0;
 
    if (pclSerial_ != NULL)
@@ -129,6 +379,22 @@ BOOL DSIFramerANT::Init(DSISerial *pclSerial_)
 BOOL DSIFramerANT::WriteMessage(void *pvData_, USHORT usMessageSize_)
 {
    UCHAR aucTxFifo[TX_FIFO_SIZE];
+   USHORT usTotalSize;
+
+   usTotalSize = FrameMessage(aucTxFifo, pvData_, usMessageSize_);
+   if (usTotalSize == 0)
+      return FALSE;
+
+   return WriteFramedBytes(aucTxFifo, usTotalSize);
+}
+
+///////////////////////////////////////////////////////////////////////
+// Frames the message into pucTxFifo_ and returns the number of bytes
+// written, including the two trailing pad bytes, or 0 if the message is
+// too large.  pucTxFifo_ must have room for ANT_TX_FRAME_MAX_SIZE bytes.
+///////////////////////////////////////////////////////////////////////
+USHORT DSIFramerANT::FrameMessage(UCHAR *pucTxFifo_, void *pvData_, USHORT usMessageSize_)
+{
    UCHAR ucTotalSize;
 
    if (usMessageSize_ > MESG_MAX_SIZE_VALUE)
@@ -136,39 +402,124 @@ BOOL DSIFramerANT::WriteMessage(void *pvData_, USHORT usMessageSize_)
       #if defined(DEBUG_FILE)
          DSIDebug::ThreadWrite("Framer->WriteMessage(): Failed, Msg Size > MESG_MAX_SIZE_VALUE.");
       #endif
-      return FALSE;
+      return 0;
    }
 
    ucTotalSize = (UCHAR) usMessageSize_ + MESG_HEADER_SIZE;
-   aucTxFifo[0] = MESG_TX_SYNC;
-   aucTxFifo[MESG_SIZE_OFFSET] = (UCHAR) usMessageSize_;
-   aucTxFifo[MESG_ID_OFFSET] = ((ANT_MESSAGE *) pvData_)->ucMessageID;
-   memcpy(&aucTxFifo[MESG_DATA_OFFSET], ((ANT_MESSAGE *) pvData_)->aucData, usMessageSize_);
-   aucTxFifo[ucTotalSize] = CheckSum_Calc8(aucTxFifo, ucTotalSize);
+   pucTxFifo_[0] = MESG_TX_SYNC;
+   pucTxFifo_[MESG_SIZE_OFFSET] = (UCHAR) usMessageSize_;
+   pucTxFifo_[MESG_ID_OFFSET] = ((ANT_MESSAGE *) pvData_)->ucMessageID;
+   memcpy(&pucTxFifo_[MESG_DATA_OFFSET], ((ANT_MESSAGE *) pvData_)->aucData, usMessageSize_);
+   pucTxFifo_[ucTotalSize] = CheckSum_Calc8(pucTxFifo_, ucTotalSize);
    ++ucTotalSize;
 
    // Pad with two zeros.
-   aucTxFifo[ucTotalSize++] = 0;
-   aucTxFifo[ucTotalSize++] = 0;
+   pucTxFifo_[ucTotalSize++] = 0;
+   pucTxFifo_[ucTotalSize++] = 0;
 
+   return ucTotalSize;
+}
 
-   if (pclSerial->WriteBytes(aucTxFifo, ucTotalSize))
-   {
-      #if defined(SERIAL_DEBUG)
-         if (aucTxFifo[MESG_ID_OFFSET] == 0x46)
-            memset(&aucTxFifo[MESG_DATA_OFFSET+1],0x00,8);
-         DSIDebug::SerialWrite(pclSerial->GetDeviceNumber(), "Tx", aucTxFifo, ucTotalSize);
-      #endif
-      return TRUE;
-   }
+///////////////////////////////////////////////////////////////////////
+// Writes one or more messages framed by FrameMessage().
+///////////////////////////////////////////////////////////////////////
+BOOL DSIFramerANT::WriteFramedBytes(UCHAR *pucTxFifo_, USHORT usSize_)
+{
+   BOOL bSuccess = pclSerial->WriteBytes(pucTxFifo_, usSize_);
 
    #if defined(SERIAL_DEBUG)
-      if (aucTxFifo[MESG_ID_OFFSET] == 0x46)
-         memset(&aucTxFifo[MESG_DATA_OFFSET+1],0x00,8);
-      DSIDebug::SerialWrite(pclSerial->GetDeviceNumber(), "***Tx Error***", aucTxFifo, ucTotalSize);
+   {
+      USHORT usOffset = 0;
+
+      while (usOffset < usSize_)
+      {
+         UCHAR aucFrame[ANT_TX_FRAME_MAX_SIZE];
+         USHORT usFrameSize = pucTxFifo_[usOffset + MESG_SIZE_OFFSET] + MESG_FRAME_SIZE + 2;
+
+         memcpy(aucFrame, &pucTxFifo_[usOffset], usFrameSize);       // The frames may be written again, so blank the copy
+         if (aucFrame[MESG_ID_OFFSET] == 0x46)
+            memset(&aucFrame[MESG_DATA_OFFSET+1],0x00,8);
+         DSIDebug::SerialWrite(pclSerial->GetDeviceNumber(), bSuccess ? "Tx" : "***Tx Error***", aucFrame, usFrameSize);
+
+         usOffset += usFrameSize;
+      }
+   }
    #endif
 
-   return FALSE;
+   return bSuccess;
+}
+
+///////////////////////////////////////////////////////////////////////
+// Adds a block to the end of a burst.  Empty blocks are left out.
+///////////////////////////////////////////////////////////////////////
+void DSIFramerANT::AddBurstPart(ANT_TX_BURST *pstBurst_, UCHAR *pucData_, ULONG ulSize_)
+{
+   if ((pucData_ == NULL) || (ulSize_ == 0) || (pstBurst_->ucParts >= DSI_FRAMER_ANT_BURST_PARTS))
+      return;
+
+   pstBurst_->apucPart[pstBurst_->ucParts] = pucData_;
+   pstBurst_->aulPartSize[pstBurst_->ucParts] = ulSize_;
+   pstBurst_->ucParts++;
+}
+
+///////////////////////////////////////////////////////////////////////
+// Frames up to ucPackets_ packets of pstBurst_ into pucWindow_, which
+// must have room for ucPackets_ * (ucMaxDataSize_ + MESG_FRAME_SIZE + 2)
+// bytes, and moves the burst on past them.  Each part is padded out to
+// a whole packet.  Returns FALSE if a packet cannot be framed.
+///////////////////////////////////////////////////////////////////////
+BOOL DSIFramerANT::FrameBurstWindow(ANT_TX_BURST *pstBurst_, ANT_MESSAGE *pstMessage_, UCHAR ucMaxDataSize_, UCHAR ucPackets_, UCHAR *pucWindow_, USHORT *pusWindowSize_, volatile ULONG *pulProgress_)
+{
+   ULONG ulPacketPayload = (ULONG)ucMaxDataSize_ - 1;
+
+   *pusWindowSize_ = 0;
+
+   while ((ucPackets_ != 0) && (pstBurst_->ucPart < pstBurst_->ucParts))
+   {
+      UCHAR *pucSource = &pstBurst_->apucPart[pstBurst_->ucPart][pstBurst_->ulOffset];
+      ULONG ulRemaining = pstBurst_->aulPartSize[pstBurst_->ucPart] - pstBurst_->ulOffset;
+      UCHAR ucDataSize = ucMaxDataSize_;
+      USHORT usFrameSize;
+
+      pstMessage_->aucData[0] = pstBurst_->ucSequence | (pstBurst_->ucChannel & CHANNEL_NUMBER_MASK);
+
+      if (ulRemaining > ulPacketPayload)
+      {
+         memcpy(&pstMessage_->aucData[1], pucSource, ulPacketPayload);
+         pstBurst_->ulOffset += ulPacketPayload;
+         *pulProgress_ += ulPacketPayload;
+      }
+      else
+      {
+         if (pstBurst_->ucPart == (pstBurst_->ucParts - 1))
+         {
+            while((UCHAR)(ucDataSize-9) >= ulRemaining)
+               ucDataSize -= 8; //Shorten the last packet by 8-bytes if possible.
+            pstMessage_->aucData[0] |= SEQUENCE_LAST_MESSAGE;
+         }
+
+         memset(&pstMessage_->aucData[1], 0x00, ucDataSize-1);
+         memcpy(&pstMessage_->aucData[1], pucSource, ulRemaining);
+         pstBurst_->ucPart++;
+         pstBurst_->ulOffset = 0;
+         *pulProgress_ += ulRemaining;
+      }
+
+      usFrameSize = FrameMessage(&pucWindow_[*pusWindowSize_], pstMessage_, ucDataSize);
+      if (usFrameSize == 0)
+         return FALSE;
+
+      *pusWindowSize_ += usFrameSize;
+      ucPackets_--;
+
+      //Adjust sequence number
+      if (pstBurst_->ucSequence == SEQUENCE_NUMBER_ROLLOVER)
+         pstBurst_->ucSequence = SEQUENCE_NUMBER_INC;
+      else
+         pstBurst_->ucSequence += SEQUENCE_NUMBER_INC;
+   }
+
+   return TRUE;
 }
 
 ///////////////////////////////////////////////////////////////////////
@@ -193,7 +544,7 @@ USHORT DSIFramerANT::WaitForMessage(ULONG ulMilliseconds_)
       }
       else //CondWait() failed
       {
-        ucError = (UCHAR)(DSI_FRAMER_ERROR & 0xFF); //Set ucError so we can distinguish from a normal error if this ever occurs
+        RaiseError((UCHAR)(DSI_FRAMER_ERROR & 0xFF)); //Set ucError so we can distinguish from a normal error if this ever occurs
         usMessageSize = DSI_FRAMER_ERROR;
       }
    }
@@ -203,6 +554,88 @@ USHORT DSIFramerANT::WaitForMessage(ULONG ulMilliseconds_)
    return usMessageSize;
 }
 
+///////////////////////////////////////////////////////////////////////
+ULONG DSIFramerANT::WaitForMessages(ULONG ulMilliseconds_)
+{
+   ULONG ulItems;
+
+   DSIThread_MutexLock(&stMutexCriticalSection);
+
+   ulItems = GetItemCount();
+
+   if ((ulItems == 0) && (ulMilliseconds_ != 0))
+   {
+      UCHAR ucStatus = DSIThread_CondTimedWait(&stCondMessageReady, &stMutexCriticalSection, ulMilliseconds_);
+      if (ucStatus == DSI_THREAD_ENONE)
+         ulItems = GetItemCount();
+      else if (ucStatus != DSI_THREAD_ETIMEDOUT)          // CondWait() failed; report it as WaitForMessage() does.
+      {
+         RaiseError((UCHAR)(DSI_FRAMER_ERROR & 0xFF));
+         ulItems = GetItemCount();
+      }
+   }
+
+   DSIThread_MutexUnlock(&stMutexCriticalSection);
+
+   return ulItems;
+}
+
+///////////////////////////////////////////////////////////////////////
+ULONG DSIFramerANT::GetMessages(ANT_MESSAGE_ITEM *pastMessages_, ULONG ulMaxMessages_)
+{
+   ULONG ulItems = 0;
+
+   DSIThread_MutexLock(&stMutexCriticalSection);
+
+   while (ulItems < ulMaxMessages_)
+   {
+      ANT_MESSAGE_ITEM *pstItem = &pastMessages_[ulItems];
+
+      if (ucError && (ulErrorPosition == 0))                // The error comes next.
+      {
+         pstItem->ucSize = DSI_FRAMER_ANT_ITEM_ERROR;
+         pstItem->stANTMessage.ucMessageID = ucError;
+
+         if (ucError == DSI_FRAMER_ANT_ESERIAL)
+            pstItem->stANTMessage.aucData[0] = ucSerialError;
+
+         ucError = 0;
+      }
+      else if (ulPriorityCount != 0)
+      {
+         memcpy(pstItem, &astPriorityQueue[ulPriorityTail], sizeof(ANT_MESSAGE_ITEM));
+         DequeuePriorityMessage();
+      }
+      else if (ulMessageCount != 0)
+      {
+         UCHAR *pucItem = &pucMessageQueue[ulMessageTail];
+
+         if (pucItem[0] > MESG_MAX_SIZE_VALUE)              // Discarded, as GetMessage() would.
+         {
+            pstItem->ucSize = DSI_FRAMER_ANT_ITEM_ERROR;
+            pstItem->stANTMessage.ucMessageID = DSI_FRAMER_ANT_EINVALID_SIZE;
+         }
+         else
+         {
+            pstItem->ucSize = pucItem[0];
+            memcpy(&pstItem->stANTMessage, &pucItem[1], 1 + pucItem[0]);  // The ID and data are laid out as an ANT_MESSAGE.
+         }
+
+         DequeueRxMessage();
+      }
+      else
+      {
+         break;
+      }
+
+      ulItems++;
+   }
+
+   DSIThread_MutexUnlock(&stMutexCriticalSection);
+
+   return ulItems;
+}
+
 ///////////////////////////////////////////////////////////////////////
 USHORT DSIFramerANT::GetMessage(void *pvData_, USHORT usSize_)
 {
@@ -220,12 +653,27 @@ USHORT DSIFramerANT::GetMessage(void *pvData_, USHORT usSize_)
       ucError = 0;
       usRetVal = DSI_FRAMER_ERROR;
    }
+   else if (ulPriorityCount != 0)
+   {
+      ANT_MESSAGE_ITEM *pstItem = &astPriorityQueue[ulPriorityTail];
+
+      usRetVal = pstItem->ucSize;
+      if (usSize_ != 0)
+         usRetVal = MIN(usRetVal, usSize_);
+
+      ((ANT_MESSAGE *) pvData_)->ucMessageID = pstItem->stANTMessage.ucMessageID;
+      memcpy(((ANT_MESSAGE *) pvData_)->aucData, pstItem->stANTMessage.aucData, usRetVal);
+
+      DequeuePriorityMessage();
+   }
    else
    {
-      if ((usMessageHead - usMessageTail) != 0)
+      if (ulMessageCount != 0)
       {
+         UCHAR *pucItem = &pucMessageQueue[ulMessageTail];
+
          // Determine the number of bytes to copy.
-         usRetVal = astMessageBuffer[usMessageTail].ucSize; // The reported number of bytes in the queue.
+         usRetVal = pucItem[0];                             // The reported number of bytes in the queue.
 
          if (usSize_ != 0)
             usRetVal = MIN(usRetVal, usSize_);              // If the usSize_ parameter is non-zero, limit the number of bytes copied from the queue to usSize_.
@@ -237,11 +685,11 @@ USHORT DSIFramerANT::GetMessage(void *pvData_, USHORT usSize_)
          }
          else
          {
-            ((ANT_MESSAGE *) pvData_)->ucMessageID = astMessageBuffer[usMessageTail].stANTMessage.ucMessageID;
-            memcpy(((ANT_MESSAGE *) pvData_)->aucData, astMessageBuffer[usMessageTail].stANTMessage.aucData, usRetVal);
+            ((ANT_MESSAGE *) pvData_)->ucMessageID = pucItem[1];
+            memcpy(((ANT_MESSAGE *) pvData_)->aucData, &pucItem[DSI_FRAMER_ANT_QUEUE_ITEM_HEADER], usRetVal);
          }
 
-         usMessageTail++;                                   // Rollover of usMessageTail happens automagically because our buffer size is MAX_USHORT + 1.
+         DequeueRxMessage();
       }
       else
       {
@@ -255,26 +703,174 @@ USHORT DSIFramerANT::GetMessage(void *pvData_, USHORT usSize_)
 }
 
 ///////////////////////////////////////////////////////////////////////
-#define MESG_CHANNEL_OFFSET                  0
-#define MESG_EVENT_ID_OFFSET                 1
-UCHAR DSIFramerANT::GetChannelNumber(ANT_MESSAGE* pstMessage)
+USHORT DSIFramerANT::PeekMessage(const ANT_MESSAGE **ppstANTMessage_)
 {
-   // Get the channel number
-   // Returns MAX_UCHAR if this message does not have a channel field
-   UCHAR ucANTchannel = pstMessage->aucData[MESG_CHANNEL_OFFSET] & CHANNEL_NUMBER_MASK;
+   USHORT usRetVal;
 
-   // Some messages do not include the channel number in the response, so
-   // they might get processed incorrectly
-   if(pstMessage->ucMessageID == MESG_RESPONSE_EVENT_ID)
+   DSIThread_MutexLock(&stMutexCriticalSection);
+
+   ulPriorityPeeked = 0;
+   ulMessagesPeeked = 0;
+
+   if (ucError)
    {
-      if(pstMessage->aucData[MESG_EVENT_ID_OFFSET] == MESG_NETWORK_KEY_ID ||  // we would need to look at the network number to figure it out
-         pstMessage->aucData[MESG_EVENT_ID_OFFSET] == MESG_RADIO_TX_POWER_ID ||  // this affects all channels
-         pstMessage->aucData[MESG_EVENT_ID_OFFSET] == MESG_RX_EXT_MESGS_ENABLE_ID)  // this affects all channels
-      {
-         return MAX_UCHAR;
-      }
+      stPeekError.ucMessageID = ucError;
+
+      if (ucError == DSI_FRAMER_ANT_ESERIAL)
+         stPeekError.aucData[0] = ucSerialError;
+
+      ucError = 0;
+      *ppstANTMessage_ = &stPeekError;
+      usRetVal = DSI_FRAMER_ERROR;
    }
-   else if(pstMessage->ucMessageID == MESG_STARTUP_MESG_ID ||
+   else if (ulPriorityCount != 0)
+   {
+      *ppstANTMessage_ = &astPriorityQueue[ulPriorityTail].stANTMessage;  // Not overwritten: a full priority queue sends messages to the main queue.
+      usRetVal = astPriorityQueue[ulPriorityTail].ucSize;
+      ulPriorityPeeked = 1;
+   }
+   else if (ulMessageCount != 0)
+   {
+      UCHAR *pucItem = &pucMessageQueue[ulMessageTail];
+
+      usRetVal = pucItem[0];
+
+      if (usRetVal > MESG_MAX_SIZE_VALUE)                   // Discarded, as GetMessage() would.
+      {
+         stPeekError.ucMessageID = DSI_FRAMER_ANT_EINVALID_SIZE;
+         DequeueRxMessage();
+         *ppstANTMessage_ = &stPeekError;
+         usRetVal = DSI_FRAMER_ERROR;
+      }
+      else
+      {
+         *ppstANTMessage_ = (const ANT_MESSAGE *)&pucItem[1]; // The ID and data are laid out as an ANT_MESSAGE.
+         ulMessagesPeeked = 1;
+      }
+   }
+   else
+   {
+      *ppstANTMessage_ = (const ANT_MESSAGE *)NULL;
+      usRetVal = DSI_FRAMER_TIMEDOUT;
+   }
+
+   DSIThread_MutexUnlock(&stMutexCriticalSection);
+
+   return usRetVal;
+}
+
+///////////////////////////////////////////////////////////////////////
+ULONG DSIFramerANT::PeekMessages(ANT_MESSAGE_VIEW *pastViews_, ULONG ulMaxViews_)
+{
+   ULONG ulViews = 0;
+   ULONG ulTail;
+
+   DSIThread_MutexLock(&stMutexCriticalSection);
+
+   ulPriorityPeeked = 0;
+   ulMessagesPeeked = 0;
+   ulTail = ulMessageTail;
+
+   while (ulViews < ulMaxViews_)
+   {
+      ANT_MESSAGE_VIEW *pstView = &pastViews_[ulViews];
+
+      if (ucError && (ulErrorPosition == ulMessagesPeeked))  // The error comes next.
+      {
+         stPeekError.ucMessageID = ucError;
+
+         if (ucError == DSI_FRAMER_ANT_ESERIAL)
+            stPeekError.aucData[0] = ucSerialError;
+
+         ucError = 0;
+         pstView->ucSize = DSI_FRAMER_ANT_ITEM_ERROR;
+         pstView->pstANTMessage = &stPeekError;
+      }
+      else if (ulPriorityPeeked < ulPriorityCount)
+      {
+         ANT_MESSAGE_ITEM *pstItem = &astPriorityQueue[(ulPriorityTail + ulPriorityPeeked) % DSI_FRAMER_ANT_PRIORITY_QUEUE_SIZE];
+
+         pstView->ucSize = pstItem->ucSize;
+         pstView->pstANTMessage = &pstItem->stANTMessage;
+         ulPriorityPeeked++;
+      }
+      else if (ulMessagesPeeked < ulMessageCount)
+      {
+         UCHAR *pucItem = &pucMessageQueue[ulTail];
+
+         if (pucItem[0] > MESG_MAX_SIZE_VALUE)              // Reported, as GetMessages() would.
+         {
+            pstView->ucSize = DSI_FRAMER_ANT_ITEM_ERROR;
+            pstView->pstANTMessage = &stInvalidSizeMessage;
+         }
+         else
+         {
+            pstView->ucSize = pucItem[0];
+            pstView->pstANTMessage = (const ANT_MESSAGE *)&pucItem[1];  // The ID and data are laid out as an ANT_MESSAGE.
+         }
+
+         // Step to the next message as DequeueRxMessage() would.
+         ulTail += DSI_FRAMER_ANT_QUEUE_ITEM_HEADER + MIN(pucItem[0], MESG_MAX_SIZE_VALUE);
+         if ((ulTail == ulMessageWrap) && (ulMessageHead < ulTail))
+            ulTail = 0;
+
+         ulMessagesPeeked++;
+      }
+      else
+      {
+         break;
+      }
+
+      ulViews++;
+   }
+
+   DSIThread_MutexUnlock(&stMutexCriticalSection);
+
+   return ulViews;
+}
+
+///////////////////////////////////////////////////////////////////////
+void DSIFramerANT::ConsumeMessage()
+{
+   ULONG ulPriority;
+   ULONG ulMessages;
+   ULONG i;
+
+   DSIThread_MutexLock(&stMutexCriticalSection);
+
+   ulPriority = ulPriorityPeeked;
+   ulMessages = ulMessagesPeeked;
+
+   for (i = 0; i < ulPriority; i++)
+      DequeuePriorityMessage();
+
+   for (i = 0; i < ulMessages; i++)
+      DequeueRxMessage();
+
+   DSIThread_MutexUnlock(&stMutexCriticalSection);
+}
+
+///////////////////////////////////////////////////////////////////////
+#define MESG_CHANNEL_OFFSET                  0
+#define MESG_EVENT_ID_OFFSET                 1
+UCHAR DSIFramerANT::GetChannelNumber(const ANT_MESSAGE* pstMessage)
+{
+   // Get the channel number
+   // Returns MAX_UCHAR if this message does not have a channel field
+   UCHAR ucANTchannel = pstMessage->aucData[MESG_CHANNEL_OFFSET] & CHANNEL_NUMBER_MASK;
+
+   // Some messages do not include the channel number in the response, so
+   // they might get processed incorrectly
+   if(pstMessage->ucMessageID == MESG_RESPONSE_EVENT_ID)
+   {
+      if(pstMessage->aucData[MESG_EVENT_ID_OFFSET] == MESG_NETWORK_KEY_ID ||  // we would need to look at the network number to figure it out
+         pstMessage->aucData[MESG_EVENT_ID_OFFSET] == MESG_RADIO_TX_POWER_ID ||  // this affects all channels
+         pstMessage->aucData[MESG_EVENT_ID_OFFSET] == MESG_RX_EXT_MESGS_ENABLE_ID)  // this affects all channels
+      {
+         return MAX_UCHAR;
+      }
+   }
+   else if(pstMessage->ucMessageID == MESG_STARTUP_MESG_ID ||
       pstMessage->ucMessageID == MESG_CAPABILITIES_ID ||
       pstMessage->ucMessageID == MESG_VERSION_ID ||
       pstMessage->ucMessageID == MESG_GET_SERIAL_NUM_ID)
@@ -290,7 +886,59 @@ UCHAR DSIFramerANT::GetChannelNumber(ANT_MESSAGE* pstMessage)
 void DSIFramerANT::ProcessByte(UCHAR ucByte_)
 {
    DSIThread_MutexLock(&stMutexCriticalSection);
+   ProcessRxByte(ucByte_);
+   DSIThread_MutexUnlock(&stMutexCriticalSection);
+
+   RunTokenCallbacks();
+}
+
+///////////////////////////////////////////////////////////////////////
+void DSIFramerANT::ProcessBytes(const UCHAR *pucBytes_, ULONG ulSize_)
+{
+   if ((pucBytes_ == NULL) || (ulSize_ == 0))
+      return;
+
+   // Take the lock once for the whole block rather than once per byte.
+   DSIThread_MutexLock(&stMutexCriticalSection);
 
+   ULONG i = 0;
+   while (i < ulSize_)
+   {
+      if (ucRxIndex != 0)                                   // Finish the frame in progress a byte at a time.
+      {
+         ProcessRxByte(pucBytes_[i++]);
+         continue;
+      }
+
+      // Pick out the frames that are entirely in this block in one pass.
+      FRAME_SCAN_RESULT astFrames[DSI_FRAMER_ANT_RX_SCAN_FRAMES];
+      ULONG ulFrames;
+      ULONG ulScanned = FrameScan_Frames(&pucBytes_[i], ulSize_ - i, MESG_TX_SYNC, MESG_FRAME_SIZE - MESG_SYNC_SIZE, RX_FIFO_SIZE,
+                                         astFrames, DSI_FRAMER_ANT_RX_SCAN_FRAMES, &ulFrames);
+
+      for (ULONG j = 0; j < ulFrames; j++)
+      {
+         memcpy(aucRxFifo, &pucBytes_[i + astFrames[j].ulOffset], astFrames[j].usSize);
+         ucRxIndex = (UCHAR)(astFrames[j].usSize - 1);
+         CompleteRxMessage(astFrames[j].bCheckSumOk);
+      }
+
+      i += ulScanned;
+
+      if ((ulFrames == 0) && (i < ulSize_))                 // A partial or oversized frame starts here; the byte path deals with it.
+         ProcessRxByte(pucBytes_[i++]);
+   }
+
+   DSIThread_MutexUnlock(&stMutexCriticalSection);
+
+   RunTokenCallbacks();
+}
+
+///////////////////////////////////////////////////////////////////////
+// stMutexCriticalSection must be locked before calling this function.
+///////////////////////////////////////////////////////////////////////
+void DSIFramerANT::ProcessRxByte(UCHAR ucByte_)
+{
    if (ucRxIndex == 0)                                      // If we are looking for the start of a message.
    {
       if (ucByte_ == MESG_TX_SYNC)                          // If it is a valid first byte.
@@ -332,29 +980,37 @@ void DSIFramerANT::ProcessByte(UCHAR ucByte_)
 
       if (ucRxIndex >= ucRxSize)                            // If we have received the whole message.
       {
-         if (ucCheckSum == 0)                               // The CRC passed.
-         {
-            ProcessMessage();                               // Process the ANT message.
-         }
-         else
-         {
-            // Set a serial error for the bad crc.
-            ucSerialError = DSI_FRAMER_ANT_CRC_ERROR;
-            ucError = DSI_FRAMER_ANT_ESERIAL;
-            DSIThread_CondSignal(&stCondMessageReady);
-            #if defined(SERIAL_DEBUG)
-               DSIDebug::SerialWrite(pclSerial->GetDeviceNumber(), "Bad CRC",aucRxFifo,ucRxIndex);
-            #endif
-         }
-         ucRxIndex = 0;                                     // Reset the index.
+         CompleteRxMessage(ucCheckSum == 0);
       }
       else
       {
          ucRxIndex++;
       }
    }
+}
 
-   DSIThread_MutexUnlock(&stMutexCriticalSection);
+///////////////////////////////////////////////////////////////////////
+// Handles the frame in aucRxFifo, which ends at ucRxIndex, and gets
+// ready for the next one.
+// stMutexCriticalSection must be locked before calling this function.
+///////////////////////////////////////////////////////////////////////
+void DSIFramerANT::CompleteRxMessage(BOOL bCheckSumOk_)
+{
+   if (bCheckSumOk_)                                        // The CRC passed.
+   {
+      ProcessMessage();                                     // Process the ANT message.
+   }
+   else
+   {
+      // Set a serial error for the bad crc.
+      ucSerialError = DSI_FRAMER_ANT_CRC_ERROR;
+      RaiseError(DSI_FRAMER_ANT_ESERIAL);
+      DSIThread_CondSignal(&stCondMessageReady);
+      #if defined(SERIAL_DEBUG)
+         DSIDebug::SerialWrite(pclSerial->GetDeviceNumber(), "Bad CRC",aucRxFifo,ucRxIndex);
+      #endif
+   }
+   ucRxIndex = 0;                                           // Reset the index.
 }
 
 ///////////////////////////////////////////////////////////////////////
@@ -363,9 +1019,10 @@ void DSIFramerANT::Error(UCHAR ucError_)
    DSIThread_MutexLock(&stMutexCriticalSection);
 
    ucSerialError = ucError_;
-   ucError = DSI_FRAMER_ANT_ESERIAL;
+   RaiseError(DSI_FRAMER_ANT_ESERIAL);
 
    DSIThread_CondSignal(&stCondMessageReady);
+   DSIThread_CondSignal(&stCondPriorityReady);
 
    DSIThread_MutexUnlock(&stMutexCriticalSection);
 }
@@ -1279,11 +1936,12 @@ BOOL DSIFramerANT::ResetSystem(ULONG ulResponseTime_)
    //// Modified SendCommand() function. ////
 
    ANTMessageResponse *pclCommandResponse = (ANTMessageResponse*)NULL;
+   ANTResponseLease clCommandLease(this);
 
    // If we are going to be waiting for a response setup the Response object
    if (ulResponseTime_ != 0)
    {
-      pclCommandResponse = new ANTMessageResponse();
+      pclCommandResponse = clCommandLease.Acquire();
       pclCommandResponse->Attach(MESG_STARTUP_MESG_ID, (UCHAR*)NULL, 0, this);
    }
 
@@ -1294,12 +1952,6 @@ BOOL DSIFramerANT::ResetSystem(ULONG ulResponseTime_)
          DSIDebug::ThreadWrite("Framer->ResetSystem():  WriteMessage Failed.");
       #endif
 
-      if(pclCommandResponse != NULL)
-      {
-         delete pclCommandResponse;
-         pclCommandResponse = (ANTMessageResponse*)NULL;
-      }
-
       return FALSE;
    }
 
@@ -1320,11 +1972,9 @@ BOOL DSIFramerANT::ResetSystem(ULONG ulResponseTime_)
          DSIDebug::ThreadWrite("Framer->ResetSystem():  Timeout.");
       #endif
 
-      delete pclCommandResponse;
       return FALSE;
    }
 
-   delete pclCommandResponse;
    return TRUE;
 }
 
@@ -1357,6 +2007,7 @@ BOOL DSIFramerANT::CloseChannel(UCHAR ucANTChannel_, ULONG ulResponseTime_)
    BOOL bReturn;
    ANT_MESSAGE stMessage;
    ANTMessageResponse *pclEventResponse = (ANTMessageResponse*)NULL;
+   ANTResponseLease clEventLease(this);
 
    stMessage.ucMessageID = MESG_CLOSE_CHANNEL_ID;
    stMessage.aucData[0]  = ucANTChannel_;
@@ -1370,7 +2021,7 @@ BOOL DSIFramerANT::CloseChannel(UCHAR ucANTChannel_, ULONG ulResponseTime_)
       aucDesiredData[ANT_DATA_EVENT_ID_OFFSET] = MESG_EVENT_ID;
       aucDesiredData[ANT_DATA_EVENT_CODE_OFFSET] = EVENT_CHANNEL_CLOSED;
 
-      pclEventResponse = new ANTMessageResponse();
+      pclEventResponse = clEventLease.Acquire();
       pclEventResponse->Attach(MESG_RESPONSE_EVENT_ID, aucDesiredData, sizeof(aucDesiredData), this);
    }
 
@@ -1386,351 +2037,319 @@ BOOL DSIFramerANT::CloseChannel(UCHAR ucANTChannel_, ULONG ulResponseTime_)
    }
 
    pclEventResponse->Remove();                                               //detach from list
-   delete pclEventResponse;
 
    return bReturn;
 }
 
 ///////////////////////////////////////////////////////////////////////
-BOOL DSIFramerANT::SendBroadcastData(UCHAR ucANTChannel_, UCHAR *pucData_)
+BOOL DSIFramerANT::SetNetworkKeyAsync(UCHAR ucNetworkNumber_, UCHAR *pucKey_, ANTCommandToken *pclToken_)
 {
    ANT_MESSAGE stMessage;
 
-   stMessage.ucMessageID = MESG_BROADCAST_DATA_ID;
-   stMessage.aucData[0] = ucANTChannel_;
-   memcpy(&stMessage.aucData[1],pucData_, ANT_STANDARD_DATA_PAYLOAD_SIZE);
+   stMessage.ucMessageID = MESG_NETWORK_KEY_ID;
+   stMessage.aucData[0] = ucNetworkNumber_;
+   memcpy(&stMessage.aucData[1], pucKey_, 8);
 
-   return WriteMessage(&stMessage, ANT_STANDARD_DATA_PAYLOAD_SIZE + MESG_CHANNEL_NUM_SIZE);
+   return SendCommandAsync(&stMessage, MESG_NETWORK_KEY_SIZE, pclToken_);
 }
 
 ///////////////////////////////////////////////////////////////////////
-BOOL DSIFramerANT::SendBurstDataPacket(UCHAR ucANTChannelSeq_, UCHAR *pucData_)
+BOOL DSIFramerANT::UnAssignChannelAsync(UCHAR ucANTChannel_, ANTCommandToken *pclToken_)
 {
    ANT_MESSAGE stMessage;
 
-   stMessage.ucMessageID = MESG_BURST_DATA_ID;
-   stMessage.aucData[0] = ucANTChannelSeq_;
-   memcpy(&stMessage.aucData[1],pucData_, MESG_DATA_SIZE-1);
+   stMessage.ucMessageID = MESG_UNASSIGN_CHANNEL_ID;
+   stMessage.aucData[0] = ucANTChannel_;
 
-   return WriteMessage(&stMessage, MESG_DATA_SIZE);
+   return SendCommandAsync(&stMessage, MESG_UNASSIGN_CHANNEL_SIZE, pclToken_);
 }
 
 ///////////////////////////////////////////////////////////////////////
-BOOL DSIFramerANT::SendAdvancedBurstDataPacket(UCHAR ucANTChannelSeq_, UCHAR *pucData_, UCHAR ucStdPcktsPerSerialMsg_)
+BOOL DSIFramerANT::AssignChannelAsync(UCHAR ucANTChannel_, UCHAR ucChannelType_, UCHAR ucNetworkNumber_, ANTCommandToken *pclToken_)
 {
-   ANT_MESSAGE* stMessage = (ANT_MESSAGE*) NULL;
-   USHORT packetDataSize = (MESG_DATA_SIZE-1) * ucStdPcktsPerSerialMsg_;
-   if(!CreateAntMsg_wOptExtBuf(&stMessage, packetDataSize+1))  //reqMinSize = packetSize + seqNum
-   {
-      #if defined(DEBUG_FILE)
-         DSIDebug::ThreadWrite("Framer->SendAdvancedBurstDataPacket(): Failed, ucStdPcktsPerSerialMsg too big for this part");
-      #endif
-      return FALSE;
-   }
+   ANT_MESSAGE stMessage;
 
-   stMessage->ucMessageID = MESG_ADV_BURST_DATA_ID;
-   stMessage->aucData[0] = ucANTChannelSeq_;
-   memcpy(&(stMessage->aucData[1]),pucData_, packetDataSize);
+   stMessage.ucMessageID = MESG_ASSIGN_CHANNEL_ID;
+   stMessage.aucData[0] = ucANTChannel_;
+   stMessage.aucData[1] = ucChannelType_;
+   stMessage.aucData[2] = ucNetworkNumber_;
 
-   BOOL result = WriteMessage(stMessage, 1 + packetDataSize);  //seqNum + (payloadLength*pcktsPerSerial)
-   delete[] stMessage;
-   return result;
+   return SendCommandAsync(&stMessage, MESG_ASSIGN_CHANNEL_SIZE, pclToken_);
 }
 
 ///////////////////////////////////////////////////////////////////////
-ANTFRAMER_RETURN DSIFramerANT::SendAcknowledgedData(UCHAR ucANTChannel_, UCHAR *pucData_, ULONG ulResponseTime_)
+BOOL DSIFramerANT::SetChannelIDAsync(UCHAR ucANTChannel_, USHORT usDeviceNumber_, UCHAR ucDeviceType_, UCHAR ucTransmitType_, ANTCommandToken *pclToken_)
 {
-   return(SetupAckDataTransfer(
-      MESG_ACKNOWLEDGED_DATA_ID,
-      ucANTChannel_,
-      pucData_,
-      MESG_DATA_SIZE,
-      ulResponseTime_));
-}
+   ANT_MESSAGE stMessage;
 
+   stMessage.ucMessageID = MESG_CHANNEL_ID_ID;
+   stMessage.aucData[0] = ucANTChannel_;
+   stMessage.aucData[1] = (UCHAR)(usDeviceNumber_ & 0xFF);
+   stMessage.aucData[2] = (UCHAR)((usDeviceNumber_ >>8) & 0xFF);
+   stMessage.aucData[3] = ucDeviceType_;
+   stMessage.aucData[4] = ucTransmitType_;
 
-ANTFRAMER_RETURN DSIFramerANT::SetupAckDataTransfer(UCHAR ucMessageID_, UCHAR ucANTChannel_, UCHAR *pucData_, UCHAR ucMaxDataSize_, ULONG ulResponseTime_)
-{
+   return SendCommandAsync(&stMessage, MESG_CHANNEL_ID_SIZE, pclToken_);
+}
 
-   ANTFRAMER_RETURN eReturn = ANTFRAMER_PASS;
+///////////////////////////////////////////////////////////////////////
+BOOL DSIFramerANT::SetChannelPeriodAsync(UCHAR ucANTChannel_, USHORT usMessagePeriod_, ANTCommandToken *pclToken_)
+{
    ANT_MESSAGE stMessage;
-   ULONG ulStartTime = DSIThread_GetSystemTime();
-   ANTMessageResponse *pclPassResponse = (ANTMessageResponse*)NULL;
-   ANTMessageResponse *pclFailResponse = (ANTMessageResponse*)NULL;
-   ANTMessageResponse *pclErrorResponse = (ANTMessageResponse*)NULL;
-
-   volatile BOOL *pbCancel_;
-   BOOL bDummyCancel = FALSE;
-
-   if (pbCancel == NULL)
-      pbCancel_ = &bDummyCancel;
-   else
-      pbCancel_ = pbCancel;
 
-   stMessage.ucMessageID = ucMessageID_;
+   stMessage.ucMessageID = MESG_CHANNEL_MESG_PERIOD_ID;
    stMessage.aucData[0] = ucANTChannel_;
-   memcpy(&stMessage.aucData[1],pucData_, ucMaxDataSize_-1);
+   stMessage.aucData[1] = (UCHAR)(usMessagePeriod_ & 0xFF);
+   stMessage.aucData[2] = (UCHAR)((usMessagePeriod_ >>8) & 0xFF);
 
-   // If we are going to be waiting for a response setup the Response objects
-   if (ulResponseTime_ != 0)
-   {
-     UCHAR aucDesiredData[3];
+   return SendCommandAsync(&stMessage, MESG_CHANNEL_MESG_PERIOD_SIZE, pclToken_);
+}
 
-     aucDesiredData[ANT_DATA_CHANNEL_NUM_OFFSET] = ucANTChannel_;   //Setup response to catch tx complete
-     aucDesiredData[ANT_DATA_EVENT_ID_OFFSET] = MESG_EVENT_ID;
-     aucDesiredData[ANT_DATA_EVENT_CODE_OFFSET] = EVENT_TRANSFER_TX_COMPLETED;
+///////////////////////////////////////////////////////////////////////
+BOOL DSIFramerANT::SetChannelSearchTimeoutAsync(UCHAR ucANTChannel_, UCHAR ucSearchTimeout_, ANTCommandToken *pclToken_)
+{
+   ANT_MESSAGE stMessage;
 
-     pclPassResponse = new ANTMessageResponse();
-     pclPassResponse->Attach(MESG_RESPONSE_EVENT_ID, aucDesiredData, sizeof(aucDesiredData), this);
+   stMessage.ucMessageID = MESG_CHANNEL_SEARCH_TIMEOUT_ID;
+   stMessage.aucData[0] = ucANTChannel_;
+   stMessage.aucData[1] = ucSearchTimeout_;
 
-     aucDesiredData[ANT_DATA_CHANNEL_NUM_OFFSET] = ucANTChannel_;   //Setup response to catch tx fail
-     aucDesiredData[ANT_DATA_EVENT_ID_OFFSET] = MESG_EVENT_ID;
-     aucDesiredData[ANT_DATA_EVENT_CODE_OFFSET] = EVENT_TRANSFER_TX_FAILED;
+   return SendCommandAsync(&stMessage, MESG_CHANNEL_SEARCH_TIMEOUT_SIZE, pclToken_);
+}
 
-     pclFailResponse = new ANTMessageResponse();
-     pclFailResponse->Attach(MESG_RESPONSE_EVENT_ID, aucDesiredData, sizeof(aucDesiredData), this, pclPassResponse->pstCondResponseReady);
+///////////////////////////////////////////////////////////////////////
+BOOL DSIFramerANT::SetChannelRFFrequencyAsync(UCHAR ucANTChannel_, UCHAR ucRFFrequency_, ANTCommandToken *pclToken_)
+{
+   ANT_MESSAGE stMessage;
 
-     aucDesiredData[ANT_DATA_CHANNEL_NUM_OFFSET] = ucANTChannel_;   //Setup response to catch any errors like transfer in progress.
-     aucDesiredData[ANT_DATA_EVENT_ID_OFFSET] = ucMessageID_;
+   stMessage.ucMessageID = MESG_CHANNEL_RADIO_FREQ_ID;
+   stMessage.aucData[0] = ucANTChannel_;
+   stMessage.aucData[1] = ucRFFrequency_;
 
-     pclErrorResponse = new ANTMessageResponse();
-     pclErrorResponse->Attach(MESG_RESPONSE_EVENT_ID, aucDesiredData, 2, this, pclPassResponse->pstCondResponseReady);
-   }
+   return SendCommandAsync(&stMessage, MESG_CHANNEL_RADIO_FREQ_SIZE, pclToken_);
+}
 
-   if (WriteMessage(&stMessage, ucMaxDataSize_) == FALSE)
-      eReturn = ANTFRAMER_FAIL;
+///////////////////////////////////////////////////////////////////////
+BOOL DSIFramerANT::SetChannelTransmitPowerAsync(UCHAR ucANTChannel_, UCHAR ucTransmitPower_, ANTCommandToken *pclToken_)
+{
+   ANT_MESSAGE stMessage;
 
-   // Return immediately if we aren't waiting for the response.
-   if (ulResponseTime_ == 0)
-      return ANTFRAMER_PASS;
+   stMessage.ucMessageID = MESG_CHANNEL_RADIO_TX_POWER_ID;
+   stMessage.aucData[0]  = ucANTChannel_;
+   stMessage.aucData[1]  = ucTransmitPower_;
 
-   DSIThread_MutexLock(&stMutexResponseRequest);
+   return SendCommandAsync(&stMessage, MESG_CHANNEL_RADIO_TX_POWER_SIZE, pclToken_);
+}
 
-   if (eReturn == ANTFRAMER_PASS)                                                                  //Only try to wait if we haven't failed yet
-   {
-      while((pclPassResponse->bResponseReady == FALSE) &&
-           (pclFailResponse->bResponseReady == FALSE) &&
-           (pclErrorResponse->bResponseReady == FALSE) &&
-           (*pbCancel_ == FALSE) &&
-           ((DSIThread_GetSystemTime() - ulStartTime) < ulResponseTime_))
-      {
-         DSIThread_CondTimedWait(pclPassResponse->pstCondResponseReady, &stMutexResponseRequest, 1000);
-      }
+///////////////////////////////////////////////////////////////////////
+BOOL DSIFramerANT::SetLowPriorityChannelSearchTimeoutAsync(UCHAR ucANTChannel_, UCHAR ucSearchTimeout_, ANTCommandToken *pclToken_)
+{
+   ANT_MESSAGE stMessage;
 
-      if (pclPassResponse->bResponseReady == FALSE)                     //The only time we are sucessful is if we get a tx transfer complete
-      {
-         //figure out the reason why we failed/stopped
-         if ((pclErrorResponse->bResponseReady == TRUE) || (pclFailResponse->bResponseReady == TRUE))
-            eReturn = ANTFRAMER_FAIL;
-         else if (*pbCancel_ == TRUE)
-            eReturn = ANTFRAMER_CANCELLED;
-         else
-            eReturn = ANTFRAMER_TIMEOUT;
-      }
-   }
+   stMessage.ucMessageID = MESG_SET_LP_SEARCH_TIMEOUT_ID;
+   stMessage.aucData[0] = ucANTChannel_;
+   stMessage.aucData[1] = ucSearchTimeout_;
 
-   pclPassResponse->Remove();
-   pclFailResponse->Remove();
-   pclErrorResponse->Remove();
+   return SendCommandAsync(&stMessage, MESG_SET_LP_SEARCH_TIMEOUT_SIZE, pclToken_);
+}
 
-   DSIThread_MutexUnlock(&stMutexResponseRequest);
+///////////////////////////////////////////////////////////////////////
+BOOL DSIFramerANT::SetRSSISearchThresholdAsync(UCHAR ucANTChannel_, UCHAR ucSearchThreshold_, ANTCommandToken *pclToken_)
+{
+   ANT_MESSAGE stMessage;
 
-   delete pclPassResponse;
-   delete pclFailResponse;
-   delete pclErrorResponse;
+   stMessage.ucMessageID = MESG_RSSI_SEARCH_THRESHOLD_ID;
+   stMessage.aucData[0]  = ucANTChannel_;
+   stMessage.aucData[1]  = ucSearchThreshold_;
 
-   return eReturn;
+   return SendCommandAsync(&stMessage, MESG_RSSI_SEARCH_THRESHOLD_SIZE, pclToken_);
 }
 
+///////////////////////////////////////////////////////////////////////
+BOOL DSIFramerANT::SetProximitySearchAsync(UCHAR ucANTChannel_, UCHAR ucSearchThreshold_, ANTCommandToken *pclToken_)
+{
+   ANT_MESSAGE stMessage;
 
+   stMessage.ucMessageID = MESG_PROX_SEARCH_CONFIG_ID;
+   stMessage.aucData[0]  = ucANTChannel_;
+   stMessage.aucData[1]  = ucSearchThreshold_;
 
-ANTFRAMER_RETURN DSIFramerANT::SetupBurstDataTransfer(UCHAR ucMessageID_, UCHAR ucANTChannel_, UCHAR * pucData_, ULONG ulSize_,UCHAR ucMaxDataSize_, ULONG ulResponseTime_)
+   return SendCommandAsync(&stMessage, MESG_PROX_SEARCH_CONFIG_SIZE, pclToken_);
+}
 
+///////////////////////////////////////////////////////////////////////
+BOOL DSIFramerANT::OpenChannelAsync(UCHAR ucANTChannel_, ANTCommandToken *pclToken_)
 {
-   ANTFRAMER_RETURN eReturn = ANTFRAMER_PASS;
-   ULONG ulStartTime = DSIThread_GetSystemTime();
-
-   ANTMessageResponse *pclPassResponse = (ANTMessageResponse*)NULL;
-   ANTMessageResponse *pclFailResponse = (ANTMessageResponse*)NULL;
-   ANTMessageResponse *pclErrorResponse = (ANTMessageResponse*)NULL;
-
-   ANT_MESSAGE* stMessage = (ANT_MESSAGE*)NULL;
-   if(!CreateAntMsg_wOptExtBuf(&stMessage, ucMaxDataSize_))
-   {
-      #if defined(DEBUG_FILE)
-         DSIDebug::ThreadWrite("Framer->SetupBurstDataTransfer(): Failed, ucMaxDataSize_ too big for this part");
-      #endif
-      return ANTFRAMER_INVALIDPARAM;
-   }
+   ANT_MESSAGE stMessage;
 
-   volatile BOOL *pbCancel_;
-   BOOL bDummyCancel = FALSE;
+   stMessage.ucMessageID = MESG_OPEN_CHANNEL_ID;
+   stMessage.aucData[0]  = ucANTChannel_;
 
-   if (pbCancel == NULL)
-      pbCancel_ = &bDummyCancel;
-   else
-      pbCancel_ = pbCancel;
+   return SendCommandAsync(&stMessage, MESG_OPEN_CHANNEL_SIZE, pclToken_);
+}
 
-   UCHAR aucDesiredData[3];
+///////////////////////////////////////////////////////////////////////
+BOOL DSIFramerANT::ConfigureChannel(UCHAR ucANTChannel_, const ANT_CHANNEL_CONFIG *pstConfig_, ANT_CHANNEL_CONFIG_RESULT *pstResult_, ULONG ulResponseTime_)
+{
+   ANTCommandToken aclSteps[ANT_CHANNEL_CONFIG_STEPS];
+   ULONG aulSent[ANT_CHANNEL_CONFIG_STEPS];                            // Time each step was written.
+   ANT_CHANNEL_CONFIG_RESULT stResult;
+   ULONG ulKnown;
+   ULONG ulSucceeded = 0;
+   UCHAR ucStep;
+
+   if (pstConfig_ == NULL)
+      return FALSE;
 
-   aucDesiredData[ANT_DATA_CHANNEL_NUM_OFFSET] = ucANTChannel_; //Setup response to catch tx complete
-   aucDesiredData[ANT_DATA_EVENT_ID_OFFSET] = MESG_EVENT_ID;
-   aucDesiredData[ANT_DATA_EVENT_CODE_OFFSET] = EVENT_TRANSFER_TX_COMPLETED;
+   memset(&stResult, 0, sizeof(stResult));
+   ulKnown = MatchChannelConfig(ucANTChannel_, pstConfig_);
 
-   pclPassResponse = new ANTMessageResponse();
-   pclPassResponse->Attach(MESG_RESPONSE_EVENT_ID, aucDesiredData, sizeof(aucDesiredData), this);
+   // Write every step without waiting; the device handles them in order.
+   for (ucStep = 0; ucStep < ANT_CHANNEL_CONFIG_STEPS; ucStep++)
+   {
+      ULONG ulField = (ULONG)1 << ucStep;
 
-   aucDesiredData[ANT_DATA_CHANNEL_NUM_OFFSET] = ucANTChannel_; //Setup response to catch tx fail
-   aucDesiredData[ANT_DATA_EVENT_ID_OFFSET] = MESG_EVENT_ID;
-   aucDesiredData[ANT_DATA_EVENT_CODE_OFFSET] = EVENT_TRANSFER_TX_FAILED;
+      if ((pstConfig_->ulFields & ulField) == 0)
+         continue;
 
-   pclFailResponse = new ANTMessageResponse();
-   pclFailResponse->Attach(MESG_RESPONSE_EVENT_ID, aucDesiredData, sizeof(aucDesiredData), this, pclPassResponse->pstCondResponseReady);
+      if ((ulKnown & ulField) != 0)
+      {
+         stResult.ulSkipped |= ulField;
+         continue;
+      }
 
-   aucDesiredData[ANT_DATA_CHANNEL_NUM_OFFSET] = ucANTChannel_; //Setup response to catch any errors like transfer in progress.
-   aucDesiredData[ANT_DATA_EVENT_ID_OFFSET] = ucMessageID_;
+      aulSent[ucStep] = DSIThread_GetSystemTime();
 
-   pclErrorResponse = new ANTMessageResponse();
-   pclErrorResponse->Attach(MESG_RESPONSE_EVENT_ID, aucDesiredData, 2, this, pclPassResponse->pstCondResponseReady);
+      if (SendConfigStep(ucStep, ucANTChannel_, pstConfig_, &aclSteps[ucStep]) == FALSE)
+      {
+         #if defined(DEBUG_FILE)
+            DSIDebug::ThreadWrite("Framer->ConfigureChannel():  WriteMessage Failed.");
+         #endif
+         stResult.ulFailed |= ulField;
+         break;
+      }
 
-   //getting error Rx will also effectively lose the transfer, but only on an AP1
+      stResult.ulSent |= ulField;
+   }
 
+   // Collect the responses.  Each step gets the full response time once the one before it is in,
+   // as it would if the steps were sent one at a time.  With no response time nothing is waited
+   // for, and nothing is remembered as applied.
+   for (ucStep = 0; ucStep < ANT_CHANNEL_CONFIG_STEPS && ulResponseTime_ != 0; ucStep++)
+   {
+      ULONG ulField = (ULONG)1 << ucStep;
 
-   stMessage->ucMessageID = ucMessageID_;
-   stMessage->aucData[0] = ucANTChannel_ & CHANNEL_NUMBER_MASK;        // Clear the sequence bits
-
-   while ((eReturn == ANTFRAMER_PASS) && ulSize_)
-   {
-     if (ulSize_ > (UCHAR)(ucMaxDataSize_-1))
-     {
-        memcpy (&stMessage->aucData[1],pucData_,ucMaxDataSize_-1);
-        ulSize_ -= ucMaxDataSize_-1;
-        pucData_ += ucMaxDataSize_-1;
-     }
-     else
-     {
-        while((UCHAR)(ucMaxDataSize_-9) >= ulSize_)
-           ucMaxDataSize_ -= 8; //Shorten the last packet by 8-bytes if possible.
-        stMessage->aucData[0] |= SEQUENCE_LAST_MESSAGE;
-        memset (&stMessage->aucData[1], 0x00, ucMaxDataSize_-1);
-        memcpy (&stMessage->aucData[1],pucData_,ulSize_);
-        ulSize_ = 0;
-     }
-
-     if (WriteMessage(stMessage,ucMaxDataSize_) == FALSE)
-        eReturn = ANTFRAMER_FAIL;
+      if ((stResult.ulSent & ulField) == 0)
+         continue;
 
-      //Adjust sequence number
-      if ((stMessage->aucData[0] & SEQUENCE_NUMBER_MASK) == SEQUENCE_NUMBER_ROLLOVER)
-         stMessage->aucData[0] = SEQUENCE_NUMBER_INC | ucANTChannel_;
-      else
-         stMessage->aucData[0] += SEQUENCE_NUMBER_INC;
+      aclSteps[ucStep].Wait(ulResponseTime_);
 
-     if (*pbCancel_ == TRUE)
-        eReturn = ANTFRAMER_CANCELLED;
+      if (aclSteps[ucStep].IsComplete() == FALSE)
+      {
+         aclSteps[ucStep].Cancel();
+         stResult.ulFailed |= ulField;
+         continue;
+      }
 
-      //Abort transfer on errors, don't keep trying to send
-     if ((pclFailResponse->bResponseReady == TRUE) || (pclErrorResponse->bResponseReady == TRUE))
-        eReturn = ANTFRAMER_FAIL;
+      // Timed when collected; a response that arrived while an earlier step was waited on is counted up to now.
+      stResult.aulLatency[ucStep] = DSIThread_GetSystemTime() - aulSent[ucStep];
 
-     if (ulResponseTime_ != 0)                                                                         //Check for errors
-     {
-       if ((DSIThread_GetSystemTime() - ulStartTime) > ulResponseTime_)
-           eReturn = ANTFRAMER_TIMEOUT;
-     }
+      if (aclSteps[ucStep].Succeeded() == FALSE)
+      {
+         stResult.ulFailed |= ulField;
+      }
+      else
+      {
+         ulSucceeded |= ulField;
+      }
    }
 
-   DSIThread_MutexLock(&stMutexResponseRequest);
-   if (ulResponseTime_ != 0)                                                                         //Check for errors
-   {
-     if (eReturn == ANTFRAMER_PASS)                                                                  //Only try to wait if we haven't failed yet
-     {
-         while((pclPassResponse->bResponseReady == FALSE) &&
-              (pclFailResponse->bResponseReady == FALSE) &&
-              (pclErrorResponse->bResponseReady == FALSE) &&
-              (*pbCancel_ == FALSE) &&
-              ((DSIThread_GetSystemTime() - ulStartTime) < ulResponseTime_))
-         {
-            DSIThread_CondTimedWait(pclPassResponse->pstCondResponseReady, &stMutexResponseRequest, 1000);
-         }
+   RememberChannelConfig(ucANTChannel_, pstConfig_, ulSucceeded);
 
-         if (pclPassResponse->bResponseReady == FALSE)                     //The only time we are sucessful is if we get a tx transfer complete
-         {
-            //figure out the reason why we failed/stopped
-            if ((pclErrorResponse->bResponseReady == TRUE) || (pclFailResponse->bResponseReady == TRUE))
-               eReturn = ANTFRAMER_FAIL;
-            else if (*pbCancel_ == TRUE)
-               eReturn = ANTFRAMER_CANCELLED;
-            else
-               eReturn = ANTFRAMER_TIMEOUT;
-         }
+   #if defined(DEBUG_FILE)
+      if (stResult.ulFailed != 0)
+      {
+         DSIDebug::ThreadPrintf("Framer->ConfigureChannel():  Channel %u failed steps 0x%04lX.", ucANTChannel_, stResult.ulFailed);
       }
-   }
+   #endif
 
-   pclPassResponse->Remove();
-   pclFailResponse->Remove();
-   pclErrorResponse->Remove();
+   if (pstResult_ != NULL)
+      *pstResult_ = stResult;
 
-   DSIThread_MutexUnlock(&stMutexResponseRequest);
+   return (stResult.ulFailed == 0);
+}
 
-   delete pclPassResponse;
-   delete pclFailResponse;
-   delete pclErrorResponse;
-   delete[] stMessage;
+///////////////////////////////////////////////////////////////////////
+BOOL DSIFramerANT::SendBroadcastData(UCHAR ucANTChannel_, UCHAR *pucData_)
+{
+   ANT_MESSAGE stMessage;
 
-   //Always return true with no timeout, so nobody relies on this return value
-   if(ulResponseTime_ == 0)
-      eReturn = ANTFRAMER_PASS;
+   stMessage.ucMessageID = MESG_BROADCAST_DATA_ID;
+   stMessage.aucData[0] = ucANTChannel_;
+   memcpy(&stMessage.aucData[1],pucData_, ANT_STANDARD_DATA_PAYLOAD_SIZE);
 
-   return eReturn;
+   return WriteMessage(&stMessage, ANT_STANDARD_DATA_PAYLOAD_SIZE + MESG_CHANNEL_NUM_SIZE);
 }
 
+///////////////////////////////////////////////////////////////////////
+BOOL DSIFramerANT::SendBurstDataPacket(UCHAR ucANTChannelSeq_, UCHAR *pucData_)
+{
+   ANT_MESSAGE stMessage;
 
+   stMessage.ucMessageID = MESG_BURST_DATA_ID;
+   stMessage.aucData[0] = ucANTChannelSeq_;
+   memcpy(&stMessage.aucData[1],pucData_, MESG_DATA_SIZE-1);
+
+   return WriteMessage(&stMessage, MESG_DATA_SIZE);
+}
 
 ///////////////////////////////////////////////////////////////////////
-ANTFRAMER_RETURN DSIFramerANT::SendTransfer(UCHAR ucANTChannel_, UCHAR * pucData_, ULONG ulSize_, ULONG ulResponseTime_)
+BOOL DSIFramerANT::SendAdvancedBurstDataPacket(UCHAR ucANTChannelSeq_, UCHAR *pucData_, UCHAR ucStdPcktsPerSerialMsg_)
 {
-   return(SetupBurstDataTransfer(
-      MESG_BURST_DATA_ID,
-      ucANTChannel_,
-      pucData_,
-      ulSize_,
-      MESG_DATA_SIZE,
-      ulResponseTime_));
+   ANT_MESSAGE* stMessage = (ANT_MESSAGE*) NULL;
+   USHORT packetDataSize = (MESG_DATA_SIZE-1) * ucStdPcktsPerSerialMsg_;
+   if(!CreateAntMsg_wOptExtBuf(&stMessage, packetDataSize+1))  //reqMinSize = packetSize + seqNum
+   {
+      #if defined(DEBUG_FILE)
+         DSIDebug::ThreadWrite("Framer->SendAdvancedBurstDataPacket(): Failed, ucStdPcktsPerSerialMsg too big for this part");
+      #endif
+      return FALSE;
+   }
+
+   stMessage->ucMessageID = MESG_ADV_BURST_DATA_ID;
+   stMessage->aucData[0] = ucANTChannelSeq_;
+   memcpy(&(stMessage->aucData[1]),pucData_, packetDataSize);
+
+   BOOL result = WriteMessage(stMessage, 1 + packetDataSize);  //seqNum + (payloadLength*pcktsPerSerial)
+   delete[] stMessage;
+   return result;
 }
 
-ANTFRAMER_RETURN DSIFramerANT::SendAdvancedTransfer(UCHAR ucANTChannel_, UCHAR * pucData_, ULONG ulSize_, UCHAR ucStdPcktsPerSerialMsg_, ULONG ulResponseTime_)
+///////////////////////////////////////////////////////////////////////
+ANTFRAMER_RETURN DSIFramerANT::SendAcknowledgedData(UCHAR ucANTChannel_, UCHAR *pucData_, ULONG ulResponseTime_)
 {
-   return(SetupBurstDataTransfer(
-      MESG_ADV_BURST_DATA_ID,
+   return(SetupAckDataTransfer(
+      MESG_ACKNOWLEDGED_DATA_ID,
       ucANTChannel_,
       pucData_,
-      ulSize_,
-      1 + ((MESG_DATA_SIZE-1) * ucStdPcktsPerSerialMsg_),   //seqNum + (payloadLength*pcktsPerSerial)
+      MESG_DATA_SIZE,
       ulResponseTime_));
 }
 
-///////////////////////////////////////////////////////////////////////
-ANTFRAMER_RETURN DSIFramerANT::SendANTFSTransfer(UCHAR ucANTChannel_, UCHAR* pucHeader_, UCHAR* pucFooter_, UCHAR * pucData_, ULONG ulSize_, ULONG ulResponseTime_, volatile ULONG *pulProgress_)
+
+ANTFRAMER_RETURN DSIFramerANT::SetupAckDataTransfer(UCHAR ucMessageID_, UCHAR ucANTChannel_, UCHAR *pucData_, UCHAR ucMaxDataSize_, ULONG ulResponseTime_)
 {
+
    ANTFRAMER_RETURN eReturn = ANTFRAMER_PASS;
    ANT_MESSAGE stMessage;
    ULONG ulStartTime = DSIThread_GetSystemTime();
-   UCHAR *pucDataSource;
-
    ANTMessageResponse *pclPassResponse = (ANTMessageResponse*)NULL;
+   ANTResponseLease clPassLease(this);
    ANTMessageResponse *pclFailResponse = (ANTMessageResponse*)NULL;
+   ANTResponseLease clFailLease(this);
    ANTMessageResponse *pclErrorResponse = (ANTMessageResponse*)NULL;
+   ANTResponseLease clErrorLease(this);
 
-#if defined(WAIT_TO_FEED_TRANSFER)
-   ANTMessageResponse *pclBroadcastResponse = (ANTMessageResponse*)NULL;
-   ANTMessageResponse *pclAcknowledgeResponse = (ANTMessageResponse*)NULL;
-   BOOL bFirstPacket = TRUE;
-   UCHAR ucSyncMesgCount = 0;
-   UCHAR ucChannelStatus;
-#endif
-
-   ULONG ulDummyProgress = 0;
    volatile BOOL *pbCancel_;
    BOOL bDummyCancel = FALSE;
 
@@ -1739,28 +2358,9 @@ ANTFRAMER_RETURN DSIFramerANT::SendANTFSTransfer(UCHAR ucANTChannel_, UCHAR* puc
    else
       pbCancel_ = pbCancel;
 
-   if (pulProgress_ == NULL)
-      pulProgress_ = &ulDummyProgress;
-
-   if (pucHeader_)                          //if the header is not NULL, set the data pointer and add 8 to the size
-   {
-      pucDataSource = pucHeader_;
-      ulSize_ += 8;
-   }
-   else
-   {
-      pucDataSource = pucData_;
-   }
-
-   #if defined(WAIT_TO_FEED_TRANSFER)
-      if(GetChannelStatus(ucANTChannel_,&ucChannelStatus, 2000) == FALSE)
-         return ANTFRAMER_FAIL;
-
-      if ((ucChannelStatus & STATUS_CHANNEL_STATE_MASK) != STATUS_TRACKING_CHANNEL)
-         return ANTFRAMER_FAIL;
-   #endif
-
-
+   stMessage.ucMessageID = ucMessageID_;
+   stMessage.aucData[0] = ucANTChannel_;
+   memcpy(&stMessage.aucData[1],pucData_, ucMaxDataSize_-1);
 
    // If we are going to be waiting for a response setup the Response objects
    if (ulResponseTime_ != 0)
@@ -1771,214 +2371,147 @@ ANTFRAMER_RETURN DSIFramerANT::SendANTFSTransfer(UCHAR ucANTChannel_, UCHAR* puc
      aucDesiredData[ANT_DATA_EVENT_ID_OFFSET] = MESG_EVENT_ID;
      aucDesiredData[ANT_DATA_EVENT_CODE_OFFSET] = EVENT_TRANSFER_TX_COMPLETED;
 
-     pclPassResponse = new ANTMessageResponse();
+     pclPassResponse = clPassLease.Acquire();
      pclPassResponse->Attach(MESG_RESPONSE_EVENT_ID, aucDesiredData, sizeof(aucDesiredData), this);
 
      aucDesiredData[ANT_DATA_CHANNEL_NUM_OFFSET] = ucANTChannel_;   //Setup response to catch tx fail
      aucDesiredData[ANT_DATA_EVENT_ID_OFFSET] = MESG_EVENT_ID;
      aucDesiredData[ANT_DATA_EVENT_CODE_OFFSET] = EVENT_TRANSFER_TX_FAILED;
 
-     pclFailResponse = new ANTMessageResponse();
+     pclFailResponse = clFailLease.Acquire();
      pclFailResponse->Attach(MESG_RESPONSE_EVENT_ID, aucDesiredData, sizeof(aucDesiredData), this, pclPassResponse->pstCondResponseReady);
 
      aucDesiredData[ANT_DATA_CHANNEL_NUM_OFFSET] = ucANTChannel_;   //Setup response to catch any errors like transfer in progress.
-     aucDesiredData[ANT_DATA_EVENT_ID_OFFSET] = MESG_BURST_DATA_ID;
+     aucDesiredData[ANT_DATA_EVENT_ID_OFFSET] = ucMessageID_;
 
-     pclErrorResponse = new ANTMessageResponse();
+     pclErrorResponse = clErrorLease.Acquire();
      pclErrorResponse->Attach(MESG_RESPONSE_EVENT_ID, aucDesiredData, 2, this, pclPassResponse->pstCondResponseReady);
-
-     //getting error Rx will also effectively lose the transfer, but only on an AP1
-#if defined(WAIT_TO_FEED_TRANSFER)
-     aucDesiredData[ANT_DATA_CHANNEL_NUM_OFFSET] = ucANTChannel_;   //Setup response to catch only broadcast/acknowledged messages for this channel
-
-     pclBroadcastResponse = new ANTMessageResponse();
-     pclBroadcastResponse->Attach(MESG_BROADCAST_DATA_ID, aucDesiredData, 1, this, pclPassResponse->pstCondResponseReady);
-
-     pclAcknowledgeResponse = new ANTMessageResponse();
-     pclAcknowledgeResponse->Attach(MESG_ACKNOWLEDGED_DATA_ID, aucDesiredData, 1, this, pclPassResponse->pstCondResponseReady);
-#endif
    }
 
+   if (WriteMessage(&stMessage, ucMaxDataSize_) == FALSE)
+      eReturn = ANTFRAMER_FAIL;
 
-   stMessage.ucMessageID = MESG_BURST_DATA_ID;
-   stMessage.aucData[0] = ucANTChannel_ & CHANNEL_NUMBER_MASK;        // Clear the sequence bits
-
-   while (eReturn == ANTFRAMER_PASS && ulSize_)
-   {
-
-     if (*pbCancel_ == TRUE)
-        eReturn = ANTFRAMER_CANCELLED;
-
-     if (ulSize_ > 8)
-     {
-        memcpy (&stMessage.aucData[1],pucDataSource,8);
-        *pulProgress_ += 8;
-        ulSize_ -= 8;
-     }
-     else
-     {
-        if (pucFooter_ == (UCHAR*)NULL)
-           stMessage.aucData[0] |= SEQUENCE_LAST_MESSAGE;
-
-        memset (&stMessage.aucData[1], 0x00, 8);
-        memcpy (&stMessage.aucData[1],pucDataSource,ulSize_);
-        *pulProgress_ += ulSize_;
-        ulSize_ = 0;
-     }
-
-     if (ulSize_)
-     {
-        if (pucDataSource == pucHeader_)
-           pucDataSource = pucData_;
-        else
-           pucDataSource += 8;
-     }
-
-     if (WriteMessage(&stMessage,9) == FALSE)
-        eReturn = ANTFRAMER_FAIL;
-
-      //Adjust sequence number
-      if ((stMessage.aucData[0] & SEQUENCE_NUMBER_MASK) == SEQUENCE_NUMBER_ROLLOVER)
-         stMessage.aucData[0] = SEQUENCE_NUMBER_INC | ucANTChannel_;
-      else
-         stMessage.aucData[0] += SEQUENCE_NUMBER_INC;
-
-
-#if defined(WAIT_TO_FEED_TRANSFER)
-     if (bFirstPacket)
-     {
-        bFirstPacket = FALSE;
-
-        DSIThread_MutexLock(&stMutexResponseRequest);
-
-        if (eReturn == ANTFRAMER_PASS)                                                                  //Only try to wait if we haven't failed yet
-        {
-            if ((pclBroadcastResponse->bResponseReady == FALSE) &&
-               (pclAcknowledgeResponse->bResponseReady == FALSE) &&
-               (pclPassResponse->bResponseReady == FALSE) &&
-               (pclFailResponse->bResponseReady == FALSE) &&
-               (pclErrorResponse->bResponseReady == FALSE) &&
-               (*pbCancel_ == FALSE) &&
-               ((DSIThread_GetSystemTime() - ulStartTime) < ulResponseTime_))
-            {
-               UCHAR ucStatus = DSIThread_CondTimedWait(pclBroadcastResponse->pstCondResponseReady, &stMutexResponseRequest, 3000);  //Try to wait for the next syncronous event to send out the next packet.
-
-               if (ucStatus != DSI_THREAD_ENONE)   //If we timeout
-               {
-                  #if defined(DEBUG_FILE)
-                     if(ucStatus == DSI_THREAD_EOTHER)
-                        DSIDebug::ThreadWrite("Framer->SendFSTransfer(): CondTimedWait() Failed!");
-                     DSIDebug::ThreadWrite("Framer->SendFSTransfer():  Wait for sync mesg failed.");
-                  #endif
-                  //if we didn't get a syncronous event,
-                  stMessage.aucData[0] += SEQUENCE_NUMBER_INC; // mess up the sequence number on purpose, this will result in the transfer being cleared off of the device and will result in us exiting this function due to the sync error.
-               }
-            }
-
-            pclBroadcastResponse->bResponseReady = FALSE;
-            pclAcknowledgeResponse->bResponseReady = FALSE;
-            //reset the variables and continue on
-        }
-        DSIThread_MutexUnlock(&stMutexResponseRequest);
-     }
-#endif
-
-     if (ulResponseTime_ != 0)                                                                         //Check for errors
-     {
-        if ((pclFailResponse->bResponseReady == TRUE) || (pclErrorResponse->bResponseReady == TRUE))
-          eReturn = ANTFRAMER_FAIL;
+   // Return immediately if we aren't waiting for the response.
+   if (ulResponseTime_ == 0)
+      return ANTFRAMER_PASS;
 
-       if ((DSIThread_GetSystemTime() - ulStartTime) > ulResponseTime_)
-           eReturn = ANTFRAMER_TIMEOUT;
-     }
-   }
+   DSIThread_MutexLock(&stMutexResponseRequest);
 
-   if ((eReturn == ANTFRAMER_PASS) && (pucFooter_))
+   if (eReturn == ANTFRAMER_PASS)                                                                  //Only try to wait if we haven't failed yet
    {
-      stMessage.aucData[0] |= SEQUENCE_LAST_MESSAGE;
-      memcpy (&stMessage.aucData[1],pucFooter_,8);
-      *pulProgress_ += 8;
+      while((pclPassResponse->bResponseReady == FALSE) &&
+           (pclFailResponse->bResponseReady == FALSE) &&
+           (pclErrorResponse->bResponseReady == FALSE) &&
+           (*pbCancel_ == FALSE) &&
+           ((DSIThread_GetSystemTime() - ulStartTime) < ulResponseTime_))
+      {
+         DSIThread_CondTimedWait(pclPassResponse->pstCondResponseReady, &stMutexResponseRequest, 1000);
+      }
 
-      if (WriteMessage(&stMessage,9) == FALSE)
-        eReturn = ANTFRAMER_FAIL;
+      if (pclPassResponse->bResponseReady == FALSE)                     //The only time we are sucessful is if we get a tx transfer complete
+      {
+         //figure out the reason why we failed/stopped
+         if ((pclErrorResponse->bResponseReady == TRUE) || (pclFailResponse->bResponseReady == TRUE))
+            eReturn = ANTFRAMER_FAIL;
+         else if (*pbCancel_ == TRUE)
+            eReturn = ANTFRAMER_CANCELLED;
+         else
+            eReturn = ANTFRAMER_TIMEOUT;
+      }
    }
 
-   if (ulResponseTime_ != 0)                                                                         //Check for errors
-   {
-     DSIThread_MutexLock(&stMutexResponseRequest);
+   pclPassResponse->Remove();
+   pclFailResponse->Remove();
+   pclErrorResponse->Remove();
 
-     if (eReturn == ANTFRAMER_PASS)                                                                  //Only try to wait if we haven't failed yet
-     {
-         while((pclPassResponse->bResponseReady == FALSE) &&
-              (pclFailResponse->bResponseReady == FALSE) &&
-              (pclErrorResponse->bResponseReady == FALSE) &&
-              (*pbCancel_ == FALSE) &&
-              ((DSIThread_GetSystemTime() - ulStartTime) < ulResponseTime_))
-         {
-            DSIThread_CondTimedWait(pclPassResponse->pstCondResponseReady, &stMutexResponseRequest, 1000);
+   DSIThread_MutexUnlock(&stMutexResponseRequest);
 
-            #if defined(WAIT_TO_FEED_TRANSFER)
-               if ((pclBroadcastResponse->bResponseReady == TRUE) ||
-               (pclAcknowledgeResponse->bResponseReady == TRUE))
-               {
-                  pclBroadcastResponse->bResponseReady = FALSE;
-                  pclAcknowledgeResponse->bResponseReady = FALSE;
+   return eReturn;
+}
 
-                  if (ucSyncMesgCount++ > 2)                   //If we get more than 2 sync events (3 or 4) when we're waiting for our transfer to complete
-                  {
-                     pclErrorResponse->bResponseReady = TRUE;  //Set the error response flag
-                  }
-               }
-            #endif
-         }
 
-         if (pclPassResponse->bResponseReady == FALSE)                     //The only time we are sucessful is if we get a tx transfer complete
-         {
-            //figure out the reason why we failed/stopped
-            if ((pclErrorResponse->bResponseReady == TRUE) || (pclFailResponse->bResponseReady == TRUE))
-               eReturn = ANTFRAMER_FAIL;
-            else if (*pbCancel_ == TRUE)
-               eReturn = ANTFRAMER_CANCELLED;
-            else
-               eReturn = ANTFRAMER_TIMEOUT;
-         }
-     }
 
-      pclPassResponse->Remove();
-      pclFailResponse->Remove();
-      pclErrorResponse->Remove();
-   #if defined(WAIT_TO_FEED_TRANSFER)
-      pclBroadcastResponse->Remove();
-      pclAcknowledgeResponse->Remove();
-   #endif
+ANTFRAMER_RETURN DSIFramerANT::SetupBurstDataTransfer(UCHAR ucMessageID_, UCHAR ucANTChannel_, UCHAR * pucData_, ULONG ulSize_,UCHAR ucMaxDataSize_, ULONG ulResponseTime_, UCHAR ucRetries_, ANT_TRANSFER_STATS *pstStats_)
+{
+   ANTFRAMER_RETURN eReturn;
+   ANT_TX_BURST stBurst;
 
-      DSIThread_MutexUnlock(&stMutexResponseRequest);
+   stBurst.ucChannel = ucANTChannel_;
+   stBurst.ucParts = 0;
+   AddBurstPart(&stBurst, pucData_, ulSize_);
 
-      delete pclPassResponse;
-      delete pclFailResponse;
-      delete pclErrorResponse;
-   #if defined(WAIT_TO_FEED_TRANSFER)
-      delete pclBroadcastResponse;
-      delete pclAcknowledgeResponse;
-   #endif
-   }
+   eReturn = SendBurst(ucMessageID_, &stBurst, ucMaxDataSize_, ulResponseTime_, ucRetries_, FALSE, pstStats_, (volatile ULONG*)NULL);
+
+   //Always return true with no timeout, so nobody relies on this return value
+   if ((ulResponseTime_ == 0) && (eReturn != ANTFRAMER_INVALIDPARAM))
+      eReturn = ANTFRAMER_PASS;
 
    return eReturn;
 }
 
 ///////////////////////////////////////////////////////////////////////
-ANTFRAMER_RETURN DSIFramerANT::SendANTFSClientTransfer(UCHAR ucANTChannel_, ANTFS_DATA* pstHeader_, ANTFS_DATA* pstFooter_, ANTFS_DATA* pstData_, ULONG ulResponseTime_, volatile ULONG *pulProgress_)
+// Sends every part of pstBurst_ as one burst, framing and writing up
+// to ucTxBatchSize packets at a time.  With bWaitForSync_ the first
+// packet is written on its own and the rest is held until the channel
+// receives a broadcast or acknowledged message, as ANT-FS requires.
+///////////////////////////////////////////////////////////////////////
+ANTFRAMER_RETURN DSIFramerANT::SendBurst(UCHAR ucMessageID_, ANT_TX_BURST *pstBurst_, UCHAR ucMaxDataSize_, ULONG ulResponseTime_, UCHAR ucRetries_, BOOL bWaitForSync_, ANT_TRANSFER_STATS *pstStats_, volatile ULONG *pulProgress_)
 {
    ANTFRAMER_RETURN eReturn = ANTFRAMER_PASS;
-   ANT_MESSAGE stMessage;
    ULONG ulStartTime = DSIThread_GetSystemTime();
-   UCHAR *pucDataSource;
-   ULONG ulBlockSize;
-   ULONG ulTotalSize;
+   ULONG ulAttemptTime = ulStartTime;
+   ULONG ulTransferSize = 0;
+   ULONG ulPackets = 0;
+   ULONG ulProgressStart;
+   UCHAR ucAttempts = 0;
+   UCHAR ucSyncMesgCount = 0;
+   BOOL bRetry;
 
    ANTMessageResponse *pclPassResponse = (ANTMessageResponse*)NULL;
+   ANTResponseLease clPassLease(this);
    ANTMessageResponse *pclFailResponse = (ANTMessageResponse*)NULL;
+   ANTResponseLease clFailLease(this);
    ANTMessageResponse *pclErrorResponse = (ANTMessageResponse*)NULL;
+   ANTResponseLease clErrorLease(this);
+   ANTMessageResponse *pclBroadcastResponse = (ANTMessageResponse*)NULL;
+   ANTResponseLease clBroadcastLease(this);
+   ANTMessageResponse *pclAcknowledgeResponse = (ANTMessageResponse*)NULL;
+   ANTResponseLease clAcknowledgeLease(this);
+
+   if (bWaitForSync_)
+   {
+      UCHAR ucChannelStatus;
+
+      if (GetChannelStatus(pstBurst_->ucChannel, &ucChannelStatus, 2000) == FALSE)
+         return ANTFRAMER_FAIL;
+
+      if ((ucChannelStatus & STATUS_CHANNEL_STATE_MASK) != STATUS_TRACKING_CHANNEL)
+         return ANTFRAMER_FAIL;
+   }
+
+   ANT_MESSAGE* stMessage = (ANT_MESSAGE*)NULL;
+   if(!CreateAntMsg_wOptExtBuf(&stMessage, ucMaxDataSize_))
+   {
+      #if defined(DEBUG_FILE)
+         DSIDebug::ThreadWrite("Framer->SendBurst(): Failed, ucMaxDataSize_ too big for this part");
+      #endif
+      return ANTFRAMER_INVALIDPARAM;
+   }
+
+   // Only one window is framed at a time; a failed attempt is framed again from the first packet.
+   UCHAR *pucWindow = new UCHAR[ucTxBatchSize * (ucMaxDataSize_ + MESG_FRAME_SIZE + 2)];
+
+   if (pucWindow == NULL)
+   {
+      delete[] stMessage;
+      return ANTFRAMER_FAIL;
+   }
+
+   for (UCHAR i = 0; i < pstBurst_->ucParts; i++)
+   {
+      ulTransferSize += pstBurst_->aulPartSize[i];
+      ulPackets += (pstBurst_->aulPartSize[i] + ucMaxDataSize_ - 2) / (ucMaxDataSize_ - 1);
+   }
 
    ULONG ulDummyProgress = 0;
    volatile BOOL *pbCancel_;
@@ -1992,169 +2525,273 @@ ANTFRAMER_RETURN DSIFramerANT::SendANTFSClientTransfer(UCHAR ucANTChannel_, ANTF
    if (pulProgress_ == NULL)
       pulProgress_ = &ulDummyProgress;
 
-   if (pstHeader_->pucData)   //if there is a header, set the data pointer
-   {
-      pucDataSource = pstHeader_->pucData;
-      ulBlockSize = pstHeader_->ulSize;
-   }
-   else
+   ulProgressStart = *pulProgress_;
+
+   UCHAR aucDesiredData[3];
+
+   aucDesiredData[ANT_DATA_CHANNEL_NUM_OFFSET] = pstBurst_->ucChannel; //Setup response to catch tx complete
+   aucDesiredData[ANT_DATA_EVENT_ID_OFFSET] = MESG_EVENT_ID;
+   aucDesiredData[ANT_DATA_EVENT_CODE_OFFSET] = EVENT_TRANSFER_TX_COMPLETED;
+
+   pclPassResponse = clPassLease.Acquire();
+   pclPassResponse->Attach(MESG_RESPONSE_EVENT_ID, aucDesiredData, sizeof(aucDesiredData), this);
+
+   aucDesiredData[ANT_DATA_CHANNEL_NUM_OFFSET] = pstBurst_->ucChannel; //Setup response to catch tx fail
+   aucDesiredData[ANT_DATA_EVENT_ID_OFFSET] = MESG_EVENT_ID;
+   aucDesiredData[ANT_DATA_EVENT_CODE_OFFSET] = EVENT_TRANSFER_TX_FAILED;
+
+   pclFailResponse = clFailLease.Acquire();
+   pclFailResponse->Attach(MESG_RESPONSE_EVENT_ID, aucDesiredData, sizeof(aucDesiredData), this, pclPassResponse->pstCondResponseReady);
+
+   aucDesiredData[ANT_DATA_CHANNEL_NUM_OFFSET] = pstBurst_->ucChannel; //Setup response to catch any errors like transfer in progress.
+   aucDesiredData[ANT_DATA_EVENT_ID_OFFSET] = ucMessageID_;
+
+   pclErrorResponse = clErrorLease.Acquire();
+   pclErrorResponse->Attach(MESG_RESPONSE_EVENT_ID, aucDesiredData, 2, this, pclPassResponse->pstCondResponseReady);
+
+   //getting error Rx will also effectively lose the transfer, but only on an AP1
+
+   if (bWaitForSync_)
    {
-      pucDataSource = pstData_->pucData;
-      ulBlockSize = pstData_->ulSize;
+      aucDesiredData[ANT_DATA_CHANNEL_NUM_OFFSET] = pstBurst_->ucChannel; //Setup response to catch only broadcast/acknowledged messages for this channel
+
+      pclBroadcastResponse = clBroadcastLease.Acquire();
+      pclBroadcastResponse->Attach(MESG_BROADCAST_DATA_ID, aucDesiredData, 1, this, pclPassResponse->pstCondResponseReady);
+
+      pclAcknowledgeResponse = clAcknowledgeLease.Acquire();
+      pclAcknowledgeResponse->Attach(MESG_ACKNOWLEDGED_DATA_ID, aucDesiredData, 1, this, pclPassResponse->pstCondResponseReady);
    }
 
-   ulTotalSize = pstHeader_->ulSize + pstData_->ulSize + pstFooter_->ulSize;
+   stMessage->ucMessageID = ucMessageID_;
 
-   // If we are going to be waiting for a response setup the Response objects
-   if (ulResponseTime_ != 0)
+   do
    {
-     UCHAR aucDesiredData[3];
+      BOOL bFirstPacket = bWaitForSync_;
 
-     aucDesiredData[ANT_DATA_CHANNEL_NUM_OFFSET] = ucANTChannel_;   //Setup response to catch tx complete
-     aucDesiredData[ANT_DATA_EVENT_ID_OFFSET] = MESG_EVENT_ID;
-     aucDesiredData[ANT_DATA_EVENT_CODE_OFFSET] = EVENT_TRANSFER_TX_COMPLETED;
+      bRetry = FALSE;
+      ucAttempts++;
+      ulAttemptTime = DSIThread_GetSystemTime();
 
-     pclPassResponse = new ANTMessageResponse();
-     pclPassResponse->Attach(MESG_RESPONSE_EVENT_ID, aucDesiredData, sizeof(aucDesiredData), this);
+      pstBurst_->ucPart = 0;
+      pstBurst_->ulOffset = 0;
+      pstBurst_->ucSequence = 0;
+      *pulProgress_ = ulProgressStart;
 
-     aucDesiredData[ANT_DATA_CHANNEL_NUM_OFFSET] = ucANTChannel_;   //Setup response to catch tx fail
-     aucDesiredData[ANT_DATA_EVENT_ID_OFFSET] = MESG_EVENT_ID;
-     aucDesiredData[ANT_DATA_EVENT_CODE_OFFSET] = EVENT_TRANSFER_TX_FAILED;
+      while ((eReturn == ANTFRAMER_PASS) && (pstBurst_->ucPart < pstBurst_->ucParts))
+      {
+         USHORT usWindowSize;
 
-     pclFailResponse = new ANTMessageResponse();
-     pclFailResponse->Attach(MESG_RESPONSE_EVENT_ID, aucDesiredData, sizeof(aucDesiredData), this, pclPassResponse->pstCondResponseReady);
+         if (*pbCancel_ == TRUE)
+         {
+            eReturn = ANTFRAMER_CANCELLED;
+            break;
+         }
 
-     aucDesiredData[ANT_DATA_CHANNEL_NUM_OFFSET] = ucANTChannel_;   //Setup response to catch any errors like transfer in progress.
-     aucDesiredData[ANT_DATA_EVENT_ID_OFFSET] = MESG_BURST_DATA_ID;
+         if (FrameBurstWindow(pstBurst_, stMessage, ucMaxDataSize_, bFirstPacket ? 1 : ucTxBatchSize, pucWindow, &usWindowSize, pulProgress_) == FALSE)
+            eReturn = ANTFRAMER_FAIL;
+         else if (WriteFramedBytes(pucWindow, usWindowSize) == FALSE)
+            eReturn = ANTFRAMER_FAIL;
 
-     pclErrorResponse = new ANTMessageResponse();
-     pclErrorResponse->Attach(MESG_RESPONSE_EVENT_ID, aucDesiredData, 2, this, pclPassResponse->pstCondResponseReady);
-   }
+         if (bFirstPacket)
+         {
+            bFirstPacket = FALSE;
 
-   stMessage.ucMessageID = MESG_BURST_DATA_ID;
-   stMessage.aucData[0] = ucANTChannel_ & CHANNEL_NUMBER_MASK;        // Clear the sequence bits
-
-   while (eReturn == ANTFRAMER_PASS && ulTotalSize)
-   {
-      UCHAR ucCurrentBlockSize;
-
-     if (*pbCancel_ == TRUE)
-        eReturn = ANTFRAMER_CANCELLED;
-
-     if (ulBlockSize > 8)
-     {
-        ucCurrentBlockSize = 8;
-        memcpy (&stMessage.aucData[1],pucDataSource, ucCurrentBlockSize);
-        *pulProgress_ += ucCurrentBlockSize;
-        ulTotalSize -= ucCurrentBlockSize;
-        ulBlockSize -= ucCurrentBlockSize;
-        pucDataSource += ucCurrentBlockSize;
-     }
-     else
-     {
-        ucCurrentBlockSize = (UCHAR)ulBlockSize;
-        memset (&stMessage.aucData[1], 0x00, 8);
-        memcpy (&stMessage.aucData[1],pucDataSource, ucCurrentBlockSize);
-        *pulProgress_ += ucCurrentBlockSize;
-        ulTotalSize -= ucCurrentBlockSize;
-        ulBlockSize = 0;
-     }
-
-     if (ulBlockSize == 0)
-     {
-        if(pucDataSource == (pstHeader_->pucData + pstHeader_->ulSize - ucCurrentBlockSize))
-        {
-           if(pstData_->pucData)
-           {
-              pucDataSource = pstData_->pucData;
-              ulBlockSize = pstData_->ulSize;
-           }
-           else if(pstFooter_->pucData)
-           {
-              pucDataSource = pstFooter_->pucData;
-              ulBlockSize = pstFooter_->ulSize;
-           }
-           else
-           {
-              stMessage.aucData[0] |= SEQUENCE_LAST_MESSAGE;
-           }
-        }
-        else if(pucDataSource == (pstData_->pucData + pstData_->ulSize - ucCurrentBlockSize))
-        {
-           if(pstFooter_->pucData)
-           {
-              pucDataSource = pstFooter_->pucData;
-              ulBlockSize = pstFooter_->ulSize;
-           }
-           else
-           {
-              stMessage.aucData[0] |= SEQUENCE_LAST_MESSAGE;
-           }
-        }
-        else   // footer
+            DSIThread_MutexLock(&stMutexResponseRequest);
+
+            if (eReturn == ANTFRAMER_PASS)                                                                  //Only try to wait if we haven't failed yet
+            {
+               if ((pclBroadcastResponse->bResponseReady == FALSE) &&
+                  (pclAcknowledgeResponse->bResponseReady == FALSE) &&
+                  (pclPassResponse->bResponseReady == FALSE) &&
+                  (pclFailResponse->bResponseReady == FALSE) &&
+                  (pclErrorResponse->bResponseReady == FALSE) &&
+                  (*pbCancel_ == FALSE) &&
+                  ((DSIThread_GetSystemTime() - ulStartTime) < ulResponseTime_))
+               {
+                  UCHAR ucStatus = DSIThread_CondTimedWait(pclBroadcastResponse->pstCondResponseReady, &stMutexResponseRequest, 3000);  //Try to wait for the next syncronous event to send out the next packet.
+
+                  if (ucStatus != DSI_THREAD_ENONE)   //If we timeout
+                  {
+                     #if defined(DEBUG_FILE)
+                        if(ucStatus == DSI_THREAD_EOTHER)
+                           DSIDebug::ThreadWrite("Framer->SendBurst(): CondTimedWait() Failed!");
+                        DSIDebug::ThreadWrite("Framer->SendBurst():  Wait for sync mesg failed.");
+                     #endif
+                     //if we didn't get a syncronous event,
+                     pstBurst_->ucSequence += SEQUENCE_NUMBER_INC; // mess up the sequence number on purpose, this will result in the transfer being cleared off of the device and will result in us exiting this function due to the sync error.
+                  }
+               }
+
+               pclBroadcastResponse->bResponseReady = FALSE;
+               pclAcknowledgeResponse->bResponseReady = FALSE;
+               //reset the variables and continue on
+            }
+            DSIThread_MutexUnlock(&stMutexResponseRequest);
+         }
+
+         //Abort transfer on errors, don't keep trying to send
+         if ((pclFailResponse->bResponseReady == TRUE) || (pclErrorResponse->bResponseReady == TRUE))
+            eReturn = ANTFRAMER_FAIL;
+
+         if (ulResponseTime_ != 0)                                                                         //Check for errors
+         {
+            if ((DSIThread_GetSystemTime() - ulStartTime) > ulResponseTime_)
+               eReturn = ANTFRAMER_TIMEOUT;
+         }
+      }
+
+      DSIThread_MutexLock(&stMutexResponseRequest);
+      if (ulResponseTime_ != 0)                                                                         //Check for errors
+      {
+        if (eReturn == ANTFRAMER_PASS)                                                                  //Only try to wait if we haven't failed yet
         {
-           stMessage.aucData[0] |= SEQUENCE_LAST_MESSAGE;
-        }
-     }
+            while((pclPassResponse->bResponseReady == FALSE) &&
+                 (pclFailResponse->bResponseReady == FALSE) &&
+                 (pclErrorResponse->bResponseReady == FALSE) &&
+                 (*pbCancel_ == FALSE) &&
+                 ((DSIThread_GetSystemTime() - ulStartTime) < ulResponseTime_))
+            {
+               DSIThread_CondTimedWait(pclPassResponse->pstCondResponseReady, &stMutexResponseRequest, 1000);
+
+               if ((bWaitForSync_) &&
+                   ((pclBroadcastResponse->bResponseReady == TRUE) ||
+                    (pclAcknowledgeResponse->bResponseReady == TRUE)))
+               {
+                  pclBroadcastResponse->bResponseReady = FALSE;
+                  pclAcknowledgeResponse->bResponseReady = FALSE;
+
+                  if (ucSyncMesgCount++ > 2)                   //If we get more than 2 sync events (3 or 4) when we're waiting for our transfer to complete
+                  {
+                     pclErrorResponse->bResponseReady = TRUE;  //Set the error response flag
+                  }
+               }
+            }
+
+            if (pclPassResponse->bResponseReady == FALSE)                     //The only time we are sucessful is if we get a tx transfer complete
+            {
+               //figure out the reason why we failed/stopped
+               if ((pclErrorResponse->bResponseReady == TRUE) || (pclFailResponse->bResponseReady == TRUE))
+                  eReturn = ANTFRAMER_FAIL;
+               else if (*pbCancel_ == TRUE)
+                  eReturn = ANTFRAMER_CANCELLED;
+               else
+                  eReturn = ANTFRAMER_TIMEOUT;
+            }
+         }
+      }
+
+      // A burst cannot be resumed part way through once the radio reports it failed,
+      // but it can be sent again from the first packet.
+      if ((eReturn == ANTFRAMER_FAIL) &&
+          (pclFailResponse->bResponseReady == TRUE) &&
+          (pclErrorResponse->bResponseReady == FALSE) &&
+          (ucAttempts <= ucRetries_))
+      {
+         #if defined(DEBUG_FILE)
+            DSIDebug::ThreadWrite("Framer->SendBurst():  Transfer failed, sending again.");
+         #endif
+         pclPassResponse->bResponseReady = FALSE;
+         pclFailResponse->bResponseReady = FALSE;
+         eReturn = ANTFRAMER_PASS;
+         bRetry = TRUE;
+      }
+
+      DSIThread_MutexUnlock(&stMutexResponseRequest);
+
+   } while (bRetry);
+
+   DSIThread_MutexLock(&stMutexResponseRequest);
+
+   pclPassResponse->Remove();
+   pclFailResponse->Remove();
+   pclErrorResponse->Remove();
+
+   if (bWaitForSync_)
+   {
+      pclBroadcastResponse->Remove();
+      pclAcknowledgeResponse->Remove();
+   }
+
+   DSIThread_MutexUnlock(&stMutexResponseRequest);
 
-     if (WriteMessage(&stMessage,9) == FALSE)
-        eReturn = ANTFRAMER_FAIL;
+   if (pstStats_ != NULL)
+   {
+      pstStats_->ulBytes = ulTransferSize;
+      pstStats_->ulPackets = ulPackets;
+      pstStats_->ucAttempts = ucAttempts;
+      pstStats_->ulTime = DSIThread_GetSystemTime() - ulAttemptTime;
+      pstStats_->ulBytesPerSecond = 0;
+
+      if ((eReturn == ANTFRAMER_PASS) && (ulResponseTime_ != 0) && (pstStats_->ulTime != 0))
+         pstStats_->ulBytesPerSecond = ((ulTransferSize / pstStats_->ulTime) * 1000) + (((ulTransferSize % pstStats_->ulTime) * 1000) / pstStats_->ulTime);
+   }
 
-      //Adjust sequence number
-      if ((stMessage.aucData[0] & SEQUENCE_NUMBER_MASK) == SEQUENCE_NUMBER_ROLLOVER)
-         stMessage.aucData[0] = SEQUENCE_NUMBER_INC | ucANTChannel_;
-      else
-         stMessage.aucData[0] += SEQUENCE_NUMBER_INC;
+   delete[] pucWindow;
+   delete[] stMessage;
 
-     if (ulResponseTime_ != 0)                                                                         //Check for errors
-     {
-        if ((pclFailResponse->bResponseReady == TRUE) || (pclErrorResponse->bResponseReady == TRUE))
-          eReturn = ANTFRAMER_FAIL;
+   return eReturn;
+}
 
-       if ((DSIThread_GetSystemTime() - ulStartTime) > ulResponseTime_)
-           eReturn = ANTFRAMER_TIMEOUT;
-     }
-   } // while loop
 
-   if (ulResponseTime_ != 0)                                                                         //Check for errors
-   {
-     DSIThread_MutexLock(&stMutexResponseRequest);
 
-     if (eReturn == ANTFRAMER_PASS)                                                                  //Only try to wait if we haven't failed yet
-     {
-         while((pclPassResponse->bResponseReady == FALSE) &&
-              (pclFailResponse->bResponseReady == FALSE) &&
-              (pclErrorResponse->bResponseReady == FALSE) &&
-              (*pbCancel_ == FALSE) &&
-              ((DSIThread_GetSystemTime() - ulStartTime) < ulResponseTime_))
-         {
-            DSIThread_CondTimedWait(pclPassResponse->pstCondResponseReady, &stMutexResponseRequest, 1000);
-         }
+///////////////////////////////////////////////////////////////////////
+ANTFRAMER_RETURN DSIFramerANT::SendTransfer(UCHAR ucANTChannel_, UCHAR * pucData_, ULONG ulSize_, ULONG ulResponseTime_, UCHAR ucRetries_, ANT_TRANSFER_STATS *pstStats_)
+{
+   return(SetupBurstDataTransfer(
+      MESG_BURST_DATA_ID,
+      ucANTChannel_,
+      pucData_,
+      ulSize_,
+      MESG_DATA_SIZE,
+      ulResponseTime_,
+      ucRetries_,
+      pstStats_));
+}
 
-         if (pclPassResponse->bResponseReady == FALSE)                     //The only time we are sucessful is if we get a tx transfer complete
-         {
-            //figure out the reason why we failed/stopped
-            if ((pclErrorResponse->bResponseReady == TRUE) || (pclFailResponse->bResponseReady == TRUE))
-               eReturn = ANTFRAMER_FAIL;
-            else if (*pbCancel_ == TRUE)
-               eReturn = ANTFRAMER_CANCELLED;
-            else
-               eReturn = ANTFRAMER_TIMEOUT;
-         }
-     }
+ANTFRAMER_RETURN DSIFramerANT::SendAdvancedTransfer(UCHAR ucANTChannel_, UCHAR * pucData_, ULONG ulSize_, UCHAR ucStdPcktsPerSerialMsg_, ULONG ulResponseTime_, UCHAR ucRetries_, ANT_TRANSFER_STATS *pstStats_)
+{
+   return(SetupBurstDataTransfer(
+      MESG_ADV_BURST_DATA_ID,
+      ucANTChannel_,
+      pucData_,
+      ulSize_,
+      1 + ((MESG_DATA_SIZE-1) * ucStdPcktsPerSerialMsg_),   //seqNum + (payloadLength*pcktsPerSerial)
+      ulResponseTime_,
+      ucRetries_,
+      pstStats_));
+}
+
+///////////////////////////////////////////////////////////////////////
+ANTFRAMER_RETURN DSIFramerANT::SendANTFSTransfer(UCHAR ucANTChannel_, UCHAR* pucHeader_, UCHAR* pucFooter_, UCHAR * pucData_, ULONG ulSize_, ULONG ulResponseTime_, volatile ULONG *pulProgress_)
+{
+   ANT_TX_BURST stBurst;
+#if defined(WAIT_TO_FEED_TRANSFER)
+   BOOL bWaitForSync = TRUE;
+#else
+   BOOL bWaitForSync = FALSE;
+#endif
 
-      pclPassResponse->Remove();
-      pclFailResponse->Remove();
-      pclErrorResponse->Remove();
+   stBurst.ucChannel = ucANTChannel_;
+   stBurst.ucParts = 0;
+   AddBurstPart(&stBurst, pucHeader_, 8);
+   AddBurstPart(&stBurst, pucData_, ulSize_);
+   AddBurstPart(&stBurst, pucFooter_, 8);
 
-      DSIThread_MutexUnlock(&stMutexResponseRequest);
+   return SendBurst(MESG_BURST_DATA_ID, &stBurst, MESG_DATA_SIZE, ulResponseTime_, 0, bWaitForSync, (ANT_TRANSFER_STATS*)NULL, pulProgress_);
+}
 
-      delete pclPassResponse;
-      delete pclFailResponse;
-      delete pclErrorResponse;
-   }
+///////////////////////////////////////////////////////////////////////
+ANTFRAMER_RETURN DSIFramerANT::SendANTFSClientTransfer(UCHAR ucANTChannel_, ANTFS_DATA* pstHeader_, ANTFS_DATA* pstFooter_, ANTFS_DATA* pstData_, ULONG ulResponseTime_, volatile ULONG *pulProgress_)
+{
+   ANT_TX_BURST stBurst;
 
-   return eReturn;
+   stBurst.ucChannel = ucANTChannel_;
+   stBurst.ucParts = 0;
+   AddBurstPart(&stBurst, pstHeader_->pucData, pstHeader_->ulSize);
+   AddBurstPart(&stBurst, pstData_->pucData, pstData_->ulSize);
+   AddBurstPart(&stBurst, pstFooter_->pucData, pstFooter_->ulSize);
+
+   return SendBurst(MESG_BURST_DATA_ID, &stBurst, MESG_DATA_SIZE, ulResponseTime_, 0, FALSE, (ANT_TRANSFER_STATS*)NULL, pulProgress_);
 }
 
 //////////////////////////////////////////////////////////////////////////////////
@@ -2170,8 +2807,10 @@ USHORT DSIFramerANT::GetMessageSize(void)
 
    if (ucError)
       usRetVal = DSI_FRAMER_ERROR;
-   else if ((usMessageHead - usMessageTail) != 0)
-      usRetVal = astMessageBuffer[usMessageTail].ucSize;
+   else if (ulPriorityCount != 0)
+      usRetVal = astPriorityQueue[ulPriorityTail].ucSize;
+   else if (ulMessageCount != 0)
+      usRetVal = pucMessageQueue[ulMessageTail];
    else
       usRetVal = DSI_FRAMER_TIMEDOUT;
 
@@ -2186,6 +2825,9 @@ void DSIFramerANT::ProcessMessage(void)
 
    CheckResponseList();
 
+   if (ucMessageID == MESG_STARTUP_MESG_ID)
+      ForgetAllChannelConfig();                                   // The device has reset and lost its configuration.
+
    if(ucMessageID == MESG_BURST_DATA_ID || ucMessageID == MESG_EXT_BURST_DATA_ID)
    {
       ucPrevSequenceNum = aucRxFifo[MESG_DATA_OFFSET] & SEQUENCE_NUMBER_MASK;
@@ -2208,7 +2850,18 @@ void DSIFramerANT::ProcessMessage(void)
       }
    }
 
-   if(ucMessageID == MESG_ADV_BURST_DATA_ID && bSplitAdvancedBursts) // split into normal burst messages.
+   if(ucMessageID == MESG_ADV_BURST_DATA_ID && bAssembleAdvancedBursts && ucSize > 1 && ucSize <= MESG_MAX_SIZE_VALUE)
+   {
+      if (!QueueBurstSegment(&aucRxFifo[MESG_DATA_OFFSET], ucSize))
+         RaiseError(DSI_FRAMER_ANT_EQUEUE_OVERFLOW);
+
+      DSIThread_CondSignal(&stCondMessageReady);
+
+      #if defined(SERIAL_DEBUG)
+         DSIDebug::SerialWrite(pclSerial->GetDeviceNumber(), "Rx", aucRxFifo, ucSize + 4);
+      #endif
+   }
+   else if(ucMessageID == MESG_ADV_BURST_DATA_ID && bSplitAdvancedBursts) // split into normal burst messages.
    {
       #if defined(SERIAL_DEBUG)
          DSIDebug::SerialWrite(pclSerial->GetDeviceNumber(), "Decomposing", aucRxFifo, ucSize+4);
@@ -2220,41 +2873,36 @@ void DSIFramerANT::ProcessMessage(void)
          ucPrevSequenceNum += SEQUENCE_NUMBER_INC;
          if((aucRxFifo[MESG_DATA_OFFSET] & SEQUENCE_LAST_MESSAGE) != 0 && (i+1)*8 == ucSize - 1) //If the last packet.
             ucPrevSequenceNum |= SEQUENCE_LAST_MESSAGE;
+         UCHAR aucPacket[9];
+         aucPacket[0] = ucPrevSequenceNum | (aucRxFifo[MESG_DATA_OFFSET] & CHANNEL_NUMBER_MASK);
+         memcpy(&aucPacket[1], &aucRxFifo[MESG_DATA_OFFSET + 1 + i*8], 8);
+
          // Add message to the queue.
-         if ((USHORT)(usMessageHead - usMessageTail) < (USHORT)(sizeof(astMessageBuffer) / sizeof(ANT_MESSAGE_ITEM) - 1))
-         {
-            astMessageBuffer[usMessageHead].ucSize = 9;
-            astMessageBuffer[usMessageHead].stANTMessage.ucMessageID = MESG_BURST_DATA_ID;
-            astMessageBuffer[usMessageHead].stANTMessage.aucData[0] = ucPrevSequenceNum | (aucRxFifo[MESG_DATA_OFFSET] & CHANNEL_NUMBER_MASK);
-            memcpy(astMessageBuffer[usMessageHead].stANTMessage.aucData + 1, &aucRxFifo[MESG_DATA_OFFSET + 1 + i*8], 8);
-            usMessageHead++;                                   // Rollover of usMessageHead happens automagically because our buffer size is MAX_USHORT + 1.
-         }
-         else
-         {
-            ucError = DSI_FRAMER_ANT_EQUEUE_OVERFLOW;
-         }
+         if (!QueueRxMessage(MESG_BURST_DATA_ID, aucPacket, sizeof(aucPacket)))
+            RaiseError(DSI_FRAMER_ANT_EQUEUE_OVERFLOW);
 
          DSIThread_CondSignal(&stCondMessageReady);
 
          #if defined(SERIAL_DEBUG)
-            DSIDebug::SerialWrite(pclSerial->GetDeviceNumber(), "Simulated Rx", astMessageBuffer[usMessageHead-1].stANTMessage.aucData, astMessageBuffer[usMessageHead-1].ucSize);
+            DSIDebug::SerialWrite(pclSerial->GetDeviceNumber(), "Simulated Rx", aucPacket, sizeof(aucPacket));
          #endif
       }
    }
+   else if (bPriorityResponses && IsPriorityMessage(ucMessageID, &aucRxFifo[MESG_DATA_OFFSET]) &&
+            QueuePriorityMessage(ucMessageID, &aucRxFifo[MESG_DATA_OFFSET], ucSize))
+   {
+      DSIThread_CondSignal(&stCondPriorityReady);
+      DSIThread_CondSignal(&stCondMessageReady);
+
+      #if defined(SERIAL_DEBUG)
+         DSIDebug::SerialWrite(pclSerial->GetDeviceNumber(), "Rx", aucRxFifo, ucSize + 4);
+      #endif
+   }
    else
    {
       // Add message to the queue.
-      if ((USHORT)(usMessageHead - usMessageTail) < (USHORT)(sizeof(astMessageBuffer) / sizeof(ANT_MESSAGE_ITEM) - 1))
-      {
-         astMessageBuffer[usMessageHead].ucSize = ucSize;
-         astMessageBuffer[usMessageHead].stANTMessage.ucMessageID = ucMessageID;
-         memcpy(astMessageBuffer[usMessageHead].stANTMessage.aucData, &aucRxFifo[MESG_DATA_OFFSET], ucSize);
-         usMessageHead++;                                   // Rollover of usMessageHead happens automagically because our buffer size is MAX_USHORT + 1.
-      }
-      else
-      {
-         ucError = DSI_FRAMER_ANT_EQUEUE_OVERFLOW;
-      }
+      if (!QueueRxMessage(ucMessageID, &aucRxFifo[MESG_DATA_OFFSET], ucSize))
+         RaiseError(DSI_FRAMER_ANT_EQUEUE_OVERFLOW);
 
       DSIThread_CondSignal(&stCondMessageReady);
 
@@ -2264,80 +2912,432 @@ void DSIFramerANT::ProcessMessage(void)
    }
 }
 
+///////////////////////////////////////////////////////////////////////
+// Appends the payload of an advanced burst message to its channel's
+// buffer, keeping it in one piece, and queues a segment message
+// pointing at it.  Returns FALSE if the buffer could not be allocated
+// or the queue is full.
+// stMutexCriticalSection must be locked before calling this function.
+///////////////////////////////////////////////////////////////////////
+BOOL DSIFramerANT::QueueBurstSegment(const UCHAR *pucData_, UCHAR ucSize_)
+{
+   UCHAR ucChannel = pucData_[0] & CHANNEL_NUMBER_MASK;
+   UCHAR ucLength = ucSize_ - 1;                                  // Less the sequence and channel byte.
+   UCHAR aucSegment[DSI_FRAMER_ANT_BURST_SEGMENT_SIZE];
+   ULONG ulOffset;
+
+   if (apucBurstBuffer[ucChannel] == NULL)
+   {
+      apucBurstBuffer[ucChannel] = new UCHAR[ulBurstBufferSize];
+      if (apucBurstBuffer[ucChannel] == NULL)
+         return FALSE;
+   }
+
+   ulOffset = aulBurstPosition[ucChannel] & (ulBurstBufferSize - 1);
+   if ((ulOffset + ucLength) > ulBurstBufferSize)                 // Skip the end of the buffer rather than split the segment.
+   {
+      aulBurstPosition[ucChannel] += ulBurstBufferSize - ulOffset;
+      ulOffset = 0;
+   }
+
+   memcpy(&apucBurstBuffer[ucChannel][ulOffset], &pucData_[1], ucLength);
+
+   aucSegment[0] = pucData_[0];
+   aucSegment[1] = (UCHAR) aulBurstPosition[ucChannel];
+   aucSegment[2] = (UCHAR) (aulBurstPosition[ucChannel] >> 8);
+   aucSegment[3] = (UCHAR) (aulBurstPosition[ucChannel] >> 16);
+   aucSegment[4] = (UCHAR) (aulBurstPosition[ucChannel] >> 24);
+   aucSegment[5] = ucLength;
+   aucSegment[6] = ucBurstGeneration;
+
+   aulBurstPosition[ucChannel] += ucLength;
+
+   return QueueRxMessage(DSI_FRAMER_ANT_BURST_SEGMENT_ID, aucSegment, sizeof(aucSegment));
+}
+
+///////////////////////////////////////////////////////////////////////
+// stMutexCriticalSection must be locked before calling this function,
+// unless the framer is being destroyed.
+///////////////////////////////////////////////////////////////////////
+void DSIFramerANT::FreeBurstBuffers(void)
+{
+   for (UCHAR i = 0; i < DSI_FRAMER_ANT_BURST_CHANNELS; i++)
+   {
+      delete[] apucBurstBuffer[i];
+      apucBurstBuffer[i] = (UCHAR*)NULL;
+   }
+}
+
+///////////////////////////////////////////////////////////////////////
+// Appends a message to the receive queue.  Each message is kept in one
+// piece: if it does not fit before the end of the buffer, the head
+// wraps to the start and ulMessageWrap marks where the data ends.
+// Only MESG_MAX_SIZE_VALUE bytes of data are kept, as GetMessage()
+// rejects anything larger, but the size reported by ANT is stored.
+// Returns FALSE if the queue is full.
+// stMutexCriticalSection must be locked before calling this function.
+///////////////////////////////////////////////////////////////////////
+BOOL DSIFramerANT::QueueRxMessage(UCHAR ucMessageID_, const UCHAR *pucData_, UCHAR ucSize_)
+{
+   ULONG ulDataSize = MIN(ucSize_, MESG_MAX_SIZE_VALUE);
+   ULONG ulItemSize = DSI_FRAMER_ANT_QUEUE_ITEM_HEADER + ulDataSize;
+   BOOL bWrapped = (ulMessageHead < ulMessageTail) || ((ulMessageHead == ulMessageTail) && (ulMessageCount != 0));
+
+   if (bWrapped)
+   {
+      if ((ulMessageHead + ulItemSize) > ulMessageTail)
+         return FALSE;
+   }
+   else if ((ulMessageHead + ulItemSize) > ulMessageQueueSize)
+   {
+      if (ulItemSize > ulMessageTail)
+         return FALSE;
+
+      ulMessageWrap = ulMessageHead;
+      ulMessageHead = 0;
+   }
+
+   UCHAR *pucItem = &pucMessageQueue[ulMessageHead];
+   pucItem[0] = ucSize_;
+   pucItem[1] = ucMessageID_;
+   memcpy(&pucItem[DSI_FRAMER_ANT_QUEUE_ITEM_HEADER], pucData_, ulDataSize);
+
+   ulMessageHead += ulItemSize;
+   ulMessageCount++;
+   ulMessageBytes += ulItemSize;
+
+   if (ulMessageBytes > ulMessageHighWater)
+      ulMessageHighWater = ulMessageBytes;
+
+   return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////
+// Drops the oldest message in the receive queue.
+// stMutexCriticalSection must be locked before calling this function.
+///////////////////////////////////////////////////////////////////////
+void DSIFramerANT::DequeueRxMessage(void)
+{
+   if (ulMessageCount == 0)
+      return;
+
+   ULONG ulItemSize = DSI_FRAMER_ANT_QUEUE_ITEM_HEADER + MIN(pucMessageQueue[ulMessageTail], MESG_MAX_SIZE_VALUE);
+
+   ulMessageTail += ulItemSize;
+   ulMessageCount--;
+   ulMessagesPeeked = 0;                                    // Any other removal ends the peek.
+   ulPriorityPeeked = 0;
+
+   if (ulErrorPosition != 0)
+      ulErrorPosition--;
+   ulMessageBytes -= ulItemSize;
+
+   if (ulMessageCount == 0)
+      ResetMessageQueue();                                  // Start again at the front of the buffer while it is empty.
+   else if ((ulMessageTail == ulMessageWrap) && (ulMessageHead < ulMessageTail))
+      ulMessageTail = 0;                                    // Follow the head back to the start.
+}
+
+///////////////////////////////////////////////////////////////////////
+// Appends a message to the priority queue.  Returns FALSE if it is
+// full or the message is too large, so the message can go to the main
+// queue instead.
+// stMutexCriticalSection must be locked before calling this function.
+///////////////////////////////////////////////////////////////////////
+BOOL DSIFramerANT::QueuePriorityMessage(UCHAR ucMessageID_, const UCHAR *pucData_, UCHAR ucSize_)
+{
+   if ((ulPriorityCount == DSI_FRAMER_ANT_PRIORITY_QUEUE_SIZE) || (ucSize_ > MESG_MAX_SIZE_VALUE))
+      return FALSE;
+
+   ANT_MESSAGE_ITEM *pstItem = &astPriorityQueue[(ulPriorityTail + ulPriorityCount) % DSI_FRAMER_ANT_PRIORITY_QUEUE_SIZE];
+   pstItem->ucSize = ucSize_;
+   pstItem->stANTMessage.ucMessageID = ucMessageID_;
+   memcpy(pstItem->stANTMessage.aucData, pucData_, ucSize_);
+
+   ulPriorityCount++;
+
+   return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////
+// Drops the oldest message in the priority queue.
+// stMutexCriticalSection must be locked before calling this function.
+///////////////////////////////////////////////////////////////////////
+void DSIFramerANT::DequeuePriorityMessage(void)
+{
+   if (ulPriorityCount == 0)
+      return;
+
+   ulPriorityTail = (ulPriorityTail + 1) % DSI_FRAMER_ANT_PRIORITY_QUEUE_SIZE;
+   ulPriorityCount--;
+   ulMessagesPeeked = 0;
+   ulPriorityPeeked = 0;
+}
+
+///////////////////////////////////////////////////////////////////////
+// stMutexCriticalSection must be locked before calling this function.
+///////////////////////////////////////////////////////////////////////
+void DSIFramerANT::ResetMessageQueue(void)
+{
+   ulMessageHead = 0;
+   ulMessageTail = 0;
+   ulMessageWrap = ulMessageQueueSize;
+   ulMessageCount = 0;
+   ulMessageBytes = 0;
+   ulErrorPosition = 0;
+   ulMessagesPeeked = 0;
+}
+
+///////////////////////////////////////////////////////////////////////
+// Flags an error, remembering how many queued messages came before it
+// so GetMessages() can report it in sequence.  A later error replaces
+// the code but keeps the place of the first.
+// stMutexCriticalSection must be locked before calling this function.
+///////////////////////////////////////////////////////////////////////
+void DSIFramerANT::RaiseError(UCHAR ucError_)
+{
+   if (ucError == 0)
+      ulErrorPosition = ulMessageCount;
+
+   ucError = ucError_;
+}
+
+///////////////////////////////////////////////////////////////////////
+// stMutexCriticalSection must be locked before calling this function.
+///////////////////////////////////////////////////////////////////////
+ULONG DSIFramerANT::GetItemCount(void)
+{
+   return ulMessageCount + ulPriorityCount + ((ucError != 0) ? 1 : 0);
+}
+
+///////////////////////////////////////////////////////////////////////
+// Waiters are indexed on the message ID and the first data byte, which
+// is the channel for channel responses, so a frame only looks at the
+// waiters that could match it.  Waiters that match on the ID alone
+// are kept under RESPONSE_ANY_CHANNEL.
 ///////////////////////////////////////////////////////////////////////
 void DSIFramerANT::CheckResponseList(void)
 {
-   ANTMessageResponse *pclResponseList;
-   BOOL bMatch;
+   // Most frames have nobody waiting on them.  A waiter is attached
+   // before its command is written, so it is always counted by the
+   // time its response can arrive.
+   if (ulResponseCount == 0)
+      return;
+
+   UCHAR ucMessageID = aucRxFifo[MESG_ID_OFFSET];
+   UCHAR ucChannelBucket = GetResponseBucket(ucMessageID, aucRxFifo[MESG_DATA_OFFSET]);
+   UCHAR ucAnyBucket = GetResponseBucket(ucMessageID, RESPONSE_ANY_CHANNEL);
 
    DSIThread_MutexLock(&stMutexResponseRequest);
 
-   pclResponseList = pclResponseListStart;
+   BOOL bTokenMatched = MatchResponses(apclResponseIndex[ucChannelBucket], FALSE);
+
+   if (ucAnyBucket != ucChannelBucket)
+      MatchResponses(apclResponseIndex[ucAnyBucket], bTokenMatched);
+
+   DSIThread_MutexUnlock(&stMutexResponseRequest);
+}
+
+///////////////////////////////////////////////////////////////////////
+// Completes the waiters in a bucket that match the received frame.
+// Tokens are queued for RunTokenCallbacks() rather than called here.
+// Returns TRUE if a token was completed.
+// stMutexResponseRequest must be locked before calling this function.
+///////////////////////////////////////////////////////////////////////
+BOOL DSIFramerANT::MatchResponses(ANTMessageResponse *pclResponse_, BOOL bTokenMatched_)
+{
+   BOOL bTokenMatched = bTokenMatched_;
 
-   while (pclResponseList != NULL)
+   while (pclResponse_ != NULL)
    {
-      bMatch = TRUE;
+      ANTMessageResponse *pclNext = pclResponse_->pclNext;
 
-      if (pclResponseList->bResponseReady == FALSE && pclResponseList->stMessageItem.stANTMessage.ucMessageID == aucRxFifo[MESG_ID_OFFSET])
+      if (pclResponse_->bResponseReady == FALSE &&
+          (pclResponse_->pclToken == NULL || bTokenMatched == FALSE) &&    // One response completes one asynchronous command
+          pclResponse_->stMessageItem.stANTMessage.ucMessageID == aucRxFifo[MESG_ID_OFFSET] &&
+          memcmp(pclResponse_->stMessageItem.stANTMessage.aucData, &aucRxFifo[MESG_DATA_OFFSET], pclResponse_->ucBytesToMatch) == 0)
       {
-         for(int i=0; i < pclResponseList->ucBytesToMatch; i++)
-         {
-            if (pclResponseList->stMessageItem.stANTMessage.aucData[i] != aucRxFifo[MESG_DATA_OFFSET + i])
-            {
-               bMatch = FALSE;                                                             // Data byte did not match
-            }
-         }
+        int i = pclResponse_->ucBytesToMatch;
+        pclResponse_->stMessageItem.ucSize = aucRxFifo[MESG_SIZE_OFFSET];
+        memcpy(&(pclResponse_->stMessageItem.stANTMessage.aucData[i]), &(aucRxFifo[MESG_DATA_OFFSET + i]), MESG_MAX_SIZE_VALUE - i);   // Copy the rest of the message
+
+        pclResponse_->bResponseReady = TRUE;
+        DSIThread_CondSignal(pclResponse_->pstCondResponseReady);
+
+        if (pclResponse_->pclToken != NULL)
+        {
+           ANTCommandToken **ppclToken = &pclCompletedTokens;
+
+           while (*ppclToken != NULL)
+              ppclToken = &((*ppclToken)->pclNextCompleted);
+
+           pclResponse_->pclToken->pclNextCompleted = (ANTCommandToken*)NULL;
+           *ppclToken = pclResponse_->pclToken;
+           bTokenMatched = TRUE;
+        }
       }
-      else
+
+      pclResponse_ = pclNext;
+   }
+
+   return bTokenMatched;
+}
+
+///////////////////////////////////////////////////////////////////////
+// Calls the callbacks of the tokens completed by the frames just
+// received.  stMutexCriticalSection and stMutexResponseRequest must
+// not be held, so that a callback can send further commands.
+///////////////////////////////////////////////////////////////////////
+void DSIFramerANT::RunTokenCallbacks(void)
+{
+   if (pclCompletedTokens == NULL)                          // Only this thread adds to the list.
+      return;
+
+   DSIThread_MutexLock(&stMutexResponseRequest);
+
+   while (pclCompletedTokens != NULL)
+   {
+      ANTCommandToken *pclToken = pclCompletedTokens;
+
+      pclCompletedTokens = pclToken->pclNextCompleted;
+      pclCompletingToken = pclToken;                        // Cancel() waits for the callback from now on.
+      hCompletingThread = DSIThread_GetCurrentThreadIDNum();
+      DSIThread_MutexUnlock(&stMutexResponseRequest);
+
+      pclToken->Complete();                                 // The token may be gone once this returns.
+
+      DSIThread_MutexLock(&stMutexResponseRequest);
+      pclCompletingToken = (ANTCommandToken*)NULL;
+      DSIThread_CondBroadcast(&stCondTokenIdle);
+   }
+
+   DSIThread_MutexUnlock(&stMutexResponseRequest);
+}
+
+///////////////////////////////////////////////////////////////////////
+// Stops a token's callback from being called, waiting for it if it is
+// running on another thread, then releases the token's response.
+///////////////////////////////////////////////////////////////////////
+void DSIFramerANT::CancelToken(ANTCommandToken *pclToken_)
+{
+   ANTCommandToken **ppclToken;
+   ANTMessageResponse *pclResponse = pclToken_->pclResponse;
+
+   DSIThread_MutexLock(&stMutexResponseRequest);
+
+   for (ppclToken = &pclCompletedTokens; *ppclToken != NULL; ppclToken = &((*ppclToken)->pclNextCompleted))
+   {
+      if (*ppclToken == pclToken_)
       {
-         bMatch = FALSE;                                                                     // Mesg ID did not match
+         *ppclToken = pclToken_->pclNextCompleted;
+         break;
       }
+   }
+
+   while ((pclCompletingToken == pclToken_) && !DSIThread_CompareThreads(hCompletingThread, DSIThread_GetCurrentThreadIDNum()))
+      DSIThread_CondTimedWait(&stCondTokenIdle, &stMutexResponseRequest, DSI_THREAD_INFINITE);
+
+   pclResponse->pclToken = (ANTCommandToken*)NULL;          // Anything it matches from now on completes no token.
+
+   DSIThread_MutexUnlock(&stMutexResponseRequest);
+
+   ReleaseResponse(pclResponse);
+}
+
+
+///////////////////////////////////////////////////////////////////////
+// Hands out a response from the pool, or a new one if all of them are
+// in use.
+///////////////////////////////////////////////////////////////////////
+ANTMessageResponse* DSIFramerANT::AcquireResponse(void)
+{
+   ANTMessageResponse *pclResponse = (ANTMessageResponse*)NULL;
+
+   DSIThread_MutexLock(&stMutexResponseRequest);
+
+   if (ucFreeResponses != 0)
+      pclResponse = apclFreeResponses[--ucFreeResponses];
+
+   DSIThread_MutexUnlock(&stMutexResponseRequest);
+
+   if (pclResponse == NULL)
+      pclResponse = new ANTMessageResponse();
+
+   return pclResponse;
+}
+
+///////////////////////////////////////////////////////////////////////
+void DSIFramerANT::ReleaseResponse(ANTMessageResponse *pclResponse_)
+{
+   pclResponse_->Remove();                                  // Detach from the list in case the caller did not.
+   pclResponse_->pclToken = (ANTCommandToken*)NULL;
+
+   if ((pclResponse_ < pclResponsePool) || (pclResponse_ >= &pclResponsePool[DSI_FRAMER_ANT_RESPONSE_POOL_SIZE]))
+   {
+      delete pclResponse_;                                  // Made because the pool was empty.
+      return;
+   }
 
-      if (bMatch)
+   DSIThread_MutexLock(&stMutexResponseRequest);
+   apclFreeResponses[ucFreeResponses++] = pclResponse_;
+   DSIThread_MutexUnlock(&stMutexResponseRequest);
+}
+
+///////////////////////////////////////////////////////////////////////
+// Detaches every response still waiting so that none of them refer to
+// the framer once it is gone.  Tokens still holding a response are
+// left idle, and responses made because the pool was empty are
+// deleted.
+///////////////////////////////////////////////////////////////////////
+void DSIFramerANT::DetachResponses(void)
+{
+   DSIThread_MutexLock(&stMutexResponseRequest);
+
+   for (UCHAR i = 0; i < DSI_FRAMER_ANT_RESPONSE_BUCKETS; i++)
+   {
+      ANTMessageResponse *pclResponse = apclResponseIndex[i];
+
+      while (pclResponse != NULL)
       {
-        int i = pclResponseList->ucBytesToMatch;
-        pclResponseList->stMessageItem.ucSize = aucRxFifo[MESG_SIZE_OFFSET];
-        memcpy(&(pclResponseList->stMessageItem.stANTMessage.aucData[i]), &(aucRxFifo[MESG_DATA_OFFSET + i]), MESG_MAX_SIZE_VALUE - i);   // Copy the rest of the message
+         ANTMessageResponse *pclNext = pclResponse->pclNext;
+
+         pclResponse->pclNext = (ANTMessageResponse*)NULL;
+         pclResponse->pclFramer = (DSIFramerANT*)NULL;
+
+         if (pclResponse->pclToken != NULL)
+         {
+            pclResponse->pclToken->pclResponse = (ANTMessageResponse*)NULL;
+            pclResponse->pclToken = (ANTCommandToken*)NULL;
+
+            if ((pclResponse < pclResponsePool) || (pclResponse >= &pclResponsePool[DSI_FRAMER_ANT_RESPONSE_POOL_SIZE]))
+               delete pclResponse;
+         }
 
-        pclResponseList->bResponseReady = TRUE;
-        DSIThread_CondSignal(pclResponseList->pstCondResponseReady);
+         pclResponse = pclNext;
       }
 
-      pclResponseList = pclResponseList->pclNext;
+      apclResponseIndex[i] = (ANTMessageResponse*)NULL;
    }
 
+   ulResponseCount = 0;
+   pclCompletedTokens = (ANTCommandToken*)NULL;
+
    DSIThread_MutexUnlock(&stMutexResponseRequest);
 }
 
-
 ///////////////////////////////////////////////////////////////////////
 BOOL DSIFramerANT::SendCommand(ANT_MESSAGE *pstANTMessage_, USHORT usMessageSize_, ULONG ulResponseTime_)
 {
    ANTMessageResponse *pclCommandResponse = (ANTMessageResponse*)NULL;
+   ANTResponseLease clCommandLease(this);
+
+   ForgetChannelConfig(pstANTMessage_);
 
    // If we are going to be waiting for a response setup the Response object
    if (ulResponseTime_ != 0)
    {
-      UCHAR aucDesiredData[2];
-      UCHAR bytesToMatch = 2;
-
-      aucDesiredData[ANT_DATA_CHANNEL_NUM_OFFSET] = pstANTMessage_->aucData[ANT_DATA_CHANNEL_NUM_OFFSET];
-      aucDesiredData[ANT_DATA_EVENT_ID_OFFSET] = pstANTMessage_->ucMessageID;
-
-      //Script dump success can be determined by looking for the script cmd 0x04 dump complete code
-      if(pstANTMessage_->ucMessageID == MESG_SCRIPT_CMD_ID && pstANTMessage_->aucData[ANT_DATA_EVENT_ID_OFFSET] == SCRIPT_CMD_DUMP)
-      {
-         aucDesiredData[ANT_DATA_CHANNEL_NUM_OFFSET] = SCRIPT_CMD_END_DUMP;
-         bytesToMatch = 1; //The second byte is the number of commands returned, which we can't guess so only match the first byte
-      }
-      else if(pstANTMessage_->ucMessageID == MESG_SCRIPT_DATA_ID)
-      {
-         //The first byte of script write is the id of the message being written, not the channel, and it is not overwritten but it is returned with the burst mask, so we need to ensure that is what we are looking for
-         aucDesiredData[ANT_DATA_CHANNEL_NUM_OFFSET] &= 0x1F;
-      }
-
-      pclCommandResponse = new ANTMessageResponse();
-      pclCommandResponse->Attach(MESG_RESPONSE_EVENT_ID, aucDesiredData, bytesToMatch, this);
+      pclCommandResponse = clCommandLease.Acquire();
+      AttachCommandResponse(pclCommandResponse, pstANTMessage_);
    }
 
    // Write the command message.
@@ -2347,12 +3347,6 @@ BOOL DSIFramerANT::SendCommand(ANT_MESSAGE *pstANTMessage_, USHORT usMessageSize
          DSIDebug::ThreadWrite("Framer->SendCommand():  WriteMessage Failed.");
       #endif
 
-      if(pclCommandResponse != NULL)
-      {
-         delete pclCommandResponse;
-         pclCommandResponse = (ANTMessageResponse*)NULL;
-      }
-
       return FALSE;
    }
 
@@ -2369,7 +3363,6 @@ BOOL DSIFramerANT::SendCommand(ANT_MESSAGE *pstANTMessage_, USHORT usMessageSize
    //if (pclCommandResponse->stMessageItem.ucSize == 0)
    if (pclCommandResponse->bResponseReady == FALSE)
    {
-      delete pclCommandResponse;
       #if defined(DEBUG_FILE)
          DSIDebug::ThreadWrite("Framer->SendCommand():  Timeout.");
       #endif
@@ -2379,22 +3372,317 @@ BOOL DSIFramerANT::SendCommand(ANT_MESSAGE *pstANTMessage_, USHORT usMessageSize
    // Check the response.
    if (pclCommandResponse->stMessageItem.stANTMessage.aucData[ANT_DATA_EVENT_CODE_OFFSET] != RESPONSE_NO_ERROR)
    {
-      delete pclCommandResponse;
       #if defined(DEBUG_FILE)
          DSIDebug::ThreadWrite("Framer->SendCommand():  Response != RESPONSE_NO_ERROR.");
       #endif
       return FALSE;
    }
 
-   delete pclCommandResponse;
    return TRUE;
 }
 
+///////////////////////////////////////////////////////////////////////
+BOOL DSIFramerANT::SendCommandAsync(ANT_MESSAGE *pstANTMessage_, USHORT usMessageSize_, ANTCommandToken *pclToken_)
+{
+   if (pclToken_ == NULL)
+      return FALSE;
+
+   ForgetChannelConfig(pstANTMessage_);
+
+   // The response has to be attached before the command is written.
+   AttachCommandResponse(pclToken_->Bind(this), pstANTMessage_);
+
+   if (!WriteMessage(pstANTMessage_, usMessageSize_))
+   {
+      #if defined(DEBUG_FILE)
+         DSIDebug::ThreadWrite("Framer->SendCommandAsync():  WriteMessage Failed.");
+      #endif
+
+      pclToken_->Cancel();
+      return FALSE;
+   }
+
+   return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////
+// Sets up a response to match the response event to a command.
+///////////////////////////////////////////////////////////////////////
+void DSIFramerANT::AttachCommandResponse(ANTMessageResponse *pclResponse_, ANT_MESSAGE *pstANTMessage_)
+{
+   UCHAR aucDesiredData[2];
+   UCHAR bytesToMatch = 2;
+
+   aucDesiredData[ANT_DATA_CHANNEL_NUM_OFFSET] = pstANTMessage_->aucData[ANT_DATA_CHANNEL_NUM_OFFSET];
+   aucDesiredData[ANT_DATA_EVENT_ID_OFFSET] = pstANTMessage_->ucMessageID;
+
+   //Script dump success can be determined by looking for the script cmd 0x04 dump complete code
+   if(pstANTMessage_->ucMessageID == MESG_SCRIPT_CMD_ID && pstANTMessage_->aucData[ANT_DATA_EVENT_ID_OFFSET] == SCRIPT_CMD_DUMP)
+   {
+      aucDesiredData[ANT_DATA_CHANNEL_NUM_OFFSET] = SCRIPT_CMD_END_DUMP;
+      bytesToMatch = 1; //The second byte is the number of commands returned, which we can't guess so only match the first byte
+   }
+   else if(pstANTMessage_->ucMessageID == MESG_SCRIPT_DATA_ID)
+   {
+      //The first byte of script write is the id of the message being written, not the channel, and it is not overwritten but it is returned with the burst mask, so we need to ensure that is what we are looking for
+      aucDesiredData[ANT_DATA_CHANNEL_NUM_OFFSET] &= 0x1F;
+   }
+
+   pclResponse_->Attach(MESG_RESPONSE_EVENT_ID, aucDesiredData, bytesToMatch, this);
+}
+
+///////////////////////////////////////////////////////////////////////
+// Writes one step of ConfigureChannel().
+///////////////////////////////////////////////////////////////////////
+BOOL DSIFramerANT::SendConfigStep(UCHAR ucStep_, UCHAR ucANTChannel_, const ANT_CHANNEL_CONFIG *pstConfig_, ANTCommandToken *pclToken_)
+{
+   ANT_MESSAGE stMessage;
+
+   switch ((ULONG)1 << ucStep_)
+   {
+      case ANT_CHANNEL_CONFIG_NETWORK_KEY:
+         return SetNetworkKeyAsync(pstConfig_->ucNetworkNumber, (UCHAR*)pstConfig_->aucNetworkKey, pclToken_);
+
+      case ANT_CHANNEL_CONFIG_ASSIGN:
+         if (pstConfig_->ucExtendedAssign == 0)
+            return AssignChannelAsync(ucANTChannel_, pstConfig_->ucChannelType, pstConfig_->ucNetworkNumber, pclToken_);
+
+         stMessage.ucMessageID = MESG_ASSIGN_CHANNEL_ID;
+         stMessage.aucData[0] = ucANTChannel_;
+         stMessage.aucData[1] = pstConfig_->ucChannelType;
+         stMessage.aucData[2] = pstConfig_->ucNetworkNumber;
+         stMessage.aucData[3] = pstConfig_->ucExtendedAssign;
+         return SendCommandAsync(&stMessage, MESG_ASSIGN_CHANNEL_SIZE + 1, pclToken_);
+
+      case ANT_CHANNEL_CONFIG_CHANNEL_ID:
+         return SetChannelIDAsync(ucANTChannel_, pstConfig_->usDeviceNumber, pstConfig_->ucDeviceType, pstConfig_->ucTransmitType, pclToken_);
+
+      case ANT_CHANNEL_CONFIG_PERIOD:
+         return SetChannelPeriodAsync(ucANTChannel_, pstConfig_->usMessagePeriod, pclToken_);
+
+      case ANT_CHANNEL_CONFIG_RF_FREQUENCY:
+         return SetChannelRFFrequencyAsync(ucANTChannel_, pstConfig_->ucRFFrequency, pclToken_);
+
+      case ANT_CHANNEL_CONFIG_SEARCH_TIMEOUT:
+         return SetChannelSearchTimeoutAsync(ucANTChannel_, pstConfig_->ucSearchTimeout, pclToken_);
+
+      case ANT_CHANNEL_CONFIG_LP_SEARCH_TIMEOUT:
+         return SetLowPriorityChannelSearchTimeoutAsync(ucANTChannel_, pstConfig_->ucLowPrioritySearchTimeout, pclToken_);
+
+      case ANT_CHANNEL_CONFIG_RSSI_THRESHOLD:
+         return SetRSSISearchThresholdAsync(ucANTChannel_, pstConfig_->ucRSSIThreshold, pclToken_);
+
+      case ANT_CHANNEL_CONFIG_PROXIMITY_SEARCH:
+         return SetProximitySearchAsync(ucANTChannel_, pstConfig_->ucProximityThreshold, pclToken_);
+
+      case ANT_CHANNEL_CONFIG_OPEN:
+         return OpenChannelAsync(ucANTChannel_, pclToken_);
+
+      default:
+         return FALSE;
+   }
+}
+
+///////////////////////////////////////////////////////////////////////
+// Returns the ANT_CHANNEL_CONFIG_ flags of the settings in pstConfig_
+// the device is known to have already.  A channel that will be
+// assigned again loses everything else.
+///////////////////////////////////////////////////////////////////////
+ULONG DSIFramerANT::MatchChannelConfig(UCHAR ucANTChannel_, const ANT_CHANNEL_CONFIG *pstConfig_)
+{
+   ULONG ulKnown = 0;
+
+   DSIThread_MutexLock(&stMutexCriticalSection);
+
+   if ((pstConfig_->ucNetworkNumber < DSI_FRAMER_ANT_CONFIG_NETWORKS) &&
+       (ucNetworkKeysKnown & (1 << pstConfig_->ucNetworkNumber)) &&
+       (memcmp(aaucNetworkKey[pstConfig_->ucNetworkNumber], pstConfig_->aucNetworkKey, 8) == 0))
+   {
+      ulKnown |= ANT_CHANNEL_CONFIG_NETWORK_KEY;
+   }
+
+   if (ucANTChannel_ < DSI_FRAMER_ANT_CONFIG_CHANNELS)
+   {
+      const ANT_CHANNEL_CONFIG *pstKnown = &astChannelConfig[ucANTChannel_];
+      ULONG ulChannelKnown = 0;
+
+      if ((pstKnown->ucChannelType == pstConfig_->ucChannelType) &&
+          (pstKnown->ucNetworkNumber == pstConfig_->ucNetworkNumber) &&
+          (pstKnown->ucExtendedAssign == pstConfig_->ucExtendedAssign))
+         ulChannelKnown |= ANT_CHANNEL_CONFIG_ASSIGN;
+
+      if ((pstKnown->usDeviceNumber == pstConfig_->usDeviceNumber) &&
+          (pstKnown->ucDeviceType == pstConfig_->ucDeviceType) &&
+          (pstKnown->ucTransmitType == pstConfig_->ucTransmitType))
+         ulChannelKnown |= ANT_CHANNEL_CONFIG_CHANNEL_ID;
+
+      if (pstKnown->usMessagePeriod == pstConfig_->usMessagePeriod)
+         ulChannelKnown |= ANT_CHANNEL_CONFIG_PERIOD;
+
+      if (pstKnown->ucRFFrequency == pstConfig_->ucRFFrequency)
+         ulChannelKnown |= ANT_CHANNEL_CONFIG_RF_FREQUENCY;
+
+      if (pstKnown->ucSearchTimeout == pstConfig_->ucSearchTimeout)
+         ulChannelKnown |= ANT_CHANNEL_CONFIG_SEARCH_TIMEOUT;
+
+      if (pstKnown->ucLowPrioritySearchTimeout == pstConfig_->ucLowPrioritySearchTimeout)
+         ulChannelKnown |= ANT_CHANNEL_CONFIG_LP_SEARCH_TIMEOUT;
+
+      if (pstKnown->ucRSSIThreshold == pstConfig_->ucRSSIThreshold)
+         ulChannelKnown |= ANT_CHANNEL_CONFIG_RSSI_THRESHOLD;
+
+      ulChannelKnown &= pstKnown->ulFields;
+
+      // Assigning the channel again resets the rest of its settings.
+      if ((pstConfig_->ulFields & ANT_CHANNEL_CONFIG_ASSIGN) && !(ulChannelKnown & ANT_CHANNEL_CONFIG_ASSIGN))
+         ulChannelKnown = 0;
+
+      ulKnown |= ulChannelKnown;
+   }
+
+   DSIThread_MutexUnlock(&stMutexCriticalSection);
+
+   return ulKnown & ~CHANNEL_CONFIG_NEVER_KNOWN;
+}
+
+///////////////////////////////////////////////////////////////////////
+// Records the settings in ulFields_ as applied to the device.
+///////////////////////////////////////////////////////////////////////
+void DSIFramerANT::RememberChannelConfig(UCHAR ucANTChannel_, const ANT_CHANNEL_CONFIG *pstConfig_, ULONG ulFields_)
+{
+   DSIThread_MutexLock(&stMutexCriticalSection);
+
+   if ((ulFields_ & ANT_CHANNEL_CONFIG_NETWORK_KEY) && (pstConfig_->ucNetworkNumber < DSI_FRAMER_ANT_CONFIG_NETWORKS))
+   {
+      memcpy(aaucNetworkKey[pstConfig_->ucNetworkNumber], pstConfig_->aucNetworkKey, 8);
+      ucNetworkKeysKnown |= (UCHAR)(1 << pstConfig_->ucNetworkNumber);
+   }
+
+   // A wildcard channel ID is filled in by the device once it finds a match.
+   if ((pstConfig_->usDeviceNumber == 0) || (pstConfig_->ucDeviceType == 0) || (pstConfig_->ucTransmitType == 0))
+      ulFields_ &= ~ANT_CHANNEL_CONFIG_CHANNEL_ID;
+
+   ulFields_ &= ~(ANT_CHANNEL_CONFIG_NETWORK_KEY | CHANNEL_CONFIG_NEVER_KNOWN);
+
+   if ((ucANTChannel_ < DSI_FRAMER_ANT_CONFIG_CHANNELS) && (ulFields_ != 0))
+   {
+      ANT_CHANNEL_CONFIG *pstKnown = &astChannelConfig[ucANTChannel_];
+
+      if (ulFields_ & ANT_CHANNEL_CONFIG_ASSIGN)
+      {
+         pstKnown->ucChannelType = pstConfig_->ucChannelType;
+         pstKnown->ucNetworkNumber = pstConfig_->ucNetworkNumber;
+         pstKnown->ucExtendedAssign = pstConfig_->ucExtendedAssign;
+      }
+
+      if (ulFields_ & ANT_CHANNEL_CONFIG_CHANNEL_ID)
+      {
+         pstKnown->usDeviceNumber = pstConfig_->usDeviceNumber;
+         pstKnown->ucDeviceType = pstConfig_->ucDeviceType;
+         pstKnown->ucTransmitType = pstConfig_->ucTransmitType;
+      }
+
+      if (ulFields_ & ANT_CHANNEL_CONFIG_PERIOD)
+         pstKnown->usMessagePeriod = pstConfig_->usMessagePeriod;
+
+      if (ulFields_ & ANT_CHANNEL_CONFIG_RF_FREQUENCY)
+         pstKnown->ucRFFrequency = pstConfig_->ucRFFrequency;
+
+      if (ulFields_ & ANT_CHANNEL_CONFIG_SEARCH_TIMEOUT)
+         pstKnown->ucSearchTimeout = pstConfig_->ucSearchTimeout;
+
+      if (ulFields_ & ANT_CHANNEL_CONFIG_LP_SEARCH_TIMEOUT)
+         pstKnown->ucLowPrioritySearchTimeout = pstConfig_->ucLowPrioritySearchTimeout;
+
+      if (ulFields_ & ANT_CHANNEL_CONFIG_RSSI_THRESHOLD)
+         pstKnown->ucRSSIThreshold = pstConfig_->ucRSSIThreshold;
+
+      pstKnown->ulFields |= ulFields_;
+   }
+
+   DSIThread_MutexUnlock(&stMutexCriticalSection);
+}
+
+///////////////////////////////////////////////////////////////////////
+// Drops what ConfigureChannel() knows about the setting a command is
+// about to change.  Called for every command, before it is written.
+///////////////////////////////////////////////////////////////////////
+void DSIFramerANT::ForgetChannelConfig(const ANT_MESSAGE *pstANTMessage_)
+{
+   UCHAR ucNumber = pstANTMessage_->aucData[0];                         // Channel, or network for a network key
+   ULONG ulFields;
+
+   switch (pstANTMessage_->ucMessageID)
+   {
+      case MESG_NETWORK_KEY_ID:
+         if (ucNumber < DSI_FRAMER_ANT_CONFIG_NETWORKS)
+         {
+            DSIThread_MutexLock(&stMutexCriticalSection);
+            ucNetworkKeysKnown &= (UCHAR)~(1 << ucNumber);
+            DSIThread_MutexUnlock(&stMutexCriticalSection);
+         }
+         return;
+
+      case MESG_ASSIGN_CHANNEL_ID:
+      case MESG_UNASSIGN_CHANNEL_ID:
+         ulFields = MAX_ULONG;
+         break;
+
+      case MESG_CHANNEL_ID_ID:
+         ulFields = ANT_CHANNEL_CONFIG_CHANNEL_ID;
+         break;
+
+      case MESG_CHANNEL_MESG_PERIOD_ID:
+         ulFields = ANT_CHANNEL_CONFIG_PERIOD;
+         break;
+
+      case MESG_CHANNEL_RADIO_FREQ_ID:
+         ulFields = ANT_CHANNEL_CONFIG_RF_FREQUENCY;
+         break;
+
+      case MESG_CHANNEL_SEARCH_TIMEOUT_ID:
+         ulFields = ANT_CHANNEL_CONFIG_SEARCH_TIMEOUT;
+         break;
+
+      case MESG_SET_LP_SEARCH_TIMEOUT_ID:
+         ulFields = ANT_CHANNEL_CONFIG_LP_SEARCH_TIMEOUT;
+         break;
+
+      case MESG_RSSI_SEARCH_THRESHOLD_ID:
+         ulFields = ANT_CHANNEL_CONFIG_RSSI_THRESHOLD;
+         break;
+
+      default:
+         return;
+   }
+
+   if (ucNumber >= DSI_FRAMER_ANT_CONFIG_CHANNELS)
+      return;
+
+   DSIThread_MutexLock(&stMutexCriticalSection);
+   astChannelConfig[ucNumber].ulFields &= ~ulFields;
+   DSIThread_MutexUnlock(&stMutexCriticalSection);
+}
+
+///////////////////////////////////////////////////////////////////////
+void DSIFramerANT::ForgetAllChannelConfig(void)
+{
+   DSIThread_MutexLock(&stMutexCriticalSection);
+
+   for (UCHAR i = 0; i < DSI_FRAMER_ANT_CONFIG_CHANNELS; i++)
+      astChannelConfig[i].ulFields = 0;
+
+   ucNetworkKeysKnown = 0;
+
+   DSIThread_MutexUnlock(&stMutexCriticalSection);
+}
+
 ///////////////////////////////////////////////////////////////////////
 BOOL DSIFramerANT::SendRequest(UCHAR ucRequestedMesgID_, UCHAR ucANTChannel_ , ANT_MESSAGE_ITEM *pstANTResponse_, ULONG ulResponseTime_)
 {
    ANT_MESSAGE stMessage;
    ANTMessageResponse *pclRequestResponse = (ANTMessageResponse*)NULL;
+   ANTResponseLease clRequestLease(this);
 
    // Build the request message
    stMessage.ucMessageID = MESG_REQUEST_ID;
@@ -2404,18 +3692,13 @@ BOOL DSIFramerANT::SendRequest(UCHAR ucRequestedMesgID_, UCHAR ucANTChannel_ , A
    // If we are going to be waiting for a response setup the Response object
    if ((ulResponseTime_ != 0) && (pstANTResponse_ != NULL))
    {
-      pclRequestResponse = new ANTMessageResponse();
+      pclRequestResponse = clRequestLease.Acquire();
      pclRequestResponse->Attach(ucRequestedMesgID_, (UCHAR*)NULL, 0, this);
    }
 
    // Write the command message.
    if (!WriteMessage(&stMessage, MESG_REQUEST_SIZE))
    {
-      if(pclRequestResponse != NULL)
-      {
-         delete pclRequestResponse;
-         pclRequestResponse = (ANTMessageResponse*)NULL;
-      }
       return FALSE;
    }
 
@@ -2431,7 +3714,6 @@ BOOL DSIFramerANT::SendRequest(UCHAR ucRequestedMesgID_, UCHAR ucANTChannel_ , A
    // We haven't received a response in the allotted time.
    if (pclRequestResponse->bResponseReady == FALSE)
    {
-      delete pclRequestResponse;
       return FALSE;
    }
 
@@ -2440,7 +3722,6 @@ BOOL DSIFramerANT::SendRequest(UCHAR ucRequestedMesgID_, UCHAR ucANTChannel_ , A
    pstANTResponse_->stANTMessage.ucMessageID = pclRequestResponse->stMessageItem.stANTMessage.ucMessageID;
    memcpy (pstANTResponse_->stANTMessage.aucData, pclRequestResponse->stMessageItem.stANTMessage.aucData, pclRequestResponse->stMessageItem.ucSize);
 
-   delete pclRequestResponse;
    return TRUE;
 }
 
@@ -2449,6 +3730,7 @@ BOOL DSIFramerANT::SendUserNvmRequest(UCHAR ucRequestedMesgID_, UCHAR ucANTChann
 {
    ANT_MESSAGE stMessage;
    ANTMessageResponse *pclRequestResponse = (ANTMessageResponse*)NULL;
+   ANTResponseLease clRequestLease(this);
 
    // Build the request message
    stMessage.ucMessageID = MESG_REQUEST_ID;
@@ -2461,18 +3743,13 @@ BOOL DSIFramerANT::SendUserNvmRequest(UCHAR ucRequestedMesgID_, UCHAR ucANTChann
    // If we are going to be waiting for a response setup the Response object
    if ((ulResponseTime_ != 0) && (pstANTResponse_ != NULL))
    {
-      pclRequestResponse = new ANTMessageResponse();
+      pclRequestResponse = clRequestLease.Acquire();
       pclRequestResponse->Attach(ucRequestedMesgID_, (UCHAR*)NULL, 0, this);
    }
 
    // Write the command message.
    if (!WriteMessage(&stMessage, MESG_REQUEST_USER_NVM_SIZE))
    {
-      if(pclRequestResponse != NULL)
-      {
-         delete pclRequestResponse;
-         pclRequestResponse = (ANTMessageResponse*)NULL;
-      }
       return FALSE;
    }
 
@@ -2488,7 +3765,6 @@ BOOL DSIFramerANT::SendUserNvmRequest(UCHAR ucRequestedMesgID_, UCHAR ucANTChann
    // We haven't received a response in the allotted time.
    if (pclRequestResponse->bResponseReady == FALSE)
    {
-      delete pclRequestResponse;
       return FALSE;
    }
 
@@ -2497,7 +3773,6 @@ BOOL DSIFramerANT::SendUserNvmRequest(UCHAR ucRequestedMesgID_, UCHAR ucANTChann
    pstANTResponse_->stANTMessage.ucMessageID = pclRequestResponse->stMessageItem.stANTMessage.ucMessageID;
    memcpy (pstANTResponse_->stANTMessage.aucData, pclRequestResponse->stMessageItem.stANTMessage.aucData, pclRequestResponse->stMessageItem.ucSize);
 
-   delete pclRequestResponse;
    return TRUE;
 }
 
@@ -2579,6 +3854,7 @@ ANTMessageResponse::ANTMessageResponse()
    bResponseReady = FALSE;
    pclNext = (ANTMessageResponse*)NULL;
    pclFramer = (DSIFramerANT*)NULL;
+   pclToken = (ANTCommandToken*)NULL;
    if (DSIThread_CondInit(pstCondResponseReady) != DSI_THREAD_ENONE)                       //Init the wait object
       return; //need to think of a different way to handle the failure
 }
@@ -2593,7 +3869,9 @@ ANTMessageResponse::~ANTMessageResponse()
 ///////////////////////////////////////////////////////////////////////
 BOOL ANTMessageResponse::Attach(UCHAR ucMessageID_, UCHAR *pucData_, UCHAR ucBytesToMatch_, DSIFramerANT * pclFramer_, DSI_CONDITION_VAR *pstCondResponseReady_)
 {
-   ANTMessageResponse *pclResponse;
+   ANTMessageResponse **ppclResponse;
+
+   Remove();                                                                               // In case we are still attached from an earlier request
 
    bResponseReady = FALSE;                                                                 //Init ResponseReady
    stMessageItem.stANTMessage.ucMessageID = ucMessageID_;                                  //Set mesg ID to look for
@@ -2612,23 +3890,20 @@ BOOL ANTMessageResponse::Attach(UCHAR ucMessageID_, UCHAR *pucData_, UCHAR ucByt
    if (pclFramer == NULL)
       return FALSE;
 
+   if (ucBytesToMatch_ == 0)
+      ucBucket = GetResponseBucket(ucMessageID_, RESPONSE_ANY_CHANNEL);
+   else
+      ucBucket = GetResponseBucket(ucMessageID_, pucData_[0]);
+
    DSIThread_MutexLock(&(pclFramer->stMutexResponseRequest));                              // Lock the mutex and begin list manipulation
 
-   pclResponse = pclFramer->pclResponseListStart;
+   ppclResponse = &(pclFramer->apclResponseIndex[ucBucket]);                               // Add ourself to the end of our bucket, so the oldest request is matched first
+   while (*ppclResponse != NULL)
+      ppclResponse = &((*ppclResponse)->pclNext);
 
-   if (pclFramer->pclResponseListStart == NULL)                                            // Check if the list is empty
-   {
-      pclFramer->pclResponseListStart = this;                                              // Add this reponse object to the list
-   }
-   else
-   {
-      pclResponse = pclFramer->pclResponseListStart;                                       // If the list is not empty, walk through the list
-     while (pclResponse->pclNext != NULL)
-      {
-         pclResponse = pclResponse->pclNext;
-      }
-     pclResponse->pclNext = this;                                                          // Add ourself to the end of the list
-   }
+   pclNext = (ANTMessageResponse*)NULL;
+   *ppclResponse = this;
+   pclFramer->ulResponseCount++;
 
    DSIThread_MutexUnlock(&(pclFramer->stMutexResponseRequest));                            // Unlock mutex when we're done
 
@@ -2646,26 +3921,47 @@ void ANTMessageResponse::Remove()
 
    DSIThread_MutexLock(&(pclFramer->stMutexResponseRequest));                              // Lock the mutex and begin list manipulation
 
-   ppclResponse = &(pclFramer->pclResponseListStart);                                      // Set the ppointer to point to pclResponseListStart
+   ppclResponse = &(pclFramer->apclResponseIndex[ucBucket]);                               // Set the ppointer to point to the head of our bucket
 
    while (*ppclResponse != NULL)                                                           // While the pclNext is not NULL
    {
       if (*ppclResponse == this)                                                           // Check if pclNext is pointing to us
-     {
-        *ppclResponse = pclNext;                                                       // Remove this object from the List by changing the pointer to point to the element behind us
+      {
+         *ppclResponse = pclNext;                                                          // Remove this object from the List by changing the pointer to point to the element behind us
+         pclNext = (ANTMessageResponse*)NULL;
+         pclFramer->ulResponseCount--;
+         break;
+      }
 
-       if (pclNext == NULL)                                                              // If we are at the end of the list, then break because we are done.
-           break;
-     }
-     else
-     {
-        ppclResponse = &((*ppclResponse)->pclNext);                                       // Advance the ppointer to point to the pclNext element of the next object in the list
-     }
+      ppclResponse = &((*ppclResponse)->pclNext);                                          // Advance the ppointer to point to the pclNext element of the next object in the list
    }
 
    DSIThread_MutexUnlock(&(pclFramer->stMutexResponseRequest));                            // Unlock mutex when we're done
 }
 
+///////////////////////////////////////////////////////////////////////
+ANTResponseLease::ANTResponseLease(DSIFramerANT *pclFramer_)
+{
+   pclFramer = pclFramer_;
+   pclResponse = (ANTMessageResponse*)NULL;
+}
+
+///////////////////////////////////////////////////////////////////////
+ANTResponseLease::~ANTResponseLease()
+{
+   if (pclResponse != NULL)
+      pclFramer->ReleaseResponse(pclResponse);
+}
+
+///////////////////////////////////////////////////////////////////////
+ANTMessageResponse* ANTResponseLease::Acquire()
+{
+   if (pclResponse == NULL)
+      pclResponse = pclFramer->AcquireResponse();
+
+   return pclResponse;
+}
+
 ///////////////////////////////////////////////////////////////////////
 BOOL ANTMessageResponse::WaitForResponse(ULONG ulMilliseconds_)
 {
@@ -2681,3 +3977,141 @@ BOOL ANTMessageResponse::WaitForResponse(ULONG ulMilliseconds_)
    return bResponseReady;
 }
 
+///////////////////////////////////////////////////////////////////////
+ANTCommandToken::ANTCommandToken()
+{
+   pclFramer = (DSIFramerANT*)NULL;
+   pclResponse = (ANTMessageResponse*)NULL;
+   pfCallback = (ANT_COMMAND_CALLBACK)NULL;
+   pvCallbackParameter = NULL;
+   pclNextCompleted = (ANTCommandToken*)NULL;
+}
+
+///////////////////////////////////////////////////////////////////////
+ANTCommandToken::~ANTCommandToken()
+{
+   Cancel();
+}
+
+///////////////////////////////////////////////////////////////////////
+void ANTCommandToken::SetCallback(ANT_COMMAND_CALLBACK pfCallback_, void *pvParameter_)
+{
+   pfCallback = pfCallback_;
+   pvCallbackParameter = pvParameter_;
+}
+
+///////////////////////////////////////////////////////////////////////
+BOOL ANTCommandToken::IsPending()
+{
+   return ((pclResponse != NULL) && (pclResponse->bResponseReady == FALSE));
+}
+
+///////////////////////////////////////////////////////////////////////
+BOOL ANTCommandToken::IsComplete()
+{
+   return ((pclResponse != NULL) && (pclResponse->bResponseReady == TRUE));
+}
+
+///////////////////////////////////////////////////////////////////////
+BOOL ANTCommandToken::Wait(ULONG ulMilliseconds_)
+{
+   if (pclResponse == NULL)
+      return FALSE;
+
+   return pclResponse->WaitForResponse(ulMilliseconds_);
+}
+
+///////////////////////////////////////////////////////////////////////
+BOOL ANTCommandToken::Succeeded()
+{
+   const ANT_MESSAGE_ITEM *pstResponse = GetResponse();
+
+   if (pstResponse == NULL)
+      return FALSE;
+
+   return (pstResponse->stANTMessage.aucData[ANT_DATA_EVENT_CODE_OFFSET] == RESPONSE_NO_ERROR);
+}
+
+///////////////////////////////////////////////////////////////////////
+const ANT_MESSAGE_ITEM* ANTCommandToken::GetResponse()
+{
+   if (IsComplete() == FALSE)
+      return (const ANT_MESSAGE_ITEM*)NULL;
+
+   return &(pclResponse->stMessageItem);
+}
+
+///////////////////////////////////////////////////////////////////////
+void ANTCommandToken::Cancel()
+{
+   if (pclResponse == NULL)
+      return;
+
+   pclFramer->CancelToken(this);
+   pclResponse = (ANTMessageResponse*)NULL;
+}
+
+///////////////////////////////////////////////////////////////////////
+// Takes a response from the framer to track a new command.
+///////////////////////////////////////////////////////////////////////
+ANTMessageResponse* ANTCommandToken::Bind(DSIFramerANT *pclFramer_)
+{
+   Cancel();
+
+   pclFramer = pclFramer_;
+   pclResponse = pclFramer->AcquireResponse();
+   pclResponse->pclToken = this;
+
+   return pclResponse;
+}
+
+///////////////////////////////////////////////////////////////////////
+// Called by the framer on its receive thread, with no locks held, once
+// the response has been copied in.
+///////////////////////////////////////////////////////////////////////
+void ANTCommandToken::Complete()
+{
+   if (pfCallback != NULL)
+      pfCallback(this, pvCallbackParameter);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////
+// Private Functions
+//////////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////
+static UCHAR GetResponseBucket(UCHAR ucMessageID_, USHORT usChannel_)
+{
+   return (UCHAR)(((ucMessageID_ * 7) + (usChannel_ * 3)) % DSI_FRAMER_ANT_RESPONSE_BUCKETS);
+}
+
+///////////////////////////////////////////////////////////////////////
+// Command responses and requested messages go in the priority queue.
+// Channel data and channel events do not: a processor needs an event
+// such as EVENT_TRANSFER_RX_FAILED after the data that came before it.
+///////////////////////////////////////////////////////////////////////
+static BOOL IsPriorityMessage(UCHAR ucMessageID_, const UCHAR *pucData_)
+{
+   switch (ucMessageID_)
+   {
+      case MESG_RESPONSE_EVENT_ID:
+         return (pucData_[ANT_DATA_EVENT_ID_OFFSET] != MESG_EVENT_ID);
+
+      case MESG_BROADCAST_DATA_ID:
+      case MESG_ACKNOWLEDGED_DATA_ID:
+      case MESG_BURST_DATA_ID:
+      case MESG_EXT_BROADCAST_DATA_ID:
+      case MESG_EXT_ACKNOWLEDGED_DATA_ID:
+      case MESG_EXT_BURST_DATA_ID:
+      case MESG_ADV_BURST_DATA_ID:
+      case MESG_RSSI_BROADCAST_DATA_ID:
+      case MESG_RSSI_ACKNOWLEDGED_DATA_ID:
+      case MESG_RSSI_BURST_DATA_ID:
+      case DSI_FRAMER_ANT_BURST_SEGMENT_ID:
+         return FALSE;
+
+      default:
+         return TRUE;
+   }
+}
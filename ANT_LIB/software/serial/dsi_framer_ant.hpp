@@ -26,9 +26,47 @@ All rights reserved.
 #define DSI_FRAMER_ANT_EINVALID_SIZE   ((UCHAR) 0x03)
 #define DSI_FRAMER_ANT_CRC_ERROR       ((UCHAR) 0x04)
 
+#define DSI_FRAMER_ANT_ITEM_ERROR      ((UCHAR) 0xFF)      // ANT_MESSAGE_ITEM.ucSize of an error returned by GetMessages().
+
 #define DSI_FRAMER_ANT_DEFAULT_RESPONSE_TIME ((ULONG) 1000)
 
 #define RX_FIFO_SIZE                   ((USHORT) 256)
+#define DSI_FRAMER_ANT_RX_SCAN_FRAMES  ((ULONG) 32)     // Frames picked out of a receive block per scanner pass.
+
+#define DSI_FRAMER_ANT_QUEUE_DEFAULT_SIZE ((ULONG) 131072)  // Bytes of received messages a framer holds by default.
+#define DSI_FRAMER_ANT_QUEUE_ITEM_HEADER  ((ULONG) 2)       // A queued message is its size, its ID and then its data.
+#define DSI_FRAMER_ANT_QUEUE_ITEM_MAX     (DSI_FRAMER_ANT_QUEUE_ITEM_HEADER + MESG_MAX_SIZE_VALUE)
+#define DSI_FRAMER_ANT_QUEUE_MIN_SIZE     (2 * DSI_FRAMER_ANT_QUEUE_ITEM_MAX)
+#define DSI_FRAMER_ANT_PRIORITY_QUEUE_SIZE ((ULONG) 32)     // Responses the priority queue holds before more go to the main queue.
+
+#define DSI_FRAMER_ANT_RESPONSE_BUCKETS   ((UCHAR) 32)      // Hash buckets for the responses being waited on.
+#define DSI_FRAMER_ANT_RESPONSE_POOL_SIZE ((UCHAR) 16)      // Response objects each framer keeps ready; more are allocated if needed.
+
+#define DSI_FRAMER_ANT_CONFIG_CHANNELS    ((UCHAR) 16)      // Channels whose settings ConfigureChannel() remembers.
+#define DSI_FRAMER_ANT_CONFIG_NETWORKS    ((UCHAR) 8)       // Networks whose keys ConfigureChannel() remembers.
+
+// Settings in an ANT_CHANNEL_CONFIG, in the order ConfigureChannel() sends them.
+#define ANT_CHANNEL_CONFIG_NETWORK_KEY         ((ULONG) 0x00000001)
+#define ANT_CHANNEL_CONFIG_ASSIGN              ((ULONG) 0x00000002)
+#define ANT_CHANNEL_CONFIG_CHANNEL_ID          ((ULONG) 0x00000004)
+#define ANT_CHANNEL_CONFIG_PERIOD              ((ULONG) 0x00000008)
+#define ANT_CHANNEL_CONFIG_RF_FREQUENCY        ((ULONG) 0x00000010)
+#define ANT_CHANNEL_CONFIG_SEARCH_TIMEOUT      ((ULONG) 0x00000020)
+#define ANT_CHANNEL_CONFIG_LP_SEARCH_TIMEOUT   ((ULONG) 0x00000040)
+#define ANT_CHANNEL_CONFIG_RSSI_THRESHOLD      ((ULONG) 0x00000080)
+#define ANT_CHANNEL_CONFIG_PROXIMITY_SEARCH    ((ULONG) 0x00000100)
+#define ANT_CHANNEL_CONFIG_OPEN                ((ULONG) 0x00000200)
+#define ANT_CHANNEL_CONFIG_STEPS               ((UCHAR) 10)
+
+#define DSI_FRAMER_ANT_BURST_SEGMENT_ID      ((UCHAR) 0xFE)     // Message ID of an advanced burst segment; made by the framer, never sent by ANT.
+#define DSI_FRAMER_ANT_BURST_SEGMENT_SIZE    ((UCHAR) 7)        // Channel and sequence, position in the channel's buffer, length, and buffer generation.
+#define DSI_FRAMER_ANT_BURST_BUFFER_DEFAULT  ((ULONG) 65536)    // Bytes of advanced burst data kept per channel when assembling.
+#define DSI_FRAMER_ANT_BURST_CHANNELS        ((UCHAR) (CHANNEL_NUMBER_MASK + 1))
+
+#define DSI_FRAMER_ANT_TX_BATCH_DEFAULT ((UCHAR) 8)      // Burst packets framed into a single serial write.
+#define DSI_FRAMER_ANT_TX_BATCH_MAX     ((UCHAR) 16)
+#define DSI_FRAMER_ANT_BURST_PARTS      ((UCHAR) 3)      // Header, data and footer of an ANT-FS transfer.
+#define ANT_TX_FRAME_MAX_SIZE          (MESG_MAX_SIZE_VALUE + MESG_FRAME_SIZE + 2)  // Largest framed message, including the two pad bytes.
 
 typedef struct ANT_MESSAGE
 {
@@ -42,6 +80,58 @@ typedef struct
    ANT_MESSAGE stANTMessage;
 } ANT_MESSAGE_ITEM;
 
+typedef struct
+{
+   UCHAR ucSize;                                            // As ANT_MESSAGE_ITEM.
+   const ANT_MESSAGE *pstANTMessage;                        // Stays valid until ConsumeMessage().
+} ANT_MESSAGE_VIEW;
+
+typedef struct
+{
+   UCHAR ucChannel;
+   UCHAR ucParts;
+   UCHAR *apucPart[DSI_FRAMER_ANT_BURST_PARTS];             // Sent back to back, each padded out to a whole packet.
+   ULONG aulPartSize[DSI_FRAMER_ANT_BURST_PARTS];
+   UCHAR ucPart;                                            // The next packet starts ulOffset bytes into part ucPart.
+   ULONG ulOffset;
+   UCHAR ucSequence;                                        // Sequence bits of the next packet.
+} ANT_TX_BURST;
+
+typedef struct
+{
+   ULONG ulFields;                                          // ANT_CHANNEL_CONFIG_ flags of the settings to apply.
+   UCHAR ucNetworkNumber;                                   // Network for the key and the assignment.
+   UCHAR aucNetworkKey[8];
+   UCHAR ucChannelType;
+   UCHAR ucExtendedAssign;                                  // Extended assignment flags, 0 for a plain assignment.
+   USHORT usDeviceNumber;
+   UCHAR ucDeviceType;
+   UCHAR ucTransmitType;
+   USHORT usMessagePeriod;
+   UCHAR ucRFFrequency;
+   UCHAR ucSearchTimeout;
+   UCHAR ucLowPrioritySearchTimeout;
+   UCHAR ucRSSIThreshold;
+   UCHAR ucProximityThreshold;
+} ANT_CHANNEL_CONFIG;
+
+typedef struct
+{
+   ULONG ulSent;                                            // ANT_CHANNEL_CONFIG_ flags of the steps written.
+   ULONG ulSkipped;                                         // Steps left out because the device already had the setting.
+   ULONG ulFailed;                                          // Steps rejected, unanswered or not written.
+   ULONG aulLatency[ANT_CHANNEL_CONFIG_STEPS];              // Milliseconds from writing each step until its response was collected, 0 if none.
+} ANT_CHANNEL_CONFIG_RESULT;
+
+typedef struct
+{
+   ULONG ulBytes;                                           // Data in the transfer.
+   ULONG ulPackets;                                         // Burst messages written per attempt.
+   UCHAR ucAttempts;                                        // Times the transfer was started.
+   ULONG ulTime;                                            // Milliseconds the last attempt took.
+   ULONG ulBytesPerSecond;                                  // Throughput of the last attempt; 0 unless it was waited on and completed.
+} ANT_TRANSFER_STATS;
+
 typedef enum
 {
    ANTFRAMER_FAIL = 0,
@@ -65,6 +155,9 @@ typedef struct
 } FS_MESSAGE;
 
 class ANTMessageResponse;
+class ANTCommandToken;
+
+typedef void (*ANT_COMMAND_CALLBACK)(ANTCommandToken *pclToken_, void *pvParameter_);
 
 //////////////////////////////////////////////////////////////////////////////////
 // Public Class Prototypes
@@ -74,6 +167,8 @@ class DSIFramerANT : public DSIFramer
 {
    private:
       BOOL bSplitAdvancedBursts; //If this flag is set Advanced burst messages will be decomposed into simple burst messages.
+      BOOL bAssembleAdvancedBursts; //If this flag is set Advanced burst payloads are appended to per channel buffers and queued as segments.
+      UCHAR ucTxBatchSize; //Number of burst packets framed together before they are written to the serial device.
       UCHAR ucPrevSequenceNum; //Previous Sequence number, used for splitting advanced bursts.
 
    protected:
@@ -81,9 +176,22 @@ class DSIFramerANT : public DSIFramer
       UCHAR aucRxFifo[RX_FIFO_SIZE];
       UCHAR ucCheckSum;
       UCHAR ucRxSize;
-      USHORT usMessageHead;
-      USHORT usMessageTail;
-      ANT_MESSAGE_ITEM astMessageBuffer[65536];
+      UCHAR *pucMessageQueue;                               // Received messages, stored back to back at their actual length.
+      ULONG ulMessageQueueSize;
+      ULONG ulMessageHead;                                  // Offset the next message is written at.
+      ULONG ulMessageTail;                                  // Offset of the oldest message.
+      ULONG ulMessageWrap;                                  // End of the messages after the tail once the head has wrapped to the start.
+      ULONG ulMessageCount;
+      ULONG ulMessageBytes;
+      ULONG ulMessageHighWater;
+      ULONG ulErrorPosition;                                // Messages queued ahead of the pending error.
+      ULONG ulMessagesPeeked;                               // Oldest messages handed out by PeekMessage() or PeekMessages().
+      ANT_MESSAGE_ITEM astPriorityQueue[DSI_FRAMER_ANT_PRIORITY_QUEUE_SIZE];  // Command responses and requested messages, read ahead of the main queue.
+      ULONG ulPriorityTail;
+      ULONG ulPriorityCount;
+      ULONG ulPriorityPeeked;                               // Oldest priority messages handed out by PeekMessage() or PeekMessages().
+      BOOL bPriorityResponses;
+      ANT_MESSAGE stPeekError;
       UCHAR ucError;
       UCHAR ucSerialError;
 
@@ -95,17 +203,61 @@ class DSIFramerANT : public DSIFramer
       DSI_MUTEX stMutexCriticalSection;
       DSI_MUTEX stMutexResponseRequest;
       DSI_CONDITION_VAR stCondMessageReady;
+      DSI_CONDITION_VAR stCondPriorityReady;
       DSI_CONDITION_VAR stCondResponseReady;
 
-      ANTMessageResponse *pclResponseListStart;
+      ANTMessageResponse *apclResponseIndex[DSI_FRAMER_ANT_RESPONSE_BUCKETS];  // Responses being waited on, hashed on message ID and channel.
+      volatile ULONG ulResponseCount;                       // Number of responses attached; read without the lock.
+      ANTMessageResponse *pclResponsePool;                  // DSI_FRAMER_ANT_RESPONSE_POOL_SIZE objects, created with the framer.
+      ANTMessageResponse *apclFreeResponses[DSI_FRAMER_ANT_RESPONSE_POOL_SIZE];
+      UCHAR ucFreeResponses;
+      ANTCommandToken *pclCompletedTokens;                  // Tokens whose callbacks are waiting to run, oldest first.  Only the receive thread adds to it.
+      ANTCommandToken *pclCompletingToken;                  // Token whose callback is running.
+      DSI_THREAD_IDNUM hCompletingThread;
+      DSI_CONDITION_VAR stCondTokenIdle;                    // Signalled when a token callback returns.
+      ANT_CHANNEL_CONFIG astChannelConfig[DSI_FRAMER_ANT_CONFIG_CHANNELS];   // Settings the device is known to have; ulFields marks which.
+      UCHAR aaucNetworkKey[DSI_FRAMER_ANT_CONFIG_NETWORKS][8];
+      UCHAR ucNetworkKeysKnown;                             // Bit per network with a key in aaucNetworkKey.
+      UCHAR *apucBurstBuffer[DSI_FRAMER_ANT_BURST_CHANNELS]; // Advanced burst data per channel, allocated on the first segment.
+      ULONG aulBurstPosition[DSI_FRAMER_ANT_BURST_CHANNELS]; // Bytes written to each buffer, including any skipped to keep a segment whole.
+      ULONG ulBurstBufferSize;                              // A power of two.
+      UCHAR ucBurstGeneration;                              // Changed whenever the buffers are freed, so older segments are not read.
 
       USHORT GetMessageSize(void);
+      void ProcessRxByte(UCHAR ucByte_);
+      void CompleteRxMessage(BOOL bCheckSumOk_);
+      BOOL QueueRxMessage(UCHAR ucMessageID_, const UCHAR *pucData_, UCHAR ucSize_);
+      void DequeueRxMessage(void);
+      BOOL QueuePriorityMessage(UCHAR ucMessageID_, const UCHAR *pucData_, UCHAR ucSize_);
+      void DequeuePriorityMessage(void);
+      void ResetMessageQueue(void);
+      void RaiseError(UCHAR ucError_);
+      ULONG GetItemCount(void);
       void ProcessMessage(void);
+      BOOL QueueBurstSegment(const UCHAR *pucData_, UCHAR ucSize_);
+      void FreeBurstBuffers(void);
       void CheckResponseList(void);
+      BOOL MatchResponses(ANTMessageResponse *pclResponse_, BOOL bTokenMatched_);
+      void RunTokenCallbacks(void);
+      void CancelToken(ANTCommandToken *pclToken_);
+      ANTMessageResponse* AcquireResponse(void);
+      void ReleaseResponse(ANTMessageResponse *pclResponse_);
+      void DetachResponses(void);
+      void AttachCommandResponse(ANTMessageResponse *pclResponse_, ANT_MESSAGE *pstANTMessage_);
+      BOOL SendConfigStep(UCHAR ucStep_, UCHAR ucANTChannel_, const ANT_CHANNEL_CONFIG *pstConfig_, ANTCommandToken *pclToken_);
+      ULONG MatchChannelConfig(UCHAR ucANTChannel_, const ANT_CHANNEL_CONFIG *pstConfig_);
+      void RememberChannelConfig(UCHAR ucANTChannel_, const ANT_CHANNEL_CONFIG *pstConfig_, ULONG ulFields_);
+      void ForgetChannelConfig(const ANT_MESSAGE *pstANTMessage_);
+      void ForgetAllChannelConfig(void);
+      USHORT FrameMessage(UCHAR *pucTxFifo_, void *pvData_, USHORT usMessageSize_);
+      BOOL WriteFramedBytes(UCHAR *pucTxFifo_, USHORT usSize_);
+      static void AddBurstPart(ANT_TX_BURST *pstBurst_, UCHAR *pucData_, ULONG ulSize_);
+      BOOL FrameBurstWindow(ANT_TX_BURST *pstBurst_, ANT_MESSAGE *pstMessage_, UCHAR ucMaxDataSize_, UCHAR ucPackets_, UCHAR *pucWindow_, USHORT *pusWindowSize_, volatile ULONG *pulProgress_);
       BOOL SendCommand(ANT_MESSAGE *pstANTMessage_, USHORT usMessageSize_, ULONG ulResponseTime_ = 0);
       BOOL SendFSCommand(FS_MESSAGE *pstFSMessage_, USHORT usMessageSize_, UCHAR* pucFSResponse, ULONG ulResponseTime_ = 0);
       ANTFRAMER_RETURN SetupAckDataTransfer(UCHAR ucMessageID_, UCHAR ucANTChannel_, UCHAR *pucData_, UCHAR ucMaxDataSize_, ULONG ulResponseTime_  = 0);
-      ANTFRAMER_RETURN SetupBurstDataTransfer(UCHAR ucMessageID_, UCHAR ucANTChannel_, UCHAR * pucData_, ULONG ulSize_,UCHAR ucMaxDataSize_, ULONG ulResponseTime_ = 0);
+      ANTFRAMER_RETURN SetupBurstDataTransfer(UCHAR ucMessageID_, UCHAR ucANTChannel_, UCHAR * pucData_, ULONG ulSize_,UCHAR ucMaxDataSize_, ULONG ulResponseTime_ = 0, UCHAR ucRetries_ = 0, ANT_TRANSFER_STATS *pstStats_ = (ANT_TRANSFER_STATS*)NULL);
+      ANTFRAMER_RETURN SendBurst(UCHAR ucMessageID_, ANT_TX_BURST *pstBurst_, UCHAR ucMaxDataSize_, ULONG ulResponseTime_, UCHAR ucRetries_, BOOL bWaitForSync_, ANT_TRANSFER_STATS *pstStats_, volatile ULONG *pulProgress_);
       virtual BOOL CreateAntMsg_wOptExtBuf(ANT_MESSAGE **ppstExtBufAntMsg_, ULONG ulReqMinDataSize_);  ///Default implementation allocates a new standard ANT_MESSAGE struct which must be free() after use. Subclassed framers use this to allocate additional (overflow) buffer space.
 
    public:
@@ -128,6 +280,7 @@ class DSIFramerANT : public DSIFramer
 
       // Inherited methods.
       void ProcessByte(UCHAR ucByte_);
+      void ProcessBytes(const UCHAR *pucBytes_, ULONG ulSize_);
       void Error(UCHAR ucError_);
 
       BOOL WriteMessage(void *pstANTMessage_, USHORT usMessageSize_);
@@ -168,10 +321,73 @@ class DSIFramerANT : public DSIFramer
       //          data[0] = DSI_SERIAL_DEVICE_GONE - the serial library reported the device connection is lost
       /////////////////////////////////////////////////////////////////
 
+      ULONG WaitForMessages(ULONG ulMilliseconds_);
+      /////////////////////////////////////////////////////////////////
+      // Waits until there is something for GetMessages() to return.
+      // Parameters:
+      //    ulMilliseconds_:  As WaitForMessage().
+      // Returns the number of items GetMessages() would return now:
+      // the queued messages plus one for a pending error.  Returns 0
+      // if it timed out.
+      /////////////////////////////////////////////////////////////////
+
+      ULONG GetMessages(ANT_MESSAGE_ITEM *pastMessages_, ULONG ulMaxMessages_);
+      /////////////////////////////////////////////////////////////////
+      // Removes up to ulMaxMessages_ items from the queue while
+      // holding the lock only once.  Items come out in the order they
+      // were received.  An error is reported where it happened in that
+      // order, rather than ahead of every queued message as
+      // GetMessage() reports it.  Its item has ucSize set to
+      // DSI_FRAMER_ANT_ITEM_ERROR and a message ID and data as
+      // GetMessage() would return them.
+      // Parameters:
+      //    *pastMessages_:   Array of at least ulMaxMessages_ items.
+      //    ulMaxMessages_:   The size of the array.
+      // Returns the number of items filled in.
+      /////////////////////////////////////////////////////////////////
+
 
       // DSIFramerANT-specific methods.
 
-      UCHAR GetChannelNumber(ANT_MESSAGE* pstANTMessage_);
+      USHORT PeekMessage(const ANT_MESSAGE **ppstANTMessage_);
+      /////////////////////////////////////////////////////////////////
+      // Returns the oldest received message without copying it out
+      // of the receive queue.  The message stays in the queue, and is
+      // not overwritten by messages received in the meantime, until
+      // ConsumeMessage() is called.  sizeof(ANT_MESSAGE) bytes can
+      // always be read through the pointer, but only the returned
+      // size belongs to the message.  Only one thread should read
+      // messages from a framer.
+      // Parameters:
+      //    **ppstANTMessage_:   Set to the message, or to NULL if
+      //                         none is available.
+      // Return:
+      //    As GetMessage().  An error is cleared when it is returned
+      //    and needs no ConsumeMessage().
+      /////////////////////////////////////////////////////////////////
+
+      ULONG PeekMessages(ANT_MESSAGE_VIEW *pastViews_, ULONG ulMaxViews_);
+      /////////////////////////////////////////////////////////////////
+      // As GetMessages(), but fills in views of the messages where
+      // they sit in the receive queue instead of copying them out.
+      // The messages stay in the queue until ConsumeMessage().  An
+      // error is cleared when it is returned.  Calling PeekMessage()
+      // or PeekMessages() again hands out the same messages again.
+      // Parameters:
+      //    *pastViews_:      Array of at least ulMaxViews_ views.
+      //    ulMaxViews_:      The size of the array.
+      // Returns the number of views filled in.
+      /////////////////////////////////////////////////////////////////
+
+      void ConsumeMessage();
+      /////////////////////////////////////////////////////////////////
+      // Removes the messages returned by PeekMessage() or
+      // PeekMessages() from the queue.  The pointers must not be used
+      // afterwards.  Does nothing if no message was returned, or if
+      // GetMessage() or GetMessages() removed messages since.
+      /////////////////////////////////////////////////////////////////
+
+      UCHAR GetChannelNumber(const ANT_MESSAGE* pstANTMessage_);
       /////////////////////////////////////////////////////////////////
       // Parameters:
       //    *pstANTMessage_: A pointer to an ANT_MESSAGE structure.
@@ -186,6 +402,103 @@ class DSIFramerANT : public DSIFramer
 
       void SetSplitAdvBursts(BOOL bSplitAdvBursts_);
 
+      void SetAssembleAdvBursts(BOOL bAssembleAdvBursts_, ULONG ulBufferSize_ = DSI_FRAMER_ANT_BURST_BUFFER_DEFAULT);
+      /////////////////////////////////////////////////////////////////
+      // Instead of queueing each received advanced burst message, or
+      // splitting it into 8-byte burst messages, appends its payload
+      // to a buffer kept for its channel and queues one
+      // DSI_FRAMER_ANT_BURST_SEGMENT_ID message in its place.  Pass
+      // that message to GetBurstSegment() to copy out the data.  Takes
+      // precedence over SetSplitAdvBursts().  Call it before a
+      // transfer starts: changing it frees the buffers, and segments
+      // already queued can no longer be read.
+      // Parameters:
+      //    bAssembleAdvBursts_: Turns the mode on or off.
+      //    ulBufferSize_:    Bytes kept per channel, rounded up to a
+      //                      power of two.  A segment can be read
+      //                      until about this much more data has been
+      //                      received on its channel.
+      /////////////////////////////////////////////////////////////////
+
+      UCHAR GetBurstSegment(const ANT_MESSAGE *pstANTMessage_, UCHAR *pucData_);
+      /////////////////////////////////////////////////////////////////
+      // Copies out the data of a DSI_FRAMER_ANT_BURST_SEGMENT_ID
+      // message.  aucData[0] of the message holds the channel number
+      // and the sequence bits of the advanced burst message, as a
+      // burst packet would.
+      // Parameters:
+      //    *pstANTMessage_:  The segment message.
+      //    *pucData_:        Receives the data.  Must have room for
+      //                      MESG_MAX_SIZE_VALUE bytes.
+      // Returns the length of the data, or 0 if the message is not a
+      // segment or its data has already been overwritten.
+      /////////////////////////////////////////////////////////////////
+
+      void SetTxBatchSize(UCHAR ucTxBatchSize_);
+      /////////////////////////////////////////////////////////////////
+      // Sets how many burst packets are framed into one buffer and
+      // sent with a single call to WriteBytes().  Transfer failures
+      // and cancellation are checked between batches, so at most one
+      // batch is written after the device reports a failure.
+      // Parameters:
+      //    ucTxBatchSize_:   1 to DSI_FRAMER_ANT_TX_BATCH_MAX.  A value
+      //                      of 1 writes every packet on its own.
+      /////////////////////////////////////////////////////////////////
+
+      BOOL SetMessageQueueSize(ULONG ulSize_);
+      /////////////////////////////////////////////////////////////////
+      // Sets how many bytes of received messages can be held until
+      // they are read.  Each message takes its data size plus
+      // DSI_FRAMER_ANT_QUEUE_ITEM_HEADER bytes, so the default holds
+      // about ten thousand typical messages.
+      // Parameters:
+      //    ulSize_:          Queue size in bytes.  Values below
+      //                      DSI_FRAMER_ANT_QUEUE_MIN_SIZE are raised
+      //                      to it.
+      // Returns FALSE if messages are still queued or the memory
+      // could not be allocated; the old queue is kept in either case.
+      /////////////////////////////////////////////////////////////////
+
+      ULONG GetMessageQueueSize();
+
+      ULONG GetMessageQueueHighWater(BOOL bReset_ = FALSE);
+      /////////////////////////////////////////////////////////////////
+      // Returns the most bytes the received message queue has held
+      // at once since the framer was created or the mark was last
+      // reset.
+      // Parameters:
+      //    bReset_:          Restart the mark from the current level.
+      /////////////////////////////////////////////////////////////////
+
+      void SetPriorityResponses(BOOL bPriorityResponses_);
+      /////////////////////////////////////////////////////////////////
+      // Queues command responses and requested messages separately
+      // from channel data, so that GetMessage(), GetMessages() and
+      // PeekMessage() return them ahead of any data waiting to be
+      // read.  Channel events stay in the main queue, in order with
+      // the data of their channel.  When
+      // DSI_FRAMER_ANT_PRIORITY_QUEUE_SIZE responses are waiting,
+      // more go to the main queue and are read in turn.
+      // Parameters:
+      //    bPriorityResponses_: Turns the priority queue on or off.
+      //                         Responses already queued are kept.
+      /////////////////////////////////////////////////////////////////
+
+      USHORT WaitForPriorityMessage(ULONG ulMilliseconds_);
+      /////////////////////////////////////////////////////////////////
+      // As WaitForMessage(), but only wakes for the priority queue, or
+      // an error.  Returns the size of the oldest priority message,
+      // DSI_FRAMER_TIMEDOUT, or DSI_FRAMER_ERROR while an error is
+      // pending.  The error itself is still returned by GetMessage().
+      /////////////////////////////////////////////////////////////////
+
+      USHORT GetPriorityMessage(void *pstANTMessage_, USHORT usMessageSize_ = 0);
+      /////////////////////////////////////////////////////////////////
+      // As GetMessage(), but only takes from the priority queue and
+      // never returns an error.  Returns DSI_FRAMER_TIMEDOUT if the
+      // priority queue is empty.
+      /////////////////////////////////////////////////////////////////
+
       BOOL SetNetworkKey(UCHAR ucNetworkNumber_, UCHAR *pucKey_, ULONG ulResponseTime_ = 0);
       BOOL UnAssignChannel(UCHAR ucANTChannel_, ULONG ulResponseTime_ = 0);
       BOOL AssignChannel(UCHAR ucANTChannel_, UCHAR ucChannelType_, UCHAR ucNetworkNumber_, ULONG ulResponseTime_ = 0);
@@ -301,6 +614,75 @@ class DSIFramerANT : public DSIFramer
       BOOL SetRSSISearchThreshold(UCHAR ucANTChannel_, UCHAR ucSearchThreshold_, ULONG ulResponseTime_ = 0);
       BOOL EncryptedChannelEnable(UCHAR ucANTChannel_, UCHAR ucMode_, UCHAR ucVolatileKeyIndex_, UCHAR ucDecimationRate_, ULONG ulResponseTime_ = 0);
 
+      /////////////////////////////////////////////////////////////////
+      // Asynchronous configuration and control messages
+      /////////////////////////////////////////////////////////////////
+
+      BOOL SendCommandAsync(ANT_MESSAGE *pstANTMessage_, USHORT usMessageSize_, ANTCommandToken *pclToken_);
+      /////////////////////////////////////////////////////////////////
+      // Writes a command and returns without waiting for its response.
+      // The response is matched on the channel and message ID, as
+      // SendCommand() matches it, and completes pclToken_.  Commands
+      // on different channels, or on different stick-wide settings,
+      // can be outstanding together; two identical commands are
+      // completed oldest first.
+      // Parameters:
+      //    *pstANTMessage_:  The command.
+      //    usMessageSize_:   The size of its data.
+      //    *pclToken_:       Completed when the response arrives.  Any
+      //                      command it was still tracking is
+      //                      forgotten.  It must outlive the command
+      //                      or be cancelled, and must be released
+      //                      before the framer is destroyed.
+      // Returns FALSE if the command could not be written; the token
+      // is then left idle.
+      /////////////////////////////////////////////////////////////////
+
+      BOOL SetNetworkKeyAsync(UCHAR ucNetworkNumber_, UCHAR *pucKey_, ANTCommandToken *pclToken_);
+      BOOL UnAssignChannelAsync(UCHAR ucANTChannel_, ANTCommandToken *pclToken_);
+      BOOL AssignChannelAsync(UCHAR ucANTChannel_, UCHAR ucChannelType_, UCHAR ucNetworkNumber_, ANTCommandToken *pclToken_);
+      BOOL SetChannelIDAsync(UCHAR ucANTChannel_, USHORT usDeviceNumber_, UCHAR ucDeviceType_, UCHAR ucTransmitType_, ANTCommandToken *pclToken_);
+      BOOL SetChannelPeriodAsync(UCHAR ucANTChannel_, USHORT usMessagePeriod_, ANTCommandToken *pclToken_);
+      BOOL SetChannelSearchTimeoutAsync(UCHAR ucANTChannel_, UCHAR ucSearchTimeout_, ANTCommandToken *pclToken_);
+      BOOL SetChannelRFFrequencyAsync(UCHAR ucANTChannel_, UCHAR ucRFFrequency_, ANTCommandToken *pclToken_);
+      BOOL SetChannelTransmitPowerAsync(UCHAR ucANTChannel_, UCHAR ucTransmitPower_, ANTCommandToken *pclToken_);
+      BOOL SetLowPriorityChannelSearchTimeoutAsync(UCHAR ucANTChannel_, UCHAR ucSearchTimeout_, ANTCommandToken *pclToken_);
+      BOOL SetRSSISearchThresholdAsync(UCHAR ucANTChannel_, UCHAR ucSearchThreshold_, ANTCommandToken *pclToken_);
+      BOOL SetProximitySearchAsync(UCHAR ucANTChannel_, UCHAR ucSearchThreshold_, ANTCommandToken *pclToken_);
+      BOOL OpenChannelAsync(UCHAR ucANTChannel_, ANTCommandToken *pclToken_);
+      /////////////////////////////////////////////////////////////////
+      // As the synchronous versions, through SendCommandAsync().
+      /////////////////////////////////////////////////////////////////
+
+      BOOL ConfigureChannel(UCHAR ucANTChannel_, const ANT_CHANNEL_CONFIG *pstConfig_, ANT_CHANNEL_CONFIG_RESULT *pstResult_ = (ANT_CHANNEL_CONFIG_RESULT*)NULL, ULONG ulResponseTime_ = DSI_FRAMER_ANT_DEFAULT_RESPONSE_TIME);
+      /////////////////////////////////////////////////////////////////
+      // Applies the settings flagged in pstConfig_->ulFields to a
+      // channel, and opens it if ANT_CHANNEL_CONFIG_OPEN is set.  The
+      // steps are written back to back in the order of the
+      // ANT_CHANNEL_CONFIG_ flags and their responses collected
+      // afterwards, rather than waiting for each in turn.
+      // A setting this framer has already applied successfully is
+      // skipped, which makes reopening a closed channel a single
+      // step.  That knowledge is dropped when the same setting is
+      // sent another way, when the channel is assigned or unassigned,
+      // and when the device resets.  Opening the channel, the
+      // proximity threshold and a channel ID containing wildcards are
+      // always sent, since the device changes them itself.
+      // The channel must be unassigned unless the assignment is
+      // skipped or not requested.
+      // Parameters:
+      //    ucANTChannel_:    The channel to configure.
+      //    *pstConfig_:      The settings.
+      //    *pstResult_:      Set to the steps sent, skipped and failed
+      //                      and how long each took, if not NULL.
+      //    ulResponseTime_:  Time allowed for each response, counted
+      //                      from the response before it.  0 writes
+      //                      the steps without waiting; none are then
+      //                      remembered as applied.
+      // Returns TRUE if every step sent succeeded, or with no response
+      // time, if every step was written.
+      /////////////////////////////////////////////////////////////////
+
       /////////////////////////////////////////////////////////////////
       // The following are the synchronous RF event functions used to
       // update the synchronous data sent over a channel
@@ -316,9 +698,26 @@ class DSIFramerANT : public DSIFramer
       BOOL SendExtAcknowledgedData(UCHAR ucANTChannel, UCHAR *pucData, ULONG ulResponseTime_ = 0);
       BOOL SendExtBurstTransferPacket(UCHAR ucANTChannelSeq_, UCHAR *pucData_);
       ANTFRAMER_RETURN SendExtBurstTransfer(UCHAR ucANTChannel_, UCHAR *pucData_, ULONG ulSize_, ULONG ulResponseTime_ = 0);
-      ANTFRAMER_RETURN SendTransfer(UCHAR ucANTChannel_, UCHAR * pucData_, ULONG ulSize_, ULONG ulResponseTime_ = 0);
+      ANTFRAMER_RETURN SendTransfer(UCHAR ucANTChannel_, UCHAR * pucData_, ULONG ulSize_, ULONG ulResponseTime_ = 0, UCHAR ucRetries_ = 0, ANT_TRANSFER_STATS *pstStats_ = (ANT_TRANSFER_STATS*)NULL);
 
-      ANTFRAMER_RETURN SendAdvancedTransfer(UCHAR ucANTChannel_, UCHAR * pucData_, ULONG ulSize_, UCHAR ucStdPcktsPerSerialMsg_, ULONG ulResponseTime_ = 0);
+      ANTFRAMER_RETURN SendAdvancedTransfer(UCHAR ucANTChannel_, UCHAR * pucData_, ULONG ulSize_, UCHAR ucStdPcktsPerSerialMsg_, ULONG ulResponseTime_ = 0, UCHAR ucRetries_ = 0, ANT_TRANSFER_STATS *pstStats_ = (ANT_TRANSFER_STATS*)NULL);
+      /////////////////////////////////////////////////////////////////
+      // Sends a block of data as a burst, framed and written in
+      // windows of SetTxBatchSize() packets, checking for a failure
+      // between windows.
+      // Parameters:
+      //    ulResponseTime_:  Time allowed for the transfer to complete,
+      //                      including any retries.  With 0 it is not
+      //                      waited on and the result is always
+      //                      ANTFRAMER_PASS.
+      //    ucRetries_:       Times to send the transfer again from the
+      //                      start if the device reports
+      //                      EVENT_TRANSFER_TX_FAILED.  A burst cannot
+      //                      be resumed part way through.
+      //    *pstStats_:       Set to the packets sent, attempts made and
+      //                      the throughput of the last attempt, if
+      //                      not NULL.
+      /////////////////////////////////////////////////////////////////
 
       ANTFRAMER_RETURN SendANTFSTransfer(UCHAR ucANTChannel_, UCHAR* pucHeader_, UCHAR* pucFooter_, UCHAR * pucData_, ULONG ulSize_, ULONG ulResponseTime_, volatile ULONG *pulProgress_);
       ANTFRAMER_RETURN SendANTFSClientTransfer(UCHAR ucANTChannel_, ANTFS_DATA* pstHeader_, ANTFS_DATA* pstFooter_, ANTFS_DATA* pstData_, ULONG ulResponseTime_, volatile ULONG *pulProgress_);
@@ -407,6 +806,8 @@ class DSIFramerANT : public DSIFramer
       /////////////////////////////////////////////////////////////////
 
       friend class ANTMessageResponse;
+      friend class ANTResponseLease;
+      friend class ANTCommandToken;
 };
 
 
@@ -427,11 +828,108 @@ class ANTMessageResponse
       ///////////////////////////////////////////////////////////////
       DSIFramerANT * pclFramer;
       ANTMessageResponse * pclNext;
+      UCHAR ucBucket;
       UCHAR ucBytesToMatch;
       ANT_MESSAGE_ITEM stMessageItem;
       DSI_CONDITION_VAR stCondResponseReady;
       DSI_CONDITION_VAR *pstCondResponseReady;
       BOOL bResponseReady;
+      ANTCommandToken *pclToken;                            // Completed along with this response, if set.
+};
+
+
+//Borrows an ANTMessageResponse from a framer's pool for the life of the
+//lease, so a command does not create and destroy a condition variable
+//each time it waits for a response.  The response is detached and
+//handed back when the lease goes out of scope.
+class ANTResponseLease
+{
+   public:
+      ANTResponseLease(DSIFramerANT *pclFramer_);
+      ~ANTResponseLease();
+
+      ANTMessageResponse* Acquire();
+      /////////////////////////////////////////////////////////////////
+      // Takes a response from the pool; use it as one made with new
+      // but do not delete it.  Only one response is held per lease.
+      /////////////////////////////////////////////////////////////////
+
+   private:
+      DSIFramerANT *pclFramer;
+      ANTMessageResponse *pclResponse;
+
+      ANTResponseLease(const ANTResponseLease&);               // Not copyable.
+      ANTResponseLease& operator=(const ANTResponseLease&);
+};
+
+
+//Tracks a command sent with DSIFramerANT::SendCommandAsync().  Its
+//completion can be polled, waited on, or delivered to a callback.
+class ANTCommandToken
+{
+   public:
+      ANTCommandToken();
+      ~ANTCommandToken();
+
+      void SetCallback(ANT_COMMAND_CALLBACK pfCallback_, void *pvParameter_ = NULL);
+      /////////////////////////////////////////////////////////////////
+      // Sets a function to call when a response completes the token.
+      // It is called on the framer's receive thread once the block of
+      // bytes holding the response has been framed, with none of the
+      // framer's locks held.  It may send further asynchronous
+      // commands and cancel, reuse or delete any token, but must not
+      // wait for a response, as no more are received until it
+      // returns.
+      /////////////////////////////////////////////////////////////////
+
+      BOOL IsPending();
+      /////////////////////////////////////////////////////////////////
+      // Returns TRUE while a sent command is waiting for a response.
+      /////////////////////////////////////////////////////////////////
+
+      BOOL IsComplete();
+      /////////////////////////////////////////////////////////////////
+      // Returns TRUE once the response has arrived.
+      /////////////////////////////////////////////////////////////////
+
+      BOOL Wait(ULONG ulMilliseconds_);
+      /////////////////////////////////////////////////////////////////
+      // Waits for the response.
+      // Returns TRUE if it has arrived.
+      /////////////////////////////////////////////////////////////////
+
+      BOOL Succeeded();
+      /////////////////////////////////////////////////////////////////
+      // Returns TRUE if the response has arrived and reported
+      // RESPONSE_NO_ERROR.
+      /////////////////////////////////////////////////////////////////
+
+      const ANT_MESSAGE_ITEM* GetResponse();
+      /////////////////////////////////////////////////////////////////
+      // Returns the response message, or NULL if it has not arrived.
+      // It stays valid until the token is cancelled or reused.
+      /////////////////////////////////////////////////////////////////
+
+      void Cancel();
+      /////////////////////////////////////////////////////////////////
+      // Stops waiting for the response and releases it.  The
+      // callback will not be called once this returns.
+      /////////////////////////////////////////////////////////////////
+
+   private:
+      DSIFramerANT *pclFramer;
+      ANTMessageResponse *pclResponse;
+      ANT_COMMAND_CALLBACK pfCallback;
+      void *pvCallbackParameter;
+      ANTCommandToken *pclNextCompleted;                    // Next token whose callback is waiting to run.
+
+      ANTMessageResponse* Bind(DSIFramerANT *pclFramer_);
+      void Complete();
+
+      ANTCommandToken(const ANTCommandToken&);                 // Not copyable.
+      ANTCommandToken& operator=(const ANTCommandToken&);
+
+      friend class DSIFramerANT;
 };
 
 #endif // !defined(DSI_FRAMER_ANT_HPP)
@@ -55,6 +55,7 @@ All rights reserved.
 BOOL DSIFramerANT::SendFSCommand(FS_MESSAGE *pstFSMessage_, USHORT usMessageSize_, UCHAR* pucFSResponse, ULONG ulResponseTime_)
 {
    ANTMessageResponse *pclCommandResponse = (ANTMessageResponse*)NULL;
+   ANTResponseLease clCommandLease(this);
 
    // If we are going to be waiting for a response setup the Response object
    if (ulResponseTime_ != 0)
@@ -66,7 +67,7 @@ BOOL DSIFramerANT::SendFSCommand(FS_MESSAGE *pstFSMessage_, USHORT usMessageSize
       aucDesiredData[OFFSET_RESPONSE_COMMAND_ID_LOW] = pstFSMessage_->ucCommandID;
       aucDesiredData[OFFSET_RESPONSE_COMMAND_ID_HIGH] = pstFSMessage_->ucMessageID;
 
-      pclCommandResponse = new ANTMessageResponse();
+      pclCommandResponse = clCommandLease.Acquire();
       pclCommandResponse->Attach((UCHAR)((MESG_EXT_RESPONSE_ID >> 8) & 0xFF), aucDesiredData, bytesToMatch, this);
    }
 
@@ -77,12 +78,6 @@ BOOL DSIFramerANT::SendFSCommand(FS_MESSAGE *pstFSMessage_, USHORT usMessageSize
          DSIDebug::ThreadWrite("Framer->SendFSCommand():  WriteMessage Failed.");
       #endif
 
-      if(pclCommandResponse != NULL)
-      {
-         delete pclCommandResponse;
-         pclCommandResponse = (ANTMessageResponse*)NULL;
-      }
-
       return FALSE;
    }
 
@@ -99,7 +94,6 @@ BOOL DSIFramerANT::SendFSCommand(FS_MESSAGE *pstFSMessage_, USHORT usMessageSize
    //if (pclCommandResponse->stMessageItem.ucSize == 0)
    if (pclCommandResponse->bResponseReady == FALSE)
    {
-      delete pclCommandResponse;
       #if defined(SERIAL_DEBUG)
       DSIDebug::ThreadWrite("Framer->SendCommand():  Timeout.");
       #endif
@@ -109,7 +103,6 @@ BOOL DSIFramerANT::SendFSCommand(FS_MESSAGE *pstFSMessage_, USHORT usMessageSize
    // Check the response.
    if (pclCommandResponse->stMessageItem.stANTMessage.aucData[OFFSET_RESPONSE_FSRESPONSE] != FS_NO_ERROR_RESPONSE)
    {
-      delete pclCommandResponse;
       #if defined(DEBUG_FILE)
          DSIDebug::ThreadWrite("Framer->SendFSCommand():  Response != RESPONSE_NO_ERROR.");
       #endif
@@ -118,7 +111,6 @@ BOOL DSIFramerANT::SendFSCommand(FS_MESSAGE *pstFSMessage_, USHORT usMessageSize
 
    *pucFSResponse = pclCommandResponse->stMessageItem.stANTMessage.aucData[OFFSET_RESPONSE_FSRESPONSE];                         //Save the FSResponse
 
-   delete pclCommandResponse;
    return TRUE;
 }
 
@@ -126,22 +118,18 @@ BOOL DSIFramerANT::SendFSCommand(FS_MESSAGE *pstFSMessage_, USHORT usMessageSize
 BOOL DSIFramerANT::SendFSRequest(UCHAR MesgSize, ANT_MESSAGE_ITEM *pstANTResponse_, FS_MESSAGE stMessage, ULONG ulResponseTime_)
 {
    ANTMessageResponse *pclRequestResponse = (ANTMessageResponse*)NULL;
+   ANTResponseLease clRequestLease(this);
 
    // If we are going to be waiting for a response setup the Response object
    if ((ulResponseTime_ != 0) && (pstANTResponse_ != NULL))
    {
-      pclRequestResponse = new ANTMessageResponse();
+      pclRequestResponse = clRequestLease.Acquire();
       pclRequestResponse->Attach(MESG_EXT_ID_2, (UCHAR*)NULL, 0, this);
    }
 
    // Write the command message.
    if (!WriteMessage(&stMessage, MesgSize))
    {
-      if(pclRequestResponse != NULL)
-      {
-         delete pclRequestResponse;
-         pclRequestResponse = (ANTMessageResponse*)NULL;
-      }
       return FALSE;
    }
 
@@ -157,7 +145,6 @@ BOOL DSIFramerANT::SendFSRequest(UCHAR MesgSize, ANT_MESSAGE_ITEM *pstANTRespons
    // We haven't received a response in the allotted time.
    if (pclRequestResponse->bResponseReady == FALSE)
    {
-      delete pclRequestResponse;
       return FALSE;
    }
 
@@ -166,7 +153,6 @@ BOOL DSIFramerANT::SendFSRequest(UCHAR MesgSize, ANT_MESSAGE_ITEM *pstANTRespons
    pstANTResponse_->stANTMessage.ucMessageID = pclRequestResponse->stMessageItem.stANTMessage.ucMessageID;
    memcpy (pstANTResponse_->stANTMessage.aucData, pclRequestResponse->stMessageItem.stANTMessage.aucData, pclRequestResponse->stMessageItem.ucSize);
 
-   delete pclRequestResponse;
    return TRUE;
 }
 
@@ -28,6 +28,21 @@ class DSISerialCallback
       //    ucByte_:          The byte to process.
       /////////////////////////////////////////////////////////////////
 
+      virtual void ProcessBytes(const UCHAR *pucBytes_, ULONG ulSize_)
+      {
+         for(ULONG i=0; i<ulSize_; i++)
+            ProcessByte(pucBytes_[i]);
+      }
+      /////////////////////////////////////////////////////////////////
+      // Processes a block of received bytes, in order.  Serial
+      // implementations should prefer this over ProcessByte() so
+      // that callbacks can handle a whole read at once.
+      // Parameters:
+      //    *pucBytes_:       A pointer to the received bytes.
+      //    ulSize_:          The number of bytes pointed to by
+      //                      *pucBytes_.
+      /////////////////////////////////////////////////////////////////
+
       virtual void Error(UCHAR ucError_) = 0;
       /////////////////////////////////////////////////////////////////
       // Signals an error.
@@ -14,6 +14,7 @@ All rights reserved.
 #include "macros.h"
 
 #include "usb_device_handle.hpp"
+#include "usb_device_registry.hpp"
 
 #include <stdio.h>
 #include <string.h>
@@ -49,6 +50,7 @@ DSISerialGeneric::DSISerialGeneric()
    bStopReceiveThread = TRUE;
    ucDeviceNumber = 0xFF;
    ulBaud = 0;
+   bDirectReceive = FALSE;
 
    return;
 }
@@ -82,7 +84,7 @@ BOOL DSISerialGeneric::AutoInit()
    pclDevice = NULL;
    ucDeviceNumber = 0xFF;
 
-   const ANTDeviceList clDeviceList = USBDeviceHandle::GetAvailableDevices();  //saves a copy of the list and all of the elements
+   const USBDeviceSnapshot clDeviceList = USBDeviceRegistry::GetAvailableDevices();  //holds its own copies of the devices
 
    if(clDeviceList.GetSize() == 0)
    {
@@ -177,7 +179,7 @@ ULONG DSISerialGeneric::GetDeviceSerialNumber()
 BOOL DSISerialGeneric::GetDeviceUSBInfo(UCHAR ucDevice_, UCHAR* pucProductString_, UCHAR* pucSerialString_, USHORT usBufferSize_)
 {
 
-   const ANTDeviceList clDeviceList = USBDeviceHandle::GetAllDevices();
+   const USBDeviceSnapshot clDeviceList = USBDeviceRegistry::GetAllDevices();
    if(clDeviceList.GetSize() <= ucDevice_)
       return FALSE;
 
@@ -243,9 +245,10 @@ BOOL DSISerialGeneric::Open(void)
 
    //If the user specified a device number instead of a USBDevice instance, then grab it from the list
    const USBDevice* pclTempDevice = pclDevice;
+   USBDeviceSnapshot clDeviceList;   //keeps pclTempDevice valid until we are done opening it
    if(pclDevice == NULL)
    {
-      const USBDeviceList<const USBDevice*> clDeviceList = USBDeviceHandle::GetAllDevices();
+      clDeviceList = USBDeviceRegistry::GetAllDevices();
       if(clDeviceList.GetSize() <= ucDeviceNumber)
          return FALSE;
 
@@ -259,6 +262,9 @@ BOOL DSISerialGeneric::Open(void)
       return FALSE;
    }
 
+   if(bDirectReceive && pclDeviceHandle->SetReceiveCallback(pclCallback))
+      return TRUE;   //No receive thread needed
+
 
    if(DSIThread_MutexInit(&stMutexCriticalSection) != DSI_THREAD_ENONE)
    {
@@ -316,6 +322,7 @@ void DSISerialGeneric::Close(BOOL bReset_)
 
    if(pclDeviceHandle)
    {
+      pclDeviceHandle->SetReceiveCallback(NULL);   //Don't report the close as an error
       USBDeviceHandle::Close(pclDeviceHandle, bReset_);
 
       //if(bReset_)                         //Only done for specific serial implementations
@@ -346,6 +353,14 @@ BOOL DSISerialGeneric::WriteBytes(void *pvData_, USHORT usSize_)
    return TRUE;
 }
 
+///////////////////////////////////////////////////////////////////////
+// Selects whether received data bypasses the receive thread.
+///////////////////////////////////////////////////////////////////////
+void DSISerialGeneric::SetDirectReceive(BOOL bDirectReceive_)
+{
+   bDirectReceive = bDirectReceive_;
+}
+
 ///////////////////////////////////////////////////////////////////////
 // Returns the device port number.
 ///////////////////////////////////////////////////////////////////////
@@ -371,8 +386,7 @@ void DSISerialGeneric::ReceiveThread(void)
       switch(eStatus)
       {
          case USBError::NONE:
-            for(ULONG i=0; i<ulRxBytesRead; i++)
-               pclCallback->ProcessByte(aucData[i]);
+            pclCallback->ProcessBytes(aucData, ulRxBytesRead);
             break;
 
          case USBError::DEVICE_GONE:
@@ -412,9 +426,10 @@ void DSISerialGeneric::USBReset(void)
 {
    //If the user specified a device number instead of a USBDevice instance, then grab it from the list
    const USBDevice* pclTempDevice = pclDevice;
+   USBDeviceSnapshot clDeviceList;   //keeps pclTempDevice valid until the reset is done
    if(pclDevice == NULL)
    {
-      const ANTDeviceList clDeviceList = USBDeviceHandle::GetAllDevices();
+      clDeviceList = USBDeviceRegistry::GetAllDevices();
       if((ucDeviceNumber == 0xFF) || (clDeviceList.GetSize() <= ucDeviceNumber))
       {
          #if defined(_MSC_VER)
@@ -428,6 +443,7 @@ void DSISerialGeneric::USBReset(void)
             SNPRINTF(&(line1[0]),sizeof(line1), "@USB\\VID_0FCF&PID_10*");   //The string for all ANT USB Devices
             WinDevice_Disable(1,argv_);
             WinDevice_Enable(1,argv_);
+            USBDeviceRegistry::Invalidate();
 
          #endif
          return;
@@ -437,5 +453,6 @@ void DSISerialGeneric::USBReset(void)
    }
 
    pclTempDevice->USBReset();
+   USBDeviceRegistry::Invalidate();   //The device re-enumerates
    return;
 }
@@ -37,6 +37,7 @@ class DSISerialGeneric : public DSISerial
       const USBDevice* pclDevice;
       UCHAR ucDeviceNumber;
       ULONG ulBaud;
+      BOOL bDirectReceive;                                  // Let the USB handle feed the callback directly.
 
       static time_t lastUsbResetTime;
 
@@ -51,6 +52,14 @@ class DSISerialGeneric : public DSISerial
       BOOL Init(ULONG ulBaud_, UCHAR ucDeviceNumber_);
       BOOL Init(ULONG ulBaud_, const USBDevice& clDevice_, UCHAR ucDeviceNumber_);
 
+      void SetDirectReceive(BOOL bDirectReceive_);
+      /////////////////////////////////////////////////////////////////
+      // When enabled, the USB device handle feeds received data to the
+      // callback from its own receive thread, skipping our receive
+      // thread and its queue.  Falls back to the normal path if the
+      // handle does not support it.  Takes effect on the next Open().
+      /////////////////////////////////////////////////////////////////
+
       void USBReset();
       UCHAR GetNumberOfDevices();
 
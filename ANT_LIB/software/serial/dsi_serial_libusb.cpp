@@ -313,17 +313,17 @@ UCHAR DSISerialLibusb::GetDeviceNumber()
 void DSISerialLibusb::ReceiveThread()
 {
 
+   UCHAR aucRxData[255];
+
    while(!bStopReceiveThread)
    {
-
-      UCHAR ucRxByte;
       ULONG ulRxBytesRead;
-      USBError::Enum eStatus = pclDeviceHandle->Read(&ucRxByte, 1, ulRxBytesRead, 1000);
+      USBError::Enum eStatus = pclDeviceHandle->Read(aucRxData, sizeof(aucRxData), ulRxBytesRead, 1000);
 
       switch(eStatus)
       {
          case USBError::NONE:
-            pclCallback->ProcessByte(ucRxByte);
+            pclCallback->ProcessBytes(aucRxData, ulRxBytesRead);
             break;
 
          case USBError::DEVICE_GONE:
@@ -362,7 +362,8 @@ DSI_THREAD_RETURN DSISerialLibusb::ProcessThread(void *pvParameter_)
 BOOL DSISerialLibusb::GetDeviceNumberByVendorId(USHORT usVid_, UCHAR& ucDeviceNumber_)
 {
 
-   const USBDeviceListLibusb clDeviceList = USBDeviceHandleLibusb::GetAvailableDevices();
+   //The open below is the availability check, and device numbers index the full list in Open()
+   const USBDeviceListLibusb clDeviceList = USBDeviceHandleLibusb::GetAllDevices();
    ULONG ulNumOfDevices = clDeviceList.GetSize();
    if(ulNumOfDevices == 0)
    {
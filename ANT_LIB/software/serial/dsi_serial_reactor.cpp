@@ -0,0 +1,379 @@
+/*
+This software is subject to the license described in the License.txt file
+included with this software distribution. You may not use this file except
+in compliance with this license.
+
+Copyright (c) Dynastream Innovations Inc. 2016
+All rights reserved.
+*/
+#include "types.h"
+#if defined(DSI_TYPES_LINUX)
+#include "defines.h"
+#include "dsi_serial_reactor.hpp"
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+
+//////////////////////////////////////////////////////////////////////////////////
+// Public Methods
+//////////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////
+// Constructor
+///////////////////////////////////////////////////////////////////////
+DSISerialReactor::DSISerialReactor()
+{
+   ucLoops = 0;
+   pstSources = (Source*)NULL;
+   bStop = TRUE;
+
+   DSIThread_MutexInit(&stMutexCriticalSection);
+   DSIThread_CondInit(&stCondSourceIdle);
+   DSIThread_CondInit(&stCondThreadExit);
+}
+
+///////////////////////////////////////////////////////////////////////
+// Destructor
+///////////////////////////////////////////////////////////////////////
+DSISerialReactor::~DSISerialReactor()
+{
+   Stop();
+
+   DSIThread_CondDestroy(&stCondThreadExit);
+   DSIThread_CondDestroy(&stCondSourceIdle);
+   DSIThread_MutexDestroy(&stMutexCriticalSection);
+}
+
+///////////////////////////////////////////////////////////////////////
+BOOL DSISerialReactor::Start(UCHAR ucThreads_)
+{
+   if(ucThreads_ == 0 || ucThreads_ > DSI_SERIAL_REACTOR_MAX_THREADS)
+      return FALSE;
+
+   Stop();
+
+   bStop = FALSE;
+
+   for(UCHAR i = 0; i < ucThreads_; i++)
+   {
+      Loop* pstLoop = &astLoop[i];
+      struct epoll_event stEvent;
+
+      pstLoop->pclReactor = this;
+      pstLoop->hThread = (DSI_THREAD_ID)NULL;
+      pstLoop->bRunning = FALSE;
+      pstLoop->ulSources = 0;
+      pstLoop->pstActive = (Source*)NULL;
+      pstLoop->pstRetired = (Source*)NULL;
+      pstLoop->iWakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+      pstLoop->iEpollFd = epoll_create1(EPOLL_CLOEXEC);
+
+      DSIThread_MutexLock(&stMutexCriticalSection);
+         ucLoops++;                                         // Counted now so Stop() cleans it up if anything below fails.
+      DSIThread_MutexUnlock(&stMutexCriticalSection);
+
+      if(pstLoop->iWakeFd < 0 || pstLoop->iEpollFd < 0)
+      {
+         Stop();
+         return FALSE;
+      }
+
+      memset(&stEvent, 0, sizeof(stEvent));
+      stEvent.events = EPOLLIN;
+      stEvent.data.ptr = NULL;                              // Sources always have a non-NULL pointer.
+      if(epoll_ctl(pstLoop->iEpollFd, EPOLL_CTL_ADD, pstLoop->iWakeFd, &stEvent) != 0)
+      {
+         Stop();
+         return FALSE;
+      }
+
+      DSIThread_MutexLock(&stMutexCriticalSection);
+         pstLoop->bRunning = TRUE;
+         pstLoop->hThread = DSIThread_CreateThread(&DSISerialReactor::LoopThreadStart, pstLoop);
+         if(pstLoop->hThread == (DSI_THREAD_ID)NULL)
+            pstLoop->bRunning = FALSE;
+      DSIThread_MutexUnlock(&stMutexCriticalSection);
+
+      if(pstLoop->hThread == (DSI_THREAD_ID)NULL)
+      {
+         Stop();
+         return FALSE;
+      }
+   }
+
+   return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////
+void DSISerialReactor::Stop(void)
+{
+   DSIThread_MutexLock(&stMutexCriticalSection);
+   bStop = TRUE;
+
+   for(UCHAR i = 0; i < ucLoops; i++)
+   {
+      uint64_t ullWake = 1;
+      if(astLoop[i].iWakeFd >= 0 && write(astLoop[i].iWakeFd, &ullWake, sizeof(ullWake)) < 0) {}  //if the counter is already set the thread is waking anyway
+   }
+
+   for(UCHAR i = 0; i < ucLoops; i++)
+   {
+      while(astLoop[i].bRunning)
+      {
+         if(DSIThread_CondTimedWait(&stCondThreadExit, &stMutexCriticalSection, 3000) != DSI_THREAD_ENONE)
+         {
+            // We were unable to stop the thread normally.
+            DSIThread_DestroyThread(astLoop[i].hThread);
+            astLoop[i].bRunning = FALSE;
+         }
+      }
+   }
+   DSIThread_MutexUnlock(&stMutexCriticalSection);
+
+   for(UCHAR i = 0; i < ucLoops; i++)
+   {
+      Loop* pstLoop = &astLoop[i];
+
+      if(pstLoop->hThread != (DSI_THREAD_ID)NULL)
+      {
+         DSIThread_ReleaseThreadID(pstLoop->hThread);
+         pstLoop->hThread = (DSI_THREAD_ID)NULL;
+      }
+
+      while(pstLoop->pstRetired != NULL)
+      {
+         Source* pstSource = pstLoop->pstRetired;
+         pstLoop->pstRetired = pstSource->pstNext;
+         delete pstSource;
+      }
+
+      if(pstLoop->iEpollFd >= 0)
+      {
+         close(pstLoop->iEpollFd);
+         pstLoop->iEpollFd = -1;
+      }
+
+      if(pstLoop->iWakeFd >= 0)
+      {
+         close(pstLoop->iWakeFd);
+         pstLoop->iWakeFd = -1;
+      }
+   }
+
+   while(pstSources != NULL)
+   {
+      Source* pstSource = pstSources;
+      pstSources = pstSource->pstNext;
+      delete pstSource;
+   }
+
+   ucLoops = 0;
+}
+
+///////////////////////////////////////////////////////////////////////
+BOOL DSISerialReactor::AddSource(int iFd_, DSISerialReactorSource *pclSource_)
+{
+   Source* pstSource;
+   Loop* pstLoop;
+   struct epoll_event stEvent;
+
+   if(iFd_ < 0 || pclSource_ == NULL)
+      return FALSE;
+
+   pstSource = new Source;
+   if(pstSource == NULL)
+      return FALSE;
+
+   DSIThread_MutexLock(&stMutexCriticalSection);
+
+   if(bStop || ucLoops == 0)
+   {
+      DSIThread_MutexUnlock(&stMutexCriticalSection);
+      delete pstSource;
+      return FALSE;
+   }
+
+   pstLoop = &astLoop[0];
+   for(UCHAR i = 1; i < ucLoops; i++)
+   {
+      if(astLoop[i].ulSources < pstLoop->ulSources)
+         pstLoop = &astLoop[i];
+   }
+
+   pstSource->iFd = iFd_;
+   pstSource->pclSource = pclSource_;
+   pstSource->pstLoop = pstLoop;
+   pstSource->bRemoved = FALSE;
+
+   memset(&stEvent, 0, sizeof(stEvent));
+   stEvent.events = EPOLLIN;
+   stEvent.data.ptr = pstSource;
+   if(epoll_ctl(pstLoop->iEpollFd, EPOLL_CTL_ADD, iFd_, &stEvent) != 0)
+   {
+      DSIThread_MutexUnlock(&stMutexCriticalSection);
+      delete pstSource;
+      return FALSE;
+   }
+
+   pstLoop->ulSources++;
+   pstSource->pstNext = pstSources;
+   pstSources = pstSource;
+
+   DSIThread_MutexUnlock(&stMutexCriticalSection);
+
+   return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////
+void DSISerialReactor::RemoveSource(DSISerialReactorSource *pclSource_)
+{
+   Source* pstSource;
+   Loop* pstLoop;
+
+   DSIThread_MutexLock(&stMutexCriticalSection);
+
+   pstSource = pstSources;
+   while(pstSource != NULL && pstSource->pclSource != pclSource_)
+      pstSource = pstSource->pstNext;
+
+   if(pstSource == NULL)
+   {
+      DSIThread_MutexUnlock(&stMutexCriticalSection);
+      return;
+   }
+
+   pstLoop = pstSource->pstLoop;
+   RetireSource(pstSource);
+
+   // Wait for a call in progress on the loop thread, unless that is the thread we are on.
+   while(pstLoop->pstActive == pstSource && !DSIThread_CompareThreads(pstLoop->hThreadIDNum, DSIThread_GetCurrentThreadIDNum()))
+      DSIThread_CondTimedWait(&stCondSourceIdle, &stMutexCriticalSection, DSI_THREAD_INFINITE);
+
+   DSIThread_MutexUnlock(&stMutexCriticalSection);
+}
+
+///////////////////////////////////////////////////////////////////////
+UCHAR DSISerialReactor::GetThreadCount(void)
+{
+   UCHAR ucThreads;
+
+   DSIThread_MutexLock(&stMutexCriticalSection);
+      ucThreads = bStop ? 0 : ucLoops;
+   DSIThread_MutexUnlock(&stMutexCriticalSection);
+
+   return ucThreads;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////
+// Private Methods
+//////////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////
+// Stops watching a source and hands it to its loop to be freed once
+// the loop is no longer holding events that point to it.
+// Must be called with the critical section held.
+///////////////////////////////////////////////////////////////////////
+void DSISerialReactor::RetireSource(Source *pstSource_)
+{
+   Source** ppstLink = &pstSources;
+   Loop* pstLoop = pstSource_->pstLoop;
+   uint64_t ullWake = 1;
+
+   while(*ppstLink != NULL && *ppstLink != pstSource_)
+      ppstLink = &(*ppstLink)->pstNext;
+
+   if(*ppstLink != NULL)
+      *ppstLink = pstSource_->pstNext;
+
+   epoll_ctl(pstLoop->iEpollFd, EPOLL_CTL_DEL, pstSource_->iFd, (struct epoll_event*)NULL);
+   pstSource_->bRemoved = TRUE;
+   pstLoop->ulSources--;
+
+   pstSource_->pstNext = pstLoop->pstRetired;
+   pstLoop->pstRetired = pstSource_;
+
+   if(write(pstLoop->iWakeFd, &ullWake, sizeof(ullWake)) < 0) {}  //if the counter is already set the thread is waking anyway
+}
+
+///////////////////////////////////////////////////////////////////////
+void DSISerialReactor::LoopThread(Loop *pstLoop_)
+{
+   UCHAR aucRxData[DSI_SERIAL_REACTOR_RX_BUFFER_SIZE];
+   struct epoll_event astEvents[DSI_SERIAL_REACTOR_MAX_EVENTS];
+
+   DSIThread_MutexLock(&stMutexCriticalSection);
+      pstLoop_->hThreadIDNum = DSIThread_GetCurrentThreadIDNum();
+   DSIThread_MutexUnlock(&stMutexCriticalSection);
+
+   while(!bStop)
+   {
+      // Nothing from the last wakeup is still referenced, so retired sources can go.
+      DSIThread_MutexLock(&stMutexCriticalSection);
+      while(pstLoop_->pstRetired != NULL)
+      {
+         Source* pstSource = pstLoop_->pstRetired;
+         pstLoop_->pstRetired = pstSource->pstNext;
+         delete pstSource;
+      }
+      DSIThread_MutexUnlock(&stMutexCriticalSection);
+
+      int iEvents = epoll_wait(pstLoop_->iEpollFd, astEvents, DSI_SERIAL_REACTOR_MAX_EVENTS, -1);
+      if(iEvents < 0)
+      {
+         if(errno == EINTR)
+            continue;
+         break;
+      }
+
+      for(int i = 0; i < iEvents && !bStop; i++)
+      {
+         Source* pstSource = (Source*)astEvents[i].data.ptr;
+         BOOL bAlive;
+
+         if(pstSource == NULL)
+         {
+            uint64_t ullWake;
+            if(read(pstLoop_->iWakeFd, &ullWake, sizeof(ullWake)) < 0) {}  //only needs to be cleared
+            continue;
+         }
+
+         DSIThread_MutexLock(&stMutexCriticalSection);
+         if(pstSource->bRemoved)
+         {
+            DSIThread_MutexUnlock(&stMutexCriticalSection);
+            continue;
+         }
+         pstLoop_->pstActive = pstSource;
+         DSIThread_MutexUnlock(&stMutexCriticalSection);
+
+         bAlive = pstSource->pclSource->ProcessEvents(astEvents[i].events, aucRxData, sizeof(aucRxData));
+
+         DSIThread_MutexLock(&stMutexCriticalSection);
+         pstLoop_->pstActive = (Source*)NULL;
+         if(!bAlive && !pstSource->bRemoved)
+            RetireSource(pstSource);
+         DSIThread_CondBroadcast(&stCondSourceIdle);
+         DSIThread_MutexUnlock(&stMutexCriticalSection);
+      }
+   }
+
+   DSIThread_MutexLock(&stMutexCriticalSection);
+      pstLoop_->bRunning = FALSE;
+      DSIThread_CondBroadcast(&stCondThreadExit);                             // Set an event to alert Stop() that the thread is finished.
+   DSIThread_MutexUnlock(&stMutexCriticalSection);
+}
+
+///////////////////////////////////////////////////////////////////////
+DSI_THREAD_RETURN DSISerialReactor::LoopThreadStart(void *pvParameter_)
+{
+   Loop* pstLoop = (Loop*) pvParameter_;
+   pstLoop->pclReactor->LoopThread(pstLoop);
+   return 0;
+}
+
+#endif //defined(DSI_TYPES_LINUX)
@@ -0,0 +1,150 @@
+/*
+This software is subject to the license described in the License.txt file
+included with this software distribution. You may not use this file except
+in compliance with this license.
+
+Copyright (c) Dynastream Innovations Inc. 2016
+All rights reserved.
+*/
+#if !defined(DSI_SERIAL_REACTOR_HPP)
+#define DSI_SERIAL_REACTOR_HPP
+
+#include "types.h"
+
+#if defined(DSI_TYPES_LINUX) // The reactor uses epoll, so it is currently only supported on linux
+#include "dsi_thread.h"
+
+
+//////////////////////////////////////////////////////////////////////////////////
+// Public Definitions
+//////////////////////////////////////////////////////////////////////////////////
+
+#define DSI_SERIAL_REACTOR_MAX_THREADS       16
+#define DSI_SERIAL_REACTOR_RX_BUFFER_SIZE    4096       // Read buffer shared by all sources on one thread.
+#define DSI_SERIAL_REACTOR_MAX_EVENTS        32         // Ready sources handled per wakeup.
+
+
+//////////////////////////////////////////////////////////////////////////////////
+// Public Class Prototypes
+//////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////
+// A device served by a DSISerialReactor.
+/////////////////////////////////////////////////////////////////
+class DSISerialReactorSource
+{
+   public:
+      virtual ~DSISerialReactorSource(){}
+
+      virtual BOOL ProcessEvents(ULONG ulEvents_, UCHAR *pucBuffer_, ULONG ulBufferSize_) = 0;
+      /////////////////////////////////////////////////////////////////
+      // Called from a reactor thread when the source's descriptor is
+      // ready.  Must not block.
+      // Parameters:
+      //    ulEvents_:        The epoll events that are pending.
+      //    *pucBuffer_:      Scratch buffer to read into.  It is
+      //                      only valid for the length of the call.
+      //    ulBufferSize_:    Size of *pucBuffer_.
+      // Returns FALSE if the device is gone, in which case the source
+      // is removed from the reactor and not called again.
+      /////////////////////////////////////////////////////////////////
+};
+
+/////////////////////////////////////////////////////////////////
+// Serves the I/O of many serial devices from a small, fixed set of
+// epoll threads instead of one receive thread per device.
+// Each source stays on the thread it was given when it was added,
+// so its data is always read and framed in order.  Sources can be
+// added and removed at any time while the reactor is running.
+/////////////////////////////////////////////////////////////////
+class DSISerialReactor
+{
+   public:
+
+      DSISerialReactor();
+      ~DSISerialReactor();
+
+      BOOL Start(UCHAR ucThreads_);
+      /////////////////////////////////////////////////////////////////
+      // Starts the reactor threads.
+      // Parameters:
+      //    ucThreads_:       Number of threads, 1 to
+      //                      DSI_SERIAL_REACTOR_MAX_THREADS.
+      // Returns TRUE if successful.  Otherwise, it returns FALSE.
+      /////////////////////////////////////////////////////////////////
+
+      void Stop(void);
+      /////////////////////////////////////////////////////////////////
+      // Stops the reactor threads.  Sources should be removed first,
+      // any that are left are dropped without being notified.
+      /////////////////////////////////////////////////////////////////
+
+      BOOL AddSource(int iFd_, DSISerialReactorSource *pclSource_);
+      /////////////////////////////////////////////////////////////////
+      // Starts watching a non-blocking descriptor for input.  The
+      // source is given to the thread serving the fewest sources.
+      // Parameters:
+      //    iFd_:             The descriptor to watch.
+      //    *pclSource_:      Called when iFd_ is ready.
+      // Returns TRUE if successful.  Otherwise, it returns FALSE.
+      /////////////////////////////////////////////////////////////////
+
+      void RemoveSource(DSISerialReactorSource *pclSource_);
+      /////////////////////////////////////////////////////////////////
+      // Stops watching a source.  When this returns the source is not
+      // being called and will not be called again, unless it was
+      // called from within the source's own ProcessEvents().
+      // Does nothing if the source was already removed.
+      /////////////////////////////////////////////////////////////////
+
+      UCHAR GetThreadCount(void);
+      /////////////////////////////////////////////////////////////////
+      // Returns the number of running reactor threads.
+      /////////////////////////////////////////////////////////////////
+
+   private:
+
+      struct Loop;
+
+      struct Source
+      {
+         int iFd;
+         DSISerialReactorSource *pclSource;
+         Loop *pstLoop;
+         BOOL bRemoved;                                     // No longer watched, waiting to be freed by its loop.
+         Source *pstNext;
+      };
+
+      struct Loop
+      {
+         DSISerialReactor *pclReactor;
+         int iEpollFd;
+         int iWakeFd;                                       // eventfd used to wake the thread for Stop() and freed sources.
+         DSI_THREAD_ID hThread;
+         DSI_THREAD_IDNUM hThreadIDNum;
+         BOOL bRunning;
+         ULONG ulSources;                                   // Sources currently watched by this thread.
+         Source *pstActive;                                 // Source whose ProcessEvents() is running.
+         Source *pstRetired;                                // Removed sources, freed between wakeups.
+      };
+
+      Loop astLoop[DSI_SERIAL_REACTOR_MAX_THREADS];
+      UCHAR ucLoops;
+      Source *pstSources;                                   // All watched sources.
+
+      DSI_MUTEX stMutexCriticalSection;                     // Protects everything above.
+      DSI_CONDITION_VAR stCondSourceIdle;                   // Signalled when a loop leaves ProcessEvents().
+      DSI_CONDITION_VAR stCondThreadExit;                   // Signalled when a loop thread ends.
+      volatile BOOL bStop;
+
+      void RetireSource(Source *pstSource_);
+      void LoopThread(Loop *pstLoop_);
+      static DSI_THREAD_RETURN LoopThreadStart(void *pvParameter_);
+
+      DSISerialReactor(const DSISerialReactor&);            // Not copyable.
+      DSISerialReactor& operator=(const DSISerialReactor&);
+};
+
+#endif // defined(DSI_TYPES_LINUX)
+
+#endif // !defined(DSI_SERIAL_REACTOR_HPP)
@@ -0,0 +1,482 @@
+/*
+This software is subject to the license described in the License.txt file
+included with this software distribution. You may not use this file except
+in compliance with this license.
+
+Copyright (c) Dynastream Innovations Inc. 2016
+All rights reserved.
+*/
+
+#include "dsi_serial_replay.hpp"
+
+#include "types.h"
+#include "macros.h"
+#include "antmessage.h"
+#include "dsi_debug.hpp"
+
+#include <stdio.h>
+#include <string.h>
+
+
+//////////////////////////////////////////////////////////////////////////////////
+// Private Definitions
+//////////////////////////////////////////////////////////////////////////////////
+
+#define REPLAY_LINE_SIZE                  ((USHORT) 1280)   // Longer than any line DSIDebug::SerialWrite() produces.
+#define REPLAY_MAX_RECORD_SIZE            ((USHORT) 256)
+
+
+//////////////////////////////////////////////////////////////////////////////////
+// Public Methods
+//////////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////
+// Constructor
+///////////////////////////////////////////////////////////////////////
+DSISerialReplay::DSISerialReplay()
+{
+   hReplayThread = NULL;
+   bStopReplayThread = TRUE;
+   bReplayDone = FALSE;
+
+   ucPacing = DSI_SERIAL_REPLAY_REALTIME;
+   bSyncToWrites = TRUE;
+   bLoop = FALSE;
+   ucDeviceNumber = 0;
+
+   ulTxMessages = 0;
+   ulRxBytesReplayed = 0;
+
+   DSIThread_MutexInit(&stMutexCriticalSection);
+   DSIThread_CondInit(&stCondWrite);
+   DSIThread_CondInit(&stEventReplayThreadExit);
+
+   return;
+}
+
+///////////////////////////////////////////////////////////////////////
+// Destructor
+///////////////////////////////////////////////////////////////////////
+DSISerialReplay::~DSISerialReplay()
+{
+   Close();
+
+   DSIThread_MutexDestroy(&stMutexCriticalSection);
+   DSIThread_CondDestroy(&stCondWrite);
+   DSIThread_CondDestroy(&stEventReplayThreadExit);
+}
+
+///////////////////////////////////////////////////////////////////////
+// Loads a SERIAL_DEBUG device log.
+///////////////////////////////////////////////////////////////////////
+BOOL DSISerialReplay::LoadCapture(const char *pcFileName_)
+{
+   if (hReplayThread)
+      return FALSE;
+
+   FILE *pfFile = FOPEN(pcFileName_, "r");
+   if (pfFile == NULL)
+      return FALSE;
+
+   ClearCapture();
+
+   char acLine[REPLAY_LINE_SIZE];
+   ULONG ulTxCount = 0;
+
+   // Lines look like "%10.3f {%10lu} <header> - [XX][XX]...".
+   while (fgets(acLine, sizeof(acLine), pfFile) != NULL)
+   {
+      unsigned long ulTime;
+      if (sscanf(acLine, "%*f {%lu}", &ulTime) != 1)
+         continue;
+
+      char *pcHeader = strchr(acLine, '}');
+      if (pcHeader == NULL || pcHeader[1] != ' ')
+         continue;
+      pcHeader += 2;
+
+      char *pcData = strstr(pcHeader, " - ");
+      if (pcData == NULL || (pcData - pcHeader) != 2)
+         continue;
+
+      if (strncmp(pcHeader, "Tx", 2) == 0)
+      {
+         ulTxCount++;
+         continue;
+      }
+
+      if (strncmp(pcHeader, "Rx", 2) != 0)
+         continue;
+
+      UCHAR aucData[REPLAY_MAX_RECORD_SIZE];
+      USHORT usSize = 0;
+      unsigned int uiByte;
+
+      pcData += 3;
+      while (usSize < sizeof(aucData) && sscanf(pcData, "[%2X]", &uiByte) == 1)
+      {
+         aucData[usSize++] = (UCHAR) uiByte;
+         pcData += 4;
+      }
+
+      if (usSize != 0)
+         AddRxData(aucData, usSize, (ULONG) ulTime, ulTxCount);
+   }
+
+   fclose(pfFile);
+
+   #if defined(DEBUG_FILE)
+   {
+      char acString[256];
+      SNPRINTF(acString, sizeof(acString), "DSISerialReplay::LoadCapture(): %lu records, %lu bytes.", (unsigned long) clRecords.size(), (unsigned long) clRxData.size());
+      DSIDebug::ThreadWrite(acString);
+   }
+   #endif
+
+   return (clRecords.size() != 0);
+}
+
+///////////////////////////////////////////////////////////////////////
+// Appends received data to the capture.
+///////////////////////////////////////////////////////////////////////
+void DSISerialReplay::AddRxData(const UCHAR *pucData_, USHORT usSize_, ULONG ulTime_, ULONG ulTxMessages_)
+{
+   if (hReplayThread || pucData_ == NULL || usSize_ == 0)
+      return;
+
+   REPLAY_RECORD stRecord;
+   stRecord.ulTime = ulTime_;
+   stRecord.ulOffset = (ULONG) clRxData.size();
+   stRecord.usSize = usSize_;
+   stRecord.ulTxMessages = ulTxMessages_;
+
+   clRxData.insert(clRxData.end(), pucData_, pucData_ + usSize_);
+   clRecords.push_back(stRecord);
+}
+
+///////////////////////////////////////////////////////////////////////
+void DSISerialReplay::ClearCapture()
+{
+   if (hReplayThread)
+      return;
+
+   clRxData.clear();
+   clRecords.clear();
+}
+
+///////////////////////////////////////////////////////////////////////
+void DSISerialReplay::SetPacing(UCHAR ucPacing_)
+{
+   ucPacing = ucPacing_;
+}
+
+///////////////////////////////////////////////////////////////////////
+void DSISerialReplay::SetSyncToWrites(BOOL bSyncToWrites_)
+{
+   bSyncToWrites = bSyncToWrites_;
+}
+
+///////////////////////////////////////////////////////////////////////
+void DSISerialReplay::SetLoop(BOOL bLoop_)
+{
+   bLoop = bLoop_;
+}
+
+///////////////////////////////////////////////////////////////////////
+BOOL DSISerialReplay::IsReplayDone()
+{
+   DSIThread_MutexLock(&stMutexCriticalSection);
+   BOOL bDone = bReplayDone;
+   DSIThread_MutexUnlock(&stMutexCriticalSection);
+
+   return bDone;
+}
+
+///////////////////////////////////////////////////////////////////////
+ULONG DSISerialReplay::GetRxBytesReplayed()
+{
+   DSIThread_MutexLock(&stMutexCriticalSection);
+   ULONG ulBytes = ulRxBytesReplayed;
+   DSIThread_MutexUnlock(&stMutexCriticalSection);
+
+   return ulBytes;
+}
+
+///////////////////////////////////////////////////////////////////////
+// Copies out the bytes written since Open().
+///////////////////////////////////////////////////////////////////////
+ULONG DSISerialReplay::GetTxBytes(UCHAR *pucData_, ULONG ulSize_)
+{
+   DSIThread_MutexLock(&stMutexCriticalSection);
+
+   ULONG ulTotal = (ULONG) clTxData.size();
+   if (ulSize_ > ulTotal)
+      ulSize_ = ulTotal;
+
+   if (pucData_ != NULL && ulSize_ != 0)
+      memcpy(pucData_, &clTxData[0], ulSize_);
+
+   DSIThread_MutexUnlock(&stMutexCriticalSection);
+
+   return ulTotal;
+}
+
+///////////////////////////////////////////////////////////////////////
+ULONG DSISerialReplay::GetTxMessageCount()
+{
+   DSIThread_MutexLock(&stMutexCriticalSection);
+   ULONG ulCount = ulTxMessages;
+   DSIThread_MutexUnlock(&stMutexCriticalSection);
+
+   return ulCount;
+}
+
+///////////////////////////////////////////////////////////////////////
+// There is no device to find, so this only succeeds if a capture has
+// been loaded.
+///////////////////////////////////////////////////////////////////////
+BOOL DSISerialReplay::AutoInit()
+{
+   Close();
+   ucDeviceNumber = 0;
+
+   return (clRecords.size() != 0);
+}
+
+///////////////////////////////////////////////////////////////////////
+// Initializes the object.
+///////////////////////////////////////////////////////////////////////
+BOOL DSISerialReplay::Init(ULONG /*ulBaud_*/, UCHAR ucDeviceNumber_)
+{
+   Close();
+   ucDeviceNumber = ucDeviceNumber_;
+
+   return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////
+ULONG DSISerialReplay::GetDeviceSerialNumber()
+{
+   return 0;
+}
+
+///////////////////////////////////////////////////////////////////////
+// Starts replaying the capture from the beginning.
+///////////////////////////////////////////////////////////////////////
+BOOL DSISerialReplay::Open(void)
+{
+   // Make sure all handles are reset before opening again.
+   Close();
+
+   if (pclCallback == NULL)
+      return FALSE;
+
+   clTxData.clear();
+   ulTxMessages = 0;
+   ulRxBytesReplayed = 0;
+   bReplayDone = FALSE;
+
+   bStopReplayThread = FALSE;
+   hReplayThread = DSIThread_CreateThread(&DSISerialReplay::ProcessThread, this);
+   if (hReplayThread == NULL)
+   {
+      bStopReplayThread = TRUE;
+      return FALSE;
+   }
+
+   return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////
+// Stops the replay thread.
+///////////////////////////////////////////////////////////////////////
+void DSISerialReplay::Close(BOOL /*bReset_*/)
+{
+   if (hReplayThread == NULL)
+      return;
+
+   DSIThread_MutexLock(&stMutexCriticalSection);
+   if (bStopReplayThread == FALSE)
+   {
+      bStopReplayThread = TRUE;
+      DSIThread_CondBroadcast(&stCondWrite);
+
+      if (DSIThread_CondTimedWait(&stEventReplayThreadExit, &stMutexCriticalSection, 3000) != DSI_THREAD_ENONE)
+      {
+         // We were unable to stop the thread normally.
+         DSIThread_DestroyThread(hReplayThread);
+      }
+   }
+   DSIThread_MutexUnlock(&stMutexCriticalSection);
+
+   DSIThread_ReleaseThreadID(hReplayThread);
+   hReplayThread = NULL;
+
+   return;
+}
+
+///////////////////////////////////////////////////////////////////////
+// Records the bytes and releases any received data waiting on them.
+///////////////////////////////////////////////////////////////////////
+BOOL DSISerialReplay::WriteBytes(void *pvData_, USHORT usSize_)
+{
+   if (hReplayThread == NULL || pvData_ == NULL)
+      return FALSE;
+
+   UCHAR *pucData = (UCHAR*) pvData_;
+
+   DSIThread_MutexLock(&stMutexCriticalSection);
+   clTxData.insert(clTxData.end(), pucData, pucData + usSize_);
+   ulTxMessages += CountMessages(pucData, usSize_);
+   DSIThread_CondBroadcast(&stCondWrite);
+   DSIThread_MutexUnlock(&stMutexCriticalSection);
+
+   return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////
+UCHAR DSISerialReplay::GetDeviceNumber()
+{
+   return ucDeviceNumber;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// Private Methods
+//////////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////
+// Counts the framed messages in a write.  The framer never splits a
+// message across writes, so walking the frames from the start is enough.
+///////////////////////////////////////////////////////////////////////
+ULONG DSISerialReplay::CountMessages(const UCHAR *pucData_, USHORT usSize_)
+{
+   ULONG ulCount = 0;
+   USHORT usOffset = 0;
+
+   while (usOffset < usSize_)
+   {
+      if ((pucData_[usOffset] == MESG_TX_SYNC) && ((usOffset + MESG_SIZE_OFFSET) < usSize_))
+      {
+         ulCount++;
+         usOffset += pucData_[usOffset + MESG_SIZE_OFFSET] + MESG_FRAME_SIZE;
+      }
+      else
+      {
+         usOffset++;                                        // Padding
+      }
+   }
+
+   return ulCount;
+}
+
+///////////////////////////////////////////////////////////////////////
+// Blocks until the record may be delivered: the host has written
+// stRecord_.ulTxMessages messages and, in real-time mode, ulDueTime_ has
+// been reached.  Returns FALSE if the thread was stopped.
+///////////////////////////////////////////////////////////////////////
+BOOL DSISerialReplay::WaitForTurn(const REPLAY_RECORD& stRecord_, ULONG ulDueTime_)
+{
+   DSIThread_MutexLock(&stMutexCriticalSection);
+
+   while (bStopReplayThread == FALSE)
+   {
+      if (stRecord_.ulTxMessages > ulTxMessages)
+      {
+         DSIThread_CondTimedWait(&stCondWrite, &stMutexCriticalSection, 1000);
+         continue;
+      }
+
+      LONG lRemaining = (LONG) (ulDueTime_ - DSIThread_GetSystemTime());
+      if ((ucPacing == DSI_SERIAL_REPLAY_REALTIME) && (lRemaining > 0))
+      {
+         DSIThread_CondTimedWait(&stCondWrite, &stMutexCriticalSection, (ULONG) lRemaining);
+         continue;
+      }
+
+      break;
+   }
+
+   BOOL bContinue = !bStopReplayThread;
+   DSIThread_MutexUnlock(&stMutexCriticalSection);
+
+   return bContinue;
+}
+
+///////////////////////////////////////////////////////////////////////
+void DSISerialReplay::ReplayThread(void)
+{
+   ULONG ulIndex = 0;
+   BOOL bFirstPass = TRUE;
+   ULONG ulLastDelivery = DSIThread_GetSystemTime();
+
+   while (clRecords.size() != 0)
+   {
+      if (ulIndex >= clRecords.size())
+      {
+         if (bLoop == FALSE)
+            break;
+
+         ulIndex = 0;
+         bFirstPass = FALSE;
+      }
+
+      const REPLAY_RECORD& stRecord = clRecords[ulIndex];
+      BOOL bSync = (bSyncToWrites && bFirstPass);
+
+      // Keep the recorded gap from the previous record, counted from when
+      // that record was actually delivered (it may have waited on a write).
+      ULONG ulDelay = 0;
+      if ((ulIndex != 0) && (stRecord.ulTime > clRecords[ulIndex - 1].ulTime))
+         ulDelay = stRecord.ulTime - clRecords[ulIndex - 1].ulTime;
+
+      REPLAY_RECORD stGate = stRecord;
+      if (bSync == FALSE)
+         stGate.ulTxMessages = 0;
+
+      if (WaitForTurn(stGate, ulLastDelivery + ulDelay) == FALSE)
+         break;
+
+      ULONG ulOffset = stRecord.ulOffset;
+      ULONG ulSize = stRecord.usSize;
+      ulIndex++;
+
+      if (ucPacing == DSI_SERIAL_REPLAY_FAST)
+      {
+         // Records are stored back to back, so any that are already due can
+         // go out together, as they would in one USB transfer.
+         ULONG ulTxAllowed = GetTxMessageCount();
+
+         while ((ulIndex < clRecords.size()) &&
+                ((ulSize + clRecords[ulIndex].usSize) <= DSI_SERIAL_REPLAY_CHUNK_SIZE) &&
+                ((bSync == FALSE) || (clRecords[ulIndex].ulTxMessages <= ulTxAllowed)))
+         {
+            ulSize += clRecords[ulIndex].usSize;
+            ulIndex++;
+         }
+      }
+
+      pclCallback->ProcessBytes(&clRxData[ulOffset], ulSize);
+      ulLastDelivery = DSIThread_GetSystemTime();
+
+      DSIThread_MutexLock(&stMutexCriticalSection);
+      ulRxBytesReplayed += ulSize;
+      DSIThread_MutexUnlock(&stMutexCriticalSection);
+   }
+
+   // Like an idle device, stay open until we are closed.
+   DSIThread_MutexLock(&stMutexCriticalSection);
+   bReplayDone = TRUE;
+   while (bStopReplayThread == FALSE)
+      DSIThread_CondTimedWait(&stCondWrite, &stMutexCriticalSection, 1000);
+
+   DSIThread_CondSignal(&stEventReplayThreadExit);      // Set an event to alert the main process that the thread is finished and can be closed.
+   DSIThread_MutexUnlock(&stMutexCriticalSection);
+}
+
+///////////////////////////////////////////////////////////////////////
+DSI_THREAD_RETURN DSISerialReplay::ProcessThread(void *pvParameter_)
+{
+   DSISerialReplay *This = (DSISerialReplay*)pvParameter_;
+   This->ReplayThread();
+   return 0;
+}
@@ -0,0 +1,143 @@
+/*
+This software is subject to the license described in the License.txt file
+included with this software distribution. You may not use this file except
+in compliance with this license.
+
+Copyright (c) Dynastream Innovations Inc. 2016
+All rights reserved.
+*/
+
+#if !defined(DSI_SERIAL_REPLAY_HPP)
+#define DSI_SERIAL_REPLAY_HPP
+
+#include "types.h"
+#include "dsi_thread.h"
+#include "dsi_serial.hpp"
+
+#include <vector>
+
+
+//////////////////////////////////////////////////////////////////////////////////
+// Public Definitions
+//////////////////////////////////////////////////////////////////////////////////
+
+// Pacing modes.
+#define DSI_SERIAL_REPLAY_REALTIME     ((UCHAR) 0)       // Keep the recorded spacing between received messages.
+#define DSI_SERIAL_REPLAY_FAST         ((UCHAR) 1)       // Deliver received data as fast as the callback takes it.
+
+#define DSI_SERIAL_REPLAY_CHUNK_SIZE   ((USHORT) 4096)   // Most bytes handed to ProcessBytes() at once in fast mode.
+
+
+//////////////////////////////////////////////////////////////////////////////////
+// Public Class Prototypes
+//////////////////////////////////////////////////////////////////////////////////
+
+// Stands in for an ANT device by playing back received data recorded
+// in a SERIAL_DEBUG device log (DeviceN.txt).  Writes are recorded
+// instead of being sent anywhere.
+class DSISerialReplay : public DSISerial
+{
+   private:
+
+      typedef struct
+      {
+         ULONG ulTime;                                      // Log timestamp in ms.
+         ULONG ulOffset;                                    // Start of the data in clRxData.
+         USHORT usSize;
+         ULONG ulTxMessages;                                // Messages the host had written before this was received.
+      } REPLAY_RECORD;
+
+      std::vector<UCHAR> clRxData;
+      std::vector<REPLAY_RECORD> clRecords;
+      std::vector<UCHAR> clTxData;                          // Everything passed to WriteBytes() since Open().
+
+      DSI_THREAD_ID hReplayThread;                          // Handle for the replay thread.
+      DSI_MUTEX stMutexCriticalSection;                     // Protects the Tx record and the flags below.
+      DSI_CONDITION_VAR stCondWrite;                        // Signalled on writes and when the thread is told to stop.
+      DSI_CONDITION_VAR stEventReplayThreadExit;            // Event to signal the replay thread has ended.
+      BOOL bStopReplayThread;                               // Flag to stop the replay thread.
+      BOOL bReplayDone;
+
+      UCHAR ucPacing;
+      BOOL bSyncToWrites;
+      BOOL bLoop;
+      UCHAR ucDeviceNumber;
+
+      ULONG ulTxMessages;                                   // Framed messages seen in writes since Open().
+      ULONG ulRxBytesReplayed;
+
+      // Private Member Functions
+      BOOL WaitForTurn(const REPLAY_RECORD& stRecord_, ULONG ulDueTime_);
+      void ReplayThread();
+      static DSI_THREAD_RETURN ProcessThread(void *pvParameter_);
+      static ULONG CountMessages(const UCHAR *pucData_, USHORT usSize_);
+
+   public:
+      DSISerialReplay();
+      ~DSISerialReplay();
+
+      BOOL LoadCapture(const char *pcFileName_);
+      /////////////////////////////////////////////////////////////////
+      // Loads the "Rx" lines of a SERIAL_DEBUG device log, replacing
+      // any capture already loaded.  "Tx" lines are counted so
+      // received data can be held back until the host has written
+      // the same number of messages (see SetSyncToWrites()).
+      // Returns TRUE if at least one Rx line was loaded.
+      /////////////////////////////////////////////////////////////////
+
+      void AddRxData(const UCHAR *pucData_, USHORT usSize_, ULONG ulTime_ = 0, ULONG ulTxMessages_ = 0);
+      /////////////////////////////////////////////////////////////////
+      // Appends received data to the capture.
+      // Parameters:
+      //    *pucData_:        Raw bytes, as they would come from the device.
+      //    usSize_:          Number of bytes.
+      //    ulTime_:          Timestamp in ms, used for real-time pacing.
+      //    ulTxMessages_:    Messages the host must have written first.
+      /////////////////////////////////////////////////////////////////
+
+      void ClearCapture();
+
+      void SetPacing(UCHAR ucPacing_);
+      /////////////////////////////////////////////////////////////////
+      // Selects DSI_SERIAL_REPLAY_REALTIME (default) or
+      // DSI_SERIAL_REPLAY_FAST.  Takes effect on the next Open().
+      /////////////////////////////////////////////////////////////////
+
+      void SetSyncToWrites(BOOL bSyncToWrites_);
+      /////////////////////////////////////////////////////////////////
+      // When enabled (default), a record is not delivered until the
+      // host has written as many messages as had been written when it
+      // was captured, so command responses follow their commands.
+      /////////////////////////////////////////////////////////////////
+
+      void SetLoop(BOOL bLoop_);
+      /////////////////////////////////////////////////////////////////
+      // Restarts the capture from the beginning once it has all been
+      // delivered.  Write syncing only applies to the first pass.
+      /////////////////////////////////////////////////////////////////
+
+      BOOL IsReplayDone();
+      ULONG GetRxBytesReplayed();
+
+      ULONG GetTxBytes(UCHAR *pucData_, ULONG ulSize_);
+      /////////////////////////////////////////////////////////////////
+      // Copies up to ulSize_ of the bytes written since Open().
+      // Returns the total number of bytes written, which may be more
+      // than was copied.
+      /////////////////////////////////////////////////////////////////
+
+      ULONG GetTxMessageCount();
+
+      // Methods inherited from the base class:
+      BOOL AutoInit();
+      BOOL Init(ULONG ulBaud_, UCHAR ucDeviceNumber_);
+      ULONG GetDeviceSerialNumber();
+
+      BOOL Open();
+      void Close(BOOL bReset = FALSE);
+      BOOL WriteBytes(void *pvData_, USHORT usSize_);
+      UCHAR GetDeviceNumber();
+
+};
+
+#endif // !defined(DSI_SERIAL_REPLAY_HPP)
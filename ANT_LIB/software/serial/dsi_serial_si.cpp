@@ -314,18 +314,18 @@ UCHAR DSISerialSI::GetDeviceNumber()
 ///////////////////////////////////////////////////////////////////////
 void DSISerialSI::ReceiveThread(void)
 {
-   UCHAR ucRxByte;
+   UCHAR aucRxData[255];
    ULONG ulRxBytesRead;
 
    while(!bStopReceiveThread)
    {
 
-      USBError::Enum eStatus = pclDeviceHandle->Read(&ucRxByte, 1, ulRxBytesRead, 1000);
+      USBError::Enum eStatus = pclDeviceHandle->Read(aucRxData, sizeof(aucRxData), ulRxBytesRead, 1000);
 
       switch(eStatus)
       {
          case USBError::NONE:
-            pclCallback->ProcessByte(ucRxByte);
+            pclCallback->ProcessBytes(aucRxData, ulRxBytesRead);
             break;
 
          case USBError::DEVICE_GONE:
@@ -0,0 +1,507 @@
+/*
+This software is subject to the license described in the License.txt file
+included with this software distribution. You may not use this file except
+in compliance with this license.
+
+Copyright (c) Dynastream Innovations Inc. 2016
+All rights reserved.
+*/
+#include "types.h"
+#if defined(DSI_TYPES_LINUX)
+#include "defines.h"
+#include "dsi_serial_tty.hpp"
+#include "macros.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <asm/termbits.h>     // termios2, for arbitrary baud rates.  Can't be mixed with <termios.h>.
+
+
+//////////////////////////////////////////////////////////////////////////////////
+// Private Definitions
+//////////////////////////////////////////////////////////////////////////////////
+
+//defines used by AutoInit
+#define ANT_USB_VID           "0fcf"
+#define ANT_USB_VID_TWO       "1915"
+#define ANT_USB_STICK_PID     0x1004
+#define ANT_USB_STICK_BAUD    ((USHORT)50000)
+#define ANT_DEFAULT_BAUD      ((USHORT)57600)
+
+#define WRITE_TIMEOUT_MS      1000
+
+
+//////////////////////////////////////////////////////////////////////////////////
+// Public Methods
+//////////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////
+// Constructor
+///////////////////////////////////////////////////////////////////////
+DSISerialTTY::DSISerialTTY()
+{
+   hReceiveThread = (DSI_THREAD_ID)NULL;
+   bStopReceiveThread = TRUE;
+   iFd = -1;
+   iEpollFd = -1;
+   iWakeFd = -1;
+   pclReactor = (DSISerialReactor*)NULL;
+   bReactorSource = FALSE;
+   acDevicePath[0] = '\0';
+   ucDeviceNumber = 0xFF;
+   ulBaud = 0;
+}
+
+///////////////////////////////////////////////////////////////////////
+// Destructor
+///////////////////////////////////////////////////////////////////////
+DSISerialTTY::~DSISerialTTY()
+{
+   Close();
+}
+
+///////////////////////////////////////////////////////////////////////
+// Finds the first ANT USB device exposed as a tty.
+///////////////////////////////////////////////////////////////////////
+BOOL DSISerialTTY::AutoInit()
+{
+   Close();
+   acDevicePath[0] = '\0';
+   ucDeviceNumber = 0xFF;
+
+   DIR* pstDir = opendir("/sys/class/tty");
+   if(pstDir == NULL)
+      return FALSE;
+
+   BOOL bFound = FALSE;
+   struct dirent* pstEntry;
+   while(!bFound && (pstEntry = readdir(pstDir)) != NULL)
+   {
+      const char* pcName = pstEntry->d_name;
+      if(strncmp(pcName, "ttyUSB", 6) != 0 && strncmp(pcName, "ttyACM", 6) != 0)
+         continue;
+
+      char acVid[8];
+      char acPid[8];
+      if(!ReadUSBAttribute(pcName, "idVendor", acVid, sizeof(acVid)) || !ReadUSBAttribute(pcName, "idProduct", acPid, sizeof(acPid)))
+         continue;
+
+      if(strcmp(acVid, ANT_USB_VID) != 0 && strcmp(acVid, ANT_USB_VID_TWO) != 0)
+         continue;
+
+      SNPRINTF(acDevicePath, sizeof(acDevicePath), "/dev/%s", pcName);
+      ucDeviceNumber = (UCHAR)atoi(&pcName[6]);
+      ulBaud = (strtoul(acPid, NULL, 16) == ANT_USB_STICK_PID) ? ANT_USB_STICK_BAUD : ANT_DEFAULT_BAUD;
+      bFound = TRUE;
+   }
+
+   closedir(pstDir);
+   return bFound;
+}
+
+///////////////////////////////////////////////////////////////////////
+// Initializes the object.
+///////////////////////////////////////////////////////////////////////
+BOOL DSISerialTTY::Init(ULONG ulBaud_, UCHAR ucDeviceNumber_)
+{
+   Close();
+
+   ulBaud = ulBaud_;
+   ucDeviceNumber = ucDeviceNumber_;
+   SNPRINTF(acDevicePath, sizeof(acDevicePath), "/dev/ttyUSB%u", ucDeviceNumber_);
+
+   return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////
+// Initializes the object.
+///////////////////////////////////////////////////////////////////////
+BOOL DSISerialTTY::Init(ULONG ulBaud_, const char* pcDevicePath_, UCHAR ucDeviceNumber_)
+{
+   Close();
+
+   if(pcDevicePath_ == NULL || strlen(pcDevicePath_) >= sizeof(acDevicePath))
+      return FALSE;
+
+   ulBaud = ulBaud_;
+   ucDeviceNumber = ucDeviceNumber_;
+   STRNCPY(acDevicePath, pcDevicePath_, sizeof(acDevicePath));
+
+   return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////
+// Returns the device serial number.
+///////////////////////////////////////////////////////////////////////
+ULONG DSISerialTTY::GetDeviceSerialNumber()
+{
+   const char* pcName = strrchr(acDevicePath, '/');
+   if(pcName == NULL)
+      return 0xFFFFFFFF;
+
+   char acSerial[32];
+   if(!ReadUSBAttribute(pcName + 1, "serial", acSerial, sizeof(acSerial)))
+      return 0xFFFFFFFF; // unsupported
+
+   return strtoul(acSerial, NULL, 10);
+}
+
+///////////////////////////////////////////////////////////////////////
+// Opens port, starts receive thread.
+///////////////////////////////////////////////////////////////////////
+BOOL DSISerialTTY::Open(void)
+{
+   // Make sure all handles are reset before opening again.
+   Close();
+
+   if (pclCallback == NULL || acDevicePath[0] == '\0')
+      return FALSE;
+
+   iFd = open(acDevicePath, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+   if(iFd < 0)
+   {
+      Close();
+      return FALSE;
+   }
+
+   if(!ConfigurePort())
+   {
+      Close();
+      return FALSE;
+   }
+
+   if(pclReactor != NULL)
+   {
+      if(!pclReactor->AddSource(iFd, this))
+      {
+         Close();
+         return FALSE;
+      }
+
+      bReactorSource = TRUE;
+      return TRUE;
+   }
+
+   iWakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+   iEpollFd = epoll_create1(EPOLL_CLOEXEC);
+   if(iWakeFd < 0 || iEpollFd < 0)
+   {
+      Close();
+      return FALSE;
+   }
+
+   struct epoll_event stEvent;
+   memset(&stEvent, 0, sizeof(stEvent));
+   stEvent.events = EPOLLIN;
+   stEvent.data.fd = iFd;
+   if(epoll_ctl(iEpollFd, EPOLL_CTL_ADD, iFd, &stEvent) != 0)
+   {
+      Close();
+      return FALSE;
+   }
+
+   stEvent.data.fd = iWakeFd;
+   if(epoll_ctl(iEpollFd, EPOLL_CTL_ADD, iWakeFd, &stEvent) != 0)
+   {
+      Close();
+      return FALSE;
+   }
+
+   if(DSIThread_MutexInit(&stMutexCriticalSection) != DSI_THREAD_ENONE)
+   {
+      Close();
+      return FALSE;
+   }
+
+   if(DSIThread_CondInit(&stEventReceiveThreadExit) != DSI_THREAD_ENONE)
+   {
+      DSIThread_MutexDestroy(&stMutexCriticalSection);
+      Close();
+      return FALSE;
+   }
+
+   bStopReceiveThread = FALSE;
+   hReceiveThread = DSIThread_CreateThread(&DSISerialTTY::ProcessThread, this);
+   if(hReceiveThread == (DSI_THREAD_ID)NULL)
+   {
+      DSIThread_MutexDestroy(&stMutexCriticalSection);
+      DSIThread_CondDestroy(&stEventReceiveThreadExit);
+      Close();
+      return FALSE;
+   }
+
+   return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////
+// Closes the tty, kills receive thread.
+///////////////////////////////////////////////////////////////////////
+void DSISerialTTY::Close(BOOL /*bReset*/) //Commented to avoid compiler warning about unreferenced formal parameter.
+{
+   if(bReactorSource)
+   {
+      pclReactor->RemoveSource(this);
+      bReactorSource = FALSE;
+   }
+
+   if(hReceiveThread)
+   {
+      DSIThread_MutexLock(&stMutexCriticalSection);
+      if(bStopReceiveThread == FALSE)
+      {
+         bStopReceiveThread = TRUE;
+
+         // Kick the receive thread out of epoll_wait().
+         uint64_t ullWake = 1;
+         if(write(iWakeFd, &ullWake, sizeof(ullWake)) < 0) {}  //if the counter is already set the thread is waking anyway
+
+         if (DSIThread_CondTimedWait(&stEventReceiveThreadExit, &stMutexCriticalSection, 3000) != DSI_THREAD_ENONE)
+         {
+            // We were unable to stop the thread normally.
+            DSIThread_DestroyThread(hReceiveThread);
+         }
+      }
+      DSIThread_MutexUnlock(&stMutexCriticalSection);
+
+      DSIThread_ReleaseThreadID(hReceiveThread);
+      hReceiveThread = (DSI_THREAD_ID)NULL;
+
+      DSIThread_MutexDestroy(&stMutexCriticalSection);
+      DSIThread_CondDestroy(&stEventReceiveThreadExit);
+   }
+
+   if(iEpollFd >= 0)
+   {
+      close(iEpollFd);
+      iEpollFd = -1;
+   }
+
+   if(iWakeFd >= 0)
+   {
+      close(iWakeFd);
+      iWakeFd = -1;
+   }
+
+   if(iFd >= 0)
+   {
+      ioctl(iFd, TCFLSH, TCIOFLUSH);
+      close(iFd);
+      iFd = -1;
+   }
+
+   return;
+}
+
+///////////////////////////////////////////////////////////////////////
+// Writes usSize_ bytes to the tty.
+///////////////////////////////////////////////////////////////////////
+BOOL DSISerialTTY::WriteBytes(void *pvData_, USHORT usSize_)
+{
+   if(iFd < 0 || pvData_ == NULL)
+      return FALSE;
+
+   const UCHAR* pucData = (const UCHAR*)pvData_;
+   USHORT usWritten = 0;
+
+   while(usWritten < usSize_)
+   {
+      ssize_t iRet = write(iFd, &pucData[usWritten], usSize_ - usWritten);
+      if(iRet > 0)
+      {
+         usWritten += (USHORT)iRet;
+         continue;
+      }
+
+      if(iRet < 0 && errno == EINTR)
+         continue;
+
+      if(iRet < 0 && errno == EAGAIN)
+      {
+         // Output buffer is full, wait for the driver to drain it.
+         struct pollfd stPoll;
+         stPoll.fd = iFd;
+         stPoll.events = POLLOUT;
+         stPoll.revents = 0;
+         if(poll(&stPoll, 1, WRITE_TIMEOUT_MS) > 0 && (stPoll.revents & POLLOUT))
+            continue;
+      }
+
+      pclCallback->Error(DSI_SERIAL_EWRITE);
+      return FALSE;
+   }
+
+   return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////
+// Returns the device port number.
+///////////////////////////////////////////////////////////////////////
+UCHAR DSISerialTTY::GetDeviceNumber()
+{
+   return ucDeviceNumber;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// Private Methods
+//////////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////
+// Puts the tty in raw 8N1 mode at ulBaud.
+///////////////////////////////////////////////////////////////////////
+BOOL DSISerialTTY::ConfigurePort()
+{
+   struct termios2 stTio;
+
+   if(ioctl(iFd, TCGETS2, &stTio) != 0)
+      return FALSE;
+
+   stTio.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL | IXON | IXOFF | IXANY);
+   stTio.c_oflag &= ~OPOST;
+   stTio.c_lflag &= ~(ECHO | ECHONL | ICANON | ISIG | IEXTEN);
+   stTio.c_cflag &= ~(CSIZE | PARENB | CSTOPB | CRTSCTS | CBAUD);
+   stTio.c_cflag |= CS8 | CREAD | CLOCAL | BOTHER;    // BOTHER: take the rate from c_ispeed/c_ospeed as is.
+   stTio.c_ispeed = ulBaud;
+   stTio.c_ospeed = ulBaud;
+   stTio.c_cc[VMIN] = 0;                              // Non-blocking, epoll tells us when there is data.
+   stTio.c_cc[VTIME] = 0;
+
+   if(ioctl(iFd, TCSETS2, &stTio) != 0)
+      return FALSE;
+
+   ioctl(iFd, TCFLSH, TCIOFLUSH);
+   return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////
+// Reads a sysfs attribute of the USB device behind a tty.
+///////////////////////////////////////////////////////////////////////
+BOOL DSISerialTTY::ReadUSBAttribute(const char* pcTTYName_, const char* pcAttribute_, char* pcValue_, USHORT usSize_)
+{
+   // ttyACM devices hang off the USB interface, ttyUSB devices hang off a port below it.
+   static const char* const apcFormats[] = { "/sys/class/tty/%s/device/../%s", "/sys/class/tty/%s/device/../../%s" };
+
+   for(UCHAR i = 0; i < sizeof(apcFormats)/sizeof(apcFormats[0]); i++)
+   {
+      char acPath[256];
+      SNPRINTF(acPath, sizeof(acPath), apcFormats[i], pcTTYName_, pcAttribute_);
+
+      FILE* pfFile = fopen(acPath, "r");
+      if(pfFile == NULL)
+         continue;
+
+      char* pcRet = fgets(pcValue_, usSize_, pfFile);
+      fclose(pfFile);
+      if(pcRet == NULL)
+         continue;
+
+      pcValue_[strcspn(pcValue_, "\r\n")] = '\0';
+      return TRUE;
+   }
+
+   return FALSE;
+}
+
+///////////////////////////////////////////////////////////////////////
+void DSISerialTTY::SetReactor(DSISerialReactor *pclReactor_)
+{
+   pclReactor = pclReactor_;
+}
+
+///////////////////////////////////////////////////////////////////////
+BOOL DSISerialTTY::ProcessEvents(ULONG ulEvents_, UCHAR *pucBuffer_, ULONG ulBufferSize_)
+{
+   BOOL bDeviceGone = FALSE;
+
+   if(ulEvents_ & EPOLLIN)
+   {
+      for(;;)
+      {
+         ssize_t iRead = read(iFd, pucBuffer_, ulBufferSize_);
+         if(iRead > 0)
+         {
+            pclCallback->ProcessBytes(pucBuffer_, (ULONG)iRead);
+            if((ULONG)iRead < ulBufferSize_)
+               break;   //short read, the driver buffer is drained
+         }
+         else if(iRead < 0 && errno == EINTR)
+         {
+            continue;
+         }
+         else if(iRead < 0 && errno == EAGAIN)
+         {
+            break;
+         }
+         else
+         {
+            bDeviceGone = TRUE;   //EOF (hangup) or EIO, the stick was unplugged
+            break;
+         }
+      }
+   }
+   else if(ulEvents_ & (EPOLLHUP | EPOLLERR))
+   {
+      bDeviceGone = TRUE;
+   }
+
+   if(bDeviceGone)
+   {
+      pclCallback->Error(DSI_SERIAL_DEVICE_GONE);
+      return FALSE;
+   }
+
+   return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////
+void DSISerialTTY::ReceiveThread(void)
+{
+   UCHAR aucRxData[DSI_SERIAL_TTY_RX_BUFFER_SIZE];
+   struct epoll_event astEvents[2];
+
+   while(!bStopReceiveThread)
+   {
+      // Blocks with no timeout, an idle port costs no wakeups.
+      int iEvents = epoll_wait(iEpollFd, astEvents, 2, -1);
+      if(iEvents < 0)
+      {
+         if(errno == EINTR)
+            continue;
+
+         pclCallback->Error(DSI_SERIAL_EREAD);
+         break;
+      }
+
+      for(int i = 0; i < iEvents && !bStopReceiveThread; i++)
+      {
+         if(astEvents[i].data.fd != iFd)
+            continue;   //wake up from Close()
+
+         if(!ProcessEvents(astEvents[i].events, aucRxData, sizeof(aucRxData)))
+            bStopReceiveThread = TRUE;
+      }
+   }
+
+   DSIThread_MutexLock(&stMutexCriticalSection);
+      bStopReceiveThread = TRUE;
+      DSIThread_CondSignal(&stEventReceiveThreadExit);                       // Set an event to alert the main process that Rx thread is finished and can be closed.
+   DSIThread_MutexUnlock(&stMutexCriticalSection);
+}
+
+///////////////////////////////////////////////////////////////////////
+DSI_THREAD_RETURN DSISerialTTY::ProcessThread(void *pvParameter_)
+{
+   DSISerialTTY *This = (DSISerialTTY *) pvParameter_;
+   This->ReceiveThread();
+   return 0;
+}
+
+#endif //defined(DSI_TYPES_LINUX)
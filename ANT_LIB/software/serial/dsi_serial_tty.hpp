@@ -0,0 +1,107 @@
+/*
+This software is subject to the license described in the License.txt file
+included with this software distribution. You may not use this file except
+in compliance with this license.
+
+Copyright (c) Dynastream Innovations Inc. 2016
+All rights reserved.
+*/
+#if !defined(DSI_SERIAL_TTY_HPP)
+#define DSI_SERIAL_TTY_HPP
+
+#include "types.h"
+
+#if defined(DSI_TYPES_LINUX) // The TTY module is currently only supported on linux
+#include "dsi_thread.h"
+#include "dsi_serial.hpp"
+#include "dsi_serial_callback.hpp"
+#include "dsi_serial_reactor.hpp"
+
+
+//////////////////////////////////////////////////////////////////////////////////
+// Public Definitions
+//////////////////////////////////////////////////////////////////////////////////
+
+#define DSI_SERIAL_TTY_PATH_SIZE       64
+#define DSI_SERIAL_TTY_RX_BUFFER_SIZE  4096
+
+
+//////////////////////////////////////////////////////////////////////////////////
+// Public Class Prototypes
+//////////////////////////////////////////////////////////////////////////////////
+
+class DSISerialTTY : public DSISerial, public DSISerialReactorSource
+{
+   private:
+
+      DSI_THREAD_ID hReceiveThread;                         // Handle for the receive thread.
+      DSI_MUTEX stMutexCriticalSection;                     // Mutex used with the wait condition
+      DSI_CONDITION_VAR stEventReceiveThreadExit;           // Event to signal the receive thread has ended.
+      volatile BOOL bStopReceiveThread;                     // Flag to stop the receive thread.
+
+      int iFd;                                              // Non-blocking tty file descriptor.
+      int iEpollFd;                                         // epoll instance watching iFd and iWakeFd.
+      int iWakeFd;                                          // eventfd used to wake the receive thread on Close().
+
+      DSISerialReactor *pclReactor;                         // If set, iFd is served by the reactor instead of a receive thread.
+      BOOL bReactorSource;                                  // iFd is currently registered with pclReactor.
+
+      char acDevicePath[DSI_SERIAL_TTY_PATH_SIZE];
+      UCHAR ucDeviceNumber;
+      ULONG ulBaud;
+
+      // Private Member Functions
+      BOOL ConfigurePort();
+      void ReceiveThread();
+      static DSI_THREAD_RETURN ProcessThread(void *pvParameter_);
+      static BOOL ReadUSBAttribute(const char* pcTTYName_, const char* pcAttribute_, char* pcValue_, USHORT usSize_);
+
+   public:
+      DSISerialTTY();
+      ~DSISerialTTY();
+
+      BOOL Init(ULONG ulBaud_, const char* pcDevicePath_, UCHAR ucDeviceNumber_ = 0);
+      /////////////////////////////////////////////////////////////////
+      // Initializes the object with an explicit device node.
+      // Parameters:
+      //    ulBaud_:          Baud rate.  Non-standard rates are set
+      //                      with termios2.
+      //    *pcDevicePath_:   Device node, e.g. "/dev/ttyACM0".
+      //    ucDeviceNumber_:  Number reported by GetDeviceNumber().
+      // Returns TRUE if successful.  Otherwise, it returns FALSE.
+      /////////////////////////////////////////////////////////////////
+
+      // Methods inherited from the base class:
+      BOOL AutoInit();
+      ULONG GetDeviceSerialNumber();
+
+      BOOL Init(ULONG ulBaud_, UCHAR ucDeviceNumber_);
+      /////////////////////////////////////////////////////////////////
+      // Initializes the object to use /dev/ttyUSB<ucDeviceNumber_>.
+      /////////////////////////////////////////////////////////////////
+
+      void SetReactor(DSISerialReactor *pclReactor_);
+      /////////////////////////////////////////////////////////////////
+      // Serves the port from a shared reactor instead of its own
+      // receive thread.  Takes effect on the next Open().
+      // Parameters:
+      //    *pclReactor_:     A started reactor, or NULL to use a
+      //                      receive thread again.
+      /////////////////////////////////////////////////////////////////
+
+      BOOL ProcessEvents(ULONG ulEvents_, UCHAR *pucBuffer_, ULONG ulBufferSize_);
+      /////////////////////////////////////////////////////////////////
+      // Reads everything available on the port and passes it to the
+      // callback.  Reports DSI_SERIAL_DEVICE_GONE and returns FALSE if
+      // the stick was unplugged.
+      /////////////////////////////////////////////////////////////////
+
+      BOOL Open();
+      void Close(BOOL bReset = FALSE);
+      BOOL WriteBytes(void *pvData_, USHORT usSize_);
+      UCHAR GetDeviceNumber();
+};
+
+#endif // defined(DSI_TYPES_LINUX)
+
+#endif // !defined(DSI_SERIAL_TTY_HPP)
@@ -168,7 +168,7 @@ BOOL DSISerialVCP::Open(void)
       return FALSE;
    }
 
-   commTimeout.ReadIntervalTimeout = 0;
+   commTimeout.ReadIntervalTimeout = MAXDWORD;              // Reads return immediately with whatever is already buffered.
    commTimeout.ReadTotalTimeoutMultiplier = 0;
    commTimeout.ReadTotalTimeoutConstant = 0;
 
@@ -315,7 +315,7 @@ UCHAR DSISerialVCP::GetDeviceNumber()
 ///////////////////////////////////////////////////////////////////////
 void DSISerialVCP::ReceiveThread(void)
 {
-   UCHAR ucRxByte;
+   UCHAR aucRxData[255];
    DWORD ulRxBytesRead;
    DWORD dwCommEvent;
    OVERLAPPED osRead = {0};
@@ -325,19 +325,26 @@ void DSISerialVCP::ReceiveThread(void)
    if (!SetCommMask(hComm, EV_RXCHAR))
       pclCallback->Error(DSI_SERIAL_EREAD);
 
+   osRead.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+   if (osRead.hEvent == NULL)                        // Error creating overlapped event handle.
+   {
+      pclCallback->Error(DSI_SERIAL_EREAD);
+      bStopReceiveThread = TRUE;
+   }
+
    while(!bStopReceiveThread)
    {
       if (WaitCommEvent(hComm, &dwCommEvent, NULL))
       {
          do
          {
-            osRead.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
-            if (osRead.hEvent == NULL)               // Error creating overlapped event handle.
-               break;
+            ulRxBytesRead = 0;
+            ResetEvent(osRead.hEvent);
 
-            if (ReadFile(hComm, &ucRxByte, 1, &ulRxBytesRead, &osRead))
+            // Drain everything the driver has buffered in one call.
+            if (ReadFile(hComm, aucRxData, sizeof(aucRxData), &ulRxBytesRead, &osRead))
             {
-               pclCallback->ProcessByte(ucRxByte);
+               pclCallback->ProcessBytes(aucRxData, ulRxBytesRead);
             }
             else
             {
@@ -356,14 +363,12 @@ void DSISerialVCP::ReceiveThread(void)
                      if (!GetOverlappedResult(hComm, &osRead, &ulRxBytesRead, TRUE))
                         pclCallback->Error(DSI_SERIAL_EREAD);
                      else
-                        pclCallback->ProcessByte(ucRxByte);
+                        pclCallback->ProcessBytes(aucRxData, ulRxBytesRead);
 
                   }
                }
             }
 
-            CloseHandle(osRead.hEvent);
-
          } while (ulRxBytesRead);
       }
       else
@@ -372,6 +377,9 @@ void DSISerialVCP::ReceiveThread(void)
       }
    }
 
+   if (osRead.hEvent != NULL)
+      CloseHandle(osRead.hEvent);
+
    DSIThread_MutexLock(&stMutexCriticalSection);
       bStopReceiveThread = TRUE;
       DSIThread_CondSignal(&stEventReceiveThreadExit);                       // Set an event to alert the main process that Rx thread is finished and can be closed.
@@ -0,0 +1,243 @@
+/*
+This software is subject to the license described in the License.txt file
+included with this software distribution. You may not use this file except
+in compliance with this license.
+
+Copyright (c) Dynastream Innovations Inc. 2016
+All rights reserved.
+*/
+#ifndef DSI_TS_RING_BUFFER_HPP
+#define DSI_TS_RING_BUFFER_HPP
+
+#include "types.h"
+#include "dsi_thread.h"
+
+#include <string.h>
+
+#if defined(DSI_TYPES_WINDOWS)
+   #include <windows.h>
+#endif
+
+
+//////////////////////////////////////////////////////////////////////////////////
+// Public Definitions
+//////////////////////////////////////////////////////////////////////////////////
+
+#define TS_RING_BUFFER_DEFAULT_SIZE    ((ULONG)65536)    // Must be a power of two.
+
+#if defined(DSI_TYPES_WINDOWS)
+   #define TS_RING_BUFFER_BARRIER()    MemoryBarrier()
+#else
+   #define TS_RING_BUFFER_BARRIER()    __sync_synchronize()
+#endif
+
+
+//////////////////////////////////////////////////////////////////////////////////
+// Public Class Prototypes
+//////////////////////////////////////////////////////////////////////////////////
+
+//NOTE: Exactly one thread may push and exactly one thread may pop.
+//NOTE: T must be safe to copy with memcpy (UCHAR, char, ...).
+//NOTE: Make sure nobody is still using this ring when it is being destroyed!
+template <class T>
+class TSRingBuffer  //thread-safe single-producer/single-consumer ring buffer
+{
+  public:
+
+   TSRingBuffer(ULONG ulCapacity_ = TS_RING_BUFFER_DEFAULT_SIZE)
+   {
+      // Round up to a power of two so indices can be masked.
+      ulCapacity = 1;
+      while(ulCapacity < ulCapacity_)
+         ulCapacity <<= 1;
+      ulMask = ulCapacity - 1;
+
+      ulHead = 0;
+      ulTail = 0;
+      bConsumerWaiting = FALSE;
+
+      UCHAR ret;
+      ret = DSIThread_CondInit(&stEventPush);
+      if(ret != DSI_THREAD_ENONE)
+         throw; //!!Need to throw something!
+
+      ret = DSIThread_MutexInit(&stMutex);
+      if(ret != DSI_THREAD_ENONE)
+      {
+         DSIThread_CondDestroy(&stEventPush);
+         throw; //!!Need to throw something!
+      }
+
+      ptBuffer = new T[ulCapacity];
+
+      return;
+   }
+
+   ~TSRingBuffer()
+   {
+      delete[] ptBuffer;
+      DSIThread_MutexDestroy(&stMutex);
+      DSIThread_CondDestroy(&stEventPush);
+      return;
+   }
+
+
+   BOOL Push(const T& tElement_)
+   {
+      return (PushArray(&tElement_, 1) == 1);
+   }
+   /////////////////////////////////////////////////////////////////
+   // Pushes one element.
+   // Returns FALSE if the ring is full and the element was dropped.
+   /////////////////////////////////////////////////////////////////
+
+   ULONG PushArray(const T* ptElementArray_, ULONG ulSize_)
+   {
+      if(ptElementArray_ == NULL || ulSize_ == 0)
+         return 0;
+
+      ULONG ulHeadNow = ulHead;
+      ULONG ulTailNow = ulTail;
+      TS_RING_BUFFER_BARRIER();                    // Read the tail before reusing the space it frees.
+
+      ULONG ulFree = ulCapacity - (ulHeadNow - ulTailNow);
+      ULONG ulCount = (ulSize_ < ulFree) ? ulSize_ : ulFree;  //MIN(ulSize_, ulFree);
+      if(ulCount == 0)
+         return 0;
+
+      ULONG ulStart = ulHeadNow & ulMask;
+      ULONG ulFirst = ulCapacity - ulStart;
+      if(ulFirst > ulCount)
+         ulFirst = ulCount;
+
+      memcpy(&ptBuffer[ulStart], ptElementArray_, ulFirst * sizeof(T));
+      if(ulCount > ulFirst)
+         memcpy(&ptBuffer[0], &ptElementArray_[ulFirst], (ulCount - ulFirst) * sizeof(T));
+
+      TS_RING_BUFFER_BARRIER();                    // Data must be visible before the new head.
+      ulHead = ulHeadNow + ulCount;
+      TS_RING_BUFFER_BARRIER();                    // Publish the head before checking for a sleeping consumer.
+
+      // Only wake the consumer on an empty to non-empty transition, and only
+      // if it is actually waiting.  The tail is re-read since the consumer may
+      // have drained the ring while we were copying.  Taking the mutex guarantees
+      // the consumer is inside DSIThread_CondTimedWait() and cannot miss the signal.
+      if(ulTail == ulHeadNow && bConsumerWaiting)
+      {
+         DSIThread_MutexLock(&stMutex);
+         if(bConsumerWaiting)                      // It may have timed out in the meantime.
+            DSIThread_CondSignal(&stEventPush);
+         DSIThread_MutexUnlock(&stMutex);
+      }
+
+      return ulCount;
+   }
+   /////////////////////////////////////////////////////////////////
+   // Pushes up to ulSize_ elements.
+   // Returns the number of elements pushed.  If the ring fills up,
+   // the elements that did not fit are dropped.
+   /////////////////////////////////////////////////////////////////
+
+
+   BOOL Pop(T& tElement_, ULONG ulWaitTime_ = 0)
+   {
+      return (PopArray(&tElement_, 1, ulWaitTime_) == 1);
+   }
+   /////////////////////////////////////////////////////////////////
+   // Pops one element, waiting up to ulWaitTime_ ms for one to
+   // arrive.  Returns FALSE on timeout.
+   /////////////////////////////////////////////////////////////////
+
+   ULONG PopArray(T* const ptElementArray_, ULONG ulMaxSize_, ULONG ulWaitTime_ = 0)
+   {
+      if(ptElementArray_ == NULL || ulMaxSize_ == 0)
+         return 0;
+
+      if(GetCount() == 0)
+      {
+         DSIThread_MutexLock(&stMutex);
+         {
+            bConsumerWaiting = TRUE;
+            TS_RING_BUFFER_BARRIER();              // Publish the flag before re-checking the head.
+
+            if(GetCount() == 0)
+            {
+               UCHAR ret;
+               ret = DSIThread_CondTimedWait(&stEventPush, &stMutex, ulWaitTime_);
+               if(ret != DSI_THREAD_ENONE)
+               {
+                  bConsumerWaiting = FALSE;
+                  DSIThread_MutexUnlock(&stMutex);
+                  return 0;
+               }
+            }
+
+            bConsumerWaiting = FALSE;
+         }
+         DSIThread_MutexUnlock(&stMutex);
+      }
+
+      ULONG ulTailNow = ulTail;
+      ULONG ulHeadNow = ulHead;
+      TS_RING_BUFFER_BARRIER();                    // Read the head before the data it covers.
+
+      ULONG ulAvailable = ulHeadNow - ulTailNow;
+      ULONG ulCount = (ulMaxSize_ < ulAvailable) ? ulMaxSize_ : ulAvailable;  //MIN(ulMaxSize_, ulAvailable);
+      if(ulCount == 0)
+         return 0;
+
+      ULONG ulStart = ulTailNow & ulMask;
+      ULONG ulFirst = ulCapacity - ulStart;
+      if(ulFirst > ulCount)
+         ulFirst = ulCount;
+
+      memcpy(ptElementArray_, &ptBuffer[ulStart], ulFirst * sizeof(T));
+      if(ulCount > ulFirst)
+         memcpy(&ptElementArray_[ulFirst], &ptBuffer[0], (ulCount - ulFirst) * sizeof(T));
+
+      TS_RING_BUFFER_BARRIER();                    // Finish reading before handing the space back.
+      ulTail = ulTailNow + ulCount;
+
+      return ulCount;
+   }
+   /////////////////////////////////////////////////////////////////
+   // Pops up to ulMaxSize_ elements.  If the ring is empty, waits up
+   // to ulWaitTime_ ms for data to arrive.
+   // Returns the number of elements popped, 0 on timeout.
+   /////////////////////////////////////////////////////////////////
+
+   ULONG GetCount(void) const
+   {
+      return (ulHead - ulTail);
+   }
+   /////////////////////////////////////////////////////////////////
+   // Returns the number of elements currently in the ring.
+   /////////////////////////////////////////////////////////////////
+
+   ULONG GetCapacity(void) const
+   {
+      return ulCapacity;
+   }
+
+
+  private:
+
+   TSRingBuffer(const TSRingBuffer&);              // Not copyable.
+   TSRingBuffer& operator=(const TSRingBuffer&);
+
+   DSI_CONDITION_VAR stEventPush;
+   DSI_MUTEX stMutex;
+
+   T* ptBuffer;
+   ULONG ulCapacity;
+   ULONG ulMask;
+
+   volatile ULONG ulHead;                          // Free-running write index, only written by the producer.
+   volatile ULONG ulTail;                          // Free-running read index, only written by the consumer.
+   volatile BOOL bConsumerWaiting;                 // Set by the consumer while it may block on stEventPush.
+
+};
+
+
+
+#endif //DSI_TS_RING_BUFFER_HPP
@@ -27,6 +27,7 @@ All rights reserved.
 #include "macros.h"
 #include "version.h"
 #include "usb_device_handle.hpp"
+#include "usb_device_registry.hpp"
 #include "dsi_serial_generic.hpp"
 #include "dsi_serial_vcp.hpp"
 #include "dsi_framer_ant.hpp"
@@ -742,7 +743,7 @@ EXPORT ULONG ANT_GetDeviceSerialNumber(DSISerialGeneric* SerialPtr)
 ///////////////////////////////////////////////////////////////////////
 EXPORT ULONG ANT_GetNumDevices()
 {
-   return USBDeviceHandle::GetAllDevices().GetSize();
+   return USBDeviceRegistry::GetAllDevices().GetSize();
 }
 
 
@@ -466,29 +466,23 @@ DSI_THREAD_RETURN HRMReceiver::RunMessageThread(void *pvParameter_)
 ////////////////////////////////////////////////////////////////////////////////
 void HRMReceiver::MessageThread()
 {
-   ANT_MESSAGE stMessage;
-   USHORT usSize;
+   ANT_MESSAGE_ITEM astMessages[MESSAGE_BATCH_SIZE];
+   ULONG ulMessages;
    bDone = FALSE;
 
    while(!bDone)
    {
-      if(pclMessageObject->WaitForMessage(1000))
+      if(pclMessageObject->WaitForMessages(1000))
       {
-         usSize = pclMessageObject->GetMessage(&stMessage);
+         ulMessages = pclMessageObject->GetMessages(astMessages, MESSAGE_BATCH_SIZE);
 
-         if(bDone)
-            break;
-
-         if(usSize == DSI_FRAMER_ERROR)
+         for(ULONG i = 0; i < ulMessages && !bDone; i++)
          {
-            // Get the message to clear the error
-            usSize = pclMessageObject->GetMessage(&stMessage, MESG_MAX_SIZE_VALUE);
-            continue;
-         }
-
-         if(usSize != DSI_FRAMER_ERROR && usSize != DSI_FRAMER_TIMEDOUT && usSize != 0)
-         {
-            ProcessMessage(stMessage, usSize);
+            // Framer errors are skipped
+            if(astMessages[i].ucSize != DSI_FRAMER_ANT_ITEM_ERROR && astMessages[i].ucSize != 0)
+            {
+               ProcessMessage(astMessages[i].stANTMessage, astMessages[i].ucSize);
+            }
          }
       }
    }
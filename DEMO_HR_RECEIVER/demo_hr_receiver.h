@@ -47,6 +47,7 @@ All rights reserved.
 #define USER_DEVICETYPE       (120) // ANT+ HRM
 #define USER_DEVICENUM        (0) // Wildcarded for pairing (default)
 #define MESSAGE_TIMEOUT       (12) // = 12*2.5 = 30 seconds
+#define MESSAGE_BATCH_SIZE    (16) // Messages taken from the framer at a time
 #define USER_NETWORK_NUM      (0) // The network key is assigned to this network number (default)
 
 // Permitted ANT+ HRM Message periods
@@ -37,6 +37,7 @@ All rights reserved.
 #define USER_PERIOD          (8070)   // HRM Profile specified
 
 #define MESSAGE_TIMEOUT       (1000)
+#define MESSAGE_BATCH_SIZE    (16)     // Messages taken from the framer at a time
 
 //Simulated device information - would be set by manufacturer for specific devices
 #define HRM_MANUFACTURER_ID            (0x01)
@@ -409,29 +410,23 @@ DSI_THREAD_RETURN Demo::RunMessageThread(void *pvParameter_)
 ////////////////////////////////////////////////////////////////////////////////
 void Demo::MessageThread()
 {
-   ANT_MESSAGE stMessage;
-   USHORT usSize;
+   ANT_MESSAGE_ITEM astMessages[MESSAGE_BATCH_SIZE];
+   ULONG ulMessages;
    bDone = FALSE;
 
    while(!bDone)
    {
-      if(pclMessageObject->WaitForMessage(1000))
+      if(pclMessageObject->WaitForMessages(1000))
       {
-         usSize = pclMessageObject->GetMessage(&stMessage);
+         ulMessages = pclMessageObject->GetMessages(astMessages, MESSAGE_BATCH_SIZE);
 
-         if(bDone)
-            break;
-
-         if(usSize == DSI_FRAMER_ERROR)
+         for(ULONG i = 0; i < ulMessages && !bDone; i++)
          {
-            // Get the message to clear the error
-            usSize = pclMessageObject->GetMessage(&stMessage, MESG_MAX_SIZE_VALUE);
-            continue;
-         }
-
-         if(usSize != DSI_FRAMER_ERROR && usSize != DSI_FRAMER_TIMEDOUT && usSize != 0)
-         {
-            ProcessMessage(stMessage, usSize);
+            // Framer errors are skipped
+            if(astMessages[i].ucSize != DSI_FRAMER_ANT_ITEM_ERROR && astMessages[i].ucSize != 0)
+            {
+               ProcessMessage(astMessages[i].stANTMessage, astMessages[i].ucSize);
+            }
          }
       }
    }